@@ -0,0 +1,139 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_ASYNC_CALL_QUEUE_H_
+#define COMMON_ASYNC_CALL_QUEUE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+
+namespace cloud_kms {
+
+// A sequence of asynchronous calls (for example, KmsClient::RawEncryptAsync),
+// whose results are consumed in the order that the calls were started. At most
+// `max_in_flight` calls are incomplete at any time.
+//
+// This class is not thread-safe, but callbacks may complete on any thread.
+// Calls that are still in flight when the queue is destroyed are abandoned:
+// they run to completion, and their results are discarded.
+template <typename Response>
+class AsyncCallQueue {
+ public:
+  using Callback = std::function<void(absl::StatusOr<Response>)>;
+
+  explicit AsyncCallQueue(size_t max_in_flight)
+      : state_(std::make_shared<State>(std::max<size_t>(max_in_flight, 1))) {}
+
+  AsyncCallQueue(const AsyncCallQueue&) = delete;
+  AsyncCallQueue& operator=(const AsyncCallQueue&) = delete;
+
+  // Starts a call by invoking `start` with the callback that receives its
+  // result. Blocks while `max_in_flight` calls are incomplete.
+  void Start(absl::FunctionRef<void(Callback)> start);
+
+  // Returns the number of calls whose results have not been taken by Pop.
+  size_t size() const {
+    absl::MutexLock lock(&state_->mutex);
+    return state_->results.size();
+  }
+
+  bool empty() const { return size() == 0; }
+
+  // Returns true if the earliest call whose result has not been taken has
+  // completed, so that Pop will not block.
+  bool FrontReady() const {
+    absl::MutexLock lock(&state_->mutex);
+    return !state_->results.empty() && state_->results.front().has_value();
+  }
+
+  // Waits for the earliest call whose result has not been taken to complete,
+  // and returns its result. The queue must not be empty.
+  absl::StatusOr<Response> Pop();
+
+ private:
+  struct State {
+    explicit State(size_t max_in_flight) : max_in_flight(max_in_flight) {}
+
+    const size_t max_in_flight;
+
+    absl::Mutex mutex;
+    size_t in_flight ABSL_GUARDED_BY(mutex) = 0;
+    // The index of the call whose result is at the front of `results`.
+    uint64_t front_index ABSL_GUARDED_BY(mutex) = 0;
+    std::deque<std::optional<absl::StatusOr<Response>>> results
+        ABSL_GUARDED_BY(mutex);
+  };
+
+  // Callbacks hold a reference to the state, so that they remain safe to
+  // invoke after the queue is destroyed.
+  std::shared_ptr<State> state_;
+};
+
+template <typename Response>
+void AsyncCallQueue<Response>::Start(absl::FunctionRef<void(Callback)> start) {
+  uint64_t index;
+  {
+    absl::MutexLock lock(&state_->mutex);
+    State* state = state_.get();
+    auto has_capacity = [state]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(
+                            state->mutex) {
+      return state->in_flight < state->max_in_flight;
+    };
+    state_->mutex.Await(absl::Condition(&has_capacity));
+
+    state_->in_flight++;
+    index = state_->front_index + state_->results.size();
+    state_->results.emplace_back();
+  }
+
+  // The lock is not held here, since `start` may invoke the callback inline.
+  start([state = state_, index](absl::StatusOr<Response> result) {
+    absl::MutexLock lock(&state->mutex);
+    state->in_flight--;
+    // Results are only removed once they are set, so this call's result is
+    // still in the queue.
+    state->results[index - state->front_index] = std::move(result);
+  });
+}
+
+template <typename Response>
+absl::StatusOr<Response> AsyncCallQueue<Response>::Pop() {
+  absl::MutexLock lock(&state_->mutex);
+  State* state = state_.get();
+  auto front_ready = [state]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(state->mutex) {
+    return state->results.front().has_value();
+  };
+  state_->mutex.Await(absl::Condition(&front_ready));
+
+  absl::StatusOr<Response> result = std::move(*state_->results.front());
+  state_->results.pop_front();
+  state_->front_index++;
+  return result;
+}
+
+}  // namespace cloud_kms
+
+#endif  // COMMON_ASYNC_CALL_QUEUE_H_
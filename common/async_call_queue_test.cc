@@ -0,0 +1,102 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/async_call_queue.h"
+
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/test/matchers.h"
+#include "common/test/test_status_macros.h"
+#include "gmock/gmock.h"
+
+namespace cloud_kms {
+namespace {
+
+using Queue = AsyncCallQueue<int>;
+
+TEST(AsyncCallQueueTest, ResultsArePoppedInStartOrder) {
+  Queue queue(8);
+  std::vector<Queue::Callback> callbacks;
+  for (int i = 0; i < 3; i++) {
+    queue.Start([&](Queue::Callback cb) { callbacks.push_back(cb); });
+  }
+  EXPECT_EQ(queue.size(), 3);
+  EXPECT_FALSE(queue.FrontReady());
+
+  callbacks[2](2);
+  callbacks[1](1);
+  EXPECT_FALSE(queue.FrontReady());
+  callbacks[0](0);
+  EXPECT_TRUE(queue.FrontReady());
+
+  EXPECT_THAT(queue.Pop(), IsOkAndHolds(0));
+  EXPECT_THAT(queue.Pop(), IsOkAndHolds(1));
+  EXPECT_THAT(queue.Pop(), IsOkAndHolds(2));
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(AsyncCallQueueTest, CallbackMayBeInvokedInline) {
+  Queue queue(1);
+  queue.Start([](Queue::Callback cb) { cb(absl::InternalError("failed")); });
+  queue.Start([](Queue::Callback cb) { cb(5); });
+
+  EXPECT_THAT(queue.Pop(), StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(queue.Pop(), IsOkAndHolds(5));
+}
+
+TEST(AsyncCallQueueTest, PopWaitsForCompletion) {
+  Queue queue(4);
+  std::thread thread;
+  queue.Start([&](Queue::Callback cb) {
+    thread = std::thread([cb] {
+      absl::SleepFor(absl::Milliseconds(10));
+      cb(7);
+    });
+  });
+
+  EXPECT_THAT(queue.Pop(), IsOkAndHolds(7));
+  thread.join();
+}
+
+TEST(AsyncCallQueueTest, StartWaitsForCapacity) {
+  Queue queue(2);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 100; i++) {
+    queue.Start([&threads, i](Queue::Callback cb) {
+      threads.emplace_back([cb, i] { cb(i); });
+    });
+  }
+  for (int i = 0; i < 100; i++) {
+    EXPECT_THAT(queue.Pop(), IsOkAndHolds(i));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(AsyncCallQueueTest, CallsMayCompleteAfterDestruction) {
+  Queue::Callback callback;
+  {
+    Queue queue(1);
+    queue.Start([&](Queue::Callback cb) { callback = cb; });
+  }
+  callback(1);
+}
+
+}  // namespace
+}  // namespace cloud_kms
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/async_log_writer.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "absl/time/time.h"
+
+namespace cloud_kms {
+namespace {
+
+// The writer thread hands lines to the write function in batches of up to
+// this many bytes.
+constexpr size_t kMaxBatchBytes = 64 * 1024;
+
+}  // namespace
+
+AsyncLogWriter::AsyncLogWriter(Options options, WriteFunction write)
+    : mask_(std::bit_ceil(std::max<size_t>(options.capacity, 2)) - 1),
+      overflow_policy_(options.overflow_policy),
+      write_(std::move(write)),
+      slots_(new Slot[mask_ + 1]),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      dropped_(0),
+      writer_idle_(false),
+      shutdown_(false),
+      written_(0) {
+  for (size_t i = 0; i <= mask_; i++) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  thread_ = std::thread(&AsyncLogWriter::Run, this);
+}
+
+AsyncLogWriter::~AsyncLogWriter() {
+  {
+    absl::MutexLock lock(&mutex_);
+    shutdown_ = true;
+    wake_.Signal();
+  }
+  thread_.join();
+}
+
+bool AsyncLogWriter::TryEnqueue(std::string& line) {
+  uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Slot* slot;
+  for (;;) {
+    slot = &slots_[pos & mask_];
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    int64_t diff = static_cast<int64_t>(sequence - pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The slot still holds a line from the previous lap: the buffer is full.
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->line = std::move(line);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool AsyncLogWriter::TryDequeue(std::string& line) {
+  Slot& slot = slots_[dequeue_pos_ & mask_];
+  if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+    return false;
+  }
+  line = std::move(slot.line);
+  slot.line.clear();
+  slot.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+  dequeue_pos_++;
+  return true;
+}
+
+bool AsyncLogWriter::Empty() const {
+  return slots_[dequeue_pos_ & mask_].sequence.load(
+             std::memory_order_acquire) != dequeue_pos_ + 1;
+}
+
+void AsyncLogWriter::WakeWriter() {
+  absl::MutexLock lock(&mutex_);
+  wake_.Signal();
+}
+
+bool AsyncLogWriter::Enqueue(std::string line) {
+  while (!TryEnqueue(line)) {
+    if (overflow_policy_ == OverflowPolicy::kDrop) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    WakeWriter();
+    absl::MutexLock lock(&mutex_);
+    uint64_t written = written_;
+    auto progressed = [this, written]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+      return written_ != written || shutdown_;
+    };
+    mutex_.AwaitWithTimeout(absl::Condition(&progressed),
+                            absl::Milliseconds(10));
+  }
+
+  // Pairs with the fence in Run: either the writer sees the new line before it
+  // goes idle, or this thread sees that it is idle and wakes it.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (writer_idle_.load(std::memory_order_relaxed)) {
+    WakeWriter();
+  }
+  return true;
+}
+
+void AsyncLogWriter::Flush() {
+  uint64_t target = enqueue_pos_.load(std::memory_order_acquire);
+  WakeWriter();
+
+  absl::MutexLock lock(&mutex_);
+  auto flushed = [this, target]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return written_ >= target;
+  };
+  mutex_.Await(absl::Condition(&flushed));
+}
+
+void AsyncLogWriter::Run() {
+  std::string batch;
+  std::string line;
+  uint64_t reported_dropped = 0;
+
+  for (;;) {
+    batch.clear();
+    uint64_t lines = 0;
+    while (batch.size() < kMaxBatchBytes && TryDequeue(line)) {
+      batch.append(line);
+      lines++;
+    }
+
+    if (lines > 0) {
+      uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+      write_(batch, dropped - reported_dropped);
+      reported_dropped = dropped;
+
+      absl::MutexLock lock(&mutex_);
+      written_ += lines;
+      continue;
+    }
+
+    absl::MutexLock lock(&mutex_);
+    writer_idle_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (Empty() && !shutdown_) {
+      wake_.Wait(&mutex_);
+    }
+    writer_idle_.store(false, std::memory_order_relaxed);
+
+    if (shutdown_ && Empty()) {
+      uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+      if (dropped > reported_dropped) {
+        write_("", dropped - reported_dropped);
+      }
+      return;
+    }
+  }
+}
+
+}  // namespace cloud_kms
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_ASYNC_LOG_WRITER_H_
+#define COMMON_ASYNC_LOG_WRITER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/synchronization/mutex.h"
+
+namespace cloud_kms {
+
+// Accepts log lines from any number of threads, and writes them in batches
+// from a background thread.
+//
+// Lines are held in a bounded ring buffer. Enqueuing a line takes no locks
+// unless the writer thread is idle and must be woken, or the buffer is full and
+// the overflow policy is kBlock.
+class AsyncLogWriter {
+ public:
+  enum class OverflowPolicy {
+    // Lines that arrive while the buffer is full are discarded and counted.
+    kDrop,
+    // Enqueue waits for the writer thread to make room.
+    kBlock,
+  };
+
+  struct Options {
+    // The number of lines the buffer holds. Rounded up to a power of two.
+    size_t capacity = 4096;
+    OverflowPolicy overflow_policy = OverflowPolicy::kDrop;
+  };
+
+  // Invoked on the writer thread with one or more complete lines, and the
+  // number of lines that were dropped since the previous invocation.
+  using WriteFunction =
+      absl::AnyInvocable<void(std::string_view lines, uint64_t dropped)>;
+
+  AsyncLogWriter(Options options, WriteFunction write);
+
+  // Writes any lines that remain in the buffer, then stops the writer thread.
+  ~AsyncLogWriter();
+
+  AsyncLogWriter(const AsyncLogWriter&) = delete;
+  AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+
+  // Queues `line` to be written. Returns false if the line was dropped.
+  bool Enqueue(std::string line);
+
+  // Blocks until every line enqueued before this call has been written. Must
+  // not be called from the write function.
+  void Flush();
+
+  // Returns the total number of lines that have been dropped.
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Slot {
+    // Equal to the slot's position when it is free for the producer that
+    // claims that position, and to the position plus one once the line has
+    // been stored.
+    std::atomic<uint64_t> sequence;
+    std::string line;
+  };
+
+  bool TryEnqueue(std::string& line);
+  // May only be called on the writer thread.
+  bool TryDequeue(std::string& line);
+  bool Empty() const;
+  void WakeWriter();
+  void Run();
+
+  const size_t mask_;
+  const OverflowPolicy overflow_policy_;
+  WriteFunction write_;
+  std::unique_ptr<Slot[]> slots_;
+
+  std::atomic<uint64_t> enqueue_pos_;
+  uint64_t dequeue_pos_;  // Only accessed by the writer thread.
+  std::atomic<uint64_t> dropped_;
+  std::atomic<bool> writer_idle_;
+
+  absl::Mutex mutex_;
+  absl::CondVar wake_;
+  bool shutdown_ ABSL_GUARDED_BY(mutex_);
+  // The number of lines that have been handed to the write function.
+  uint64_t written_ ABSL_GUARDED_BY(mutex_);
+
+  std::thread thread_;
+};
+
+}  // namespace cloud_kms
+
+#endif  // COMMON_ASYNC_LOG_WRITER_H_
@@ -0,0 +1,170 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/async_log_writer.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/synchronization/notification.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace cloud_kms {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAreArray;
+
+// Collects everything passed to an AsyncLogWriter's write function.
+class Collector {
+ public:
+  AsyncLogWriter::WriteFunction Function() {
+    return [this](std::string_view lines, uint64_t dropped) {
+      absl::MutexLock lock(&mutex_);
+      output_.append(lines);
+      dropped_ += dropped;
+      calls_++;
+    };
+  }
+
+  std::vector<std::string> Lines() {
+    absl::MutexLock lock(&mutex_);
+    return absl::StrSplit(output_, '\n', absl::SkipEmpty());
+  }
+
+  uint64_t dropped() {
+    absl::MutexLock lock(&mutex_);
+    return dropped_;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  std::string output_ ABSL_GUARDED_BY(mutex_);
+  uint64_t dropped_ ABSL_GUARDED_BY(mutex_) = 0;
+  int calls_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+TEST(AsyncLogWriterTest, FlushWritesEnqueuedLines) {
+  Collector collector;
+  AsyncLogWriter writer(AsyncLogWriter::Options(), collector.Function());
+
+  EXPECT_TRUE(writer.Enqueue("first\n"));
+  EXPECT_TRUE(writer.Enqueue("second\n"));
+  writer.Flush();
+
+  EXPECT_THAT(collector.Lines(), ElementsAre("first", "second"));
+}
+
+TEST(AsyncLogWriterTest, DestructorWritesEnqueuedLines) {
+  Collector collector;
+  {
+    AsyncLogWriter writer(AsyncLogWriter::Options(), collector.Function());
+    for (int i = 0; i < 100; i++) {
+      writer.Enqueue(absl::StrCat(i, "\n"));
+    }
+  }
+
+  EXPECT_EQ(collector.Lines().size(), 100);
+}
+
+TEST(AsyncLogWriterTest, FlushWithNothingEnqueuedReturns) {
+  Collector collector;
+  AsyncLogWriter writer(AsyncLogWriter::Options(), collector.Function());
+
+  writer.Flush();
+  EXPECT_THAT(collector.Lines(), IsEmpty());
+}
+
+TEST(AsyncLogWriterTest, LinesAreDroppedWhenFull) {
+  absl::Notification release;
+  Collector collector;
+  AsyncLogWriter::WriteFunction collect = collector.Function();
+  AsyncLogWriter writer(
+      AsyncLogWriter::Options{.capacity = 2},
+      [&](std::string_view lines, uint64_t dropped) {
+        release.WaitForNotification();
+        collect(lines, dropped);
+      });
+
+  // The writer takes at most one batch while it is blocked, so at least two
+  // of these lines remain in the buffer, and the rest are dropped.
+  int enqueued = 0;
+  for (int i = 0; i < 10; i++) {
+    enqueued += writer.Enqueue(absl::StrCat(i, "\n"));
+  }
+  EXPECT_LE(enqueued, 4);
+  EXPECT_EQ(writer.dropped(), 10 - enqueued);
+
+  release.Notify();
+  writer.Flush();
+  EXPECT_EQ(collector.Lines().size(), enqueued);
+  EXPECT_EQ(collector.dropped(), 10 - enqueued);
+}
+
+TEST(AsyncLogWriterTest, BlockPolicyNeverDrops) {
+  Collector collector;
+  AsyncLogWriter writer(
+      AsyncLogWriter::Options{
+          .capacity = 4,
+          .overflow_policy = AsyncLogWriter::OverflowPolicy::kBlock,
+      },
+      collector.Function());
+
+  std::vector<std::string> expected;
+  for (int i = 0; i < 1000; i++) {
+    expected.push_back(absl::StrCat(i));
+    EXPECT_TRUE(writer.Enqueue(absl::StrCat(i, "\n")));
+  }
+  writer.Flush();
+
+  EXPECT_EQ(writer.dropped(), 0);
+  EXPECT_EQ(collector.Lines(), expected);
+}
+
+TEST(AsyncLogWriterTest, ConcurrentProducers) {
+  Collector collector;
+  AsyncLogWriter writer(
+      AsyncLogWriter::Options{
+          .capacity = 64,
+          .overflow_policy = AsyncLogWriter::OverflowPolicy::kBlock,
+      },
+      collector.Function());
+
+  std::vector<std::string> expected;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    for (int j = 0; j < 500; j++) {
+      expected.push_back(absl::StrCat(i, "-", j));
+    }
+    threads.emplace_back([&writer, i] {
+      for (int j = 0; j < 500; j++) {
+        writer.Enqueue(absl::StrCat(i, "-", j, "\n"));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  writer.Flush();
+
+  EXPECT_THAT(collector.Lines(), UnorderedElementsAreArray(expected));
+}
+
+}  // namespace
+}  // namespace cloud_kms
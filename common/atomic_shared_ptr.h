@@ -0,0 +1,77 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_ATOMIC_SHARED_PTR_H_
+#define COMMON_ATOMIC_SHARED_PTR_H_
+
+#include <atomic>
+#include <memory>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace cloud_kms {
+
+// A std::shared_ptr that may be loaded and replaced concurrently. This allows
+// readers to take a reference to an immutable value without blocking on, or
+// being blocked by, a writer that is publishing a replacement.
+//
+// This uses std::atomic<std::shared_ptr<T>> where the standard library
+// provides it. Otherwise, the pointer is guarded by a mutex that is held only
+// while it is copied or swapped; the C++20-deprecated atomic free functions
+// for shared_ptr are avoided so that the build stays warning-free.
+template <typename T>
+class AtomicSharedPtr {
+ public:
+  AtomicSharedPtr() = default;
+  explicit AtomicSharedPtr(std::shared_ptr<T> value) : ptr_(std::move(value)) {}
+
+  AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+  AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+  std::shared_ptr<T> Load() const {
+#ifdef __cpp_lib_atomic_shared_ptr
+    return ptr_.load(std::memory_order_acquire);
+#else
+    absl::MutexLock lock(&mutex_);
+    return ptr_;
+#endif
+  }
+
+  void Store(std::shared_ptr<T> value) {
+#ifdef __cpp_lib_atomic_shared_ptr
+    ptr_.store(std::move(value), std::memory_order_release);
+#else
+    {
+      absl::MutexLock lock(&mutex_);
+      ptr_.swap(value);
+    }
+    // The previous value, now in `value`, is released outside the lock.
+#endif
+  }
+
+ private:
+#ifdef __cpp_lib_atomic_shared_ptr
+  std::atomic<std::shared_ptr<T>> ptr_;
+#else
+  mutable absl::Mutex mutex_;
+  std::shared_ptr<T> ptr_ ABSL_GUARDED_BY(mutex_);
+#endif
+};
+
+}  // namespace cloud_kms
+
+#endif  // COMMON_ATOMIC_SHARED_PTR_H_
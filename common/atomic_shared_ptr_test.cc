@@ -0,0 +1,78 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/atomic_shared_ptr.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+namespace cloud_kms {
+namespace {
+
+TEST(AtomicSharedPtrTest, DefaultIsNull) {
+  AtomicSharedPtr<int> ptr;
+  EXPECT_EQ(ptr.Load(), nullptr);
+}
+
+TEST(AtomicSharedPtrTest, LoadReturnsStoredValue) {
+  AtomicSharedPtr<const int> ptr(std::make_shared<const int>(1));
+  EXPECT_EQ(*ptr.Load(), 1);
+
+  std::shared_ptr<const int> value = std::make_shared<const int>(2);
+  ptr.Store(value);
+  EXPECT_EQ(ptr.Load(), value);
+}
+
+TEST(AtomicSharedPtrTest, LoadedValueOutlivesReplacement) {
+  AtomicSharedPtr<const int> ptr(std::make_shared<const int>(1));
+  std::shared_ptr<const int> loaded = ptr.Load();
+
+  ptr.Store(std::make_shared<const int>(2));
+
+  EXPECT_EQ(*loaded, 1);
+  EXPECT_EQ(*ptr.Load(), 2);
+}
+
+TEST(AtomicSharedPtrTest, ConcurrentLoadsObserveMonotonicValues) {
+  AtomicSharedPtr<const int> ptr(std::make_shared<const int>(0));
+  std::atomic<bool> done(false);
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&]() {
+      int last = 0;
+      while (!done.load()) {
+        int current = *ptr.Load();
+        EXPECT_GE(current, last);
+        last = current;
+      }
+    });
+  }
+
+  for (int i = 1; i <= 10000; i++) {
+    ptr.Store(std::make_shared<const int>(i));
+  }
+  done.store(true);
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(*ptr.Load(), 10000);
+}
+
+}  // namespace
+}  // namespace cloud_kms
@@ -14,6 +14,7 @@
 
 #include "common/file_log_sink.h"
 
+#include <filesystem>
 #include <fstream>
 
 #include "absl/log/log.h"
@@ -38,6 +39,11 @@ std::string GetLogSeverityPrefix(absl::LogSeverity severity) {
 
 absl::StatusOr<std::unique_ptr<FileLogSink>> FileLogSink::New(
     absl::string_view file_name) {
+  return New(file_name, Options());
+}
+
+absl::StatusOr<std::unique_ptr<FileLogSink>> FileLogSink::New(
+    absl::string_view file_name, const Options& options) {
   // Try to open the file for appending to it and return an error if the file
   // could not be opened.
   std::ofstream s(std::string(file_name).c_str(), std::ofstream::app);
@@ -45,12 +51,25 @@ absl::StatusOr<std::unique_ptr<FileLogSink>> FileLogSink::New(
     return absl::InvalidArgumentError(
         absl::StrCat("Could not open file ", file_name));
   }
-  return absl::WrapUnique(new FileLogSink(std::move(s)));
+  return absl::WrapUnique(
+      new FileLogSink(std::string(file_name), std::move(s), options));
+}
+
+FileLogSink::~FileLogSink() {
+  // Drain the buffer before the stream is closed.
+  writer_.reset();
 }
 
 void FileLogSink::Send(const absl::LogEntry& e) {
-  stream_ << GetLogSeverityPrefix(e.log_severity()) << "\t"
-          << e.text_message_with_newline();
+  std::string line = absl::StrCat(GetLogSeverityPrefix(e.log_severity()), "\t",
+                                  e.text_message_with_newline());
+  if (!writer_) {
+    Write(line);
+  } else if (!writer_->Enqueue(line) &&
+             e.log_severity() == absl::LogSeverity::kFatal) {
+    // Never drop a fatal entry; it is likely to explain the crash.
+    Write(line);
+  }
   // If we are logging a fatal error, flush the sink now because the process
   // will terminate right after this function returns.
   if (e.log_severity() == absl::LogSeverity::kFatal) {
@@ -58,8 +77,74 @@ void FileLogSink::Send(const absl::LogEntry& e) {
   }
 };
 
-void FileLogSink::Flush() { stream_.flush(); };
+void FileLogSink::Flush() {
+  if (writer_) {
+    writer_->Flush();
+  }
+  absl::MutexLock lock(&mutex_);
+  stream_.flush();
+};
+
+uint64_t FileLogSink::dropped_entries() const {
+  return writer_ ? writer_->dropped() : 0;
+}
+
+FileLogSink::FileLogSink(std::string file_name, std::ofstream stream,
+                         const Options& options)
+    : file_name_(std::move(file_name)),
+      max_file_bytes_(options.max_file_bytes),
+      max_rotated_files_(options.max_rotated_files),
+      stream_(std::move(stream)),
+      file_bytes_(0) {
+  std::error_code ec;
+  uintmax_t size = std::filesystem::file_size(file_name_, ec);
+  if (!ec) {
+    file_bytes_ = size;
+  }
+
+  if (options.async) {
+    writer_ = std::make_unique<AsyncLogWriter>(
+        options.async_options,
+        [this](absl::string_view lines, uint64_t dropped) {
+          if (dropped > 0) {
+            Write(absl::StrFormat("[W]\tdropped %d log entries\n", dropped));
+          }
+          Write(lines);
+          // Each batch reaches the file in a single write where possible.
+          absl::MutexLock lock(&mutex_);
+          stream_.flush();
+        });
+  }
+}
 
-FileLogSink::FileLogSink(std::ofstream stream) { stream_ = std::move(stream); }
+void FileLogSink::Write(absl::string_view data) {
+  absl::MutexLock lock(&mutex_);
+  if (max_file_bytes_ > 0 && file_bytes_ > 0 &&
+      file_bytes_ + data.size() > max_file_bytes_) {
+    Rotate();
+  }
+  stream_.write(data.data(), data.size());
+  file_bytes_ += data.size();
+}
+
+void FileLogSink::Rotate() {
+  stream_.close();
+
+  // Rename failures are ignored: at worst, entries are appended to a file that
+  // is larger than the configured maximum.
+  std::error_code ec;
+  if (max_rotated_files_ < 1) {
+    std::filesystem::remove(file_name_, ec);
+  } else {
+    for (int i = max_rotated_files_; i > 1; i--) {
+      std::filesystem::rename(absl::StrCat(file_name_, ".", i - 1),
+                              absl::StrCat(file_name_, ".", i), ec);
+    }
+    std::filesystem::rename(file_name_, absl::StrCat(file_name_, ".1"), ec);
+  }
+
+  stream_.open(file_name_, std::ofstream::app);
+  file_bytes_ = 0;
+}
 
 }  // namespace cloud_kms
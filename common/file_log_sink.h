@@ -18,20 +18,45 @@
 #define COMMON_FILE_LOG_SINK_H_
 
 #include <fstream>
+#include <memory>
+#include <string>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "common/async_log_writer.h"
 
 namespace cloud_kms {
 // A simple log sink that is writing all INFO log entries to a file.
 class FileLogSink : public absl::LogSink {
  public:
+  struct Options {
+    // If true, entries are formatted on the logging thread and written to the
+    // file in batches by a background thread, so that logging never waits for
+    // the disk. FATAL entries are always written before Send returns.
+    bool async = false;
+    // Buffering options for asynchronous mode.
+    AsyncLogWriter::Options async_options;
+    // If non-zero, the file is rotated before a write would grow it beyond
+    // this many bytes: file_name is renamed to file_name.1 (and file_name.1 to
+    // file_name.2, and so on) and a new file is started.
+    uint64_t max_file_bytes = 0;
+    // The number of rotated files that are kept.
+    int max_rotated_files = 1;
+  };
+
   // Create a new FileLogSink that writes in the specified file_name.
   // Any logs are appended to the contents of the file if the file already
   // exists. Returns an error if the file cannot be opened.
   static absl::StatusOr<std::unique_ptr<FileLogSink>> New(
       absl::string_view file_name);
+  static absl::StatusOr<std::unique_ptr<FileLogSink>> New(
+      absl::string_view file_name, const Options& options);
+
+  // Writes any buffered entries, then closes the file.
+  ~FileLogSink() override;
 
   // Logs messages to the specified file.
   // Writing to the file may fail silently.
@@ -40,10 +65,28 @@ class FileLogSink : public absl::LogSink {
   // Flush the buffer to file.
   void Flush() override;
 
+  // Returns the number of entries that were discarded because the buffer was
+  // full. Always zero in synchronous mode.
+  uint64_t dropped_entries() const;
+
  private:
-  std::ofstream stream_;
+  FileLogSink(std::string file_name, std::ofstream stream,
+              const Options& options);
+
+  // Appends `data` to the file, rotating it first if necessary.
+  void Write(absl::string_view data);
+  void Rotate() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const std::string file_name_;
+  const uint64_t max_file_bytes_;
+  const int max_rotated_files_;
+
+  absl::Mutex mutex_;
+  std::ofstream stream_ ABSL_GUARDED_BY(mutex_);
+  uint64_t file_bytes_ ABSL_GUARDED_BY(mutex_);
 
-  FileLogSink(std::ofstream stream);
+  // Set in asynchronous mode.
+  std::unique_ptr<AsyncLogWriter> writer_;
 };
 
 }  // namespace cloud_kms
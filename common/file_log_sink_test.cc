@@ -14,11 +14,13 @@
 
 #include "common/file_log_sink.h"
 
+#include <cstdio>
 #include <fstream>
 #include <streambuf>
 #include <string>
 
 #include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
 #include "common/test/test_status_macros.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -28,6 +30,7 @@ namespace {
 
 using ::testing::_;
 using ::testing::HasSubstr;
+using ::testing::Not;
 
 std::string ReadFile(const char* file_name) {
   std::ifstream stream(file_name);
@@ -140,5 +143,101 @@ TEST(FileLogSinkTest, NewLogSinkAppendsToExistingFile) {
   EXPECT_NE(ReadFile(dest_path.c_str()).find(init_entry), std::string::npos);
 }
 
+TEST(FileLogSinkTest, AsyncEntriesAreWrittenOnFlush) {
+  std::string dest_path = "test_async.log";
+  std::remove(dest_path.c_str());
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<FileLogSink> sink,
+      FileLogSink::New(dest_path, FileLogSink::Options{.async = true}));
+
+  std::string first_entry = "first async entry";
+  LOG(INFO).ToSinkOnly(sink.get()) << first_entry;
+  std::string second_entry = "second async entry";
+  LOG(WARNING).ToSinkOnly(sink.get()) << second_entry;
+  sink->Flush();
+
+  std::string contents = ReadFile(dest_path.c_str());
+  EXPECT_THAT(contents, HasSubstr(absl::StrCat("[I]\t", first_entry)));
+  EXPECT_THAT(contents, HasSubstr(absl::StrCat("[W]\t", second_entry)));
+  EXPECT_EQ(sink->dropped_entries(), 0);
+}
+
+TEST(FileLogSinkTest, AsyncEntriesAreWrittenOnDestruction) {
+  std::string dest_path = "test_async.log";
+  std::remove(dest_path.c_str());
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<FileLogSink> sink,
+      FileLogSink::New(dest_path, FileLogSink::Options{.async = true}));
+
+  for (int i = 0; i < 100; i++) {
+    LOG(INFO).ToSinkOnly(sink.get()) << "entry " << i;
+  }
+  sink.reset();
+
+  EXPECT_THAT(ReadFile(dest_path.c_str()), HasSubstr("entry 99"));
+}
+
+TEST(FileLogSinkTest, AsyncFatalLogsAreWrittenToFile) {
+  // The writer thread does not survive a fork, so the death test must
+  // re-execute the test binary and create its own sink.
+  GTEST_FLAG_SET(death_test_style, "threadsafe");
+  std::string dest_path = "test_async.log";
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<FileLogSink> sink,
+      FileLogSink::New(dest_path, FileLogSink::Options{.async = true}));
+
+  std::string entry = "async fatal entry";
+  EXPECT_DEATH(LOG(FATAL).ToSinkOnly(sink.get()) << entry, _);
+
+  EXPECT_THAT(ReadFile(dest_path.c_str()), HasSubstr(entry));
+}
+
+TEST(FileLogSinkTest, FileIsRotatedAtMaxSize) {
+  std::string dest_path = "test_rotation.log";
+  std::string rotated_path = dest_path + ".1";
+  std::remove(dest_path.c_str());
+  std::remove(rotated_path.c_str());
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<FileLogSink> sink,
+      FileLogSink::New(dest_path, FileLogSink::Options{.max_file_bytes = 64}));
+
+  std::string first_entry(40, 'a');
+  LOG(INFO).ToSinkOnly(sink.get()) << first_entry;
+  std::string second_entry(40, 'b');
+  LOG(INFO).ToSinkOnly(sink.get()) << second_entry;
+  sink.reset();
+
+  EXPECT_THAT(ReadFile(rotated_path.c_str()), HasSubstr(first_entry));
+  EXPECT_THAT(ReadFile(dest_path.c_str()), HasSubstr(second_entry));
+  EXPECT_THAT(ReadFile(dest_path.c_str()), Not(HasSubstr(first_entry)));
+}
+
+TEST(FileLogSinkTest, RotationKeepsMaxRotatedFiles) {
+  std::string dest_path = "test_rotation.log";
+  for (std::string path : {dest_path, dest_path + ".1", dest_path + ".2",
+                           dest_path + ".3"}) {
+    std::remove(path.c_str());
+  }
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<FileLogSink> sink,
+                       FileLogSink::New(dest_path, FileLogSink::Options{
+                                                       .async = true,
+                                                       .max_file_bytes = 16,
+                                                       .max_rotated_files = 2,
+                                                   }));
+
+  for (char c : {'a', 'b', 'c', 'd'}) {
+    LOG(INFO).ToSinkOnly(sink.get()) << std::string(12, c);
+    sink->Flush();
+  }
+  sink.reset();
+
+  EXPECT_THAT(ReadFile(dest_path.c_str()), HasSubstr(std::string(12, 'd')));
+  EXPECT_THAT(ReadFile((dest_path + ".1").c_str()),
+              HasSubstr(std::string(12, 'c')));
+  EXPECT_THAT(ReadFile((dest_path + ".2").c_str()),
+              HasSubstr(std::string(12, 'b')));
+  EXPECT_FALSE(std::ifstream(dest_path + ".3").good());
+}
+
 }  // namespace
 }  // namespace cloud_kms
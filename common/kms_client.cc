@@ -21,15 +21,40 @@
 #include "common/backoff.h"
 #include "common/openssl.h"
 #include "common/platform.h"
+#include "common/retry_policy.h"
 #include "common/source_location.h"
 #include "common/status_macros.h"
+#include "grpc/grpc.h"
 #include "grpcpp/client_context.h"
+#include "grpcpp/completion_queue.h"
 #include "grpcpp/create_channel.h"
 #include "grpcpp/security/credentials.h"
 
 namespace cloud_kms {
 namespace {
 
+// A channel argument that distinguishes the channels in a KmsClient's pool.
+constexpr char kChannelIndexArg[] = "cloud_kms.channel_index";
+
+// Methods whose requests may safely be repeated, and are therefore included in
+// DefaultRetryPolicies. CreateCryptoKey, CreateCryptoKeyVersion and
+// DestroyCryptoKeyVersion are omitted: repeating a request that succeeded
+// would create a duplicate resource or fail.
+constexpr std::string_view kRetriedMethods[] = {
+    "AsymmetricDecrypt",     "AsymmetricSign",      "GenerateRandomBytes",
+    "GetCryptoKey",          "GetCryptoKeyVersion", "GetPublicKey",
+    "ListCryptoKeyVersions", "ListCryptoKeys",      "MacSign",
+    "MacVerify",             "RawDecrypt",          "RawEncrypt",
+};
+
+// Methods whose requests may be hedged. Each of these is either read-only, or
+// (in the case of AsymmetricSign) hedged only at the caller's request.
+constexpr std::string_view kHedgedMethods[] = {
+    "AsymmetricSign", "GetCryptoKeyVersion",  "GetPublicKey",
+    "ListCryptoKeys", "ListCryptoKeyVersions", "MacSign",
+    "MacVerify",
+};
+
 // clang-format off
 // Sample value:
 // `cloud-kms-pkcs11/0.21 (amd64; BoringSSL; Linux/4.15.0-1096-gcp-x86_64; glibc/2.23)`
@@ -77,8 +102,215 @@ bool CRC32CMatches(std::string_view data, uint32_t crc32c) {
   return crc32c == ComputeCRC32C(data);
 }
 
+absl::Status ResponseChecksumMismatchError() {
+  return absl::InternalError(absl::StrFormat(
+      "at %s: the response crc32c did not match the expected checksum value",
+      SOURCE_LOCATION.ToString()));
+}
+
+absl::Status RequestChecksumNotVerifiedError() {
+  return absl::InternalError(
+      absl::StrFormat("at %s: the server did not verify the checksum values "
+                      "provided in the request",
+                      SOURCE_LOCATION.ToString()));
+}
+
+// AddRequestChecksums populates the CRC32C fields of a crypto request, so that
+// the server can verify that the request was not corrupted in transit.
+
+absl::Status AddRequestChecksums(kms_v1::AsymmetricDecryptRequest& request) {
+  request.mutable_ciphertext_crc32c()->set_value(
+      ComputeCRC32C(request.ciphertext()));
+  return absl::OkStatus();
+}
+
+absl::Status AddRequestChecksums(kms_v1::AsymmetricSignRequest& request) {
+  if (!request.data().empty()) {
+    request.mutable_data_crc32c()->set_value(ComputeCRC32C(request.data()));
+    return absl::OkStatus();
+  }
+  ASSIGN_OR_RETURN(std::string digest_string,
+                   GetDigestString(request.digest()));
+  request.mutable_digest_crc32c()->set_value(ComputeCRC32C(digest_string));
+  return absl::OkStatus();
+}
+
+absl::Status AddRequestChecksums(kms_v1::MacSignRequest& request) {
+  request.mutable_data_crc32c()->set_value(ComputeCRC32C(request.data()));
+  return absl::OkStatus();
+}
+
+absl::Status AddRequestChecksums(kms_v1::MacVerifyRequest& request) {
+  request.mutable_data_crc32c()->set_value(ComputeCRC32C(request.data()));
+  request.mutable_mac_crc32c()->set_value(ComputeCRC32C(request.mac()));
+  return absl::OkStatus();
+}
+
+absl::Status AddRequestChecksums(kms_v1::RawDecryptRequest& request) {
+  request.mutable_ciphertext_crc32c()->set_value(
+      ComputeCRC32C(request.ciphertext()));
+  request.mutable_initialization_vector_crc32c()->set_value(
+      ComputeCRC32C(request.initialization_vector()));
+  request.mutable_additional_authenticated_data_crc32c()->set_value(
+      ComputeCRC32C(request.additional_authenticated_data()));
+  return absl::OkStatus();
+}
+
+absl::Status AddRequestChecksums(kms_v1::RawEncryptRequest& request) {
+  request.mutable_plaintext_crc32c()->set_value(
+      ComputeCRC32C(request.plaintext()));
+  request.mutable_additional_authenticated_data_crc32c()->set_value(
+      ComputeCRC32C(request.additional_authenticated_data()));
+  request.mutable_initialization_vector_crc32c()->set_value(
+      ComputeCRC32C(request.initialization_vector()));
+  return absl::OkStatus();
+}
+
+// VerifyResponseChecksums ensures that the response was not corrupted in
+// transit, and that the server verified the checksums sent in the request.
+
+absl::Status VerifyResponseChecksums(
+    const kms_v1::AsymmetricDecryptRequest& request,
+    const kms_v1::AsymmetricDecryptResponse& response) {
+  if (!CRC32CMatches(response.plaintext(),
+                     response.plaintext_crc32c().value())) {
+    return ResponseChecksumMismatchError();
+  }
+  if (!response.verified_ciphertext_crc32c()) {
+    return RequestChecksumNotVerifiedError();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status VerifyResponseChecksums(
+    const kms_v1::AsymmetricSignRequest& request,
+    const kms_v1::AsymmetricSignResponse& response) {
+  if (!CRC32CMatches(response.signature(),
+                     response.signature_crc32c().value())) {
+    return ResponseChecksumMismatchError();
+  }
+  bool use_data = !request.data().empty();
+  if (use_data && !response.verified_data_crc32c()) {
+    return RequestChecksumNotVerifiedError();
+  }
+  if (!use_data && !response.verified_digest_crc32c()) {
+    return RequestChecksumNotVerifiedError();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status VerifyResponseChecksums(const kms_v1::MacSignRequest& request,
+                                     const kms_v1::MacSignResponse& response) {
+  if (!CRC32CMatches(response.mac(), response.mac_crc32c().value())) {
+    return ResponseChecksumMismatchError();
+  }
+  if (!response.verified_data_crc32c()) {
+    return RequestChecksumNotVerifiedError();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status VerifyResponseChecksums(
+    const kms_v1::MacVerifyRequest& request,
+    const kms_v1::MacVerifyResponse& response) {
+  if (response.success() != response.verified_success_integrity()) {
+    return ResponseChecksumMismatchError();
+  }
+  if (!response.verified_data_crc32c() || !response.verified_mac_crc32c()) {
+    return RequestChecksumNotVerifiedError();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status VerifyResponseChecksums(
+    const kms_v1::RawDecryptRequest& request,
+    const kms_v1::RawDecryptResponse& response) {
+  if (!CRC32CMatches(response.plaintext(),
+                     response.plaintext_crc32c().value())) {
+    return ResponseChecksumMismatchError();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status VerifyResponseChecksums(
+    const kms_v1::RawEncryptRequest& request,
+    const kms_v1::RawEncryptResponse& response) {
+  if (!CRC32CMatches(response.ciphertext(),
+                     response.ciphertext_crc32c().value())) {
+    return ResponseChecksumMismatchError();
+  }
+  if (!response.verified_plaintext_crc32c() ||
+      !response.verified_additional_authenticated_data_crc32c() ||
+      !response.verified_initialization_vector_crc32c()) {
+    return RequestChecksumNotVerifiedError();
+  }
+  return absl::OkStatus();
+}
+
+// A tag for an asynchronous call that is pending on a completion queue.
+class AsyncCallTag {
+ public:
+  virtual ~AsyncCallTag() {}
+
+  // Invoked by the poller when the call's tag is returned by the queue.
+  virtual void Complete(bool ok) = 0;
+};
+
+template <typename Request, typename Response>
+class AsyncCall : public AsyncCallTag {
+ public:
+  AsyncCall(Request request, AsyncCallback<Response> callback)
+      : request(std::move(request)), callback_(std::move(callback)) {}
+
+  void Complete(bool ok) override {
+    if (!ok) {
+      callback_(absl::InternalError(
+          absl::StrFormat("at %s: the asynchronous call did not complete",
+                          SOURCE_LOCATION.ToString())));
+      return;
+    }
+    absl::Status result = ToStatus(status);
+    if (result.ok()) {
+      result = VerifyResponseChecksums(request, response);
+    }
+    if (!result.ok()) {
+      callback_(result);
+      return;
+    }
+    callback_(std::move(response));
+  }
+
+  grpc::ClientContext ctx;
+  Request request;
+  Response response;
+  grpc::Status status;
+  std::unique_ptr<grpc::ClientAsyncResponseReader<Response>> reader;
+
+ private:
+  AsyncCallback<Response> callback_;
+};
+
+// Delivers completions from `queue` until the queue is shut down and drained.
+void PollCompletionQueue(grpc::CompletionQueue* queue) {
+  void* tag;
+  bool ok;
+  while (queue->Next(&tag, &ok)) {
+    std::unique_ptr<AsyncCallTag> call(static_cast<AsyncCallTag*>(tag));
+    call->Complete(ok);
+  }
+}
+
 }  // namespace
 
+absl::flat_hash_map<std::string, RetryPolicy> DefaultRetryPolicies(
+    int max_attempts) {
+  absl::flat_hash_map<std::string, RetryPolicy> policies;
+  for (std::string_view method : kRetriedMethods) {
+    policies[method].max_attempts = max_attempts;
+  }
+  return policies;
+}
+
 void KmsClient::AddContextSettings(grpc::ClientContext* ctx,
                                    std::string_view relative_resource,
                                    std::string_view resource_name,
@@ -96,6 +328,14 @@ void KmsClient::AddContextSettings(grpc::ClientContext* ctx,
   }
 }
 
+kms_v1::KeyManagementService::Stub* KmsClient::NextStub() const {
+  if (kms_stubs_.size() == 1) {
+    return kms_stubs_.front().get();
+  }
+  size_t index = next_stub_index_.fetch_add(1, std::memory_order_relaxed);
+  return kms_stubs_[index % kms_stubs_.size()].get();
+}
+
 absl::Status KmsClient::DecorateStatus(absl::Status& status) const {
   if (error_decorator_.has_value()) {
     (*error_decorator_)(status);
@@ -103,251 +343,437 @@ absl::Status KmsClient::DecorateStatus(absl::Status& status) const {
   return status;
 }
 
+absl::Status KmsClient::CallWithRetries(
+    std::string_view method, std::string_view resource_name,
+    absl::Time deadline,
+    absl::FunctionRef<absl::Status(absl::Time)> attempt) const {
+  if (!rpc_stats_) {
+    return AttemptWithRetries(method, deadline, attempt);
+  }
+  RpcStats::Call call = rpc_stats_->Start(method, resource_name);
+  absl::Status result = AttemptWithRetries(method, deadline, attempt);
+  call.Done(result);
+  return result;
+}
+
+absl::Status KmsClient::AttemptWithRetries(
+    std::string_view method, absl::Time deadline,
+    absl::FunctionRef<absl::Status(absl::Time)> attempt) const {
+  auto it = retry_policies_.find(method);
+  if (it == retry_policies_.end()) {
+    return attempt(deadline);
+  }
+  const RetryPolicy& policy = it->second;
+  int max_attempts = std::max(policy.max_attempts, 1);
+
+  for (int tries = 0;; tries++) {
+    // Share the remaining time evenly between the remaining attempts, so that
+    // a single hung attempt can't consume the entire deadline.
+    absl::Time now = absl::Now();
+    absl::Time attempt_deadline =
+        now + (deadline - now) / (max_attempts - tries);
+
+    absl::Status result = attempt(attempt_deadline);
+    if (result.ok() || tries + 1 >= max_attempts ||
+        !IsRetryable(policy, result)) {
+      return result;
+    }
+
+    absl::Duration backoff = JitteredBackoff(policy, tries);
+    if (absl::Now() + backoff >= deadline) {
+      return result;
+    }
+    if (retry_budget_ && !retry_budget_->TryAcquire()) {
+      return result;
+    }
+    absl::SleepFor(backoff);
+  }
+}
+
 KmsClient::KmsClient(const Options& options)
-    : rpc_timeout_(options.rpc_timeout),
+    : next_stub_index_(0),
+      rpc_timeout_(options.rpc_timeout),
       rpc_feature_flags_(options.rpc_feature_flags),
       user_project_override_(options.user_project_override),
-      error_decorator_(options.error_decorator) {
-  grpc::ChannelArguments args;
-  args.SetUserAgentPrefix(ComputeUserAgentPrefix(
-      options.user_agent, options.version_major, options.version_minor));
-  args.SetServiceConfigJSON(std::string(kDefaultCloudKmsGrpcServiceConfig));
+      error_decorator_(options.error_decorator),
+      hedging_delay_(options.hedging_delay),
+      retry_policies_(options.retry_policies),
+      retry_budget_(options.retry_budget),
+      rpc_stats_(options.rpc_stats) {
+  for (std::string_view method : kHedgedMethods) {
+    hedge_counters_.try_emplace(method);
+  }
 
-  std::shared_ptr<grpc::Channel> channel = grpc::CreateCustomChannel(
-      std::string(options.endpoint_address), options.creds, args);
+  int channel_count = std::max(options.channel_count, 1);
+  channels_.reserve(channel_count);
+  kms_stubs_.reserve(channel_count);
+  for (int i = 0; i < channel_count; i++) {
+    grpc::ChannelArguments args;
+    args.SetUserAgentPrefix(ComputeUserAgentPrefix(
+        options.user_agent, options.version_major, options.version_minor));
+    args.SetServiceConfigJSON(std::string(kDefaultCloudKmsGrpcServiceConfig));
+    // Channels with identical arguments share subchannels (and therefore
+    // connections) through gRPC's global subchannel pool. Give each channel
+    // its own pool and a distinct argument so that each one opens its own
+    // connection.
+    args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    args.SetInt(kChannelIndexArg, i);
+
+    channels_.push_back(grpc::CreateCustomChannel(
+        std::string(options.endpoint_address), options.creds, args));
+    kms_stubs_.push_back(
+        kms_v1::KeyManagementService::NewStub(channels_.back()));
+  }
+  async_queue_ = std::make_unique<grpc::CompletionQueue>();
+}
 
-  kms_stub_ = kms_v1::KeyManagementService::NewStub(channel);
+KmsClient::~KmsClient() {
+  // Pending calls are still delivered to the poller after Shutdown, so every
+  // outstanding callback runs before the join completes.
+  async_queue_->Shutdown();
+  if (poller_.joinable()) {
+    poller_.join();
+  }
 }
 
 absl::StatusOr<kms_v1::AsymmetricDecryptResponse> KmsClient::AsymmetricDecrypt(
     kms_v1::AsymmetricDecryptRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
-  request.mutable_ciphertext_crc32c()->set_value(
-      ComputeCRC32C(request.ciphertext()));
-
-  kms_v1::AsymmetricDecryptResponse response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->AsymmetricDecrypt(&ctx, request, &response));
+  absl::Status rpc_result = AddRequestChecksums(request);
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
 
-  if (!CRC32CMatches(response.plaintext(),
-                     response.plaintext_crc32c().value())) {
-    rpc_result = absl::InternalError(absl::StrFormat(
-        "at %s: the response crc32c did not match the expected checksum value",
-        SOURCE_LOCATION.ToString()));
-    return DecorateStatus(rpc_result);
+  kms_v1::AsymmetricDecryptResponse response;
+  rpc_result = CallWithRetries(
+      "AsymmetricDecrypt", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        return ToStatus(
+            NextStub()->AsymmetricDecrypt(&ctx, request, &response));
+      });
+  if (rpc_result.ok()) {
+    rpc_result = VerifyResponseChecksums(request, response);
   }
-
-  if (!response.verified_ciphertext_crc32c()) {
-    rpc_result = absl::InternalError(
-        absl::StrFormat("at %s: the server did not verify the checksum values "
-                        "provided in the request",
-                        SOURCE_LOCATION.ToString()));
+  if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
-
   return response;
 }
 
 absl::StatusOr<kms_v1::AsymmetricSignResponse> KmsClient::AsymmetricSign(
-    kms_v1::AsymmetricSignRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
-  bool use_data = false;
-  if (!request.data().empty()) {
-    use_data = true;
-    request.mutable_data_crc32c()->set_value(ComputeCRC32C(request.data()));
-  } else {
-    absl::StatusOr<std::string> digest_string =
-        GetDigestString(request.digest());
-    if (!digest_string.ok()) {
-      absl::Status status = digest_string.status();
-      return DecorateStatus(status);
-    }
-    request.mutable_digest_crc32c()->set_value(ComputeCRC32C(*digest_string));
-  }
-
-  kms_v1::AsymmetricSignResponse response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->AsymmetricSign(&ctx, request, &response));
+    kms_v1::AsymmetricSignRequest& request, bool deterministic) const {
+  absl::Status rpc_result = AddRequestChecksums(request);
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
 
-  if (!CRC32CMatches(response.signature(),
-                     response.signature_crc32c().value())) {
-    rpc_result = absl::InternalError(absl::StrFormat(
-        "at %s: the response crc32c did not match the expected checksum value",
-        SOURCE_LOCATION.ToString()));
-    return DecorateStatus(rpc_result);
-  }
-
-  if (use_data && !response.verified_data_crc32c()) {
-    rpc_result = absl::InternalError(
-        absl::StrFormat("at %s: the server did not verify the checksum values "
-                        "provided in the request",
-                        SOURCE_LOCATION.ToString()));
-    return DecorateStatus(rpc_result);
+  kms_v1::AsymmetricSignResponse response;
+  rpc_result = CallWithRetries(
+      "AsymmetricSign", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        if (deterministic && hedging_enabled()) {
+          return HedgedCall(
+              &kms_v1::KeyManagementService::Stub::PrepareAsyncAsymmetricSign,
+              "AsymmetricSign", &ctx, "name", request.name(), request,
+              &response);
+        }
+        return ToStatus(NextStub()->AsymmetricSign(&ctx, request, &response));
+      });
+  if (rpc_result.ok()) {
+    rpc_result = VerifyResponseChecksums(request, response);
   }
-  if (!use_data && !response.verified_digest_crc32c()) {
-    rpc_result = absl::InternalError(
-        absl::StrFormat("at %s: the server did not verify the checksum values "
-                        "provided in the request",
-                        SOURCE_LOCATION.ToString()));
+  if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
-
   return response;
 }
 
 absl::StatusOr<kms_v1::MacSignResponse> KmsClient::MacSign(
     kms_v1::MacSignRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
-  request.mutable_data_crc32c()->set_value(ComputeCRC32C(request.data()));
-
-  kms_v1::MacSignResponse response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->MacSign(&ctx, request, &response));
+  absl::Status rpc_result = AddRequestChecksums(request);
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
 
-  if (!CRC32CMatches(response.mac(), response.mac_crc32c().value())) {
-    rpc_result = absl::InternalError(absl::StrFormat(
-        "at %s: the response crc32c did not match the expected checksum value",
-        SOURCE_LOCATION.ToString()));
-    return DecorateStatus(rpc_result);
+  kms_v1::MacSignResponse response;
+  rpc_result = CallWithRetries(
+      "MacSign", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        if (hedging_enabled()) {
+          return HedgedCall(
+              &kms_v1::KeyManagementService::Stub::PrepareAsyncMacSign,
+              "MacSign", &ctx, "name", request.name(), request, &response);
+        }
+        return ToStatus(NextStub()->MacSign(&ctx, request, &response));
+      });
+  if (rpc_result.ok()) {
+    rpc_result = VerifyResponseChecksums(request, response);
   }
-
-  if (!response.verified_data_crc32c()) {
-    rpc_result = absl::InternalError(
-        absl::StrFormat("at %s: the server did not verify the checksum values "
-                        "provided in the request",
-                        SOURCE_LOCATION.ToString()));
+  if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
-
   return response;
 }
 
 absl::StatusOr<kms_v1::MacVerifyResponse> KmsClient::MacVerify(
     kms_v1::MacVerifyRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
-  request.mutable_data_crc32c()->set_value(ComputeCRC32C(request.data()));
-  request.mutable_mac_crc32c()->set_value(ComputeCRC32C(request.mac()));
-
-  kms_v1::MacVerifyResponse response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->MacVerify(&ctx, request, &response));
+  absl::Status rpc_result = AddRequestChecksums(request);
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
 
-  if (response.success() != response.verified_success_integrity()) {
-    rpc_result = absl::InternalError(absl::StrFormat(
-        "at %s: the response crc32c did not match the expected checksum value",
-        SOURCE_LOCATION.ToString()));
-    return DecorateStatus(rpc_result);
+  kms_v1::MacVerifyResponse response;
+  rpc_result = CallWithRetries(
+      "MacVerify", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        if (hedging_enabled()) {
+          return HedgedCall(
+              &kms_v1::KeyManagementService::Stub::PrepareAsyncMacVerify,
+              "MacVerify", &ctx, "name", request.name(), request, &response);
+        }
+        return ToStatus(NextStub()->MacVerify(&ctx, request, &response));
+      });
+  if (rpc_result.ok()) {
+    rpc_result = VerifyResponseChecksums(request, response);
   }
-
-  if (!response.verified_data_crc32c() || !response.verified_mac_crc32c()) {
-    rpc_result = absl::InternalError(
-        absl::StrFormat("at %s: the server did not verify the checksum values "
-                        "provided in the request",
-                        SOURCE_LOCATION.ToString()));
+  if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
-
   return response;
 }
 
 absl::StatusOr<kms_v1::RawDecryptResponse> KmsClient::RawDecrypt(
     kms_v1::RawDecryptRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
-  request.mutable_ciphertext_crc32c()->set_value(
-      ComputeCRC32C(request.ciphertext()));
-  request.mutable_initialization_vector_crc32c()->set_value(
-      ComputeCRC32C(request.initialization_vector()));
-  request.mutable_additional_authenticated_data_crc32c()->set_value(
-      ComputeCRC32C(request.additional_authenticated_data()));
-
-  kms_v1::RawDecryptResponse response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->RawDecrypt(&ctx, request, &response));
+  absl::Status rpc_result = AddRequestChecksums(request);
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
 
-  if (!CRC32CMatches(response.plaintext(),
-                     response.plaintext_crc32c().value())) {
-    rpc_result = absl::InternalError(absl::StrFormat(
-        "at %s: the response crc32c did not match the expected checksum value",
-        SOURCE_LOCATION.ToString()));
+  kms_v1::RawDecryptResponse response;
+  rpc_result = CallWithRetries(
+      "RawDecrypt", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        return ToStatus(NextStub()->RawDecrypt(&ctx, request, &response));
+      });
+  if (rpc_result.ok()) {
+    rpc_result = VerifyResponseChecksums(request, response);
+  }
+  if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
-
   return response;
 }
 
 absl::StatusOr<kms_v1::RawEncryptResponse> KmsClient::RawEncrypt(
     kms_v1::RawEncryptRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
-  request.mutable_plaintext_crc32c()->set_value(
-      ComputeCRC32C(request.plaintext()));
-  request.mutable_additional_authenticated_data_crc32c()->set_value(
-      ComputeCRC32C(request.additional_authenticated_data()));
-  request.mutable_initialization_vector_crc32c()->set_value(
-      ComputeCRC32C(request.initialization_vector()));
+  absl::Status rpc_result = AddRequestChecksums(request);
+  if (!rpc_result.ok()) {
+    return DecorateStatus(rpc_result);
+  }
 
   kms_v1::RawEncryptResponse response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->RawEncrypt(&ctx, request, &response));
+  rpc_result = CallWithRetries(
+      "RawEncrypt", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        return ToStatus(NextStub()->RawEncrypt(&ctx, request, &response));
+      });
+  if (rpc_result.ok()) {
+    rpc_result = VerifyResponseChecksums(request, response);
+  }
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
+  return response;
+}
 
-  if (!CRC32CMatches(response.ciphertext(),
-                     response.ciphertext_crc32c().value())) {
-    rpc_result = absl::InternalError(absl::StrFormat(
-        "at %s: the response crc32c did not match the expected checksum value",
-        SOURCE_LOCATION.ToString()));
-    return DecorateStatus(rpc_result);
+template <typename Request, typename Response>
+absl::Status KmsClient::HedgedCall(PrepareAsyncRpc<Request, Response> rpc,
+                                   std::string_view method,
+                                   grpc::ClientContext* ctx,
+                                   std::string_view relative_resource,
+                                   std::string_view resource_name,
+                                   const Request& request,
+                                   Response* response) const {
+  struct Attempt {
+    grpc::ClientContext* ctx;
+    Response response;
+    grpc::Status status;
+    std::unique_ptr<grpc::ClientAsyncResponseReader<Response>> reader;
+  };
+
+  // Both attempts complete on a queue that is local to this call. The address
+  // of each attempt is used as its tag.
+  grpc::CompletionQueue queue;
+  grpc::ClientContext hedge_ctx;
+  Attempt attempts[2] = {{.ctx = ctx}, {.ctx = &hedge_ctx}};
+  auto start = [&](Attempt* attempt) {
+    attempt->reader = (NextStub()->*rpc)(attempt->ctx, request, &queue);
+    attempt->reader->StartCall();
+    attempt->reader->Finish(&attempt->response, &attempt->status, attempt);
+  };
+
+  HedgeCounters& counters = hedge_counters_.at(method);
+  start(&attempts[0]);
+  int pending = 1;
+
+  void* tag;
+  bool ok;
+  if (queue.AsyncNext(&tag, &ok,
+                      absl::ToChronoTime(absl::Now() + hedging_delay_)) ==
+      grpc::CompletionQueue::TIMEOUT) {
+    // The hedge shares the original request's deadline, so hedging never
+    // extends the time a caller waits for a result.
+    AddContextSettings(&hedge_ctx, relative_resource, resource_name,
+                       absl::FromChrono(ctx->deadline()));
+    start(&attempts[1]);
+    pending++;
+    counters.hedges_sent.fetch_add(1, std::memory_order_relaxed);
+    queue.Next(&tag, &ok);
+  }
+  pending--;
+
+  Attempt* winner = static_cast<Attempt*>(tag);
+  if (pending > 0) {
+    if (winner->status.ok()) {
+      Attempt* loser = winner == &attempts[0] ? &attempts[1] : &attempts[0];
+      loser->ctx->TryCancel();
+      queue.Next(&tag, &ok);
+    } else {
+      // The other attempt may still succeed, so a fast failure doesn't win.
+      // Its outcome is returned, whether or not it succeeds.
+      queue.Next(&tag, &ok);
+      winner = static_cast<Attempt*>(tag);
+    }
+  }
+  queue.Shutdown();
+  while (queue.Next(&tag, &ok)) {
   }
 
-  if (!response.verified_plaintext_crc32c() ||
-      !response.verified_additional_authenticated_data_crc32c() ||
-      !response.verified_initialization_vector_crc32c()) {
-    rpc_result = absl::InternalError(
-        absl::StrFormat("at %s: the server did not verify the checksum values "
-                        "provided in the request",
-                        SOURCE_LOCATION.ToString()));
-    return DecorateStatus(rpc_result);
+  if (winner == &attempts[1]) {
+    counters.hedges_won.fetch_add(1, std::memory_order_relaxed);
   }
+  *response = std::move(winner->response);
+  return ToStatus(winner->status);
+}
 
-  return response;
+absl::flat_hash_map<std::string, HedgeCounts> KmsClient::GetHedgeCounts()
+    const {
+  absl::flat_hash_map<std::string, HedgeCounts> result;
+  for (const auto& [method, counters] : hedge_counters_) {
+    result.try_emplace(
+        method,
+        HedgeCounts{
+            .hedges_sent =
+                counters.hedges_sent.load(std::memory_order_relaxed),
+            .hedges_won = counters.hedges_won.load(std::memory_order_relaxed),
+        });
+  }
+  return result;
+}
+
+template <typename Request, typename Response>
+void KmsClient::StartAsyncCall(PrepareAsyncRpc<Request, Response> rpc,
+                               std::string_view method, Request request,
+                               AsyncCallback<Response> callback) const {
+  absl::Status checksum_result = AddRequestChecksums(request);
+  if (!checksum_result.ok()) {
+    callback(DecorateStatus(checksum_result));
+    return;
+  }
+
+  std::optional<RpcStats::Call> stats_call;
+  if (rpc_stats_) {
+    stats_call = rpc_stats_->Start(method, request.name());
+  }
+  AsyncCallback<Response> decorated_callback =
+      [this, stats_call, callback = std::move(callback)](
+          absl::StatusOr<Response> result) {
+        if (stats_call.has_value()) {
+          stats_call->Done(result.status());
+        }
+        if (!result.ok()) {
+          absl::Status status = result.status();
+          callback(DecorateStatus(status));
+          return;
+        }
+        callback(std::move(result));
+      };
+
+  auto* call = new AsyncCall<Request, Response>(std::move(request),
+                                                std::move(decorated_callback));
+  AddContextSettings(&call->ctx, "name", call->request.name());
+  call->reader =
+      (NextStub()->*rpc)(&call->ctx, call->request, async_queue());
+  call->reader->StartCall();
+  // The completion queue owns `call` until its tag is returned to the poller.
+  call->reader->Finish(&call->response, &call->status, call);
+}
+
+void KmsClient::AsymmetricDecryptAsync(
+    kms_v1::AsymmetricDecryptRequest request,
+    AsyncCallback<kms_v1::AsymmetricDecryptResponse> callback) const {
+  StartAsyncCall(
+      &kms_v1::KeyManagementService::Stub::PrepareAsyncAsymmetricDecrypt,
+      "AsymmetricDecrypt", std::move(request), std::move(callback));
+}
+
+void KmsClient::AsymmetricSignAsync(
+    kms_v1::AsymmetricSignRequest request,
+    AsyncCallback<kms_v1::AsymmetricSignResponse> callback) const {
+  StartAsyncCall(
+      &kms_v1::KeyManagementService::Stub::PrepareAsyncAsymmetricSign,
+      "AsymmetricSign", std::move(request), std::move(callback));
+}
+
+void KmsClient::MacSignAsync(
+    kms_v1::MacSignRequest request,
+    AsyncCallback<kms_v1::MacSignResponse> callback) const {
+  StartAsyncCall(&kms_v1::KeyManagementService::Stub::PrepareAsyncMacSign,
+                 "MacSign", std::move(request), std::move(callback));
+}
+
+void KmsClient::MacVerifyAsync(
+    kms_v1::MacVerifyRequest request,
+    AsyncCallback<kms_v1::MacVerifyResponse> callback) const {
+  StartAsyncCall(&kms_v1::KeyManagementService::Stub::PrepareAsyncMacVerify,
+                 "MacVerify", std::move(request), std::move(callback));
+}
+
+void KmsClient::RawDecryptAsync(
+    kms_v1::RawDecryptRequest request,
+    AsyncCallback<kms_v1::RawDecryptResponse> callback) const {
+  StartAsyncCall(&kms_v1::KeyManagementService::Stub::PrepareAsyncRawDecrypt,
+                 "RawDecrypt", std::move(request), std::move(callback));
+}
+
+void KmsClient::RawEncryptAsync(
+    kms_v1::RawEncryptRequest request,
+    AsyncCallback<kms_v1::RawEncryptResponse> callback) const {
+  StartAsyncCall(&kms_v1::KeyManagementService::Stub::PrepareAsyncRawEncrypt,
+                 "RawEncrypt", std::move(request), std::move(callback));
+}
+
+grpc::CompletionQueue* KmsClient::async_queue() const {
+  absl::call_once(poller_started_, [this] {
+    poller_ = std::thread(&PollCompletionQueue, async_queue_.get());
+  });
+  return async_queue_.get();
 }
 
 absl::StatusOr<kms_v1::CryptoKey> KmsClient::CreateCryptoKey(
     const kms_v1::CreateCryptoKeyRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "parent", request.parent());
-
   kms_v1::CryptoKey response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->CreateCryptoKey(&ctx, request, &response));
+  absl::Status rpc_result = CallWithRetries(
+      "CreateCryptoKey", request.parent(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "parent", request.parent(), deadline);
+        return ToStatus(NextStub()->CreateCryptoKey(&ctx, request, &response));
+      });
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
@@ -367,14 +793,17 @@ KmsClient::CreateCryptoKeyAndWaitForFirstVersion(
   } else {
     std::string name = absl::StrCat(ck.name(), "/cryptoKeyVersions/1");
 
-    grpc::ClientContext ctx;
-    AddContextSettings(&ctx, "name", name, deadline);
-
     kms_v1::GetCryptoKeyVersionRequest get_ckv_req;
     get_ckv_req.set_name(name);
 
-    absl::Status rpc_result =
-        ToStatus(kms_stub_->GetCryptoKeyVersion(&ctx, get_ckv_req, &ckv));
+    absl::Status rpc_result = CallWithRetries(
+        "GetCryptoKeyVersion", name, deadline,
+        [&](absl::Time attempt_deadline) {
+          grpc::ClientContext ctx;
+          AddContextSettings(&ctx, "name", name, attempt_deadline);
+          return ToStatus(
+              NextStub()->GetCryptoKeyVersion(&ctx, get_ckv_req, &ckv));
+        });
     if (!rpc_result.ok()) {
       return DecorateStatus(rpc_result);
     }
@@ -389,12 +818,15 @@ KmsClient::CreateCryptoKeyVersionAndWait(
     const kms_v1::CreateCryptoKeyVersionRequest& request) const {
   absl::Time deadline = absl::Now() + rpc_timeout_;
 
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "parent", request.parent(), deadline);
-
   kms_v1::CryptoKeyVersion response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->CreateCryptoKeyVersion(&ctx, request, &response));
+  absl::Status rpc_result = CallWithRetries(
+      "CreateCryptoKeyVersion", request.parent(), deadline,
+      [&](absl::Time attempt_deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "parent", request.parent(), attempt_deadline);
+        return ToStatus(
+            NextStub()->CreateCryptoKeyVersion(&ctx, request, &response));
+      });
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
@@ -404,12 +836,14 @@ KmsClient::CreateCryptoKeyVersionAndWait(
 
 absl::StatusOr<kms_v1::CryptoKeyVersion> KmsClient::DestroyCryptoKeyVersion(
     const kms_v1::DestroyCryptoKeyVersionRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
   kms_v1::CryptoKeyVersion response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->DestroyCryptoKeyVersion(&ctx, request, &response));
+  absl::Status rpc_result = CallWithRetries(
+      "DestroyCryptoKeyVersion", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        return ToStatus(
+            NextStub()->DestroyCryptoKeyVersion(&ctx, request, &response));
+      });
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
@@ -418,12 +852,13 @@ absl::StatusOr<kms_v1::CryptoKeyVersion> KmsClient::DestroyCryptoKeyVersion(
 
 absl::StatusOr<kms_v1::CryptoKey> KmsClient::GetCryptoKey(
     const kms_v1::GetCryptoKeyRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
   kms_v1::CryptoKey response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->GetCryptoKey(&ctx, request, &response));
+  absl::Status rpc_result = CallWithRetries(
+      "GetCryptoKey", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        return ToStatus(NextStub()->GetCryptoKey(&ctx, request, &response));
+      });
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
@@ -432,12 +867,20 @@ absl::StatusOr<kms_v1::CryptoKey> KmsClient::GetCryptoKey(
 
 absl::StatusOr<kms_v1::CryptoKeyVersion> KmsClient::GetCryptoKeyVersion(
     const kms_v1::GetCryptoKeyVersionRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
   kms_v1::CryptoKeyVersion response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->GetCryptoKeyVersion(&ctx, request, &response));
+  absl::Status rpc_result = CallWithRetries(
+      "GetCryptoKeyVersion", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        if (hedging_enabled()) {
+          return HedgedCall(&kms_v1::KeyManagementService::Stub::
+                                PrepareAsyncGetCryptoKeyVersion,
+                            "GetCryptoKeyVersion", &ctx, "name",
+                            request.name(), request, &response);
+        }
+        return ToStatus(
+            NextStub()->GetCryptoKeyVersion(&ctx, request, &response));
+      });
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
@@ -446,12 +889,19 @@ absl::StatusOr<kms_v1::CryptoKeyVersion> KmsClient::GetCryptoKeyVersion(
 
 absl::StatusOr<kms_v1::PublicKey> KmsClient::GetPublicKey(
     const kms_v1::GetPublicKeyRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "name", request.name());
-
   kms_v1::PublicKey response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->GetPublicKey(&ctx, request, &response));
+  absl::Status rpc_result = CallWithRetries(
+      "GetPublicKey", request.name(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "name", request.name(), deadline);
+        if (hedging_enabled()) {
+          return HedgedCall(
+              &kms_v1::KeyManagementService::Stub::PrepareAsyncGetPublicKey,
+              "GetPublicKey", &ctx, "name", request.name(), request,
+              &response);
+        }
+        return ToStatus(NextStub()->GetPublicKey(&ctx, request, &response));
+      });
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
@@ -464,12 +914,20 @@ CryptoKeysRange KmsClient::ListCryptoKeys(
       request,
       [this](const kms_v1::ListCryptoKeysRequest& request)
           -> absl::StatusOr<kms_v1::ListCryptoKeysResponse> {
-        grpc::ClientContext ctx;
-        AddContextSettings(&ctx, "parent", request.parent());
-
         kms_v1::ListCryptoKeysResponse response;
-        absl::Status rpc_result =
-            ToStatus(kms_stub_->ListCryptoKeys(&ctx, request, &response));
+        absl::Status rpc_result = CallWithRetries(
+            "ListCryptoKeys", request.parent(), [&](absl::Time deadline) {
+              grpc::ClientContext ctx;
+              AddContextSettings(&ctx, "parent", request.parent(), deadline);
+              if (hedging_enabled()) {
+                return HedgedCall(&kms_v1::KeyManagementService::Stub::
+                                      PrepareAsyncListCryptoKeys,
+                                  "ListCryptoKeys", &ctx, "parent",
+                                  request.parent(), request, &response);
+              }
+              return ToStatus(
+                  NextStub()->ListCryptoKeys(&ctx, request, &response));
+            });
         if (!rpc_result.ok()) {
           return DecorateStatus(rpc_result);
         }
@@ -490,12 +948,21 @@ CryptoKeyVersionsRange KmsClient::ListCryptoKeyVersions(
       request,
       [this](const kms_v1::ListCryptoKeyVersionsRequest& request)
           -> absl::StatusOr<kms_v1::ListCryptoKeyVersionsResponse> {
-        grpc::ClientContext ctx;
-        AddContextSettings(&ctx, "parent", request.parent());
-
         kms_v1::ListCryptoKeyVersionsResponse response;
-        absl::Status rpc_result = ToStatus(
-            kms_stub_->ListCryptoKeyVersions(&ctx, request, &response));
+        absl::Status rpc_result = CallWithRetries(
+            "ListCryptoKeyVersions", request.parent(),
+            [&](absl::Time deadline) {
+              grpc::ClientContext ctx;
+              AddContextSettings(&ctx, "parent", request.parent(), deadline);
+              if (hedging_enabled()) {
+                return HedgedCall(&kms_v1::KeyManagementService::Stub::
+                                      PrepareAsyncListCryptoKeyVersions,
+                                  "ListCryptoKeyVersions", &ctx, "parent",
+                                  request.parent(), request, &response);
+              }
+              return ToStatus(
+                  NextStub()->ListCryptoKeyVersions(&ctx, request, &response));
+            });
         if (!rpc_result.ok()) {
           return DecorateStatus(rpc_result);
         }
@@ -514,12 +981,14 @@ CryptoKeyVersionsRange KmsClient::ListCryptoKeyVersions(
 absl::StatusOr<kms_v1::GenerateRandomBytesResponse>
 KmsClient::GenerateRandomBytes(
     const kms_v1::GenerateRandomBytesRequest& request) const {
-  grpc::ClientContext ctx;
-  AddContextSettings(&ctx, "location", request.location());
-
   kms_v1::GenerateRandomBytesResponse response;
-  absl::Status rpc_result =
-      ToStatus(kms_stub_->GenerateRandomBytes(&ctx, request, &response));
+  absl::Status rpc_result = CallWithRetries(
+      "GenerateRandomBytes", request.location(), [&](absl::Time deadline) {
+        grpc::ClientContext ctx;
+        AddContextSettings(&ctx, "location", request.location(), deadline);
+        return ToStatus(
+            NextStub()->GenerateRandomBytes(&ctx, request, &response));
+      });
   if (!rpc_result.ok()) {
     return DecorateStatus(rpc_result);
   }
@@ -537,13 +1006,15 @@ absl::Status KmsClient::WaitForGeneration(kms_v1::CryptoKeyVersion& ckv,
   while (ckv.state() == kms_v1::CryptoKeyVersion::PENDING_GENERATION) {
     absl::SleepFor(ComputeBackoff(kMinDelay, kMaxDelay, tries++));
 
-    grpc::ClientContext ctx;
-    AddContextSettings(&ctx, "name", ckv.name(), deadline);
-
     kms_v1::GetCryptoKeyVersionRequest req;
     req.set_name(ckv.name());
-    absl::Status rpc_result =
-        ToStatus(kms_stub_->GetCryptoKeyVersion(&ctx, req, &ckv));
+    absl::Status rpc_result = CallWithRetries(
+        "GetCryptoKeyVersion", req.name(), deadline,
+        [&](absl::Time attempt_deadline) {
+          grpc::ClientContext ctx;
+          AddContextSettings(&ctx, "name", req.name(), attempt_deadline);
+          return ToStatus(NextStub()->GetCryptoKeyVersion(&ctx, req, &ckv));
+        });
     if (!rpc_result.ok()) {
       return DecorateStatus(rpc_result);
     }
@@ -17,15 +17,27 @@
 #ifndef COMMON_KMS_CLIENT_H_
 #define COMMON_KMS_CLIENT_H_
 
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <string_view>
+#include <thread>
 
+#include "absl/base/call_once.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_map.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/statusor.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "common/kms_v1.h"
 #include "common/pagination_range.h"
+#include "common/retry_policy.h"
+#include "common/rpc_stats.h"
+#include "grpcpp/channel.h"
+#include "grpcpp/completion_queue.h"
 #include "grpcpp/security/credentials.h"
+#include "grpcpp/support/async_unary_call.h"
 
 namespace cloud_kms {
 
@@ -43,6 +55,25 @@ using CryptoKeyVersionsRange =
                     kms_v1::ListCryptoKeyVersionsRequest,
                     kms_v1::ListCryptoKeyVersionsResponse>;
 
+// A callback that receives the outcome of an asynchronous KmsClient call.
+template <typename T>
+using AsyncCallback = std::function<void(absl::StatusOr<T>)>;
+
+// Counts of hedged requests issued for a single KmsClient method.
+struct HedgeCounts {
+  // The number of times a duplicate request was sent because the original
+  // request had not completed within the hedging delay.
+  uint64_t hedges_sent = 0;
+  // The number of times the duplicate request completed first.
+  uint64_t hedges_won = 0;
+};
+
+// Returns retry policies that allow each KmsClient method whose requests may
+// safely be repeated to be attempted up to `max_attempts` times. Methods that
+// create or destroy resources are not included.
+absl::flat_hash_map<std::string, RetryPolicy> DefaultRetryPolicies(
+    int max_attempts);
+
 struct CryptoKeyAndVersion {
   kms_v1::CryptoKey crypto_key;
   kms_v1::CryptoKeyVersion crypto_key_version;
@@ -62,17 +93,49 @@ class KmsClient {
     std::optional<ErrorDecorator> error_decorator = std::nullopt;
     std::string rpc_feature_flags = "";
     std::string user_project_override = "";
+    // The number of gRPC channels that requests are spread over. Each channel
+    // maintains its own connection to the endpoint, so a larger pool raises
+    // the number of requests that can be in flight before HTTP/2 stream limits
+    // are reached. Values less than 1 are treated as 1.
+    int channel_count = 1;
+    // If non-zero, read-only and idempotent requests that have not completed
+    // within this delay are duplicated, and the first response to arrive is
+    // used. Zero disables hedging.
+    absl::Duration hedging_delay = absl::ZeroDuration();
+    // Retry policies keyed by method name (for example, "GetPublicKey").
+    // Methods without a policy are not retried by the client. Asynchronous
+    // calls are never retried.
+    absl::flat_hash_map<std::string, RetryPolicy> retry_policies;
+    // If set, each retry consumes a token from this budget, and an RPC is not
+    // retried when the budget is exhausted. A budget may be shared by several
+    // clients.
+    std::shared_ptr<RetryBudget> retry_budget;
+    // If set, the latency and outcome of each call are recorded here. Calls
+    // are keyed by method name and by the name of the resource they target.
+    // A RpcStats may be shared by several clients.
+    std::shared_ptr<RpcStats> rpc_stats;
   };
 
   KmsClient(const Options& options);
+  ~KmsClient();
 
-  kms_v1::KeyManagementService::Stub* kms_stub() { return kms_stub_.get(); }
+  kms_v1::KeyManagementService::Stub* kms_stub() {
+    return kms_stubs_.front().get();
+  }
+
+  // The channels that requests are spread over, one for each stub.
+  const std::vector<std::shared_ptr<grpc::Channel>>& channels() const {
+    return channels_;
+  }
 
   absl::StatusOr<kms_v1::AsymmetricDecryptResponse> AsymmetricDecrypt(
       kms_v1::AsymmetricDecryptRequest& request) const;
 
+  // Signatures are only hedged when `deterministic` is true, since a hedged
+  // request for a randomized signature scheme could return either of two
+  // different signatures.
   absl::StatusOr<kms_v1::AsymmetricSignResponse> AsymmetricSign(
-      kms_v1::AsymmetricSignRequest& request) const;
+      kms_v1::AsymmetricSignRequest& request, bool deterministic = false) const;
 
   absl::StatusOr<kms_v1::MacSignResponse> MacSign(
       kms_v1::MacSignRequest& request) const;
@@ -86,6 +149,36 @@ class KmsClient {
   absl::StatusOr<kms_v1::RawEncryptResponse> RawEncrypt(
       kms_v1::RawEncryptRequest& request) const;
 
+  // Asynchronous variants of the crypto RPCs above. Each call is dispatched on
+  // a completion queue owned by this client, and `callback` is invoked exactly
+  // once, on the client's polling thread, when the call completes. Requests
+  // and responses are subject to the same CRC32C integrity checks as the
+  // synchronous variants.
+  //
+  // Callbacks should return promptly: a blocked callback delays the delivery
+  // of every other completion for this client.
+  void AsymmetricDecryptAsync(
+      kms_v1::AsymmetricDecryptRequest request,
+      AsyncCallback<kms_v1::AsymmetricDecryptResponse> callback) const;
+
+  void AsymmetricSignAsync(
+      kms_v1::AsymmetricSignRequest request,
+      AsyncCallback<kms_v1::AsymmetricSignResponse> callback) const;
+
+  void MacSignAsync(kms_v1::MacSignRequest request,
+                    AsyncCallback<kms_v1::MacSignResponse> callback) const;
+
+  void MacVerifyAsync(kms_v1::MacVerifyRequest request,
+                      AsyncCallback<kms_v1::MacVerifyResponse> callback) const;
+
+  void RawDecryptAsync(
+      kms_v1::RawDecryptRequest request,
+      AsyncCallback<kms_v1::RawDecryptResponse> callback) const;
+
+  void RawEncryptAsync(
+      kms_v1::RawEncryptRequest request,
+      AsyncCallback<kms_v1::RawEncryptResponse> callback) const;
+
   absl::StatusOr<kms_v1::CryptoKey> CreateCryptoKey(
       const kms_v1::CreateCryptoKeyRequest& request) const;
 
@@ -116,7 +209,73 @@ class KmsClient {
   absl::StatusOr<kms_v1::GenerateRandomBytesResponse> GenerateRandomBytes(
       const kms_v1::GenerateRandomBytesRequest& request) const;
 
+  // Returns the hedge counts for each method that supports hedging, keyed by
+  // method name (for example, "MacSign").
+  absl::flat_hash_map<std::string, HedgeCounts> GetHedgeCounts() const;
+
  private:
+  template <typename Request, typename Response>
+  using PrepareAsyncRpc =
+      std::unique_ptr<grpc::ClientAsyncResponseReader<Response>> (
+          kms_v1::KeyManagementService::Stub::*)(grpc::ClientContext*,
+                                                 const Request&,
+                                                 grpc::CompletionQueue*);
+
+  // Adds request checksums, then starts `rpc` on the completion queue. The
+  // response checksums are verified before `callback` is invoked.
+  template <typename Request, typename Response>
+  void StartAsyncCall(PrepareAsyncRpc<Request, Response> rpc,
+                      std::string_view method, Request request,
+                      AsyncCallback<Response> callback) const;
+
+  // Issues `rpc` using `ctx`, and sends a duplicate request if no response has
+  // arrived within the hedging delay. The first successful response to arrive
+  // is stored in `response`, and the other request is cancelled. If the first
+  // request to complete fails, the outcome of the other request is returned.
+  // `relative_resource` and `resource_name` are used to configure the
+  // duplicate request's context.
+  template <typename Request, typename Response>
+  absl::Status HedgedCall(PrepareAsyncRpc<Request, Response> rpc,
+                          std::string_view method, grpc::ClientContext* ctx,
+                          std::string_view relative_resource,
+                          std::string_view resource_name,
+                          const Request& request, Response* response) const;
+
+  // Invokes `attempt` until it succeeds, fails with an error that `method`'s
+  // retry policy does not consider transient, or the policy, the retry budget
+  // or the time until `deadline` is exhausted. Each invocation is passed the
+  // deadline for that attempt, which is an even share of the time remaining
+  // until `deadline`. If RPC stats are enabled, the call as a whole,
+  // including any retries, is recorded against `method` and `resource_name`.
+  absl::Status CallWithRetries(
+      std::string_view method, std::string_view resource_name,
+      absl::Time deadline,
+      absl::FunctionRef<absl::Status(absl::Time)> attempt) const;
+
+  inline absl::Status CallWithRetries(
+      std::string_view method, std::string_view resource_name,
+      absl::FunctionRef<absl::Status(absl::Time)> attempt) const {
+    return CallWithRetries(method, resource_name, absl::Now() + rpc_timeout_,
+                           attempt);
+  }
+
+  // Implements CallWithRetries, without recording RPC stats.
+  absl::Status AttemptWithRetries(
+      std::string_view method, absl::Time deadline,
+      absl::FunctionRef<absl::Status(absl::Time)> attempt) const;
+
+  bool hedging_enabled() const {
+    return hedging_delay_ > absl::ZeroDuration();
+  }
+
+  // Returns the completion queue used for asynchronous calls, starting the
+  // polling thread if it isn't running yet.
+  grpc::CompletionQueue* async_queue() const;
+
+  // Returns the stub that should be used for the next request. Stubs are
+  // selected round-robin across the channel pool.
+  kms_v1::KeyManagementService::Stub* NextStub() const;
+
   absl::Status WaitForGeneration(kms_v1::CryptoKeyVersion& ckv,
                                  absl::Time deadline) const;
 
@@ -134,11 +293,29 @@ class KmsClient {
                               absl::Now() + rpc_timeout_);
   }
 
-  std::unique_ptr<kms_v1::KeyManagementService::Stub> kms_stub_;
+  std::vector<std::shared_ptr<grpc::Channel>> channels_;
+  std::vector<std::unique_ptr<kms_v1::KeyManagementService::Stub>> kms_stubs_;
+  mutable std::atomic<size_t> next_stub_index_;
   const absl::Duration rpc_timeout_;
   const std::string rpc_feature_flags_;
   const std::string user_project_override_;
   const std::optional<ErrorDecorator> error_decorator_;
+  const absl::Duration hedging_delay_;
+  const absl::flat_hash_map<std::string, RetryPolicy> retry_policies_;
+  const std::shared_ptr<RetryBudget> retry_budget_;
+  const std::shared_ptr<RpcStats> rpc_stats_;
+
+  struct HedgeCounters {
+    std::atomic<uint64_t> hedges_sent = 0;
+    std::atomic<uint64_t> hedges_won = 0;
+  };
+  // Populated at construction time with an entry for each method that supports
+  // hedging, and not modified afterwards.
+  mutable absl::node_hash_map<std::string_view, HedgeCounters> hedge_counters_;
+
+  std::unique_ptr<grpc::CompletionQueue> async_queue_;
+  mutable absl::once_flag poller_started_;
+  mutable std::thread poller_;
 };
 
 }  // namespace cloud_kms
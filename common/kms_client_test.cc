@@ -14,6 +14,10 @@
 
 #include "common/kms_client.h"
 
+#include <atomic>
+
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
 #include "common/openssl.h"
 #include "common/test/matchers.h"
@@ -44,6 +48,39 @@ std::unique_ptr<KmsClient> NewClient(
       .endpoint_address = std::string(listen_addr), .rpc_timeout = rpc_timeout});
 }
 
+// Returns the default retry policies, with backoffs shortened for tests.
+absl::flat_hash_map<std::string, RetryPolicy> FastRetryPolicies(
+    int max_attempts) {
+  absl::flat_hash_map<std::string, RetryPolicy> policies =
+      DefaultRetryPolicies(max_attempts);
+  for (auto& [method, policy] : policies) {
+    policy.min_backoff = absl::Milliseconds(1);
+    policy.max_backoff = absl::Milliseconds(10);
+  }
+  return policies;
+}
+
+// Captures the result delivered to an AsyncCallback.
+template <typename T>
+class AsyncResult {
+ public:
+  AsyncCallback<T> Callback() {
+    return [this](absl::StatusOr<T> result) {
+      result_.emplace(std::move(result));
+      done_.Notify();
+    };
+  }
+
+  absl::StatusOr<T> Wait() {
+    done_.WaitForNotification();
+    return *result_;
+  }
+
+ private:
+  absl::Notification done_;
+  std::optional<absl::StatusOr<T>> result_;
+};
+
 TEST(KmsClientTest, ListCryptoKeysSuccess) {
   ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
                        fakekms::Server::New());
@@ -441,6 +478,169 @@ TEST(KmsClientTest, RawEncryptFailureCustomIvAesGcm) {
               StatusIs(absl::StatusCode::kInvalidArgument));
 }
 
+TEST(KmsClientTest, AsymmetricSignAsyncSuccess) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  std::unique_ptr<KmsClient> client = NewClient(fake->listen_addr());
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client->kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  ck = CreateCryptoKeyOrDie(client->kms_stub(), kr.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv;
+  ckv = CreateCryptoKeyVersionOrDie(client->kms_stub(), ck.name(), ckv);
+  ckv = WaitForEnablement(client->kms_stub(), ckv);
+
+  kms_v1::GetPublicKeyRequest pub_req;
+  pub_req.set_name(ckv.name());
+  ASSERT_OK_AND_ASSIGN(kms_v1::PublicKey pk, client->GetPublicKey(pub_req));
+
+  ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> pub,
+                       ParseX509PublicKeyPem(pk.pem()));
+
+  std::string data = "Here is some data to authenticate";
+  uint8_t digest[32];
+  SHA256(reinterpret_cast<const uint8_t*>(data.data()), data.size(), digest);
+
+  kms_v1::AsymmetricSignRequest sign_req;
+  sign_req.set_name(ckv.name());
+  sign_req.mutable_digest()->set_sha256(digest, sizeof(digest));
+
+  AsyncResult<kms_v1::AsymmetricSignResponse> result;
+  client->AsymmetricSignAsync(sign_req, result.Callback());
+  ASSERT_OK_AND_ASSIGN(kms_v1::AsymmetricSignResponse sign_resp,
+                       result.Wait());
+
+  EC_KEY* ec_key = EVP_PKEY_get0_EC_KEY(pub.get());
+  ASSERT_OK_AND_ASSIGN(
+      std::vector<uint8_t> p1363_sig,
+      EcdsaSigAsn1ToP1363(sign_resp.signature(), EC_KEY_get0_group(ec_key)));
+
+  EXPECT_OK(EcdsaVerifyP1363(ec_key, EVP_sha256(), digest, p1363_sig));
+}
+
+TEST(KmsClientTest, AsymmetricSignAsyncFailureInvalidName) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  std::unique_ptr<KmsClient> client = NewClient(fake->listen_addr());
+
+  kms_v1::AsymmetricSignRequest req;
+  req.set_name("foo");
+  req.set_data("bar");
+
+  AsyncResult<kms_v1::AsymmetricSignResponse> result;
+  client->AsymmetricSignAsync(req, result.Callback());
+  EXPECT_THAT(result.Wait(), StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(KmsClientTest, AsymmetricSignAsyncFailureMissingDigest) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  std::unique_ptr<KmsClient> client = NewClient(fake->listen_addr());
+
+  kms_v1::AsymmetricSignRequest req;
+  req.set_name("foo");
+
+  AsyncResult<kms_v1::AsymmetricSignResponse> result;
+  client->AsymmetricSignAsync(req, result.Callback());
+  EXPECT_THAT(result.Wait(), StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(KmsClientTest, RawEncryptDecryptAsyncSuccess) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  std::unique_ptr<KmsClient> client = NewClient(fake->listen_addr());
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client->kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::AES_256_GCM);
+  ck = CreateCryptoKeyOrDie(client->kms_stub(), kr.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv;
+  ckv = CreateCryptoKeyVersionOrDie(client->kms_stub(), ck.name(), ckv);
+  ckv = WaitForEnablement(client->kms_stub(), ckv);
+
+  std::string data = "Here is some data to encrypt";
+
+  kms_v1::RawEncryptRequest encrypt_req;
+  encrypt_req.set_name(ckv.name());
+  encrypt_req.set_plaintext(data);
+
+  AsyncResult<kms_v1::RawEncryptResponse> encrypt_result;
+  client->RawEncryptAsync(encrypt_req, encrypt_result.Callback());
+  ASSERT_OK_AND_ASSIGN(kms_v1::RawEncryptResponse encrypt_resp,
+                       encrypt_result.Wait());
+
+  kms_v1::RawDecryptRequest decrypt_req;
+  decrypt_req.set_name(ckv.name());
+  decrypt_req.set_ciphertext(encrypt_resp.ciphertext());
+  decrypt_req.set_initialization_vector(encrypt_resp.initialization_vector());
+
+  AsyncResult<kms_v1::RawDecryptResponse> decrypt_result;
+  client->RawDecryptAsync(decrypt_req, decrypt_result.Callback());
+  ASSERT_OK_AND_ASSIGN(kms_v1::RawDecryptResponse decrypt_resp,
+                       decrypt_result.Wait());
+  EXPECT_EQ(decrypt_resp.plaintext(), data);
+}
+
+TEST(KmsClientTest, MacSignAsyncManyCallsInFlight) {
+  constexpr int kCallCount = 64;
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  std::unique_ptr<KmsClient> client = NewClient(fake->listen_addr());
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client->kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::MAC);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::HMAC_SHA256);
+  ck = CreateCryptoKeyOrDie(client->kms_stub(), kr.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv;
+  ckv = CreateCryptoKeyVersionOrDie(client->kms_stub(), ck.name(), ckv);
+  ckv = WaitForEnablement(client->kms_stub(), ckv);
+
+  // Each fault is consumed by a single call, so every call is delayed.
+  constexpr absl::Duration kDelay = absl::Milliseconds(100);
+  for (int i = 0; i < kCallCount; i++) {
+    AddDelayOrDie(*fake, kDelay, "MacSign");
+  }
+
+  kms_v1::MacSignRequest sign_req;
+  sign_req.set_name(ckv.name());
+  sign_req.set_data("Here is some data to authenticate");
+
+  absl::Time start = absl::Now();
+  absl::BlockingCounter pending(kCallCount);
+  std::atomic<int> success_count(0);
+  for (int i = 0; i < kCallCount; i++) {
+    client->MacSignAsync(
+        sign_req, [&](absl::StatusOr<kms_v1::MacSignResponse> result) {
+          if (result.ok()) {
+            success_count++;
+          }
+          pending.DecrementCount();
+        });
+  }
+  pending.Wait();
+
+  EXPECT_EQ(success_count.load(), kCallCount);
+  // The calls overlap, so the total is far less than the sum of the delays.
+  EXPECT_LT(absl::Now() - start, kDelay * kCallCount / 2);
+}
+
 TEST(KmsClientTest, CreateCryptoKeyCreatesCryptoKey) {
   ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
                        fakekms::Server::New());
@@ -740,6 +940,46 @@ TEST(KmsClientTest, GetCryptoKeyVersionSuccess) {
   EXPECT_THAT(got_ckv, EqualsProto(ckv));
 }
 
+TEST(KmsClientTest, ChannelPoolServesRequestsOnEveryChannel) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Milliseconds(500),
+      .channel_count = 4,
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), RandomId(), ck,
+                            false);
+
+  // Channels connect when their first request is sent. The key ring and key
+  // above were created through kms_stub(), which uses only the first channel.
+  ASSERT_EQ(client.channels().size(), 4);
+  for (size_t i = 1; i < client.channels().size(); i++) {
+    EXPECT_EQ(client.channels()[i]->GetState(false), GRPC_CHANNEL_IDLE)
+        << "channel " << i;
+  }
+
+  // Issue enough requests that each channel in the pool is used at least
+  // twice.
+  for (int i = 0; i < 8; i++) {
+    kms_v1::GetCryptoKeyRequest req;
+    req.set_name(ck.name());
+    ASSERT_OK_AND_ASSIGN(kms_v1::CryptoKey got_ck, client.GetCryptoKey(req));
+    EXPECT_THAT(got_ck, EqualsProto(ck));
+  }
+
+  for (size_t i = 0; i < client.channels().size(); i++) {
+    EXPECT_EQ(client.channels()[i]->GetState(false), GRPC_CHANNEL_READY)
+        << "channel " << i;
+  }
+}
+
 TEST(KmsClientTest, ClientRetriesTransparentlyOnUnavailable) {
   ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
                        fakekms::Server::New());
@@ -787,6 +1027,421 @@ TEST(KmsClientTest, ClientRetriesTransparentlyOnServerDeadlineExceeded) {
   EXPECT_THAT(got_ck, EqualsProto(ck));
 }
 
+TEST(KmsClientTest, MacSignHedgingCollapsesTailLatency) {
+  constexpr absl::Duration kSlowDelay = absl::Seconds(2);
+  constexpr absl::Duration kHedgingDelay = absl::Milliseconds(200);
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .hedging_delay = kHedgingDelay,
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::MAC);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::HMAC_SHA256);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv;
+  ckv = CreateCryptoKeyVersionOrDie(client.kms_stub(), ck.name(), ckv);
+  ckv = WaitForEnablement(client.kms_stub(), ckv);
+
+  // Every fourth request is slow. The delay is consumed by the original
+  // request, so the hedged request that follows it is not delayed.
+  constexpr int kCallCount = 16;
+  absl::Duration max_latency;
+  for (int i = 0; i < kCallCount; i++) {
+    if (i % 4 == 0) {
+      AddDelayOrDie(*fake, kSlowDelay, "MacSign");
+    }
+
+    kms_v1::MacSignRequest req;
+    req.set_name(ckv.name());
+    req.set_data("Here is some data to authenticate");
+
+    absl::Time start = absl::Now();
+    ASSERT_OK(client.MacSign(req));
+    max_latency = std::max(max_latency, absl::Now() - start);
+  }
+
+  EXPECT_LT(max_latency, kSlowDelay / 2);
+
+  // Requests that were not delayed may also have been hedged on a slow test
+  // machine, so these are lower bounds.
+  HedgeCounts counts = client.GetHedgeCounts()["MacSign"];
+  EXPECT_GE(counts.hedges_sent, kCallCount / 4);
+  EXPECT_GE(counts.hedges_won, kCallCount / 4);
+}
+
+TEST(KmsClientTest, HedgedRequestThatFailsFirstDoesNotWin) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .hedging_delay = absl::Milliseconds(50),
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::MAC);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::HMAC_SHA256);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv;
+  ckv = CreateCryptoKeyVersionOrDie(client.kms_stub(), ck.name(), ckv);
+  ckv = WaitForEnablement(client.kms_stub(), ckv);
+
+  // The original request is slow but succeeds, and the hedged request fails
+  // right away.
+  AddDelayOrDie(*fake, absl::Milliseconds(300), "MacSign");
+  AddErrorOrDie(*fake, absl::PermissionDeniedError("denied"), "MacSign");
+
+  kms_v1::MacSignRequest req;
+  req.set_name(ckv.name());
+  req.set_data("Here is some data to authenticate");
+  EXPECT_OK(client.MacSign(req));
+
+  HedgeCounts counts = client.GetHedgeCounts()["MacSign"];
+  EXPECT_EQ(counts.hedges_sent, 1);
+  EXPECT_EQ(counts.hedges_won, 0);
+}
+
+TEST(KmsClientTest, AsymmetricSignHedgesOnlyDeterministicRequests) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .hedging_delay = absl::Milliseconds(50),
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::RSA_SIGN_PKCS1_2048_SHA256);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv;
+  ckv = CreateCryptoKeyVersionOrDie(client.kms_stub(), ck.name(), ckv);
+  ckv = WaitForEnablement(client.kms_stub(), ckv);
+
+  uint8_t digest[32];
+  SHA256(reinterpret_cast<const uint8_t*>("data"), 4, digest);
+
+  kms_v1::AsymmetricSignRequest req;
+  req.set_name(ckv.name());
+  req.mutable_digest()->set_sha256(digest, sizeof(digest));
+
+  AddDelayOrDie(*fake, absl::Milliseconds(300), "AsymmetricSign");
+  ASSERT_OK(client.AsymmetricSign(req));
+  EXPECT_EQ(client.GetHedgeCounts()["AsymmetricSign"].hedges_sent, 0);
+
+  AddDelayOrDie(*fake, absl::Milliseconds(300), "AsymmetricSign");
+  ASSERT_OK(client.AsymmetricSign(req, /*deterministic=*/true));
+  EXPECT_EQ(client.GetHedgeCounts()["AsymmetricSign"].hedges_sent, 1);
+}
+
+TEST(KmsClientTest, HedgingDisabledByDefault) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  std::unique_ptr<KmsClient> client = NewClient(fake->listen_addr());
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client->kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  ck =
+      CreateCryptoKeyOrDie(client->kms_stub(), kr.name(), RandomId(), ck, true);
+
+  AddDelayOrDie(*fake, absl::Milliseconds(200), "GetCryptoKeyVersion");
+
+  kms_v1::GetCryptoKeyVersionRequest req;
+  req.set_name(absl::StrCat(ck.name(), "/cryptoKeyVersions/1"));
+  ASSERT_OK(client->GetCryptoKeyVersion(req));
+
+  for (const auto& [method, counts] : client->GetHedgeCounts()) {
+    EXPECT_EQ(counts.hedges_sent, 0) << method;
+  }
+}
+
+TEST(KmsClientTest, RetryPolicyRetriesTransientErrors) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .retry_policies = FastRetryPolicies(3),
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), RandomId(), ck,
+                            false);
+
+  AddErrorOrDie(*fake, absl::ResourceExhaustedError("quota"), "GetCryptoKey");
+  AddErrorOrDie(*fake, absl::ResourceExhaustedError("quota"), "GetCryptoKey");
+
+  kms_v1::GetCryptoKeyRequest req;
+  req.set_name(ck.name());
+  ASSERT_OK_AND_ASSIGN(kms_v1::CryptoKey got_ck, client.GetCryptoKey(req));
+  EXPECT_THAT(got_ck, EqualsProto(ck));
+}
+
+TEST(KmsClientTest, RetryPolicyGivesUpAfterMaxAttempts) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .retry_policies = FastRetryPolicies(2),
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), RandomId(), ck,
+                            false);
+
+  AddErrorOrDie(*fake, absl::ResourceExhaustedError("quota"), "GetCryptoKey");
+  AddErrorOrDie(*fake, absl::ResourceExhaustedError("quota"), "GetCryptoKey");
+
+  kms_v1::GetCryptoKeyRequest req;
+  req.set_name(ck.name());
+  EXPECT_THAT(client.GetCryptoKey(req),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+}
+
+TEST(KmsClientTest, RetryPolicyDoesNotRetryPermanentErrors) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .retry_policies = FastRetryPolicies(3),
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), RandomId(), ck,
+                            false);
+
+  AddErrorOrDie(*fake, absl::PermissionDeniedError("denied"), "GetCryptoKey");
+
+  kms_v1::GetCryptoKeyRequest req;
+  req.set_name(ck.name());
+  EXPECT_THAT(client.GetCryptoKey(req),
+              StatusIs(absl::StatusCode::kPermissionDenied));
+}
+
+TEST(KmsClientTest, NoRetriesWithoutRetryPolicy) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  std::unique_ptr<KmsClient> client = NewClient(fake->listen_addr());
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client->kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  ck = CreateCryptoKeyOrDie(client->kms_stub(), kr.name(), RandomId(), ck,
+                            false);
+
+  AddErrorOrDie(*fake, absl::ResourceExhaustedError("quota"), "GetCryptoKey");
+
+  kms_v1::GetCryptoKeyRequest req;
+  req.set_name(ck.name());
+  EXPECT_THAT(client->GetCryptoKey(req),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+}
+
+TEST(KmsClientTest, CreateCryptoKeyIsNotRetriedByDefault) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .retry_policies = FastRetryPolicies(3),
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  AddErrorOrDie(*fake, absl::ResourceExhaustedError("quota"),
+                "CreateCryptoKey");
+
+  kms_v1::CreateCryptoKeyRequest req;
+  req.set_parent(kr.name());
+  req.set_crypto_key_id(RandomId());
+  req.mutable_crypto_key()->set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  req.set_skip_initial_version_creation(true);
+
+  EXPECT_THAT(client.CreateCryptoKey(req),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+}
+
+TEST(KmsClientTest, RetryBudgetLimitsRetries) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  // The budget holds a single retry, and never refills.
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .retry_policies = FastRetryPolicies(5),
+      .retry_budget = std::make_shared<RetryBudget>(0, 1),
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), RandomId(), ck,
+                            false);
+
+  for (int i = 0; i < 3; i++) {
+    AddErrorOrDie(*fake, absl::ResourceExhaustedError("quota"),
+                  "GetCryptoKey");
+  }
+
+  kms_v1::GetCryptoKeyRequest req;
+  req.set_name(ck.name());
+  // The first attempt fails, the retry consumes the budget and fails, and no
+  // further retries are permitted.
+  EXPECT_THAT(client.GetCryptoKey(req),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+  // The remaining error is returned without a retry.
+  EXPECT_THAT(client.GetCryptoKey(req),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+  ASSERT_OK(client.GetCryptoKey(req));
+}
+
+TEST(KmsClientTest, RetryPolicyCarvesPerAttemptDeadlines) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Milliseconds(1500),
+      .retry_policies = FastRetryPolicies(3),
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), RandomId(), ck,
+                            false);
+
+  // The first attempt hangs for longer than the overall timeout. Its own
+  // deadline is a third of the overall timeout, which leaves time for a
+  // second attempt to succeed.
+  AddDelayOrDie(*fake, absl::Seconds(3), "GetCryptoKey");
+
+  kms_v1::GetCryptoKeyRequest req;
+  req.set_name(ck.name());
+  ASSERT_OK_AND_ASSIGN(kms_v1::CryptoKey got_ck, client.GetCryptoKey(req));
+  EXPECT_THAT(got_ck, EqualsProto(ck));
+}
+
+TEST(KmsClientTest, RpcStatsRecordCallsIncludingRetries) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  auto stats = std::make_shared<RpcStats>(RpcStats::Options{
+      .per_resource = true,
+  });
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .retry_policies = FastRetryPolicies(3),
+      .rpc_stats = stats,
+  });
+
+  kms_v1::KeyRing kr;
+  kr = CreateKeyRingOrDie(client.kms_stub(), kTestLocation, RandomId(), kr);
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ENCRYPT_DECRYPT);
+  ck = CreateCryptoKeyOrDie(client.kms_stub(), kr.name(), RandomId(), ck,
+                            false);
+
+  AddErrorOrDie(*fake, absl::ResourceExhaustedError("quota"), "GetCryptoKey");
+
+  kms_v1::GetCryptoKeyRequest req;
+  req.set_name(ck.name());
+  ASSERT_OK(client.GetCryptoKey(req));
+  req.set_name("foo");
+  EXPECT_THAT(client.GetCryptoKey(req),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  std::vector<RpcStats::Entry> snapshot = stats->Snapshot();
+  ASSERT_THAT(snapshot, SizeIs(3));
+
+  // The retried call is recorded once, with its final outcome.
+  EXPECT_EQ(snapshot[0].method, "GetCryptoKey");
+  EXPECT_EQ(snapshot[0].resource_name, "");
+  EXPECT_EQ(snapshot[0].in_flight, 0);
+  EXPECT_EQ(snapshot[0].status_counts[static_cast<int>(absl::StatusCode::kOk)],
+            1);
+  EXPECT_EQ(snapshot[0].status_counts[static_cast<int>(
+                absl::StatusCode::kInvalidArgument)],
+            1);
+  EXPECT_EQ(snapshot[0].status_counts[static_cast<int>(
+                absl::StatusCode::kResourceExhausted)],
+            0);
+
+  EXPECT_EQ(snapshot[1].resource_name, "foo");
+  EXPECT_EQ(snapshot[2].resource_name, ck.name());
+}
+
+TEST(KmsClientTest, RpcStatsRecordAsyncCalls) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake,
+                       fakekms::Server::New());
+  auto stats = std::make_shared<RpcStats>();
+  KmsClient client(KmsClient::Options{
+      .endpoint_address = std::string(fake->listen_addr()),
+      .rpc_timeout = absl::Seconds(5),
+      .rpc_stats = stats,
+  });
+
+  kms_v1::AsymmetricSignRequest req;
+  req.set_name("foo");
+  req.set_data("bar");
+
+  AsyncResult<kms_v1::AsymmetricSignResponse> result;
+  client.AsymmetricSignAsync(req, result.Callback());
+  EXPECT_THAT(result.Wait(), StatusIs(absl::StatusCode::kInvalidArgument));
+
+  std::vector<RpcStats::Entry> snapshot = stats->Snapshot();
+  ASSERT_THAT(snapshot, SizeIs(1));
+  EXPECT_EQ(snapshot[0].method, "AsymmetricSign");
+  EXPECT_EQ(snapshot[0].in_flight, 0);
+  EXPECT_EQ(snapshot[0].status_counts[static_cast<int>(
+                absl::StatusCode::kInvalidArgument)],
+            1);
+}
+
 TEST(KmsClientTest, GenerateRandomBytesSuccess) {
   constexpr size_t kByteLength = 64;
 
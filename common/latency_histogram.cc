@@ -0,0 +1,47 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/latency_histogram.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "absl/strings/str_format.h"
+
+namespace cloud_kms {
+
+size_t LatencyBucket(absl::Duration latency) {
+  uint64_t micros = static_cast<uint64_t>(
+      std::max<int64_t>(absl::ToInt64Microseconds(latency), 0));
+  return std::min<size_t>(std::bit_width(micros), kLatencyBucketCount - 1);
+}
+
+void AppendLatencyBuckets(std::string* dest,
+                          absl::Span<const uint64_t> buckets) {
+  for (size_t i = 0; i < buckets.size(); i++) {
+    if (buckets[i] == 0) {
+      continue;
+    }
+    if (i == kLatencyBucketCount - 1) {
+      absl::StrAppendFormat(dest, " >=%d=%d", uint64_t{1} << (i - 1),
+                            buckets[i]);
+    } else {
+      absl::StrAppendFormat(dest, " <%d=%d", uint64_t{1} << i, buckets[i]);
+    }
+  }
+}
+
+}  // namespace cloud_kms
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_LATENCY_HISTOGRAM_H_
+#define COMMON_LATENCY_HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+
+namespace cloud_kms {
+
+// Latency histograms use power-of-two buckets. The upper bound of bucket i is
+// 2^i microseconds, exclusive. The final bucket has no upper bound.
+inline constexpr size_t kLatencyBucketCount = 28;
+
+// Returns the index of the bucket that `latency` falls into. Negative
+// latencies are counted in bucket 0.
+size_t LatencyBucket(absl::Duration latency);
+
+// Appends the non-empty buckets in `buckets`, which must have
+// kLatencyBucketCount elements, to `dest`. Each bucket is rendered as
+// " <bound=count", or " >=bound=count" for the final bucket, with bounds in
+// microseconds.
+void AppendLatencyBuckets(std::string* dest,
+                          absl::Span<const uint64_t> buckets);
+
+}  // namespace cloud_kms
+
+#endif  // COMMON_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/latency_histogram.h"
+
+#include <array>
+
+#include "gmock/gmock.h"
+
+namespace cloud_kms {
+namespace {
+
+TEST(LatencyBucketTest, BucketsByPowersOfTwoMicroseconds) {
+  EXPECT_EQ(LatencyBucket(absl::Nanoseconds(500)), 0);
+  EXPECT_EQ(LatencyBucket(absl::Microseconds(1)), 1);
+  EXPECT_EQ(LatencyBucket(absl::Microseconds(3)), 2);
+  EXPECT_EQ(LatencyBucket(absl::Microseconds(4)), 3);
+}
+
+TEST(LatencyBucketTest, NegativeLatencyIsBucketZero) {
+  EXPECT_EQ(LatencyBucket(absl::Microseconds(-10)), 0);
+}
+
+TEST(LatencyBucketTest, LongLatencyIsFinalBucket) {
+  EXPECT_EQ(LatencyBucket(absl::Hours(1)), kLatencyBucketCount - 1);
+  EXPECT_EQ(LatencyBucket(absl::InfiniteDuration()), kLatencyBucketCount - 1);
+}
+
+TEST(AppendLatencyBucketsTest, RendersNonEmptyBuckets) {
+  std::array<uint64_t, kLatencyBucketCount> buckets = {};
+  buckets[0] = 1;
+  buckets[2] = 3;
+  buckets[kLatencyBucketCount - 1] = 2;
+
+  std::string result = "latency_us:";
+  AppendLatencyBuckets(&result, buckets);
+  EXPECT_EQ(result, "latency_us: <1=1 <4=3 >=67108864=2");
+}
+
+}  // namespace
+}  // namespace cloud_kms
@@ -83,6 +83,7 @@ MAKE_DELETER(EC_GROUP, EC_GROUP_free);
 MAKE_DELETER(EC_KEY, EC_KEY_free);
 MAKE_DELETER(EC_POINT, EC_POINT_free);
 MAKE_DELETER(ECDSA_SIG, ECDSA_SIG_free);
+MAKE_DELETER(EVP_CIPHER_CTX, EVP_CIPHER_CTX_free);
 MAKE_DELETER(EVP_MD_CTX, EVP_MD_CTX_free);
 MAKE_DELETER(EVP_PKEY, EVP_PKEY_free);
 MAKE_DELETER(EVP_PKEY_CTX, EVP_PKEY_CTX_free);
@@ -0,0 +1,150 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "common/status_macros.h"
+
+namespace cloud_kms {
+
+// The state of one loop, shared by the threads that run it.
+struct WorkerPool::Loop {
+  Loop(size_t count, absl::FunctionRef<absl::Status(size_t)> fn)
+      : count(count), fn(fn), failed_index(count) {}
+
+  // Claims and runs indices until none remain or an invocation fails.
+  void Work() {
+    while (!failed.load(std::memory_order_relaxed)) {
+      size_t i = next_index.fetch_add(1);
+      if (i >= count) {
+        return;
+      }
+      absl::Status status = fn(i);
+      if (!status.ok()) {
+        absl::MutexLock lock(&mutex);
+        // Every index below `i` has already been started, so the lowest index
+        // recorded here is the lowest failing index overall.
+        if (i < failed_index) {
+          failed_index = i;
+          result = status;
+        }
+        failed.store(true, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  const size_t count;
+  const absl::FunctionRef<absl::Status(size_t)> fn;
+  std::atomic<size_t> next_index{0};
+  std::atomic<bool> failed{false};
+
+  absl::Mutex mutex;
+  size_t failed_index ABSL_GUARDED_BY(mutex);
+  absl::Status result ABSL_GUARDED_BY(mutex);
+  // Set once the calling thread has returned from Work. A pool thread that
+  // picks up the loop after that must not invoke `fn`, which belongs to the
+  // caller and may no longer be valid.
+  bool done ABSL_GUARDED_BY(mutex) = false;
+  // The number of pool threads that are inside Work.
+  size_t active ABSL_GUARDED_BY(mutex) = 0;
+};
+
+WorkerPool::WorkerPool(size_t thread_count) : shutdown_(false) {
+  threads_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; i++) {
+    threads_.emplace_back(&WorkerPool::Run, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    shutdown_ = true;
+  }
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::Run() {
+  for (;;) {
+    std::shared_ptr<Loop> loop;
+    {
+      absl::MutexLock lock(&mutex_);
+      auto ready = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+        return shutdown_ || !pending_.empty();
+      };
+      mutex_.Await(absl::Condition(&ready));
+      if (pending_.empty()) {
+        return;
+      }
+      loop = std::move(pending_.front());
+      pending_.pop_front();
+    }
+
+    {
+      absl::MutexLock lock(&loop->mutex);
+      if (loop->done) {
+        continue;
+      }
+      loop->active++;
+    }
+    loop->Work();
+    absl::MutexLock lock(&loop->mutex);
+    loop->active--;
+  }
+}
+
+absl::Status WorkerPool::ParallelFor(
+    size_t count, size_t max_concurrency,
+    absl::FunctionRef<absl::Status(size_t)> fn) {
+  size_t thread_count = std::min({count, std::max<size_t>(max_concurrency, 1),
+                                  threads_.size() + 1});
+  if (thread_count <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      RETURN_IF_ERROR(fn(i));
+    }
+    return absl::OkStatus();
+  }
+
+  auto loop = std::make_shared<Loop>(count, fn);
+  {
+    absl::MutexLock lock(&mutex_);
+    for (size_t i = 1; i < thread_count; i++) {
+      pending_.push_back(loop);
+    }
+  }
+  loop->Work();
+
+  absl::MutexLock lock(&loop->mutex);
+  loop->done = true;
+  auto idle = [&loop]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(loop->mutex) {
+    return loop->active == 0;
+  };
+  loop->mutex.Await(absl::Condition(&idle));
+  return loop->result;
+}
+
+absl::Status ParallelFor(size_t count, size_t max_concurrency,
+                         absl::FunctionRef<absl::Status(size_t)> fn) {
+  size_t thread_count = std::min(count, std::max<size_t>(max_concurrency, 1));
+  WorkerPool pool(thread_count > 0 ? thread_count - 1 : 0);
+  return pool.ParallelFor(count, max_concurrency, fn);
+}
+
+}  // namespace cloud_kms
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_PARALLEL_FOR_H_
+#define COMMON_PARALLEL_FOR_H_
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+
+namespace cloud_kms {
+
+// Invokes `fn` once for each index in [0, count), using up to
+// `max_concurrency` threads (including the calling thread). Indices are started
+// in increasing order, and no further indices are started once an invocation
+// fails.
+//
+// Returns the error from the lowest failed index, which is the same error that
+// a sequential loop over the indices would return.
+absl::Status ParallelFor(size_t count, size_t max_concurrency,
+                         absl::FunctionRef<absl::Status(size_t)> fn);
+
+// A fixed set of threads for running ParallelFor loops. The threads are started
+// once and reused, so a loop that runs repeatedly does not start new threads
+// each time.
+//
+// This class is thread-safe. Loops that run at the same time share the pool's
+// threads.
+class WorkerPool {
+ public:
+  // Starts `thread_count` threads. A pool with no threads runs each loop on the
+  // calling thread.
+  explicit WorkerPool(size_t thread_count);
+
+  // Stops the pool's threads. Must not be called while a loop is running.
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // Behaves like the ParallelFor function, but runs `fn` on the calling thread
+  // and up to `max_concurrency - 1` of the pool's threads.
+  absl::Status ParallelFor(size_t count, size_t max_concurrency,
+                           absl::FunctionRef<absl::Status(size_t)> fn);
+
+ private:
+  struct Loop;
+
+  void Run();
+
+  absl::Mutex mutex_;
+  // One entry for each pool thread that a loop has asked for.
+  std::deque<std::shared_ptr<Loop>> pending_ ABSL_GUARDED_BY(mutex_);
+  bool shutdown_ ABSL_GUARDED_BY(mutex_);
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace cloud_kms
+
+#endif  // COMMON_PARALLEL_FOR_H_
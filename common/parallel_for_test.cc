@@ -0,0 +1,166 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/parallel_for.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/barrier.h"
+#include "absl/synchronization/mutex.h"
+#include "common/test/matchers.h"
+#include "common/test/test_status_macros.h"
+#include "gmock/gmock.h"
+
+namespace cloud_kms {
+namespace {
+
+TEST(ParallelForTest, InvokesEachIndexOnce) {
+  std::vector<std::atomic<int>> calls(1000);
+  EXPECT_OK(ParallelFor(calls.size(), 8, [&](size_t i) {
+    calls[i]++;
+    return absl::OkStatus();
+  }));
+
+  for (size_t i = 0; i < calls.size(); i++) {
+    EXPECT_EQ(calls[i].load(), 1) << "index " << i;
+  }
+}
+
+TEST(ParallelForTest, ZeroCountIsOk) {
+  EXPECT_OK(ParallelFor(0, 8, [](size_t i) {
+    ADD_FAILURE() << "unexpected invocation for index " << i;
+    return absl::OkStatus();
+  }));
+}
+
+TEST(ParallelForTest, ZeroConcurrencyRunsSequentially) {
+  std::vector<size_t> order;
+  EXPECT_OK(ParallelFor(10, 0, [&](size_t i) {
+    order.push_back(i);
+    return absl::OkStatus();
+  }));
+
+  EXPECT_THAT(order, testing::ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9));
+}
+
+TEST(ParallelForTest, RunsConcurrently) {
+  // Each invocation waits until all four have started, which can only
+  // succeed if they run at the same time.
+  absl::Barrier barrier(4);
+  EXPECT_OK(ParallelFor(4, 4, [&](size_t i) {
+    barrier.Block();
+    return absl::OkStatus();
+  }));
+}
+
+TEST(ParallelForTest, ReturnsErrorFromLowestFailedIndex) {
+  for (int attempt = 0; attempt < 20; attempt++) {
+    absl::Status result = ParallelFor(100, 8, [](size_t i) -> absl::Status {
+      if (i % 10 == 7) {
+        return absl::InternalError(absl::StrCat("failed at ", i));
+      }
+      return absl::OkStatus();
+    });
+    EXPECT_THAT(result, StatusIs(absl::StatusCode::kInternal,
+                                 testing::HasSubstr("failed at 7")));
+  }
+}
+
+TEST(ParallelForTest, StopsStartingIndicesAfterFailure) {
+  std::atomic<size_t> started(0);
+  absl::Status result = ParallelFor(100000, 4, [&](size_t i) -> absl::Status {
+    started++;
+    if (i == 0) {
+      return absl::AbortedError("stop");
+    }
+    return absl::OkStatus();
+  });
+
+  EXPECT_THAT(result, StatusIs(absl::StatusCode::kAborted));
+  EXPECT_LT(started.load(), 100000);
+}
+
+TEST(WorkerPoolTest, InvokesEachIndexOnce) {
+  WorkerPool pool(7);
+  std::vector<std::atomic<int>> calls(1000);
+  EXPECT_OK(pool.ParallelFor(calls.size(), 8, [&](size_t i) {
+    calls[i]++;
+    return absl::OkStatus();
+  }));
+
+  for (size_t i = 0; i < calls.size(); i++) {
+    EXPECT_EQ(calls[i].load(), 1) << "index " << i;
+  }
+}
+
+TEST(WorkerPoolTest, ReusesThreadsAcrossLoops) {
+  WorkerPool pool(3);
+  absl::Mutex mutex;
+  absl::flat_hash_set<std::thread::id> thread_ids;
+
+  for (int loop = 0; loop < 10; loop++) {
+    // Each invocation waits until all four have started, so each runs on a
+    // different thread.
+    absl::Barrier barrier(4);
+    EXPECT_OK(pool.ParallelFor(4, 4, [&](size_t i) {
+      {
+        absl::MutexLock lock(&mutex);
+        thread_ids.insert(std::this_thread::get_id());
+      }
+      barrier.Block();
+      return absl::OkStatus();
+    }));
+  }
+
+  // The calling thread and the pool's three threads ran every loop.
+  EXPECT_EQ(thread_ids.size(), 4);
+}
+
+TEST(WorkerPoolTest, ConcurrentLoopsShareThreads) {
+  WorkerPool pool(2);
+  std::atomic<int> calls(0);
+  auto run_loop = [&] {
+    EXPECT_OK(pool.ParallelFor(100, 3, [&](size_t i) {
+      calls++;
+      return absl::OkStatus();
+    }));
+  };
+
+  std::thread other(run_loop);
+  run_loop();
+  other.join();
+  EXPECT_EQ(calls.load(), 200);
+}
+
+TEST(WorkerPoolTest, ReturnsErrorFromLowestFailedIndex) {
+  WorkerPool pool(7);
+  for (int attempt = 0; attempt < 20; attempt++) {
+    absl::Status result =
+        pool.ParallelFor(100, 8, [](size_t i) -> absl::Status {
+          if (i % 10 == 7) {
+            return absl::InternalError(absl::StrCat("failed at ", i));
+          }
+          return absl::OkStatus();
+        });
+    EXPECT_THAT(result, StatusIs(absl::StatusCode::kInternal,
+                                 testing::HasSubstr("failed at 7")));
+  }
+}
+
+}  // namespace
+}  // namespace cloud_kms
@@ -46,6 +46,20 @@ std::string GetHostPlatformInfo();
 // Writes the provided message to the system log. This is a no-op on Windows.
 void WriteToSystemLog(const char* message);
 
+// Returns the size of a page of virtual memory.
+size_t GetPageSize();
+
+// Maps `len` bytes of zeroed, page-aligned memory that is not shared with any
+// other allocation, and attempts to lock it into physical memory so that it is
+// never written to swap. `len` must be a multiple of GetPageSize(). Returns
+// nullptr if the memory could not be mapped. Locking is best-effort, since it
+// fails once the process's locked memory limit is reached; `*locked` is set to
+// whether it succeeded.
+void* MapLockedPages(size_t len, bool* locked);
+
+// Unlocks and unmaps memory that was returned by MapLockedPages.
+void UnmapLockedPages(void* addr, size_t len);
+
 }  // namespace cloud_kms
 
 #endif  // COMMON_PLATFORM_H_
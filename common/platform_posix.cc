@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <errno.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/utsname.h>
@@ -83,4 +84,26 @@ void WriteToSystemLog(const char* message) {
   closelog();
 }
 
+size_t GetPageSize() { return static_cast<size_t>(sysconf(_SC_PAGESIZE)); }
+
+void* MapLockedPages(size_t len, bool* locked) {
+  void* addr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    *locked = false;
+    return nullptr;
+  }
+#ifdef MADV_DONTDUMP
+  // Keep the contents out of core dumps as well.
+  madvise(addr, len, MADV_DONTDUMP);
+#endif
+  *locked = mlock(addr, len) == 0;
+  return addr;
+}
+
+void UnmapLockedPages(void* addr, size_t len) {
+  munlock(addr, len);
+  munmap(addr, len);
+}
+
 }  // namespace cloud_kms
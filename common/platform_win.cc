@@ -157,4 +157,26 @@ void WriteToSystemLog(const char* message) {
   // https://learn.microsoft.com/en-us/windows/win32/eventlog/event-sources
 }
 
+size_t GetPageSize() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+}
+
+void* MapLockedPages(size_t len, bool* locked) {
+  void* addr =
+      VirtualAlloc(nullptr, len, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+  if (!addr) {
+    *locked = false;
+    return nullptr;
+  }
+  *locked = VirtualLock(addr, len) != 0;
+  return addr;
+}
+
+void UnmapLockedPages(void* addr, size_t len) {
+  VirtualUnlock(addr, len);
+  VirtualFree(addr, 0, MEM_RELEASE);
+}
+
 }  // namespace cloud_kms
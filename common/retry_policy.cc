@@ -0,0 +1,61 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/retry_policy.h"
+
+#include <algorithm>
+
+#include "absl/random/random.h"
+#include "common/backoff.h"
+
+namespace cloud_kms {
+
+bool IsRetryable(const RetryPolicy& policy, const absl::Status& status) {
+  return std::find(policy.retryable_codes.begin(),
+                   policy.retryable_codes.end(),
+                   status.code()) != policy.retryable_codes.end();
+}
+
+absl::Duration JitteredBackoff(const RetryPolicy& policy,
+                               int previous_retries) {
+  thread_local absl::InsecureBitGen bit_gen;
+  absl::Duration backoff = ComputeBackoff(
+      policy.min_backoff, policy.max_backoff, previous_retries);
+  return backoff * absl::Uniform(bit_gen, 0.5, 1.0);
+}
+
+RetryBudget::RetryBudget(double retries_per_second, double capacity)
+    : retries_per_second_(retries_per_second),
+      capacity_(capacity),
+      tokens_(capacity),
+      last_refill_(absl::InfinitePast()) {}
+
+bool RetryBudget::TryAcquire(absl::Time now) {
+  absl::MutexLock lock(&mutex_);
+  if (now > last_refill_) {
+    if (last_refill_ != absl::InfinitePast()) {
+      tokens_ = std::min(capacity_,
+                         tokens_ + absl::ToDoubleSeconds(now - last_refill_) *
+                                       retries_per_second_);
+    }
+    last_refill_ = now;
+  }
+  if (tokens_ < 1) {
+    return false;
+  }
+  tokens_ -= 1;
+  return true;
+}
+
+}  // namespace cloud_kms
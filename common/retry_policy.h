@@ -0,0 +1,77 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_RETRY_POLICY_H_
+#define COMMON_RETRY_POLICY_H_
+
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace cloud_kms {
+
+// Describes how failed attempts of an RPC should be retried.
+struct RetryPolicy {
+  // The maximum number of attempts, including the original request. Values
+  // less than 1 are treated as 1.
+  int max_attempts = 1;
+  // Bounds for the delay between attempts, which grows exponentially (see
+  // ComputeBackoff) and is then jittered.
+  absl::Duration min_backoff = absl::Milliseconds(50);
+  absl::Duration max_backoff = absl::Seconds(2);
+  // The status codes that are considered transient.
+  std::vector<absl::StatusCode> retryable_codes = {
+      absl::StatusCode::kUnavailable,
+      absl::StatusCode::kResourceExhausted,
+      absl::StatusCode::kDeadlineExceeded,
+  };
+};
+
+// Returns true if `status` is an error that `policy` considers transient.
+bool IsRetryable(const RetryPolicy& policy, const absl::Status& status);
+
+// Returns the delay that should precede the next attempt, after
+// `previous_retries` retries have already been made. The result is chosen
+// uniformly at random between half of and the full exponential backoff, so
+// that callers that failed together do not retry together.
+absl::Duration JitteredBackoff(const RetryPolicy& policy, int previous_retries);
+
+// A token bucket that limits the rate at which retries may be issued, so that
+// retries cannot amplify an outage. The bucket starts full, and refills at a
+// constant rate up to its capacity. This class is thread-safe.
+class RetryBudget {
+ public:
+  RetryBudget(double retries_per_second, double capacity);
+
+  // Takes a token from the bucket and returns true if one is available as of
+  // `now`; otherwise returns false.
+  bool TryAcquire(absl::Time now = absl::Now());
+
+ private:
+  const double retries_per_second_;
+  const double capacity_;
+
+  absl::Mutex mutex_;
+  double tokens_ ABSL_GUARDED_BY(mutex_);
+  absl::Time last_refill_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace cloud_kms
+
+#endif  // COMMON_RETRY_POLICY_H_
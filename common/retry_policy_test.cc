@@ -0,0 +1,96 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/retry_policy.h"
+
+#include "common/backoff.h"
+#include "gmock/gmock.h"
+
+namespace cloud_kms {
+namespace {
+
+TEST(IsRetryableTest, DefaultPolicyRetriesTransientErrors) {
+  RetryPolicy policy;
+  EXPECT_TRUE(IsRetryable(policy, absl::UnavailableError("unavailable")));
+  EXPECT_TRUE(IsRetryable(policy, absl::ResourceExhaustedError("quota")));
+  EXPECT_TRUE(IsRetryable(policy, absl::DeadlineExceededError("deadline")));
+}
+
+TEST(IsRetryableTest, DefaultPolicyDoesNotRetryOtherErrors) {
+  RetryPolicy policy;
+  EXPECT_FALSE(IsRetryable(policy, absl::OkStatus()));
+  EXPECT_FALSE(IsRetryable(policy, absl::InvalidArgumentError("invalid")));
+  EXPECT_FALSE(IsRetryable(policy, absl::NotFoundError("not found")));
+  EXPECT_FALSE(IsRetryable(policy, absl::InternalError("internal")));
+}
+
+TEST(IsRetryableTest, CustomRetryableCodes) {
+  RetryPolicy policy;
+  policy.retryable_codes = {absl::StatusCode::kAborted};
+  EXPECT_TRUE(IsRetryable(policy, absl::AbortedError("aborted")));
+  EXPECT_FALSE(IsRetryable(policy, absl::UnavailableError("unavailable")));
+}
+
+TEST(JitteredBackoffTest, BoundedByComputeBackoff) {
+  RetryPolicy policy;
+  policy.min_backoff = absl::Milliseconds(100);
+  policy.max_backoff = absl::Seconds(5);
+
+  for (int retries = 0; retries < 20; retries++) {
+    absl::Duration backoff =
+        ComputeBackoff(policy.min_backoff, policy.max_backoff, retries);
+    absl::Duration jittered = JitteredBackoff(policy, retries);
+    EXPECT_GE(jittered, backoff / 2);
+    EXPECT_LE(jittered, backoff);
+  }
+}
+
+TEST(RetryBudgetTest, StartsFull) {
+  absl::Time now = absl::Now();
+  RetryBudget budget(1, 3);
+
+  EXPECT_TRUE(budget.TryAcquire(now));
+  EXPECT_TRUE(budget.TryAcquire(now));
+  EXPECT_TRUE(budget.TryAcquire(now));
+  EXPECT_FALSE(budget.TryAcquire(now));
+}
+
+TEST(RetryBudgetTest, RefillsOverTime) {
+  absl::Time now = absl::Now();
+  RetryBudget budget(2, 1);
+
+  EXPECT_TRUE(budget.TryAcquire(now));
+  EXPECT_FALSE(budget.TryAcquire(now));
+  EXPECT_FALSE(budget.TryAcquire(now + absl::Milliseconds(250)));
+  EXPECT_TRUE(budget.TryAcquire(now + absl::Milliseconds(500)));
+}
+
+TEST(RetryBudgetTest, RefillIsCappedAtCapacity) {
+  absl::Time now = absl::Now();
+  RetryBudget budget(10, 2);
+
+  EXPECT_TRUE(budget.TryAcquire(now));
+  now += absl::Hours(1);
+  EXPECT_TRUE(budget.TryAcquire(now));
+  EXPECT_TRUE(budget.TryAcquire(now));
+  EXPECT_FALSE(budget.TryAcquire(now));
+}
+
+TEST(RetryBudgetTest, ZeroCapacityNeverAllowsRetries) {
+  RetryBudget budget(100, 0);
+  EXPECT_FALSE(budget.TryAcquire());
+}
+
+}  // namespace
+}  // namespace cloud_kms
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/rpc_stats.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+
+namespace cloud_kms {
+namespace {
+
+size_t StatusCodeIndex(absl::StatusCode code) {
+  size_t index = static_cast<size_t>(code);
+  if (index >= RpcStats::kStatusCodeCount) {
+    return static_cast<size_t>(absl::StatusCode::kUnknown);
+  }
+  return index;
+}
+
+}  // namespace
+
+RpcStats::RpcStats(Options options) : per_resource_(options.per_resource) {}
+
+RpcStats::Call RpcStats::Start(std::string_view method,
+                               std::string_view resource_name) {
+  Counters* method_counters = nullptr;
+  Counters* resource_counters = nullptr;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    auto it = methods_.find(method);
+    if (it != methods_.end()) {
+      method_counters = &it->second.totals;
+      if (per_resource_) {
+        auto resource_it = it->second.resources.find(resource_name);
+        if (resource_it != it->second.resources.end()) {
+          resource_counters = &resource_it->second;
+        }
+      }
+    }
+  }
+
+  // This is the first call to this method or resource.
+  if (!method_counters || (per_resource_ && !resource_counters)) {
+    absl::MutexLock lock(&mutex_);
+    MethodCounters& counters =
+        methods_.try_emplace(std::string(method)).first->second;
+    method_counters = &counters.totals;
+    if (per_resource_) {
+      resource_counters =
+          &counters.resources.try_emplace(std::string(resource_name))
+               .first->second;
+    }
+  }
+
+  return Call(method_counters, resource_counters);
+}
+
+RpcStats::Call::Call(Counters* method_counters, Counters* resource_counters)
+    : method_counters_(method_counters),
+      resource_counters_(resource_counters),
+      start_(absl::Now()) {
+  method_counters_->in_flight.fetch_add(1, std::memory_order_relaxed);
+  if (resource_counters_) {
+    resource_counters_->in_flight.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void RpcStats::Call::Done(const absl::Status& status) const {
+  size_t latency_bucket = LatencyBucket(absl::Now() - start_);
+  size_t status_index = StatusCodeIndex(status.code());
+  for (Counters* counters : {method_counters_, resource_counters_}) {
+    if (!counters) {
+      continue;
+    }
+    counters->in_flight.fetch_sub(1, std::memory_order_relaxed);
+    counters->status_counts[status_index].fetch_add(1,
+                                                    std::memory_order_relaxed);
+    counters->latency_buckets[latency_bucket].fetch_add(
+        1, std::memory_order_relaxed);
+  }
+}
+
+std::vector<RpcStats::Entry> RpcStats::Snapshot() const {
+  auto to_entry = [](std::string_view method, std::string_view resource_name,
+                     const Counters& counters) {
+    Entry entry;
+    entry.method = std::string(method);
+    entry.resource_name = std::string(resource_name);
+    entry.in_flight = counters.in_flight.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kStatusCodeCount; i++) {
+      entry.status_counts[i] =
+          counters.status_counts[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < kLatencyBucketCount; i++) {
+      entry.latency_buckets[i] =
+          counters.latency_buckets[i].load(std::memory_order_relaxed);
+    }
+    return entry;
+  };
+
+  std::vector<Entry> result;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (const auto& [method, counters] : methods_) {
+      result.push_back(to_entry(method, "", counters.totals));
+      for (const auto& [resource_name, resource_counters] :
+           counters.resources) {
+        result.push_back(to_entry(method, resource_name, resource_counters));
+      }
+    }
+  }
+
+  std::sort(result.begin(), result.end(),
+            [](const Entry& a, const Entry& b) {
+              return std::tie(a.method, a.resource_name) <
+                     std::tie(b.method, b.resource_name);
+            });
+  return result;
+}
+
+std::string RpcStats::ToString() const {
+  std::string result;
+  for (const Entry& entry : Snapshot()) {
+    absl::StrAppend(&result, entry.method);
+    if (!entry.resource_name.empty()) {
+      absl::StrAppend(&result, " ", entry.resource_name);
+    }
+    absl::StrAppendFormat(&result, ": in_flight=%d", entry.in_flight);
+    for (size_t i = 0; i < kStatusCodeCount; i++) {
+      if (entry.status_counts[i] > 0) {
+        absl::StrAppendFormat(
+            &result, " %s=%d",
+            absl::StatusCodeToString(static_cast<absl::StatusCode>(i)),
+            entry.status_counts[i]);
+      }
+    }
+    absl::StrAppend(&result, "\n  latency_us:");
+    AppendLatencyBuckets(&result, entry.latency_buckets);
+    absl::StrAppend(&result, "\n");
+  }
+  return result;
+}
+
+}  // namespace cloud_kms
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_RPC_STATS_H_
+#define COMMON_RPC_STATS_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/node_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "common/latency_histogram.h"
+
+namespace cloud_kms {
+
+// Latency histograms, in-flight gauges and status code counts for the calls
+// made by one or more KmsClients, keyed by method name and, optionally, by
+// resource name. This class is thread-safe.
+class RpcStats {
+ public:
+  // Latency is bucketed as described in common/latency_histogram.h.
+  static constexpr size_t kLatencyBucketCount = cloud_kms::kLatencyBucketCount;
+  // One count is kept for each absl::StatusCode, from kOk to kUnauthenticated.
+  static constexpr size_t kStatusCodeCount = 17;
+
+  struct Options {
+    // If true, statistics are also kept for each distinct resource name, in
+    // addition to the totals for each method.
+    bool per_resource = false;
+  };
+
+  // A snapshot of the statistics for one method, or for one method and
+  // resource.
+  struct Entry {
+    std::string method;
+    // Empty for the totals of a method.
+    std::string resource_name;
+    // The number of calls that have started but not completed.
+    int64_t in_flight = 0;
+    // Completed calls, indexed by absl::StatusCode.
+    std::array<uint64_t, kStatusCodeCount> status_counts = {};
+    std::array<uint64_t, kLatencyBucketCount> latency_buckets = {};
+  };
+
+  class Call;
+
+  explicit RpcStats(Options options);
+  RpcStats() : RpcStats(Options()) {}
+
+  RpcStats(const RpcStats&) = delete;
+  RpcStats& operator=(const RpcStats&) = delete;
+
+  // Records the start of a call to `method` for `resource_name`.
+  Call Start(std::string_view method, std::string_view resource_name);
+
+  // Returns the current statistics, sorted by method and then by resource
+  // name. The totals for each method precede its per-resource entries.
+  std::vector<Entry> Snapshot() const;
+
+  // Renders the current statistics as text.
+  std::string ToString() const;
+
+ private:
+  struct Counters {
+    std::atomic<int64_t> in_flight = 0;
+    std::array<std::atomic<uint64_t>, kStatusCodeCount> status_counts = {};
+    std::array<std::atomic<uint64_t>, kLatencyBucketCount> latency_buckets =
+        {};
+  };
+
+  struct MethodCounters {
+    Counters totals;
+    absl::node_hash_map<std::string, Counters> resources;
+  };
+
+  const bool per_resource_;
+
+  mutable absl::Mutex mutex_;
+  // Counters are never removed, so pointers to them remain valid for the
+  // lifetime of this object.
+  absl::node_hash_map<std::string, MethodCounters> methods_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+// A call that is in progress. Done should be invoked exactly once, when the
+// call completes.
+class RpcStats::Call {
+ public:
+  void Done(const absl::Status& status) const;
+
+ private:
+  friend class RpcStats;
+  Call(Counters* method_counters, Counters* resource_counters);
+
+  Counters* method_counters_;
+  Counters* resource_counters_;  // May be nullptr.
+  absl::Time start_;
+};
+
+}  // namespace cloud_kms
+
+#endif  // COMMON_RPC_STATS_H_
@@ -0,0 +1,144 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/rpc_stats.h"
+
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace cloud_kms {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Not;
+
+uint64_t Sum(const std::array<uint64_t, RpcStats::kLatencyBucketCount>& a) {
+  return std::accumulate(a.begin(), a.end(), uint64_t{0});
+}
+
+TEST(RpcStatsTest, SnapshotIsInitiallyEmpty) {
+  RpcStats stats;
+  EXPECT_THAT(stats.Snapshot(), IsEmpty());
+}
+
+TEST(RpcStatsTest, InFlightCallsAreCounted) {
+  RpcStats stats;
+
+  RpcStats::Call call = stats.Start("GetCryptoKey", "projects/foo");
+  std::vector<RpcStats::Entry> snapshot = stats.Snapshot();
+  ASSERT_EQ(snapshot.size(), 1);
+  EXPECT_EQ(snapshot[0].method, "GetCryptoKey");
+  EXPECT_EQ(snapshot[0].resource_name, "");
+  EXPECT_EQ(snapshot[0].in_flight, 1);
+  EXPECT_EQ(Sum(snapshot[0].latency_buckets), 0);
+
+  call.Done(absl::OkStatus());
+  snapshot = stats.Snapshot();
+  EXPECT_EQ(snapshot[0].in_flight, 0);
+  EXPECT_EQ(Sum(snapshot[0].latency_buckets), 1);
+}
+
+TEST(RpcStatsTest, StatusCodesAreCounted) {
+  RpcStats stats;
+
+  stats.Start("AsymmetricSign", "").Done(absl::OkStatus());
+  stats.Start("AsymmetricSign", "").Done(absl::UnavailableError("down"));
+  stats.Start("AsymmetricSign", "").Done(absl::UnavailableError("down"));
+
+  RpcStats::Entry entry = stats.Snapshot()[0];
+  EXPECT_EQ(entry.status_counts[static_cast<int>(absl::StatusCode::kOk)], 1);
+  EXPECT_EQ(
+      entry.status_counts[static_cast<int>(absl::StatusCode::kUnavailable)],
+      2);
+}
+
+TEST(RpcStatsTest, ResourcesAreNotTrackedByDefault) {
+  RpcStats stats;
+
+  stats.Start("AsymmetricSign", "projects/foo").Done(absl::OkStatus());
+  stats.Start("AsymmetricSign", "projects/bar").Done(absl::OkStatus());
+
+  std::vector<RpcStats::Entry> snapshot = stats.Snapshot();
+  ASSERT_EQ(snapshot.size(), 1);
+  EXPECT_EQ(snapshot[0].status_counts[0], 2);
+}
+
+TEST(RpcStatsTest, ResourcesAreTrackedWhenEnabled) {
+  RpcStats stats(RpcStats::Options{.per_resource = true});
+
+  stats.Start("AsymmetricSign", "projects/foo").Done(absl::OkStatus());
+  stats.Start("AsymmetricSign", "projects/bar").Done(absl::OkStatus());
+  stats.Start("AsymmetricSign", "projects/foo").Done(absl::OkStatus());
+  stats.Start("AsymmetricDecrypt", "projects/foo").Done(absl::OkStatus());
+
+  std::vector<RpcStats::Entry> snapshot = stats.Snapshot();
+  ASSERT_EQ(snapshot.size(), 5);
+  EXPECT_EQ(snapshot[0].method, "AsymmetricDecrypt");
+  EXPECT_EQ(snapshot[0].resource_name, "");
+  EXPECT_EQ(snapshot[1].method, "AsymmetricDecrypt");
+  EXPECT_EQ(snapshot[1].resource_name, "projects/foo");
+  EXPECT_EQ(snapshot[2].method, "AsymmetricSign");
+  EXPECT_EQ(snapshot[2].resource_name, "");
+  EXPECT_EQ(snapshot[2].status_counts[0], 3);
+  EXPECT_EQ(snapshot[3].resource_name, "projects/bar");
+  EXPECT_EQ(snapshot[3].status_counts[0], 1);
+  EXPECT_EQ(snapshot[4].resource_name, "projects/foo");
+  EXPECT_EQ(snapshot[4].status_counts[0], 2);
+}
+
+TEST(RpcStatsTest, ConcurrentCallsAreCounted) {
+  RpcStats stats(RpcStats::Options{.per_resource = true});
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&stats, i] {
+      for (int j = 0; j < 1000; j++) {
+        stats.Start("Encrypt", i % 2 ? "projects/foo" : "projects/bar")
+            .Done(absl::OkStatus());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<RpcStats::Entry> snapshot = stats.Snapshot();
+  ASSERT_EQ(snapshot.size(), 3);
+  EXPECT_EQ(snapshot[0].status_counts[0], 8000);
+  EXPECT_EQ(snapshot[1].status_counts[0], 4000);
+  EXPECT_EQ(snapshot[2].status_counts[0], 4000);
+}
+
+TEST(RpcStatsTest, ToStringIncludesCounts) {
+  RpcStats stats(RpcStats::Options{.per_resource = true});
+
+  RpcStats::Call call = stats.Start("MacSign", "projects/foo");
+  stats.Start("MacSign", "projects/foo")
+      .Done(absl::DeadlineExceededError("slow"));
+
+  std::string text = stats.ToString();
+  EXPECT_THAT(text, HasSubstr("MacSign: in_flight=1 DEADLINE_EXCEEDED=1"));
+  EXPECT_THAT(text, HasSubstr("MacSign projects/foo: in_flight=1"));
+  EXPECT_THAT(text, HasSubstr("latency_us:"));
+  EXPECT_THAT(text, Not(HasSubstr("OK=")));
+  call.Done(absl::OkStatus());
+}
+
+}  // namespace
+}  // namespace cloud_kms
@@ -65,6 +65,49 @@ func TestListCryptoKeysSorted(t *testing.T) {
 	}
 }
 
+func TestListCryptoKeysFiltered(t *testing.T) {
+	ctx := context.Background()
+
+	kr := client.CreateTestKR(ctx, t, &kmspb.CreateKeyRingRequest{Parent: location})
+
+	client.CreateTestCK(ctx, t, &kmspb.CreateCryptoKeyRequest{
+		Parent:      kr.Name,
+		CryptoKeyId: "key-a",
+		CryptoKey: &kmspb.CryptoKey{
+			Purpose: kmspb.CryptoKey_ENCRYPT_DECRYPT,
+		},
+	})
+
+	ckb := client.CreateTestCK(ctx, t, &kmspb.CreateCryptoKeyRequest{
+		Parent:      kr.Name,
+		CryptoKeyId: "key-b",
+		CryptoKey: &kmspb.CryptoKey{
+			Purpose: kmspb.CryptoKey_ASYMMETRIC_SIGN,
+			VersionTemplate: &kmspb.CryptoKeyVersionTemplate{
+				Algorithm: kmspb.CryptoKeyVersion_EC_SIGN_P256_SHA256,
+			},
+		},
+		SkipInitialVersionCreation: true,
+	})
+
+	iter := client.ListCryptoKeys(ctx, &kmspb.ListCryptoKeysRequest{
+		Parent: kr.Name,
+		Filter: "purpose=ASYMMETRIC_SIGN",
+	})
+
+	r1, err := iter.Next()
+	if err != nil {
+		t.Fatalf("first call to iter.Next() resulted in error=%v, want nil", err)
+	}
+	if diff := cmp.Diff(ckb, r1, ProtoDiffOpts()...); diff != "" {
+		t.Errorf("first element mismatch (-want +got): %s", diff)
+	}
+
+	if r2, err := iter.Next(); err == nil {
+		t.Errorf("second call to iter.Next() returned %v, want no more elements", r2)
+	}
+}
+
 func TestListCryptoKeysMalformedParent(t *testing.T) {
 	ctx := context.Background()
 
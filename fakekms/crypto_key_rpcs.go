@@ -118,7 +118,7 @@ func (f *fakeKMS) GetCryptoKey(ctx context.Context, req *kmspb.GetCryptoKeyReque
 
 // ListCryptoKeys fakes a Cloud KMS API function.
 func (f *fakeKMS) ListCryptoKeys(ctx context.Context, req *kmspb.ListCryptoKeysRequest) (*kmspb.ListCryptoKeysResponse, error) {
-	if err := allowlist("parent").check(req); err != nil {
+	if err := allowlist("parent", "filter").check(req); err != nil {
 		return nil, err
 	}
 
@@ -127,6 +127,11 @@ func (f *fakeKMS) ListCryptoKeys(ctx context.Context, req *kmspb.ListCryptoKeysR
 		return nil, err
 	}
 
+	fltr, err := parseFilter(req.Filter)
+	if err != nil {
+		return nil, err
+	}
+
 	kr, ok := f.keyRings[parent]
 	if !ok {
 		return nil, errNotFound(parent)
@@ -134,7 +139,9 @@ func (f *fakeKMS) ListCryptoKeys(ctx context.Context, req *kmspb.ListCryptoKeysR
 
 	r := make([]*kmspb.CryptoKey, 0, len(kr.keys))
 	for _, ck := range kr.keys {
-		r = append(r, ck.pb)
+		if filterMatches(fltr, ck.pb) {
+			r = append(r, ck.pb)
+		}
 	}
 
 	if len(r) > maxPageSize {
@@ -112,7 +112,7 @@ func (f *fakeKMS) GetCryptoKeyVersion(ctx context.Context, req *kmspb.GetCryptoK
 
 // ListCryptoKeyVersions fakes a Cloud KMS API function.
 func (f *fakeKMS) ListCryptoKeyVersions(ctx context.Context, req *kmspb.ListCryptoKeyVersionsRequest) (*kmspb.ListCryptoKeyVersionsResponse, error) {
-	if err := allowlist("parent").check(req); err != nil {
+	if err := allowlist("parent", "filter").check(req); err != nil {
 		return nil, err
 	}
 
@@ -121,6 +121,11 @@ func (f *fakeKMS) ListCryptoKeyVersions(ctx context.Context, req *kmspb.ListCryp
 		return nil, err
 	}
 
+	fltr, err := parseFilter(req.Filter)
+	if err != nil {
+		return nil, err
+	}
+
 	ck, err := f.cryptoKey(parent)
 	if err != nil {
 		return nil, err
@@ -128,7 +133,9 @@ func (f *fakeKMS) ListCryptoKeyVersions(ctx context.Context, req *kmspb.ListCryp
 
 	r := make([]*kmspb.CryptoKeyVersion, 0, len(ck.versions))
 	for _, ckv := range ck.versions {
-		r = append(r, ckv.pb)
+		if filterMatches(fltr, ckv.pb) {
+			r = append(r, ckv.pb)
+		}
 	}
 
 	if len(r) > maxPageSize {
@@ -107,6 +107,12 @@ type ServerOptions struct {
 
 // NewServer starts a new local Fake KMS server that is listening for gRPC requests.
 func NewServer() (*Server, error) {
+	return NewServerWithOptions(ServerOptions{})
+}
+
+// NewServerWithOptions starts a new local Fake KMS server that is listening for
+// gRPC requests, and that behaves according to the provided options.
+func NewServerWithOptions(opts ServerOptions) (*Server, error) {
 	lis, err := net.Listen("tcp", "localhost:0")
 	if err != nil {
 		return nil, err
@@ -115,7 +121,8 @@ func NewServer() (*Server, error) {
 	fakeKMS := &fakeKMS{keyRings: make(map[keyRingName]*keyRing)}
 	faultServer := &fault.Server{}
 	s := grpc.NewServer(grpc.ChainUnaryInterceptor(
-		faultServer.NewInterceptor(), newLockInterceptor(&fakeKMS.mux)))
+		faultServer.NewInterceptor(), newDelayInterceptor(opts.Delay),
+		newLockInterceptor(&fakeKMS.mux)))
 	kmspb.RegisterKeyManagementServiceServer(s, fakeKMS)
 	faultpb.RegisterFaultServiceServer(s, faultServer)
 
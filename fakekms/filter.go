@@ -0,0 +1,312 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fakekms
+
+import (
+	"fmt"
+	"strings"
+
+	"google.golang.org/protobuf/proto"
+	"google.golang.org/protobuf/reflect/protoreflect"
+)
+
+// filter is a parsed list filter. It supports the subset of the AIP-160
+// grammar that is useful against KMS resources: comparisons with =, != and :
+// (substring) against scalar, enum and map fields, combined with AND, OR, NOT
+// (or a leading -) and parentheses. As in AIP-160, OR binds more tightly than
+// AND.
+type filter interface {
+	matches(msg protoreflect.Message) bool
+}
+
+// parseFilter parses the provided filter expression. An empty expression
+// matches everything.
+func parseFilter(expr string) (filter, error) {
+	tokens, err := tokenizeFilter(expr)
+	if err != nil {
+		return nil, err
+	}
+	if len(tokens) == 0 {
+		return matchAll{}, nil
+	}
+
+	p := &filterParser{tokens: tokens}
+	f, err := p.parseAnd()
+	if err != nil {
+		return nil, err
+	}
+	if !p.done() {
+		return nil, errInvalidArgument("unexpected token in filter: %q", p.peek())
+	}
+	return f, nil
+}
+
+// filterMatches returns whether msg matches f.
+func filterMatches(f filter, msg proto.Message) bool {
+	return f.matches(msg.ProtoReflect())
+}
+
+type matchAll struct{}
+
+func (matchAll) matches(protoreflect.Message) bool { return true }
+
+type andFilter []filter
+
+func (a andFilter) matches(msg protoreflect.Message) bool {
+	for _, f := range a {
+		if !f.matches(msg) {
+			return false
+		}
+	}
+	return true
+}
+
+type orFilter []filter
+
+func (o orFilter) matches(msg protoreflect.Message) bool {
+	for _, f := range o {
+		if f.matches(msg) {
+			return true
+		}
+	}
+	return false
+}
+
+type notFilter struct{ f filter }
+
+func (n notFilter) matches(msg protoreflect.Message) bool {
+	return !n.f.matches(msg)
+}
+
+type comparison struct {
+	path  []string
+	op    string
+	value string
+}
+
+func (c comparison) matches(msg protoreflect.Message) bool {
+	v, ok := resolveFilterPath(msg, c.path)
+	switch c.op {
+	case "=":
+		return ok && v == c.value
+	case "!=":
+		return !ok || v != c.value
+	case ":":
+		return ok && strings.Contains(v, c.value)
+	default:
+		return false
+	}
+}
+
+// resolveFilterPath returns the string form of the field at path in msg.
+// Enum values are represented by their names. The final element of a path
+// that traverses a string-keyed map field selects the map entry.
+func resolveFilterPath(msg protoreflect.Message, path []string) (string, bool) {
+	for i, name := range path {
+		fd := msg.Descriptor().Fields().ByName(protoreflect.Name(name))
+		if fd == nil {
+			return "", false
+		}
+		v := msg.Get(fd)
+		last := i == len(path)-1
+
+		switch {
+		case fd.IsMap():
+			if i != len(path)-2 {
+				return "", false
+			}
+			mv := v.Map().Get(protoreflect.ValueOfString(path[i+1]).MapKey())
+			if !mv.IsValid() {
+				return "", false
+			}
+			return mv.String(), true
+		case fd.IsList():
+			return "", false
+		case fd.Kind() == protoreflect.MessageKind:
+			if last || !msg.Has(fd) {
+				return "", false
+			}
+			msg = v.Message()
+		case !last:
+			return "", false
+		case fd.Kind() == protoreflect.EnumKind:
+			ev := fd.Enum().Values().ByNumber(v.Enum())
+			if ev == nil {
+				return fmt.Sprint(v.Enum()), true
+			}
+			return string(ev.Name()), true
+		default:
+			return fmt.Sprint(v.Interface()), true
+		}
+	}
+	return "", false
+}
+
+type filterParser struct {
+	tokens []string
+	pos    int
+}
+
+func (p *filterParser) done() bool { return p.pos >= len(p.tokens) }
+
+func (p *filterParser) peek() string {
+	if p.done() {
+		return ""
+	}
+	return p.tokens[p.pos]
+}
+
+func (p *filterParser) next() string {
+	t := p.peek()
+	p.pos++
+	return t
+}
+
+func (p *filterParser) parseAnd() (filter, error) {
+	var terms andFilter
+	for {
+		f, err := p.parseOr()
+		if err != nil {
+			return nil, err
+		}
+		terms = append(terms, f)
+		if p.peek() != "AND" {
+			break
+		}
+		p.next()
+	}
+	if len(terms) == 1 {
+		return terms[0], nil
+	}
+	return terms, nil
+}
+
+func (p *filterParser) parseOr() (filter, error) {
+	var terms orFilter
+	for {
+		f, err := p.parseFactor()
+		if err != nil {
+			return nil, err
+		}
+		terms = append(terms, f)
+		if p.peek() != "OR" {
+			break
+		}
+		p.next()
+	}
+	if len(terms) == 1 {
+		return terms[0], nil
+	}
+	return terms, nil
+}
+
+func (p *filterParser) parseFactor() (filter, error) {
+	switch t := p.next(); t {
+	case "NOT", "-":
+		f, err := p.parseFactor()
+		if err != nil {
+			return nil, err
+		}
+		return notFilter{f}, nil
+	case "(":
+		f, err := p.parseAnd()
+		if err != nil {
+			return nil, err
+		}
+		if p.next() != ")" {
+			return nil, errInvalidArgument("unbalanced parentheses in filter")
+		}
+		return f, nil
+	default:
+		if !isFilterValue(t) {
+			return nil, errInvalidArgument("expected field name in filter, got %q", t)
+		}
+		op := p.next()
+		if op != "=" && op != "!=" && op != ":" {
+			return nil, errInvalidArgument("expected comparison operator in filter, got %q", op)
+		}
+		value := p.next()
+		if !isFilterValue(value) {
+			return nil, errInvalidArgument("expected value in filter, got %q", value)
+		}
+		return comparison{
+			path:  strings.Split(t, "."),
+			op:    op,
+			value: strings.Trim(value, `"`),
+		}, nil
+	}
+}
+
+func isFilterValue(t string) bool {
+	switch t {
+	case "", "(", ")", "=", "!=", ":", "-", "AND", "OR", "NOT":
+		return false
+	default:
+		return true
+	}
+}
+
+func tokenizeFilter(expr string) ([]string, error) {
+	var tokens []string
+	for i := 0; i < len(expr); {
+		c := expr[i]
+		switch {
+		case c == ' ' || c == '\t' || c == '\n':
+			i++
+		case c == '(' || c == ')' || c == '=' || c == ':':
+			tokens = append(tokens, string(c))
+			i++
+		case c == '!' && i+1 < len(expr) && expr[i+1] == '=':
+			tokens = append(tokens, "!=")
+			i += 2
+		case c == '-' && !followsComparator(tokens):
+			// A leading '-' negates the term that follows it. After a
+			// comparator, it is part of the value instead.
+			tokens = append(tokens, "-")
+			i++
+		case c == '"':
+			end := strings.IndexByte(expr[i+1:], '"')
+			if end < 0 {
+				return nil, errInvalidArgument("unterminated string in filter")
+			}
+			tokens = append(tokens, expr[i:i+end+2])
+			i += end + 2
+		default:
+			start := i
+			for i < len(expr) && !strings.ContainsRune(" \t\n()=:!\"", rune(expr[i])) {
+				i++
+			}
+			if i == start {
+				return nil, errInvalidArgument("unexpected character in filter: %q", c)
+			}
+			tokens = append(tokens, expr[start:i])
+		}
+	}
+	return tokens, nil
+}
+
+// followsComparator returns whether the next token is the value of a
+// comparison.
+func followsComparator(tokens []string) bool {
+	if len(tokens) == 0 {
+		return false
+	}
+	switch tokens[len(tokens)-1] {
+	case "=", "!=", ":":
+		return true
+	default:
+		return false
+	}
+}
@@ -0,0 +1,97 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fakekms
+
+import (
+	"testing"
+
+	"google.golang.org/grpc/codes"
+	"google.golang.org/grpc/status"
+
+	kmspb "google.golang.org/genproto/googleapis/cloud/kms/v1"
+)
+
+var filterTestKey = &kmspb.CryptoKey{
+	Name:    "projects/p/locations/l/keyRings/kr/cryptoKeys/signing-key",
+	Purpose: kmspb.CryptoKey_ASYMMETRIC_SIGN,
+	VersionTemplate: &kmspb.CryptoKeyVersionTemplate{
+		ProtectionLevel: kmspb.ProtectionLevel_HSM,
+		Algorithm:       kmspb.CryptoKeyVersion_EC_SIGN_P256_SHA256,
+	},
+	Labels: map[string]string{"env": "prod"},
+}
+
+func TestFilterMatches(t *testing.T) {
+	var cases = []struct {
+		Filter string
+		Want   bool
+	}{
+		{Filter: "", Want: true},
+		{Filter: "purpose=ASYMMETRIC_SIGN", Want: true},
+		{Filter: "purpose = MAC", Want: false},
+		{Filter: "purpose!=MAC", Want: true},
+		{Filter: "version_template.protection_level=HSM", Want: true},
+		{Filter: "version_template.protection_level=SOFTWARE", Want: false},
+		{Filter: "labels.env=prod", Want: true},
+		{Filter: "labels.env=dev", Want: false},
+		{Filter: "labels.team=prod", Want: false},
+		{Filter: `name:"cryptoKeys/signing-"`, Want: true},
+		{Filter: "name:decrypt", Want: false},
+		{Filter: "purpose=MAC OR purpose=ASYMMETRIC_SIGN", Want: true},
+		{Filter: "purpose=MAC OR labels.env=prod AND purpose=MAC", Want: false},
+		{Filter: "(purpose=MAC OR labels.env=prod) AND name:signing", Want: true},
+		{Filter: "NOT purpose=MAC", Want: true},
+		{Filter: "NOT (purpose=ASYMMETRIC_SIGN)", Want: false},
+		{Filter: "-purpose=MAC", Want: true},
+		{Filter: "-(purpose=ASYMMETRIC_SIGN)", Want: false},
+		{Filter: "purpose=MAC OR -labels.env=dev", Want: true},
+		{Filter: "name:-key", Want: true},
+		{Filter: "labels.env=-prod", Want: false},
+		{Filter: "primary.state=ENABLED", Want: false},
+		{Filter: "unknown_field=foo", Want: false},
+	}
+
+	for _, c := range cases {
+		f, err := parseFilter(c.Filter)
+		if err != nil {
+			t.Errorf("parseFilter(%q) returned err=%v", c.Filter, err)
+			continue
+		}
+		if got := filterMatches(f, filterTestKey); got != c.Want {
+			t.Errorf("filter %q matched=%t, want %t", c.Filter, got, c.Want)
+		}
+	}
+}
+
+func TestFilterParseErrors(t *testing.T) {
+	var filters = []string{
+		"purpose",
+		"purpose=",
+		"=MAC",
+		"(purpose=MAC",
+		"purpose=MAC)",
+		"purpose=MAC AND",
+		"-",
+		"purpose=MAC -",
+		`name:"unterminated`,
+	}
+
+	for _, filter := range filters {
+		_, err := parseFilter(filter)
+		if status.Code(err) != codes.InvalidArgument {
+			t.Errorf("parseFilter(%q) returned err=%v, want code=%s", filter, err, codes.InvalidArgument)
+		}
+	}
+}
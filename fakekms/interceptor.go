@@ -18,11 +18,21 @@ import (
 	"context"
 	"strings"
 	"sync"
+	"time"
 
 	"google.golang.org/grpc"
 	"google.golang.org/protobuf/proto"
 )
 
+func newDelayInterceptor(delay time.Duration) grpc.UnaryServerInterceptor {
+	return func(ctx context.Context, req interface{}, info *grpc.UnaryServerInfo, handler grpc.UnaryHandler) (interface{}, error) {
+		if delay > 0 && strings.HasPrefix(info.FullMethod, "/google.cloud.kms.v1.KeyManagementService/") {
+			time.Sleep(delay)
+		}
+		return handler(ctx, req)
+	}
+}
+
 func newLockInterceptor(mux *sync.RWMutex) grpc.UnaryServerInterceptor {
 	return func(ctx context.Context, req interface{}, info *grpc.UnaryServerInfo, handler grpc.UnaryHandler) (interface{}, error) {
 		methodParts := strings.Split(info.FullMethod, "/")
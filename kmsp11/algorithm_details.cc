@@ -14,34 +14,47 @@
 
 #include "kmsp11/algorithm_details.h"
 
-#include "absl/container/btree_set.h"
 #include "kmsp11/kmsp11.h"
 #include "kmsp11/util/errors.h"
 
 namespace cloud_kms::kmsp11 {
 
-struct AlgorithmCmp {
-  using is_transparent = void;
-  bool operator()(const AlgorithmDetails& a, const AlgorithmDetails& b) const {
-    return a.algorithm < b.algorithm;
-  }
-  bool operator()(const AlgorithmDetails& a,
-                  kms_v1::CryptoKeyVersion::CryptoKeyVersionAlgorithm b) const {
-    return a.algorithm < b;
-  }
-  bool operator()(kms_v1::CryptoKeyVersion::CryptoKeyVersionAlgorithm a,
-                  const AlgorithmDetails& b) const {
-    return a < b.algorithm;
-  }
-};
+constexpr CK_MECHANISM_TYPE kEcdsaSha256Mechanisms[] = {CKM_ECDSA,
+                                                        CKM_ECDSA_SHA256};
+constexpr CK_MECHANISM_TYPE kEcdsaSha384Mechanisms[] = {CKM_ECDSA,
+                                                        CKM_ECDSA_SHA384};
+constexpr CK_MECHANISM_TYPE kRsaOaepMechanisms[] = {
+    CKM_RSA_PKCS_OAEP, CKM_CLOUDKMS_ENVELOPE_AES_GCM};
+constexpr CK_MECHANISM_TYPE kRsaPkcs1Sha256Mechanisms[] = {CKM_RSA_PKCS,
+                                                           CKM_SHA256_RSA_PKCS};
+constexpr CK_MECHANISM_TYPE kRsaPkcs1Sha512Mechanisms[] = {CKM_RSA_PKCS,
+                                                           CKM_SHA512_RSA_PKCS};
+constexpr CK_MECHANISM_TYPE kRsaPssSha256Mechanisms[] = {
+    CKM_RSA_PKCS_PSS, CKM_SHA256_RSA_PKCS_PSS};
+constexpr CK_MECHANISM_TYPE kRsaPssSha512Mechanisms[] = {
+    CKM_RSA_PKCS_PSS, CKM_SHA512_RSA_PKCS_PSS};
+constexpr CK_MECHANISM_TYPE kRsaRawPkcs1Mechanisms[] = {
+    CKM_RSA_PKCS, CKM_SHA256_RSA_PKCS, CKM_SHA512_RSA_PKCS};
+constexpr CK_MECHANISM_TYPE kHmacSha1Mechanisms[] = {CKM_SHA_1_HMAC};
+constexpr CK_MECHANISM_TYPE kHmacSha224Mechanisms[] = {CKM_SHA224_HMAC};
+constexpr CK_MECHANISM_TYPE kHmacSha256Mechanisms[] = {CKM_SHA256_HMAC};
+constexpr CK_MECHANISM_TYPE kHmacSha384Mechanisms[] = {CKM_SHA384_HMAC};
+constexpr CK_MECHANISM_TYPE kHmacSha512Mechanisms[] = {CKM_SHA512_HMAC};
+constexpr CK_MECHANISM_TYPE kAesGcmMechanisms[] = {
+    CKM_CLOUDKMS_AES_GCM, CKM_CLOUDKMS_ENVELOPE_AES_GCM};
+constexpr CK_MECHANISM_TYPE kAesCtrMechanisms[] = {CKM_AES_CTR};
+constexpr CK_MECHANISM_TYPE kAesCbcMechanisms[] = {CKM_AES_CBC,
+                                                   CKM_AES_CBC_PAD};
 
-static const auto* const kAlgorithmDetails = new absl::btree_set<
-    AlgorithmDetails, AlgorithmCmp>{
+// Algorithms are looked up with a linear scan. The table is small enough that
+// this is no slower than a search tree, and it allows the table to be
+// constant-initialized.
+constexpr AlgorithmDetails kAlgorithmDetails[] = {
     // EC_SIGN_*
     {
         kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,             // purpose
-        {CKM_ECDSA, CKM_ECDSA_SHA256},                  // allowed_mechanisms
+        kEcdsaSha256Mechanisms,                         // allowed_mechanisms
         CKK_EC,                                         // key_type
         256,                                            // key_bit_length
         CKM_EC_KEY_PAIR_GEN,                            // key_gen_mechanism
@@ -50,7 +63,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::EC_SIGN_P384_SHA384,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,             // purpose
-        {CKM_ECDSA, CKM_ECDSA_SHA384},                  // allowed_mechanisms
+        kEcdsaSha384Mechanisms,                         // allowed_mechanisms
         CKK_EC,                                         // key_type
         384,                                            // key_bit_length
         CKM_EC_KEY_PAIR_GEN,                            // key_gen_mechanism
@@ -61,7 +74,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_2048_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_DECRYPT,                   // purpose
-        {CKM_RSA_PKCS_OAEP},        // allowed_mechanisms
+        kRsaOaepMechanisms,         // allowed_mechanisms
         CKK_RSA,                    // key_type
         2048,                       // key_bit_length
         CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
@@ -70,7 +83,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_3072_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_DECRYPT,                   // purpose
-        {CKM_RSA_PKCS_OAEP},        // allowed_mechanisms
+        kRsaOaepMechanisms,         // allowed_mechanisms
         CKK_RSA,                    // key_type
         3072,                       // key_bit_length
         CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
@@ -79,7 +92,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_4096_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_DECRYPT,                   // purpose
-        {CKM_RSA_PKCS_OAEP},        // allowed_mechanisms
+        kRsaOaepMechanisms,         // allowed_mechanisms
         CKK_RSA,                    // key_type
         4096,                       // key_bit_length
         CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
@@ -88,7 +101,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_4096_SHA512,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_DECRYPT,                   // purpose
-        {CKM_RSA_PKCS_OAEP},        // allowed_mechanisms
+        kRsaOaepMechanisms,         // allowed_mechanisms
         CKK_RSA,                    // key_type
         4096,                       // key_bit_length
         CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
@@ -99,84 +112,83 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_PKCS1_2048_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                    // purpose
-        {CKM_RSA_PKCS, CKM_SHA256_RSA_PKCS},  // allowed_mechanisms
-        CKK_RSA,                              // key_type
-        2048,                                 // key_bit_length
-        CKM_RSA_PKCS_KEY_PAIR_GEN,            // key_gen_mechanism
-        CKM_SHA256,                           // digest_mechanism
+        kRsaPkcs1Sha256Mechanisms,  // allowed_mechanisms
+        CKK_RSA,                    // key_type
+        2048,                       // key_bit_length
+        CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
+        CKM_SHA256,                 // digest_mechanism
     },
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_PKCS1_3072_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                    // purpose
-        {CKM_RSA_PKCS, CKM_SHA256_RSA_PKCS},  // allowed_mechanisms
-        CKK_RSA,                              // key_type
-        3072,                                 // key_bit_length
-        CKM_RSA_PKCS_KEY_PAIR_GEN,            // key_gen_mechanism
-        CKM_SHA256,                           // digest_mechanism
+        kRsaPkcs1Sha256Mechanisms,  // allowed_mechanisms
+        CKK_RSA,                    // key_type
+        3072,                       // key_bit_length
+        CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
+        CKM_SHA256,                 // digest_mechanism
     },
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_PKCS1_4096_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                    // purpose
-        {CKM_RSA_PKCS, CKM_SHA256_RSA_PKCS},  // allowed_mechanisms
-        CKK_RSA,                              // key_type
-        4096,                                 // key_bit_length
-        CKM_RSA_PKCS_KEY_PAIR_GEN,            // key_gen_mechanism
-        CKM_SHA256,                           // digest_mechanism
+        kRsaPkcs1Sha256Mechanisms,  // allowed_mechanisms
+        CKK_RSA,                    // key_type
+        4096,                       // key_bit_length
+        CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
+        CKM_SHA256,                 // digest_mechanism
     },
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_PKCS1_4096_SHA512,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                    // purpose
-        {CKM_RSA_PKCS, CKM_SHA512_RSA_PKCS},  // allowed_mechanisms
-        CKK_RSA,                              // key_type
-        4096,                                 // key_bit_length
-        CKM_RSA_PKCS_KEY_PAIR_GEN,            // key_gen_mechanism
-        CKM_SHA512,                           // digest_mechanism
+        kRsaPkcs1Sha512Mechanisms,  // allowed_mechanisms
+        CKK_RSA,                    // key_type
+        4096,                       // key_bit_length
+        CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
+        CKM_SHA512,                 // digest_mechanism
     },
 
     // RSA_SIGN_PSS_*
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_PSS_2048_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                  // purpose
-        {CKM_RSA_PKCS_PSS, CKM_SHA256_RSA_PKCS_PSS},  // allowed_mechanisms
-        CKK_RSA,                                      // key_type
-        2048,                                         // key_bit_length
-        CKM_RSA_PKCS_KEY_PAIR_GEN,                    // key_gen_mechanism
-        CKM_SHA256,                                   // digest_mechanism
+        kRsaPssSha256Mechanisms,    // allowed_mechanisms
+        CKK_RSA,                    // key_type
+        2048,                       // key_bit_length
+        CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
+        CKM_SHA256,                 // digest_mechanism
     },
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_PSS_3072_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                  // purpose
-        {CKM_RSA_PKCS_PSS, CKM_SHA256_RSA_PKCS_PSS},  // allowed_mechanisms
-        CKK_RSA,                                      // key_type
-        3072,                                         // key_bit_length
-        CKM_RSA_PKCS_KEY_PAIR_GEN,                    // key_gen_mechanism
-        CKM_SHA256,                                   // digest_mechanism
+        kRsaPssSha256Mechanisms,    // allowed_mechanisms
+        CKK_RSA,                    // key_type
+        3072,                       // key_bit_length
+        CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
+        CKM_SHA256,                 // digest_mechanism
     },
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_PSS_4096_SHA256,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                  // purpose
-        {CKM_RSA_PKCS_PSS, CKM_SHA256_RSA_PKCS_PSS},  // allowed_mechanisms
-        CKK_RSA,                                      // key_type
-        4096,                                         // key_bit_length
-        CKM_RSA_PKCS_KEY_PAIR_GEN,                    // key_gen_mechanism
-        CKM_SHA256,                                   // digest_mechanism
+        kRsaPssSha256Mechanisms,    // allowed_mechanisms
+        CKK_RSA,                    // key_type
+        4096,                       // key_bit_length
+        CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
+        CKM_SHA256,                 // digest_mechanism
     },
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_PSS_4096_SHA512,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                  // purpose
-        {CKM_RSA_PKCS_PSS, CKM_SHA512_RSA_PKCS_PSS},  // allowed_mechanisms
-        CKK_RSA,                                      // key_type
-        4096,                                         // key_bit_length
-        CKM_RSA_PKCS_KEY_PAIR_GEN,                    // key_gen_mechanism
-        CKM_SHA512,                                   // digest_mechanism
+        kRsaPssSha512Mechanisms,    // allowed_mechanisms
+        CKK_RSA,                    // key_type
+        4096,                       // key_bit_length
+        CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
+        CKM_SHA512,                 // digest_mechanism
     },
 
     // RSA_SIGN_RAW_PKCS1_*
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_RAW_PKCS1_2048,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                 // purpose
-        {CKM_RSA_PKCS, CKM_SHA256_RSA_PKCS,
-         CKM_SHA512_RSA_PKCS},      // allowed_mechanisms
+        kRsaRawPkcs1Mechanisms,     // allowed_mechanisms
         CKK_RSA,                    // key_type
         2048,                       // key_bit_length
         CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
@@ -185,8 +197,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_RAW_PKCS1_3072,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                 // purpose
-        {CKM_RSA_PKCS, CKM_SHA256_RSA_PKCS,
-         CKM_SHA512_RSA_PKCS},      // allowed_mechanisms
+        kRsaRawPkcs1Mechanisms,     // allowed_mechanisms
         CKK_RSA,                    // key_type
         3072,                       // key_bit_length
         CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
@@ -195,8 +206,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::RSA_SIGN_RAW_PKCS1_4096,  // algorithm
         kms_v1::CryptoKey::ASYMMETRIC_SIGN,                 // purpose
-        {CKM_RSA_PKCS, CKM_SHA256_RSA_PKCS,
-         CKM_SHA512_RSA_PKCS},      // allowed_mechanisms
+        kRsaRawPkcs1Mechanisms,     // allowed_mechanisms
         CKK_RSA,                    // key_type
         4096,                       // key_bit_length
         CKM_RSA_PKCS_KEY_PAIR_GEN,  // key_gen_mechanism
@@ -206,7 +216,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::HMAC_SHA1,  // algorithm
         kms_v1::CryptoKey::MAC,               // purpose
-        {CKM_SHA_1_HMAC},                     // allowed_mechanisms
+        kHmacSha1Mechanisms,                  // allowed_mechanisms
         CKK_SHA_1_HMAC,                       // key_type
         160,                                  // key_bit_length
         CKM_GENERIC_SECRET_KEY_GEN,           // key_gen_mechanism
@@ -215,7 +225,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::HMAC_SHA224,  // algorithm
         kms_v1::CryptoKey::MAC,                 // purpose
-        {CKM_SHA224_HMAC},                      // allowed_mechanisms
+        kHmacSha224Mechanisms,                  // allowed_mechanisms
         CKK_SHA224_HMAC,                        // key_type
         224,                                    // key_bit_length
         CKM_GENERIC_SECRET_KEY_GEN,             // key_gen_mechanism
@@ -224,7 +234,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::HMAC_SHA256,  // algorithm
         kms_v1::CryptoKey::MAC,                 // purpose
-        {CKM_SHA256_HMAC},                      // allowed_mechanisms
+        kHmacSha256Mechanisms,                  // allowed_mechanisms
         CKK_SHA256_HMAC,                        // key_type
         256,                                    // key_bit_length
         CKM_GENERIC_SECRET_KEY_GEN,             // key_gen_mechanism
@@ -233,7 +243,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::HMAC_SHA384,  // algorithm
         kms_v1::CryptoKey::MAC,                 // purpose
-        {CKM_SHA384_HMAC},                      // allowed_mechanisms
+        kHmacSha384Mechanisms,                  // allowed_mechanisms
         CKK_SHA384_HMAC,                        // key_type
         384,                                    // key_bit_length
         CKM_GENERIC_SECRET_KEY_GEN,             // key_gen_mechanism
@@ -242,7 +252,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::HMAC_SHA512,  // algorithm
         kms_v1::CryptoKey::MAC,                 // purpose
-        {CKM_SHA512_HMAC},                      // allowed_mechanisms
+        kHmacSha512Mechanisms,                  // allowed_mechanisms
         CKK_SHA512_HMAC,                        // key_type
         512,                                    // key_bit_length
         CKM_GENERIC_SECRET_KEY_GEN,             // key_gen_mechanism
@@ -252,7 +262,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::AES_128_GCM,   // algorithm
         kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT,  // purpose
-        {CKM_CLOUDKMS_AES_GCM},                  // allowed_mechanisms
+        kAesGcmMechanisms,                       // allowed_mechanisms
         CKK_AES,                                 // key_type
         128,                                     // key_bit_length
         CKM_AES_KEY_GEN,                         // key_gen_mechanism
@@ -261,7 +271,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::AES_256_GCM,   // algorithm
         kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT,  // purpose
-        {CKM_CLOUDKMS_AES_GCM},                  // allowed_mechanisms
+        kAesGcmMechanisms,                       // allowed_mechanisms
         CKK_AES,                                 // key_type
         256,                                     // key_bit_length
         CKM_AES_KEY_GEN,                         // key_gen_mechanism
@@ -270,7 +280,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::AES_128_CTR,   // algorithm
         kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT,  // purpose
-        {CKM_AES_CTR},                           // allowed_mechanisms
+        kAesCtrMechanisms,                       // allowed_mechanisms
         CKK_AES,                                 // key_type
         128,                                     // key_bit_length
         CKM_AES_KEY_GEN,                         // key_gen_mechanism
@@ -279,7 +289,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::AES_256_CTR,   // algorithm
         kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT,  // purpose
-        {CKM_AES_CTR},                           // allowed_mechanisms
+        kAesCtrMechanisms,                       // allowed_mechanisms
         CKK_AES,                                 // key_type
         256,                                     // key_bit_length
         CKM_AES_KEY_GEN,                         // key_gen_mechanism
@@ -288,7 +298,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::AES_128_CBC,   // algorithm
         kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT,  // purpose
-        {CKM_AES_CBC, CKM_AES_CBC_PAD},          // allowed_mechanisms
+        kAesCbcMechanisms,                       // allowed_mechanisms
         CKK_AES,                                 // key_type
         128,                                     // key_bit_length
         CKM_AES_KEY_GEN,                         // key_gen_mechanism
@@ -297,7 +307,7 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     {
         kms_v1::CryptoKeyVersion::AES_256_CBC,   // algorithm
         kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT,  // purpose
-        {CKM_AES_CBC, CKM_AES_CBC_PAD},          // allowed_mechanisms
+        kAesCbcMechanisms,                       // allowed_mechanisms
         CKK_AES,                                 // key_type
         256,                                     // key_bit_length
         CKM_AES_KEY_GEN,                         // key_gen_mechanism
@@ -305,14 +315,15 @@ static const auto* const kAlgorithmDetails = new absl::btree_set<
     },
 };
 
-absl::StatusOr<AlgorithmDetails> GetDetails(
+absl::StatusOr<const AlgorithmDetails*> GetDetails(
     kms_v1::CryptoKeyVersion::CryptoKeyVersionAlgorithm algorithm) {
-  auto it = kAlgorithmDetails->find(algorithm);
-  if (it == kAlgorithmDetails->end()) {
-    return NewInternalError(
-        absl::StrFormat("algorithm not found: %d", algorithm), SOURCE_LOCATION);
+  for (const AlgorithmDetails& details : kAlgorithmDetails) {
+    if (details.algorithm == algorithm) {
+      return &details;
+    }
   }
-  return *it;
+  return NewInternalError(absl::StrFormat("algorithm not found: %d", algorithm),
+                          SOURCE_LOCATION);
 }
 
 }  // namespace cloud_kms::kmsp11
@@ -20,6 +20,7 @@
 #include <optional>
 
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "common/kms_v1.h"
 #include "google/cloud/kms/v1/resources.pb.h"
 #include "google/cloud/kms/v1/service.pb.h"
@@ -30,14 +31,16 @@ namespace cloud_kms::kmsp11 {
 struct AlgorithmDetails {
   kms_v1::CryptoKeyVersion::CryptoKeyVersionAlgorithm algorithm;
   kms_v1::CryptoKey::CryptoKeyPurpose purpose;
-  std::vector<CK_MECHANISM_TYPE> allowed_mechanisms;
+  absl::Span<const CK_MECHANISM_TYPE> allowed_mechanisms;
   CK_KEY_TYPE key_type;
   size_t key_bit_length;
   CK_MECHANISM_TYPE key_gen_mechanism;
   std::optional<CK_MECHANISM_TYPE> digest_mechanism;
 };
 
-absl::StatusOr<AlgorithmDetails> GetDetails(
+// Returns the details for the provided algorithm. The returned value points
+// into a static table, and remains valid for the life of the program.
+absl::StatusOr<const AlgorithmDetails*> GetDetails(
     kms_v1::CryptoKeyVersion::CryptoKeyVersionAlgorithm algorithm);
 
 }  // namespace cloud_kms::kmsp11
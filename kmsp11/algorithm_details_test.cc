@@ -25,89 +25,100 @@ using ::testing::ElementsAre;
 
 TEST(GetAlgorithmDetailsTest, AlgorithmEc) {
   ASSERT_OK_AND_ASSIGN(
-      AlgorithmDetails details,
+      const AlgorithmDetails* details,
       GetDetails(kms_v1::CryptoKeyVersion::EC_SIGN_P384_SHA384));
 
-  EXPECT_EQ(details.algorithm, kms_v1::CryptoKeyVersion::EC_SIGN_P384_SHA384);
-  EXPECT_EQ(details.purpose, kms_v1::CryptoKey::ASYMMETRIC_SIGN);
-  EXPECT_THAT(details.allowed_mechanisms,
+  EXPECT_EQ(details->algorithm, kms_v1::CryptoKeyVersion::EC_SIGN_P384_SHA384);
+  EXPECT_EQ(details->purpose, kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+  EXPECT_THAT(details->allowed_mechanisms,
               ElementsAre(CKM_ECDSA, CKM_ECDSA_SHA384));
-  EXPECT_EQ(details.key_type, CKK_EC);
-  EXPECT_EQ(details.key_bit_length, 384);
-  EXPECT_EQ(details.key_gen_mechanism, CKM_EC_KEY_PAIR_GEN);
-  EXPECT_EQ(details.digest_mechanism, CKM_SHA384);
+  EXPECT_EQ(details->key_type, CKK_EC);
+  EXPECT_EQ(details->key_bit_length, 384);
+  EXPECT_EQ(details->key_gen_mechanism, CKM_EC_KEY_PAIR_GEN);
+  EXPECT_EQ(details->digest_mechanism, CKM_SHA384);
 }
 
 TEST(GetAlgorithmDetailsTest, AlgorithmRsaOaep) {
   ASSERT_OK_AND_ASSIGN(
-      AlgorithmDetails details,
+      const AlgorithmDetails* details,
       GetDetails(kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_4096_SHA256));
 
-  EXPECT_EQ(details.algorithm,
+  EXPECT_EQ(details->algorithm,
             kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_4096_SHA256);
-  EXPECT_EQ(details.purpose, kms_v1::CryptoKey::ASYMMETRIC_DECRYPT);
-  EXPECT_THAT(details.allowed_mechanisms, ElementsAre(CKM_RSA_PKCS_OAEP));
-  EXPECT_EQ(details.key_type, CKK_RSA);
-  EXPECT_EQ(details.key_bit_length, 4096);
-  EXPECT_EQ(details.key_gen_mechanism, CKM_RSA_PKCS_KEY_PAIR_GEN);
-  EXPECT_EQ(details.digest_mechanism, CKM_SHA256);
+  EXPECT_EQ(details->purpose, kms_v1::CryptoKey::ASYMMETRIC_DECRYPT);
+  EXPECT_THAT(details->allowed_mechanisms,
+              ElementsAre(CKM_RSA_PKCS_OAEP, CKM_CLOUDKMS_ENVELOPE_AES_GCM));
+  EXPECT_EQ(details->key_type, CKK_RSA);
+  EXPECT_EQ(details->key_bit_length, 4096);
+  EXPECT_EQ(details->key_gen_mechanism, CKM_RSA_PKCS_KEY_PAIR_GEN);
+  EXPECT_EQ(details->digest_mechanism, CKM_SHA256);
 }
 
 TEST(GetAlgorithmDetailsTest, AlgorithmHmac) {
-  ASSERT_OK_AND_ASSIGN(AlgorithmDetails details,
+  ASSERT_OK_AND_ASSIGN(const AlgorithmDetails* details,
                        GetDetails(kms_v1::CryptoKeyVersion::HMAC_SHA256));
 
-  EXPECT_EQ(details.algorithm, kms_v1::CryptoKeyVersion::HMAC_SHA256);
-  EXPECT_EQ(details.purpose, kms_v1::CryptoKey::MAC);
-  EXPECT_THAT(details.allowed_mechanisms, ElementsAre(CKM_SHA256_HMAC));
-  EXPECT_EQ(details.key_type, CKK_SHA256_HMAC);
-  EXPECT_EQ(details.key_bit_length, 256);
-  EXPECT_EQ(details.key_gen_mechanism, CKM_GENERIC_SECRET_KEY_GEN);
-  EXPECT_EQ(details.digest_mechanism, std::nullopt);
+  EXPECT_EQ(details->algorithm, kms_v1::CryptoKeyVersion::HMAC_SHA256);
+  EXPECT_EQ(details->purpose, kms_v1::CryptoKey::MAC);
+  EXPECT_THAT(details->allowed_mechanisms, ElementsAre(CKM_SHA256_HMAC));
+  EXPECT_EQ(details->key_type, CKK_SHA256_HMAC);
+  EXPECT_EQ(details->key_bit_length, 256);
+  EXPECT_EQ(details->key_gen_mechanism, CKM_GENERIC_SECRET_KEY_GEN);
+  EXPECT_EQ(details->digest_mechanism, std::nullopt);
 }
 
 TEST(GetAlgorithmDetailsTest, AlgorithmAesGcm) {
-  ASSERT_OK_AND_ASSIGN(AlgorithmDetails details,
+  ASSERT_OK_AND_ASSIGN(const AlgorithmDetails* details,
                        GetDetails(kms_v1::CryptoKeyVersion::AES_256_GCM));
 
-  EXPECT_EQ(details.algorithm, kms_v1::CryptoKeyVersion::AES_256_GCM);
-  EXPECT_EQ(details.purpose, kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
-  EXPECT_THAT(details.allowed_mechanisms, ElementsAre(CKM_CLOUDKMS_AES_GCM));
-  EXPECT_EQ(details.key_type, CKK_AES);
-  EXPECT_EQ(details.key_bit_length, 256);
-  EXPECT_EQ(details.key_gen_mechanism, CKM_AES_KEY_GEN);
-  EXPECT_EQ(details.digest_mechanism, std::nullopt);
+  EXPECT_EQ(details->algorithm, kms_v1::CryptoKeyVersion::AES_256_GCM);
+  EXPECT_EQ(details->purpose, kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
+  EXPECT_THAT(details->allowed_mechanisms,
+              ElementsAre(CKM_CLOUDKMS_AES_GCM, CKM_CLOUDKMS_ENVELOPE_AES_GCM));
+  EXPECT_EQ(details->key_type, CKK_AES);
+  EXPECT_EQ(details->key_bit_length, 256);
+  EXPECT_EQ(details->key_gen_mechanism, CKM_AES_KEY_GEN);
+  EXPECT_EQ(details->digest_mechanism, std::nullopt);
 }
 
 TEST(GetAlgorithmDetailsTest, AlgorithmAesCbc) {
-  ASSERT_OK_AND_ASSIGN(AlgorithmDetails details,
+  ASSERT_OK_AND_ASSIGN(const AlgorithmDetails* details,
                        GetDetails(kms_v1::CryptoKeyVersion::AES_128_CBC));
 
-  EXPECT_EQ(details.algorithm, kms_v1::CryptoKeyVersion::AES_128_CBC);
-  EXPECT_EQ(details.purpose, kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
-  EXPECT_THAT(details.allowed_mechanisms,
+  EXPECT_EQ(details->algorithm, kms_v1::CryptoKeyVersion::AES_128_CBC);
+  EXPECT_EQ(details->purpose, kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
+  EXPECT_THAT(details->allowed_mechanisms,
               ElementsAre(CKM_AES_CBC, CKM_AES_CBC_PAD));
-  EXPECT_EQ(details.key_type, CKK_AES);
-  EXPECT_EQ(details.key_bit_length, 128);
-  EXPECT_EQ(details.key_gen_mechanism, CKM_AES_KEY_GEN);
-  EXPECT_EQ(details.digest_mechanism, std::nullopt);
+  EXPECT_EQ(details->key_type, CKK_AES);
+  EXPECT_EQ(details->key_bit_length, 128);
+  EXPECT_EQ(details->key_gen_mechanism, CKM_AES_KEY_GEN);
+  EXPECT_EQ(details->digest_mechanism, std::nullopt);
 }
 
 TEST(GetAlgorithmDetailsTest, AlgorithmAesCtr) {
-  ASSERT_OK_AND_ASSIGN(AlgorithmDetails details,
+  ASSERT_OK_AND_ASSIGN(const AlgorithmDetails* details,
                        GetDetails(kms_v1::CryptoKeyVersion::AES_256_CTR));
 
-  EXPECT_EQ(details.algorithm, kms_v1::CryptoKeyVersion::AES_256_CTR);
-  EXPECT_EQ(details.purpose, kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
-  EXPECT_THAT(details.allowed_mechanisms, ElementsAre(CKM_AES_CTR));
-  EXPECT_EQ(details.key_type, CKK_AES);
-  EXPECT_EQ(details.key_bit_length, 256);
-  EXPECT_EQ(details.key_gen_mechanism, CKM_AES_KEY_GEN);
-  EXPECT_EQ(details.digest_mechanism, std::nullopt);
+  EXPECT_EQ(details->algorithm, kms_v1::CryptoKeyVersion::AES_256_CTR);
+  EXPECT_EQ(details->purpose, kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
+  EXPECT_THAT(details->allowed_mechanisms, ElementsAre(CKM_AES_CTR));
+  EXPECT_EQ(details->key_type, CKK_AES);
+  EXPECT_EQ(details->key_bit_length, 256);
+  EXPECT_EQ(details->key_gen_mechanism, CKM_AES_KEY_GEN);
+  EXPECT_EQ(details->digest_mechanism, std::nullopt);
+}
+
+TEST(GetAlgorithmDetailsTest, DetailsAreShared) {
+  ASSERT_OK_AND_ASSIGN(const AlgorithmDetails* details1,
+                       GetDetails(kms_v1::CryptoKeyVersion::AES_256_GCM));
+  ASSERT_OK_AND_ASSIGN(const AlgorithmDetails* details2,
+                       GetDetails(kms_v1::CryptoKeyVersion::AES_256_GCM));
+
+  EXPECT_EQ(details1, details2);
 }
 
 TEST(GetAlgorithmDetailsTest, AlgorithmNotFound) {
-  absl::StatusOr<AlgorithmDetails> details =
+  absl::StatusOr<const AlgorithmDetails*> details =
       GetDetails(kms_v1::CryptoKeyVersion::EXTERNAL_SYMMETRIC_ENCRYPTION);
   EXPECT_FALSE(details.ok());
   EXPECT_THAT(details.status(), StatusIs(absl::StatusCode::kInternal));
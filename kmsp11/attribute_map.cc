@@ -14,48 +14,111 @@
 
 #include "kmsp11/attribute_map.h"
 
+#include <algorithm>
+
 #include "kmsp11/util/errors.h"
+#include "kmsp11/util/status_utils.h"
 
 namespace cloud_kms::kmsp11 {
 
 void AttributeMap::Put(CK_ATTRIBUTE_TYPE type, std::string_view value) {
-  attrs_[type] = std::string(value.data(), value.size());
+  Entry& entry = FindOrInsert(type);
+  // A replaced inline value is left in place in values_. Attributes are
+  // rarely replaced, so this is simpler than compacting the buffer.
+  entry.offset = values_.size();
+  entry.size = value.size();
+  entry.storage = Storage::kInline;
+  values_.append(value.data(), value.size());
 }
 
 void AttributeMap::PutSensitive(CK_ATTRIBUTE_TYPE type) {
-  static constexpr SensitiveValue kSensitiveValue;
-  attrs_[type] = kSensitiveValue;
+  Entry& entry = FindOrInsert(type);
+  entry.offset = 0;
+  entry.size = 0;
+  entry.storage = Storage::kSensitive;
+}
+
+void AttributeMap::PutShared(CK_ATTRIBUTE_TYPE type,
+                             std::shared_ptr<const std::string> value) {
+  Entry& entry = FindOrInsert(type);
+  entry.offset = shared_values_.size();
+  entry.size = value->size();
+  entry.storage = Storage::kShared;
+  shared_values_.push_back(std::move(value));
 }
 
 bool AttributeMap::Contains(const CK_ATTRIBUTE& attribute) const {
-  auto it = attrs_.find(attribute.type);
-  if (it == attrs_.end()) {
+  const Entry* entry = Find(attribute.type);
+  if (!entry) {
     return false;
   }
-  if (std::holds_alternative<SensitiveValue>(it->second)) {
+  if (entry->storage == Storage::kSensitive) {
     return false;
   }
 
-  return std::get<std::string>(it->second) ==
+  return ValueOf(*entry) ==
          std::string_view(static_cast<char*>(attribute.pValue),
                           attribute.ulValueLen);
 }
 
 absl::StatusOr<std::string_view> AttributeMap::Value(
     CK_ATTRIBUTE_TYPE type) const {
-  auto it = attrs_.find(type);
-  if (it == attrs_.end()) {
+  const Entry* entry = Find(type);
+  if (!entry) {
     return NewError(absl::StatusCode::kNotFound,
                     absl::StrFormat("attribute not found: %#x", type),
                     CKR_ATTRIBUTE_TYPE_INVALID, SOURCE_LOCATION);
   }
-  if (std::holds_alternative<SensitiveValue>(it->second)) {
+  if (entry->storage == Storage::kSensitive) {
     return NewError(absl::StatusCode::kPermissionDenied,
                     absl::StrFormat("attribute value sensitive: %#x", type),
                     CKR_ATTRIBUTE_SENSITIVE, SOURCE_LOCATION);
   }
-  const std::string& s = std::get<std::string>(it->second);
-  return std::string_view(s);
+  return ValueOf(*entry);
+}
+
+absl::StatusOr<std::string_view> AttributeMap::ProbeValue(
+    CK_ATTRIBUTE_TYPE type) const {
+  const Entry* entry = Find(type);
+  if (!entry) {
+    return ExpectedError(CKR_ATTRIBUTE_TYPE_INVALID);
+  }
+  if (entry->storage == Storage::kSensitive) {
+    return ExpectedError(CKR_ATTRIBUTE_SENSITIVE);
+  }
+  return ValueOf(*entry);
+}
+
+const AttributeMap::Entry* AttributeMap::Find(CK_ATTRIBUTE_TYPE type) const {
+  auto it = std::lower_bound(
+      entries_.begin(), entries_.end(), type,
+      [](const Entry& entry, CK_ATTRIBUTE_TYPE t) { return entry.type < t; });
+  if (it == entries_.end() || it->type != type) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+AttributeMap::Entry& AttributeMap::FindOrInsert(CK_ATTRIBUTE_TYPE type) {
+  auto it = std::lower_bound(
+      entries_.begin(), entries_.end(), type,
+      [](const Entry& entry, CK_ATTRIBUTE_TYPE t) { return entry.type < t; });
+  if (it == entries_.end() || it->type != type) {
+    it = entries_.insert(it, Entry{type, 0, 0, Storage::kSensitive});
+  }
+  return *it;
+}
+
+std::string_view AttributeMap::ValueOf(const Entry& entry) const {
+  switch (entry.storage) {
+    case Storage::kInline:
+      return std::string_view(values_).substr(entry.offset, entry.size);
+    case Storage::kShared:
+      return *shared_values_[entry.offset];
+    case Storage::kSensitive:
+      break;
+  }
+  return std::string_view();
 }
 
 }  // namespace cloud_kms::kmsp11
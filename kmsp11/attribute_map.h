@@ -17,9 +17,12 @@
 #ifndef KMSP11_ATTRIBUTE_MAP_H_
 #define KMSP11_ATTRIBUTE_MAP_H_
 
-#include <variant>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
-#include "absl/container/flat_hash_map.h"
 #include "absl/status/statusor.h"
 #include "common/openssl.h"
 #include "kmsp11/cryptoki.h"
@@ -33,6 +36,11 @@ class AttributeMap {
  public:
   void Put(CK_ATTRIBUTE_TYPE type, std::string_view value);
   void PutSensitive(CK_ATTRIBUTE_TYPE type);
+  // Adds an attribute whose value is held by reference, rather than copied
+  // into this map. This allows large values that are common to several
+  // objects (like the public key DER of a key pair) to be stored once.
+  void PutShared(CK_ATTRIBUTE_TYPE type,
+                 std::shared_ptr<const std::string> value);
 
   inline void PutBool(CK_ATTRIBUTE_TYPE type, bool value) {
     Put(type, MarshalBool(value));
@@ -58,28 +66,56 @@ class AttributeMap {
   bool Contains(const CK_ATTRIBUTE& attribute) const;
   absl::StatusOr<std::string_view> Value(CK_ATTRIBUTE_TYPE type) const;
 
- private:
-  class SensitiveValue {};
+  // Like Value, but reports an absent or sensitive attribute with
+  // ExpectedError, which carries no message and is not logged. For callers
+  // like C_GetAttributeValue, for which these outcomes are routine.
+  absl::StatusOr<std::string_view> ProbeValue(CK_ATTRIBUTE_TYPE type) const;
 
+ private:
   // See discussion of C_GetAttributeValue at
   // http://docs.oasis-open.org/pkcs11/pkcs11-base/v2.40/errata01/os/pkcs11-base-v2.40-errata01-os-complete.html#_Toc235002350
   //
   // Any object may or may not contain an attribute. In our implementation,
-  // attrs_ will contain an entry for the attribute type if the attribute is
+  // entries_ will contain an entry for the attribute type if the attribute is
   // present.
   //
   // If the attribute is present, its value may be empty, sensitive, or
   // populated:
-  //  * Empty attributes have a value of the empty string.
-  //  * Sensitive attributes have a value of type SensitiveValue. As an example,
-  //    the value of CKA_PRIVATE_EXPONENT will be SensitiveValue for RSA private
-  //    keys; the actual value is not available in this library.
-  //  * Populated attributes have a std::string value that corresponds to the
-  //    attribute's definition. For example, a CK_ULONG attribute will be
-  //    modeled as a std::string of size sizeof(CK_ULONG).
-  using AttributeValue = std::variant<std::string, SensitiveValue>;
-
-  absl::flat_hash_map<CK_ATTRIBUTE_TYPE, AttributeValue> attrs_;
+  //  * Empty attributes have a value of size 0.
+  //  * Sensitive attributes have no value. As an example, the value of
+  //    CKA_PRIVATE_EXPONENT is sensitive for RSA private keys; the actual value
+  //    is not available in this library.
+  //  * Populated attributes have a value that corresponds to the attribute's
+  //    definition. For example, a CK_ULONG attribute will be modeled as a
+  //    value of size sizeof(CK_ULONG).
+  enum class Storage : uint8_t {
+    // The value is stored in values_, starting at offset.
+    kInline,
+    // The value is shared_values_[offset].
+    kShared,
+    kSensitive,
+  };
+
+  struct Entry {
+    CK_ATTRIBUTE_TYPE type;
+    uint32_t offset;
+    uint32_t size;
+    Storage storage;
+  };
+
+  // Returns the entry for the provided type, or nullptr if the attribute is
+  // absent.
+  const Entry* Find(CK_ATTRIBUTE_TYPE type) const;
+  // Returns the entry for the provided type, inserting it if necessary.
+  Entry& FindOrInsert(CK_ATTRIBUTE_TYPE type);
+  std::string_view ValueOf(const Entry& entry) const;
+
+  // Attributes are few and are all written before an object is used, so they
+  // are kept in a vector that is sorted by type, and their values are packed
+  // together in a single buffer.
+  std::vector<Entry> entries_;
+  std::string values_;
+  std::vector<std::shared_ptr<const std::string>> shared_values_;
 };
 
 }  // namespace cloud_kms::kmsp11
@@ -18,10 +18,13 @@
 #include "gmock/gmock.h"
 #include "kmsp11/cryptoki.h"
 #include "kmsp11/test/matchers.h"
+#include "kmsp11/util/status_utils.h"
 
 namespace cloud_kms::kmsp11 {
 namespace {
 
+using ::testing::HasSubstr;
+
 TEST(AttributeMapTest, PopulatedValue) {
   AttributeMap m;
   m.Put(CKA_LABEL, "my_important_key");
@@ -51,6 +54,59 @@ TEST(AttributeMapTest, ValueSensitive) {
               StatusRvIs(CKR_ATTRIBUTE_SENSITIVE));
 }
 
+TEST(AttributeMapTest, ValueErrorsAreNotExpected) {
+  AttributeMap m;
+  m.PutSensitive(CKA_PRIVATE_EXPONENT);
+
+  absl::Status not_set = m.Value(CKA_ID).status();
+  EXPECT_FALSE(IsExpectedError(not_set));
+  EXPECT_THAT(not_set.message(), HasSubstr("attribute not found"));
+
+  absl::Status sensitive = m.Value(CKA_PRIVATE_EXPONENT).status();
+  EXPECT_FALSE(IsExpectedError(sensitive));
+  EXPECT_THAT(sensitive.message(), HasSubstr("attribute value sensitive"));
+}
+
+TEST(AttributeMapTest, ProbeValue) {
+  AttributeMap m;
+  m.Put(CKA_LABEL, "my_important_key");
+  m.PutSensitive(CKA_PRIVATE_EXPONENT);
+
+  EXPECT_THAT(m.ProbeValue(CKA_LABEL), IsOkAndHolds("my_important_key"));
+
+  absl::Status not_set = m.ProbeValue(CKA_ID).status();
+  EXPECT_TRUE(IsExpectedError(not_set));
+  EXPECT_EQ(GetCkRv(not_set), CKR_ATTRIBUTE_TYPE_INVALID);
+
+  absl::Status sensitive = m.ProbeValue(CKA_PRIVATE_EXPONENT).status();
+  EXPECT_TRUE(IsExpectedError(sensitive));
+  EXPECT_EQ(GetCkRv(sensitive), CKR_ATTRIBUTE_SENSITIVE);
+}
+
+TEST(AttributeMapTest, PutReplacesValue) {
+  AttributeMap m;
+  m.Put(CKA_LABEL, "first");
+  m.PutSensitive(CKA_LABEL);
+  m.Put(CKA_LABEL, "second");
+
+  ASSERT_OK_AND_ASSIGN(std::string_view got, m.Value(CKA_LABEL));
+  EXPECT_EQ(got, "second");
+}
+
+TEST(AttributeMapTest, PutSharedDoesNotCopy) {
+  auto value = std::make_shared<const std::string>("public key DER");
+
+  AttributeMap m1, m2;
+  m1.PutShared(CKA_PUBLIC_KEY_INFO, value);
+  m2.PutShared(CKA_PUBLIC_KEY_INFO, value);
+
+  ASSERT_OK_AND_ASSIGN(std::string_view got1, m1.Value(CKA_PUBLIC_KEY_INFO));
+  ASSERT_OK_AND_ASSIGN(std::string_view got2, m2.Value(CKA_PUBLIC_KEY_INFO));
+  EXPECT_EQ(got1, *value);
+  EXPECT_EQ(got1.data(), value->data());
+  EXPECT_EQ(got2.data(), value->data());
+}
+
 TEST(AttributeMapTest, PutBool) {
   AttributeMap m;
   m.PutBool(CKA_ENCRYPT, false);
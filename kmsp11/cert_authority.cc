@@ -159,8 +159,9 @@ absl::StatusOr<bssl::UniquePtr<X509>> CertAuthority::GenerateCert(
   // complicated by the fact that we don't actually generate a self-signed CA
   // cert for the signing key (maybe we should?).
 
-  ASSIGN_OR_RETURN(AlgorithmDetails algorithm, GetDetails(ckv.algorithm()));
-  switch (algorithm.purpose) {
+  ASSIGN_OR_RETURN(const AlgorithmDetails* algorithm,
+                   GetDetails(ckv.algorithm()));
+  switch (algorithm->purpose) {
     case kms_v1::CryptoKey::ASYMMETRIC_SIGN:
       RETURN_IF_ERROR(AddExtension(&ctx, cert.get(), NID_key_usage,
                                    "critical,digitalSignature"));
@@ -172,7 +173,7 @@ absl::StatusOr<bssl::UniquePtr<X509>> CertAuthority::GenerateCert(
       break;
     default:
       return NewInternalError(
-          absl::StrFormat("unexpected key purpose: %d", algorithm.purpose),
+          absl::StrFormat("unexpected key purpose: %d", algorithm->purpose),
           SOURCE_LOCATION);
   }
 
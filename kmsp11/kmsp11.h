@@ -106,6 +106,55 @@ extern "C" {
 //   field should not be freed between C_EncryptInit and C_Encrypt..
 #define CKM_CLOUDKMS_AES_GCM (CKM_GOOGLE_DEFINED | 0x01UL)
 
+// Envelope encryption with AES-256-GCM. Messages of any size are encrypted
+// locally with a data encryption key (DEK) that the library generates, and the
+// DEK is wrapped by the Cloud KMS key:
+// - an AES-GCM key (CKO_SECRET_KEY) wraps the DEK with RawEncrypt, and unwraps
+//   it with RawDecrypt.
+// - an RSA-OAEP decryption key wraps the DEK locally with its public key
+//   (CKO_PUBLIC_KEY), and unwraps it with AsymmetricDecrypt using its private
+//   key (CKO_PRIVATE_KEY).
+// A DEK is reused for several messages, and unwrapped DEKs are cached, as
+// determined by the library configuration. Because of this, disabling or
+// destroying the Cloud KMS key version does not take effect immediately: a
+// cached DEK continues to be used until the library next refreshes its view
+// of the key ring, or until the DEK reaches its configured lifetime.
+//
+// The optional mechanism parameter is additional authenticated data (AAD),
+// which must be provided again for decryption.
+//
+// The ciphertext is self-describing, and consists of:
+// - a format version (1 byte, currently 0x01)
+// - the wrapping method (1 byte, 0x01 for RawEncrypt or 0x02 for RSA-OAEP)
+// - the length of the wrapped DEK (2 bytes, big-endian)
+// - the wrapped DEK; for RawEncrypt, the 12-byte Cloud KMS IV followed by the
+//   RawEncrypt ciphertext
+// - a 12-byte nonce
+// - the AES-GCM ciphertext, followed by a 16-byte tag
+// Everything before the AES-GCM ciphertext is authenticated along with the AAD.
+#define CKM_CLOUDKMS_ENVELOPE_AES_GCM (CKM_GOOGLE_DEFINED | 0x02UL)
+
+// The library also exports the following vendor functions, which are not part
+// of its CK_FUNCTION_LIST and must be located by symbol name:
+//
+//   CK_RV C_CloudKmsGetCallStats(CK_UTF8CHAR_PTR pStats,
+//                                CK_ULONG_PTR pulStatsLen);
+//   CK_RV C_CloudKmsGetRpcStats(CK_UTF8CHAR_PTR pStats,
+//                               CK_ULONG_PTR pulStatsLen);
+//
+// C_CloudKmsGetCallStats writes a text report of the call counts, error counts
+// by CK_RV and latency histograms collected for each PKCS #11 function, when
+// the `enable_call_stats` configuration option is set. The report is not
+// NUL-terminated. As with other PKCS #11 functions, if pStats is NULL the
+// required length is written to pulStatsLen; since statistics change between
+// calls, callers should be prepared to retry on CKR_BUFFER_TOO_SMALL.
+//
+// C_CloudKmsGetRpcStats writes a text report of the latency histograms,
+// in-flight counts and status code counts collected for each Cloud KMS method
+// (and, with `rpc_stats_per_key`, each key), when the `enable_rpc_stats`
+// configuration option is set. Its buffer conventions are the same as those
+// of C_CloudKmsGetCallStats.
+
 #ifdef __cplusplus
 }
 #endif
@@ -90,7 +90,8 @@ func loadELFBinary(t *testing.T) *elf.File {
 	return elfBin
 }
 
-// loadP11FunctionNames returns the list of PKCS#11 C_* functions, sorted by name.
+// loadP11FunctionNames returns the list of PKCS#11 C_* functions, including
+// vendor functions, sorted by name.
 func loadP11FunctionNames(t *testing.T) []string {
 	t.Helper()
 
@@ -104,9 +105,9 @@ func loadP11FunctionNames(t *testing.T) []string {
 		log.Fatalf("error parsing function list textproto: %+v", err)
 	}
 
-	names := make([]string, len(list.Functions))
-	for i, v := range list.Functions {
-		names[i] = v.Name
+	var names []string
+	for _, v := range append(list.Functions, list.VendorFunctions...) {
+		names = append(names, v.Name)
 	}
 	sort.Strings(names)
 	return names
@@ -12,7 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "kmsp11/main/bridge.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/types/optional.h"
 #include "common/status_macros.h"
 #include "glog/logging.h"
@@ -22,6 +29,7 @@
 #include "kmsp11/main/fork_support.h"
 #include "kmsp11/main/function_list.h"
 #include "kmsp11/provider.h"
+#include "kmsp11/util/call_stats.h"
 #include "kmsp11/util/crypto_utils.h"
 #include "kmsp11/util/errors.h"
 #include "kmsp11/util/global_provider.h"
@@ -52,8 +60,53 @@ absl::StatusOr<std::shared_ptr<Session>> GetSession(
   return provider->GetSession(session_handle);
 }
 
+absl::Status WriteCallStats(const std::string& path) {
+  std::ofstream out(path, std::ios::out | std::ios::trunc);
+  out << LibraryCallStats().ToString();
+  out.close();
+  if (out.fail()) {
+    return FailedPreconditionError(
+        absl::StrCat("failed to write call statistics to ", path),
+        CKR_GENERAL_ERROR, SOURCE_LOCATION);
+  }
+  return absl::OkStatus();
+}
+
+// Copies a statistics report to `pStats`, following the usual conventions for
+// variable-length output.
+absl::Status CopyStatsReport(std::string_view report, CK_UTF8CHAR_PTR pStats,
+                             CK_ULONG_PTR pulStatsLen) {
+  CK_ULONG stats_len = *pulStatsLen;
+  *pulStatsLen = report.size();
+  if (!pStats) {
+    return absl::OkStatus();
+  }
+  if (stats_len < report.size()) {
+    return ExpectedError(CKR_BUFFER_TOO_SMALL);
+  }
+  std::copy(report.begin(), report.end(), pStats);
+  return absl::OkStatus();
+}
+
+RawEncryptionOptions GetRawEncryptionOptions(Provider* provider) {
+  const LibraryConfig& config = provider->library_config();
+  RawEncryptionOptions options;
+  options.chunked = config.experimental_chunked_raw_encryption();
+  if (config.raw_encryption_chunk_concurrency() > 0) {
+    options.max_concurrent_chunks = config.raw_encryption_chunk_concurrency();
+  }
+  options.data_key_cache = provider->data_key_cache();
+  options.decrypt_result_cache = provider->decrypt_result_cache();
+  return options;
+}
+
 }  // namespace
 
+CallStats& LibraryCallStats() {
+  static CallStats* const kCallStats = new CallStats(kFunctionNames);
+  return *kCallStats;
+}
+
 // Initialize the library.
 // http://docs.oasis-open.org/pkcs11/pkcs11-base/v2.40/pkcs11-base-v2.40.html#_Toc235002322
 absl::Status Initialize(CK_VOID_PTR pInitArgs) {
@@ -105,8 +158,19 @@ absl::Status Initialize(CK_VOID_PTR pInitArgs) {
   // Provider::New emits info log messages (for example, noting that a CKV is
   // being skipped due to state DISABLED), so logging should be initialized
   // before it is invoked.
-  RETURN_IF_ERROR(
-      InitializeLogging(config.log_directory(), config.log_filename_suffix()));
+  LogFileOptions log_file_options;
+  log_file_options.async = config.async_logging();
+  if (config.async_log_buffer_size() > 0) {
+    log_file_options.async_options.capacity = config.async_log_buffer_size();
+  }
+  if (config.async_log_block_when_full()) {
+    log_file_options.async_options.overflow_policy =
+        AsyncLogWriter::OverflowPolicy::kBlock;
+  }
+  log_file_options.max_file_size_mb = config.max_log_file_size_mb();
+  RETURN_IF_ERROR(InitializeLogging(config.log_directory(),
+                                    config.log_filename_suffix(),
+                                    log_file_options));
 
   absl::StatusOr<std::unique_ptr<Provider>> new_provider =
       Provider::New(config);
@@ -115,13 +179,25 @@ absl::Status Initialize(CK_VOID_PTR pInitArgs) {
     return new_provider.status();
   }
 
+  LibraryCallStats().Reset();
+  LibraryCallStats().set_enabled(config.enable_call_stats());
   return SetGlobalProvider(std::move(new_provider).value());
 }
 
 // Shut down the library.
 // http://docs.oasis-open.org/pkcs11/pkcs11-base/v2.40/pkcs11-base-v2.40.html#_Toc383864872
 absl::Status Finalize(CK_VOID_PTR pReserved) {
-  RETURN_IF_ERROR(GetProvider());
+  ASSIGN_OR_RETURN(const Provider* provider, GetProvider());
+  const std::string& call_stats_file =
+      provider->library_config().call_stats_file();
+  if (LibraryCallStats().enabled() && !call_stats_file.empty()) {
+    absl::Status result = WriteCallStats(call_stats_file);
+    if (!result.ok()) {
+      LOG(WARNING) << result;
+    }
+  }
+  LibraryCallStats().set_enabled(false);
+
   RETURN_IF_ERROR(ReleaseGlobalProvider());
   ShutdownLogging();
   return absl::OkStatus();
@@ -340,10 +416,19 @@ absl::Status GetAttributeValue(CK_SESSION_HANDLE hSession,
     return NullArgumentError("pTemplate", SOURCE_LOCATION);
   }
 
+  if (object->public_key_deferred()) {
+    for (const CK_ATTRIBUTE& attr : absl::MakeConstSpan(pTemplate, ulCount)) {
+      if (Object::IsPublicKeyAttribute(attr.type)) {
+        ASSIGN_OR_RETURN(object, session->token()->ResolvePublicKey(object));
+        break;
+      }
+    }
+  }
+
   absl::Status result = absl::OkStatus();
   for (CK_ATTRIBUTE& attr : absl::MakeSpan(pTemplate, ulCount)) {
     absl::StatusOr<std::string_view> value =
-        object->attributes().Value(attr.type);
+        object->attributes().ProbeValue(attr.type);
 
     // C_GetAttributeValue cases 1 and 2
     if (!value.ok()) {
@@ -367,11 +452,7 @@ absl::Status GetAttributeValue(CK_SESSION_HANDLE hSession,
 
     // C_GetAttributeValue case 5
     attr.ulValueLen = CK_UNAVAILABLE_INFORMATION;
-    result = OutOfRangeError(
-        absl::StrFormat(
-            "attribute %#X is of length %d, received buffer of length %d",
-            attr.type, value->size(), attr.ulValueLen),
-        SOURCE_LOCATION);
+    result = ExpectedError(CKR_BUFFER_TOO_SMALL);
   }
 
   return result;
@@ -433,7 +514,8 @@ absl::Status DecryptInit(CK_SESSION_HANDLE hSession,
   }
   return session->DecryptInit(
       key, pMechanism,
-      provider->library_config().experimental_allow_raw_encryption_keys());
+      provider->library_config().experimental_allow_raw_encryption_keys(),
+      GetRawEncryptionOptions(provider));
 }
 
 // Complete a decrypt operation.
@@ -496,18 +578,44 @@ absl::Status DecryptUpdate(CK_SESSION_HANDLE hSession,
     return NullArgumentError("pulPartLen", SOURCE_LOCATION);
   }
 
-  absl::Status result = session->DecryptUpdate(
-      absl::MakeConstSpan(pEncryptedPart, ulEncryptedPartLen));
-
-  if (!result.ok()) {
+  // Plaintext returned by DecryptUpdate comes from earlier parts, so its length
+  // is known before this part is accepted. Most operations return all of
+  // their plaintext from DecryptFinal, in which case the length is 0.
+  absl::StatusOr<size_t> plaintext_size = session->DecryptUpdateOutputLength();
+  if (!plaintext_size.ok()) {
     session->ReleaseOperation();
+    return plaintext_size.status();
   }
 
-  // The library does not return partial decrypted plaintext, so we set the
-  // partial output length to 0.
-  *pulPartLen = 0;
+  if (!pPart) {
+    *pulPartLen = *plaintext_size;
+    return absl::OkStatus();
+  }
 
-  return result;
+  if (*pulPartLen < *plaintext_size) {
+    absl::Status result = OutOfRangeError(
+        absl::StrFormat(
+            "plaintext of length %d cannot fit in buffer of length %d",
+            *plaintext_size, *pulPartLen),
+        SOURCE_LOCATION);
+    *pulPartLen = *plaintext_size;
+    return result;
+  }
+
+  // The length is checked again under the session's lock, in case another
+  // thread advanced the operation after it was measured above.
+  absl::StatusOr<size_t> plaintext_len = session->DecryptUpdate(
+      absl::MakeConstSpan(pEncryptedPart, ulEncryptedPartLen),
+      absl::MakeSpan(pPart, *pulPartLen));
+  if (!plaintext_len.ok()) {
+    if (GetCkRv(plaintext_len.status()) != CKR_BUFFER_TOO_SMALL) {
+      session->ReleaseOperation();
+    }
+    return plaintext_len.status();
+  }
+
+  *pulPartLen = *plaintext_len;
+  return absl::OkStatus();
 }
 
 // Complete a multi-part encrypt operation.
@@ -561,7 +669,8 @@ absl::Status EncryptInit(CK_SESSION_HANDLE hSession,
   }
   return session->EncryptInit(
       key, pMechanism,
-      provider->library_config().experimental_allow_raw_encryption_keys());
+      provider->library_config().experimental_allow_raw_encryption_keys(),
+      GetRawEncryptionOptions(provider));
 }
 
 // Complete an encrypt operation.
@@ -623,18 +732,45 @@ absl::Status EncryptUpdate(CK_SESSION_HANDLE hSession, CK_BYTE_PTR pPart,
     return NullArgumentError("pulEncryptedPartLen", SOURCE_LOCATION);
   }
 
-  absl::Status result =
-      session->EncryptUpdate(absl::MakeConstSpan(pPart, ulPartLen));
-
-  if (!result.ok()) {
+  // Ciphertext returned by EncryptUpdate comes from earlier parts, so its
+  // length is known before this part is accepted. Most operations return all
+  // of their ciphertext from EncryptFinal, in which case the length is 0.
+  absl::StatusOr<size_t> ciphertext_size =
+      session->EncryptUpdateOutputLength();
+  if (!ciphertext_size.ok()) {
     session->ReleaseOperation();
+    return ciphertext_size.status();
   }
 
-  // The library does not return partial encrypted ciphertext, so we set the
-  // partial output length to 0.
-  *pulEncryptedPartLen = 0;
+  if (!pEncryptedPart) {
+    *pulEncryptedPartLen = *ciphertext_size;
+    return absl::OkStatus();
+  }
 
-  return result;
+  if (*pulEncryptedPartLen < *ciphertext_size) {
+    absl::Status result = OutOfRangeError(
+        absl::StrFormat(
+            "ciphertext of length %d cannot fit in buffer of length %d",
+            *ciphertext_size, *pulEncryptedPartLen),
+        SOURCE_LOCATION);
+    *pulEncryptedPartLen = *ciphertext_size;
+    return result;
+  }
+
+  // The length is checked again under the session's lock, in case another
+  // thread advanced the operation after it was measured above.
+  absl::StatusOr<size_t> ciphertext_len = session->EncryptUpdate(
+      absl::MakeConstSpan(pPart, ulPartLen),
+      absl::MakeSpan(pEncryptedPart, *pulEncryptedPartLen));
+  if (!ciphertext_len.ok()) {
+    if (GetCkRv(ciphertext_len.status()) != CKR_BUFFER_TOO_SMALL) {
+      session->ReleaseOperation();
+    }
+    return ciphertext_len.status();
+  }
+
+  *pulEncryptedPartLen = *ciphertext_len;
+  return absl::OkStatus();
 }
 
 // Complete a multi-part encrypt operation.
@@ -972,4 +1108,36 @@ absl::Status GenerateRandom(CK_SESSION_HANDLE hSession, CK_BYTE_PTR pRandomData,
   return session->GenerateRandom(absl::MakeSpan(pRandomData, ulRandomLen));
 }
 
+// Retrieve the call statistics collected by the library. This is a vendor
+// function; see kmsp11.h.
+absl::Status CloudKmsGetCallStats(CK_UTF8CHAR_PTR pStats,
+                                  CK_ULONG_PTR pulStatsLen) {
+  RETURN_IF_ERROR(GetProvider());
+  if (!pulStatsLen) {
+    return NullArgumentError("pulStatsLen", SOURCE_LOCATION);
+  }
+  if (!LibraryCallStats().enabled()) {
+    return FailedPreconditionError("call statistics are not enabled",
+                                   CKR_FUNCTION_NOT_SUPPORTED,
+                                   SOURCE_LOCATION);
+  }
+
+  return CopyStatsReport(LibraryCallStats().ToString(), pStats, pulStatsLen);
+}
+
+absl::Status CloudKmsGetRpcStats(CK_UTF8CHAR_PTR pStats,
+                                 CK_ULONG_PTR pulStatsLen) {
+  ASSIGN_OR_RETURN(Provider * provider, GetProvider());
+  if (!pulStatsLen) {
+    return NullArgumentError("pulStatsLen", SOURCE_LOCATION);
+  }
+  if (!provider->rpc_stats()) {
+    return FailedPreconditionError("RPC statistics are not enabled",
+                                   CKR_FUNCTION_NOT_SUPPORTED,
+                                   SOURCE_LOCATION);
+  }
+
+  return CopyStatsReport(provider->RpcStatsReport(), pStats, pulStatsLen);
+}
+
 }  // namespace cloud_kms::kmsp11
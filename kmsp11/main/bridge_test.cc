@@ -15,6 +15,7 @@
 #include "kmsp11/main/bridge.h"
 
 #include <fstream>
+#include <sstream>
 
 #include "absl/cleanup/cleanup.h"
 #include "common/openssl.h"
@@ -186,6 +187,121 @@ TEST(BridgeTest, GetInfoFailsNullPtr) {
   EXPECT_THAT(GetInfo(nullptr), StatusRvIs(CKR_ARGUMENTS_BAD));
 }
 
+TEST(BridgeTest, CloudKmsGetCallStatsFailsWhenNotEnabled) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake_server,
+                       fakekms::Server::New());
+  ASSERT_OK_AND_ASSIGN(std::string config_file,
+                       InitializeBridgeForOneKmsKeyRing(fake_server.get()));
+  absl::Cleanup c = [config_file] {
+    std::remove(config_file.c_str());
+    EXPECT_OK(Finalize(nullptr));
+  };
+
+  CK_ULONG stats_len;
+  EXPECT_THAT(CloudKmsGetCallStats(nullptr, &stats_len),
+              StatusRvIs(CKR_FUNCTION_NOT_SUPPORTED));
+}
+
+TEST(BridgeTest, CloudKmsGetCallStatsReportsEntryPointCalls) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake_server,
+                       fakekms::Server::New());
+  std::string config_file = CreateConfigFileWithOneKeyring(fake_server.get());
+  std::ofstream(config_file, std::ofstream::out | std::ofstream::app)
+      << "enable_call_stats: true" << std::endl;
+  absl::Cleanup config_close = [config_file] {
+    std::remove(config_file.c_str());
+  };
+
+  auto init_args = InitArgs(config_file.c_str());
+  EXPECT_OK(Initialize(&init_args));
+  absl::Cleanup c = [] { EXPECT_OK(Finalize(nullptr)); };
+
+  CK_INFO info;
+  EXPECT_EQ(C_GetInfo(&info), CKR_OK);
+  EXPECT_EQ(C_GetInfo(nullptr), CKR_ARGUMENTS_BAD);
+
+  CK_ULONG stats_len;
+  EXPECT_OK(CloudKmsGetCallStats(nullptr, &stats_len));
+
+  CK_ULONG short_len = 1;
+  std::string stats(stats_len, ' ');
+  EXPECT_THAT(CloudKmsGetCallStats(
+                  reinterpret_cast<CK_UTF8CHAR_PTR>(stats.data()), &short_len),
+              StatusRvIs(CKR_BUFFER_TOO_SMALL));
+  EXPECT_EQ(short_len, stats_len);
+
+  EXPECT_OK(CloudKmsGetCallStats(
+      reinterpret_cast<CK_UTF8CHAR_PTR>(stats.data()), &stats_len));
+  stats.resize(stats_len);
+  EXPECT_THAT(stats, HasSubstr("C_GetInfo: calls=2 errors=1"));
+  EXPECT_THAT(stats, HasSubstr("errors_by_rv: 0x7=1"));
+}
+
+TEST(BridgeTest, FinalizeWritesCallStatsFile) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake_server,
+                       fakekms::Server::New());
+  std::string config_file = CreateConfigFileWithOneKeyring(fake_server.get());
+  std::string stats_file = std::tmpnam(nullptr);
+  std::ofstream(config_file, std::ofstream::out | std::ofstream::app)
+      << "enable_call_stats: true" << std::endl
+      << "call_stats_file: \"" << stats_file << "\"" << std::endl;
+  absl::Cleanup files_close = [config_file, stats_file] {
+    std::remove(config_file.c_str());
+    std::remove(stats_file.c_str());
+  };
+
+  auto init_args = InitArgs(config_file.c_str());
+  EXPECT_OK(Initialize(&init_args));
+  CK_SLOT_ID slot_id;
+  CK_ULONG slot_count = 1;
+  EXPECT_EQ(C_GetSlotList(CK_FALSE, &slot_id, &slot_count), CKR_OK);
+  EXPECT_OK(Finalize(nullptr));
+
+  std::stringstream stats;
+  stats << std::ifstream(stats_file).rdbuf();
+  EXPECT_THAT(stats.str(), HasSubstr("C_GetSlotList: calls=1 errors=0"));
+}
+
+TEST(BridgeTest, CloudKmsGetRpcStatsFailsWhenNotEnabled) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake_server,
+                       fakekms::Server::New());
+  ASSERT_OK_AND_ASSIGN(std::string config_file,
+                       InitializeBridgeForOneKmsKeyRing(fake_server.get()));
+  absl::Cleanup c = [config_file] {
+    std::remove(config_file.c_str());
+    EXPECT_OK(Finalize(nullptr));
+  };
+
+  CK_ULONG stats_len;
+  EXPECT_THAT(CloudKmsGetRpcStats(nullptr, &stats_len),
+              StatusRvIs(CKR_FUNCTION_NOT_SUPPORTED));
+}
+
+TEST(BridgeTest, CloudKmsGetRpcStatsReportsKmsCalls) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake_server,
+                       fakekms::Server::New());
+  std::string config_file = CreateConfigFileWithOneKeyring(fake_server.get());
+  std::ofstream(config_file, std::ofstream::out | std::ofstream::app)
+      << "enable_rpc_stats: true" << std::endl;
+  absl::Cleanup config_close = [config_file] {
+    std::remove(config_file.c_str());
+  };
+
+  auto init_args = InitArgs(config_file.c_str());
+  EXPECT_OK(Initialize(&init_args));
+  absl::Cleanup c = [] { EXPECT_OK(Finalize(nullptr)); };
+
+  CK_ULONG stats_len;
+  EXPECT_OK(CloudKmsGetRpcStats(nullptr, &stats_len));
+  std::string stats(stats_len, ' ');
+  EXPECT_OK(CloudKmsGetRpcStats(
+      reinterpret_cast<CK_UTF8CHAR_PTR>(stats.data()), &stats_len));
+  stats.resize(stats_len);
+
+  // Loading the key ring lists its keys.
+  EXPECT_THAT(stats, HasSubstr("ListCryptoKeys: in_flight=0 OK=1"));
+}
+
 TEST(BridgeTest, GetFunctionListSuccess) {
   CK_FUNCTION_LIST* function_list;
   EXPECT_OK(GetFunctionList(&function_list));
@@ -1007,6 +1123,12 @@ TEST(BridgeTest, GetMechanismInfoRawEncryptionKeysExperimentEnabled) {
   EXPECT_EQ(info.ulMinKeySize, 16);
   EXPECT_EQ(info.ulMaxKeySize, 32);
   EXPECT_EQ(info.flags, CKF_DECRYPT | CKF_ENCRYPT);
+
+  EXPECT_OK(GetMechanismInfo(0, CKM_CLOUDKMS_ENVELOPE_AES_GCM, &info));
+
+  EXPECT_EQ(info.ulMinKeySize, 0);
+  EXPECT_EQ(info.ulMaxKeySize, 0);
+  EXPECT_EQ(info.flags, CKF_DECRYPT | CKF_ENCRYPT);
 }
 
 TEST(BridgeTest, GetMechanismInfoFailsNotInitialized) {
@@ -28,7 +28,7 @@ absl::Status RegisterForkHandlers() {
     // This deadlocks unless it comes after the gRPC postfork routine.
     // Presumably there is some mutex/counter of created gRPC objects.
     ReleaseGlobalProvider().IgnoreError();
-    ShutdownLogging();
+    ShutdownLoggingInForkedChild();
   });
   if (result != 0) {
     return absl::InternalError(
@@ -72,17 +72,20 @@ INSTANTIATE_TEST_SUITE_P(TestSymmetricEncryption, SymmetricGcmCryptTest,
 
 // Initializes a KMS KeyRing, a key in this KeyRing and a crypto key version
 // with the specified algorithm. Creates a configuration file with this keyring
-// as a token that also enables raw encryption keys. Returns the configuration
-// file, the created key, and a session for the created KeyRing.
+// as a token that also enables raw encryption keys, followed by any
+// `extra_config`. Returns the configuration file, the created key, and a
+// session for the created KeyRing.
 absl::StatusOr<std::string> InitializeAsymmetricCryptTest(
     fakekms::Server* fake_server,
     kms_v1::CryptoKeyVersion::CryptoKeyVersionAlgorithm algorithm,
-    kms_v1::CryptoKeyVersion* ckv, CK_SESSION_HANDLE* session) {
+    kms_v1::CryptoKeyVersion* ckv, CK_SESSION_HANDLE* session,
+    std::string_view extra_config = "") {
   kms_v1::KeyRing kr;
   std::string config_file = CreateConfigFileWithOneKeyring(fake_server, &kr);
 
   std::ofstream(config_file, std::ofstream::out | std::ofstream::app)
-      << "experimental_allow_raw_encryption_keys: true" << std::endl;
+      << "experimental_allow_raw_encryption_keys: true" << std::endl
+      << extra_config << std::endl;
 
   auto init_args = InitArgs(config_file.c_str());
 
@@ -370,6 +373,80 @@ TEST_P(SymmetricCtrCryptTest, EncryptDecryptMultiPartSuccess) {
   EXPECT_EQ(recovered_plaintext_size, plaintext.size());
 }
 
+TEST_P(SymmetricCtrCryptTest, ChunkedEncryptUpdateReturnsCiphertext) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake_server,
+                       fakekms::Server::New());
+  kms_v1::CryptoKeyVersion ckv;
+  CK_SESSION_HANDLE session;
+  ASSERT_OK_AND_ASSIGN(
+      std::string config_file,
+      InitializeAsymmetricCryptTest(
+          fake_server.get(), GetParam(), &ckv, &session,
+          "experimental_chunked_raw_encryption: true"));
+  absl::Cleanup c = [config_file] {
+    std::remove(config_file.c_str());
+    EXPECT_OK(Finalize(nullptr));
+  };
+
+  ASSERT_OK_AND_ASSIGN(CK_OBJECT_HANDLE secret_key,
+                       GetSecretKeyObjectHandle(session, ckv));
+
+  CK_AES_CTR_PARAMS params;
+  params.ulCounterBits = 128;
+  RAND_bytes(params.cb, sizeof(params.cb));
+
+  CK_MECHANISM mech = {
+      CKM_AES_CTR,     // mechanism
+      &params,         // pParameter
+      sizeof(params),  // ulParameterLen
+  };
+
+  constexpr size_t kChunkSize = 64 * 1024;
+  std::vector<uint8_t> part1(kChunkSize + 5);
+  std::vector<uint8_t> part2(kChunkSize + 5);
+  RAND_bytes(part1.data(), part1.size());
+  RAND_bytes(part2.data(), part2.size());
+  std::vector<uint8_t> plaintext(part1);
+  plaintext.insert(plaintext.end(), part2.begin(), part2.end());
+
+  EXPECT_OK(EncryptInit(session, &mech, secret_key));
+  std::vector<uint8_t> ciphertext(plaintext.size());
+
+  // The first part completes a chunk, whose ciphertext is returned by the
+  // next call.
+  CK_ULONG part_size = 0;
+  EXPECT_OK(EncryptUpdate(session, part1.data(), part1.size(), nullptr,
+                          &part_size));
+  EXPECT_EQ(part_size, 0);
+  EXPECT_OK(EncryptUpdate(session, part1.data(), part1.size(),
+                          ciphertext.data(), &part_size));
+  EXPECT_EQ(part_size, 0);
+
+  EXPECT_OK(EncryptUpdate(session, part2.data(), part2.size(), nullptr,
+                          &part_size));
+  EXPECT_EQ(part_size, kChunkSize);
+  part_size = 16;
+  EXPECT_THAT(EncryptUpdate(session, part2.data(), part2.size(),
+                            ciphertext.data(), &part_size),
+              StatusRvIs(CKR_BUFFER_TOO_SMALL));
+  EXPECT_EQ(part_size, kChunkSize);
+  EXPECT_OK(EncryptUpdate(session, part2.data(), part2.size(),
+                          ciphertext.data(), &part_size));
+  EXPECT_EQ(part_size, kChunkSize);
+
+  CK_ULONG final_size = 0;
+  EXPECT_OK(EncryptFinal(session, nullptr, &final_size));
+  EXPECT_EQ(final_size, kChunkSize + 10);
+  EXPECT_OK(
+      EncryptFinal(session, ciphertext.data() + kChunkSize, &final_size));
+  EXPECT_EQ(final_size, kChunkSize + 10);
+
+  CK_ULONG recovered_plaintext_size = plaintext.size();
+  std::vector<uint8_t> recovered_plaintext = DecryptCiphertext(
+      session, mech, secret_key, ciphertext, &recovered_plaintext_size);
+  EXPECT_EQ(recovered_plaintext, plaintext);
+}
+
 TEST_P(SymmetricGcmCryptTest, EncryptDecryptSuccess) {
   ASSERT_OK_AND_ASSIGN(std::unique_ptr<fakekms::Server> fake_server,
                        fakekms::Server::New());
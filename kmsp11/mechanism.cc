@@ -208,6 +208,17 @@ AllMechanisms() {
                   CKF_DECRYPT | CKF_ENCRYPT  // flags
               },
           },
+          // The envelope mechanism accepts AES keys, whose sizes are given
+          // in bytes, and RSA keys, whose sizes are given in bits. No single
+          // range covers both units, so no key size bounds are reported.
+          {
+              CKM_CLOUDKMS_ENVELOPE_AES_GCM,
+              {
+                  0,                         // ulMinKeySize
+                  0,                         // ulMaxKeySize
+                  CKF_DECRYPT | CKF_ENCRYPT  // flags
+              },
+          },
           {
               CKM_AES_CTR,
               {
@@ -251,7 +262,8 @@ const absl::flat_hash_set<CK_MECHANISM_TYPE>& AllRawEncryptionMechanisms() {
   // These mechanisms are only supported if the
   // experimental_allow_raw_encryption_keys config flag is set.
   static const absl::flat_hash_set<CK_MECHANISM_TYPE> kRawEncryptionMechanisms =
-      {CKM_CLOUDKMS_AES_GCM, CKM_AES_CTR, CKM_AES_CBC, CKM_AES_CBC_PAD};
+      {CKM_CLOUDKMS_AES_GCM, CKM_CLOUDKMS_ENVELOPE_AES_GCM, CKM_AES_CTR,
+       CKM_AES_CBC, CKM_AES_CBC_PAD};
   return kRawEncryptionMechanisms;
 }
 
@@ -45,46 +45,46 @@ absl::Status AddStorageAttributes(AttributeMap* attrs,
 
 absl::Status AddKeyAttributes(AttributeMap* attrs,
                               const kms_v1::CryptoKeyVersion& ckv) {
-  ASSIGN_OR_RETURN(AlgorithmDetails algorithm, GetDetails(ckv.algorithm()));
+  ASSIGN_OR_RETURN(const AlgorithmDetails* algorithm,
+                   GetDetails(ckv.algorithm()));
 
   // 4.7 Key objects
-  attrs->PutULong(CKA_KEY_TYPE, algorithm.key_type);
+  attrs->PutULong(CKA_KEY_TYPE, algorithm->key_type);
   attrs->Put(CKA_ID, ckv.name());
   attrs->Put(CKA_START_DATE, "");
   attrs->Put(CKA_END_DATE, "");
   attrs->PutBool(CKA_DERIVE, false);
   attrs->PutBool(CKA_LOCAL, ckv.import_job().empty());
   attrs->PutULong(CKA_KEY_GEN_MECHANISM, ckv.import_job().empty()
-                                             ? algorithm.key_gen_mechanism
+                                             ? algorithm->key_gen_mechanism
                                              : CK_UNAVAILABLE_INFORMATION);
-  attrs->PutULongList(CKA_ALLOWED_MECHANISMS, algorithm.allowed_mechanisms);
+  attrs->PutULongList(CKA_ALLOWED_MECHANISMS, algorithm->allowed_mechanisms);
 
   return absl::OkStatus();
 }
 
 absl::Status AddPublicKeyAttributes(AttributeMap* attrs,
-                                    const kms_v1::CryptoKeyVersion& ckv,
-                                    std::string_view public_key_der) {
-  ASSIGN_OR_RETURN(AlgorithmDetails algorithm, GetDetails(ckv.algorithm()));
+                                    const kms_v1::CryptoKeyVersion& ckv) {
+  ASSIGN_OR_RETURN(const AlgorithmDetails* algorithm,
+                   GetDetails(ckv.algorithm()));
 
   // 4.8 Public key objects
   attrs->Put(CKA_SUBJECT, "");
   attrs->PutBool(CKA_ENCRYPT,
-                 algorithm.purpose == kms_v1::CryptoKey::ASYMMETRIC_DECRYPT);
+                 algorithm->purpose == kms_v1::CryptoKey::ASYMMETRIC_DECRYPT);
   attrs->PutBool(CKA_VERIFY,
-                 algorithm.purpose == kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+                 algorithm->purpose == kms_v1::CryptoKey::ASYMMETRIC_SIGN);
   attrs->PutBool(CKA_VERIFY_RECOVER, false);
   attrs->PutBool(CKA_WRAP, false);
   attrs->PutBool(CKA_TRUSTED, false);
   attrs->Put(CKA_WRAP_TEMPLATE, "");
-  attrs->Put(CKA_PUBLIC_KEY_INFO, public_key_der);
   return absl::OkStatus();
 }
 
 absl::Status AddPrivateKeyAttributes(AttributeMap* attrs,
-                                     const kms_v1::CryptoKeyVersion& ckv,
-                                     std::string_view public_key_der) {
-  ASSIGN_OR_RETURN(AlgorithmDetails algorithm, GetDetails(ckv.algorithm()));
+                                     const kms_v1::CryptoKeyVersion& ckv) {
+  ASSIGN_OR_RETURN(const AlgorithmDetails* algorithm,
+                   GetDetails(ckv.algorithm()));
 
   // Override CKA_DESTROYABLE (from 4.4 Storage Objects)
   attrs->PutBool(CKA_DESTROYABLE, true);
@@ -93,9 +93,9 @@ absl::Status AddPrivateKeyAttributes(AttributeMap* attrs,
   attrs->Put(CKA_SUBJECT, "");
   attrs->PutBool(CKA_SENSITIVE, true);
   attrs->PutBool(CKA_DECRYPT,
-                 algorithm.purpose == kms_v1::CryptoKey::ASYMMETRIC_DECRYPT);
+                 algorithm->purpose == kms_v1::CryptoKey::ASYMMETRIC_DECRYPT);
   attrs->PutBool(CKA_SIGN,
-                 algorithm.purpose == kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+                 algorithm->purpose == kms_v1::CryptoKey::ASYMMETRIC_SIGN);
   attrs->PutBool(CKA_SIGN_RECOVER, false);
   attrs->PutBool(CKA_UNWRAP, false);
   attrs->PutBool(CKA_EXTRACTABLE, false);
@@ -104,10 +104,30 @@ absl::Status AddPrivateKeyAttributes(AttributeMap* attrs,
   attrs->PutBool(CKA_WRAP_WITH_TRUSTED, false);
   attrs->Put(CKA_UNWRAP_TEMPLATE, "");
   attrs->PutBool(CKA_ALWAYS_AUTHENTICATE, false);
-  attrs->Put(CKA_PUBLIC_KEY_INFO, public_key_der);
   return absl::OkStatus();
 }
 
+// Adds the private key attributes whose values are never revealed, and which
+// therefore don't depend on the public key.
+void AddSensitivePrivateKeyAttributes(AttributeMap* attrs,
+                                      CK_KEY_TYPE key_type) {
+  switch (key_type) {
+    case CKK_EC:
+      // 2.3.4 Elliptic curve private key objects
+      attrs->PutSensitive(CKA_VALUE);
+      break;
+    case CKK_RSA:
+      // 2.1.3 RSA private key objects
+      attrs->PutSensitive(CKA_PRIVATE_EXPONENT);
+      attrs->PutSensitive(CKA_PRIME_1);
+      attrs->PutSensitive(CKA_PRIME_2);
+      attrs->PutSensitive(CKA_EXPONENT_1);
+      attrs->PutSensitive(CKA_EXPONENT_2);
+      attrs->PutSensitive(CKA_COEFFICIENT);
+      break;
+  }
+}
+
 absl::Status AddEcPublicKeyAttributes(AttributeMap* attrs,
                                       BSSL_CONST EC_KEY* public_key) {
   ASSIGN_OR_RETURN(std::string params, MarshalEcParametersDer(public_key));
@@ -128,9 +148,7 @@ absl::Status AddEcPrivateKeyAttributes(AttributeMap* attrs,
   // Some implementations seem to expect that EC private keys contain the EC
   // public key attributes as well.
   RETURN_IF_ERROR(AddEcPublicKeyAttributes(attrs, public_key));
-
-  // 2.3.4 Elliptic curve private key objects
-  attrs->PutSensitive(CKA_VALUE);
+  AddSensitivePrivateKeyAttributes(attrs, CKK_EC);
 
   return absl::OkStatus();
 }
@@ -152,21 +170,15 @@ absl::Status AddRsaPrivateKeyAttributes(AttributeMap* attrs,
   // Some implementations seem to expect that RSA private keys contain the RSA
   // public key attributes as well.
   RETURN_IF_ERROR(AddRsaPublicKeyAttributes(attrs, public_key));
-
-  // 2.1.3 RSA private key objects
-  attrs->PutSensitive(CKA_PRIVATE_EXPONENT);
-  attrs->PutSensitive(CKA_PRIME_1);
-  attrs->PutSensitive(CKA_PRIME_2);
-  attrs->PutSensitive(CKA_EXPONENT_1);
-  attrs->PutSensitive(CKA_EXPONENT_2);
-  attrs->PutSensitive(CKA_COEFFICIENT);
+  AddSensitivePrivateKeyAttributes(attrs, CKK_RSA);
 
   return absl::OkStatus();
 }
 
 absl::Status AddSecretKeyAttributes(AttributeMap* attrs,
                                     const kms_v1::CryptoKeyVersion& ckv) {
-  ASSIGN_OR_RETURN(AlgorithmDetails algorithm, GetDetails(ckv.algorithm()));
+  ASSIGN_OR_RETURN(const AlgorithmDetails* algorithm,
+                   GetDetails(ckv.algorithm()));
 
   // CKA_VALUE and CKA_VALUE_LEN are tied to the mechanisms in the spec, but
   // in practice they are the same for all secret keys.
@@ -174,7 +186,7 @@ absl::Status AddSecretKeyAttributes(AttributeMap* attrs,
   // http://docs.oasis-open.org/pkcs11/pkcs11-curr/v2.40/errata01/os/pkcs11-curr-v2.40-errata01-os-complete.html#_Toc228894691
   attrs->PutSensitive(CKA_VALUE);
   // CKA_VALUE_LEN = key size in bytes.
-  attrs->PutULong(CKA_VALUE_LEN, algorithm.key_bit_length / 8);
+  attrs->PutULong(CKA_VALUE_LEN, algorithm->key_bit_length / 8);
 
   // Override CKA_DESTROYABLE (from 4.4 Storage Objects)
   attrs->PutBool(CKA_DESTROYABLE, true);
@@ -183,11 +195,11 @@ absl::Status AddSecretKeyAttributes(AttributeMap* attrs,
   attrs->Put(CKA_SUBJECT, "");
   attrs->PutBool(CKA_SENSITIVE, true);
   attrs->PutBool(CKA_ENCRYPT,
-                 algorithm.purpose == kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
+                 algorithm->purpose == kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
   attrs->PutBool(CKA_DECRYPT,
-                 algorithm.purpose == kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
-  attrs->PutBool(CKA_SIGN, algorithm.purpose == kms_v1::CryptoKey::MAC);
-  attrs->PutBool(CKA_VERIFY, algorithm.purpose == kms_v1::CryptoKey::MAC);
+                 algorithm->purpose == kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
+  attrs->PutBool(CKA_SIGN, algorithm->purpose == kms_v1::CryptoKey::MAC);
+  attrs->PutBool(CKA_VERIFY, algorithm->purpose == kms_v1::CryptoKey::MAC);
   attrs->PutBool(CKA_WRAP, false);
   attrs->PutBool(CKA_UNWRAP, false);
   attrs->PutBool(CKA_EXTRACTABLE, false);
@@ -255,19 +267,23 @@ absl::Status AddX509CertificateAttributes(AttributeMap* attrs,
 
 absl::StatusOr<KeyPair> Object::NewKeyPair(const kms_v1::CryptoKeyVersion& ckv,
                                            BSSL_CONST EVP_PKEY* public_key) {
-  ASSIGN_OR_RETURN(std::string pub_der, MarshalX509PublicKeyDer(public_key));
+  ASSIGN_OR_RETURN(std::string marshaled_der,
+                   MarshalX509PublicKeyDer(public_key));
+  auto pub_der = std::make_shared<const std::string>(std::move(marshaled_der));
 
   AttributeMap pub_attrs;
   pub_attrs.PutULong(CKA_CLASS, CKO_PUBLIC_KEY);
   RETURN_IF_ERROR(AddStorageAttributes(&pub_attrs, ckv));
   RETURN_IF_ERROR(AddKeyAttributes(&pub_attrs, ckv));
-  RETURN_IF_ERROR(AddPublicKeyAttributes(&pub_attrs, ckv, pub_der));
+  RETURN_IF_ERROR(AddPublicKeyAttributes(&pub_attrs, ckv));
+  pub_attrs.PutShared(CKA_PUBLIC_KEY_INFO, pub_der);
 
   AttributeMap prv_attrs;
   prv_attrs.PutULong(CKA_CLASS, CKO_PRIVATE_KEY);
   RETURN_IF_ERROR(AddStorageAttributes(&prv_attrs, ckv));
   RETURN_IF_ERROR(AddKeyAttributes(&prv_attrs, ckv));
-  RETURN_IF_ERROR(AddPrivateKeyAttributes(&prv_attrs, ckv, pub_der));
+  RETURN_IF_ERROR(AddPrivateKeyAttributes(&prv_attrs, ckv));
+  prv_attrs.PutShared(CKA_PUBLIC_KEY_INFO, pub_der);
 
   int pkey_id = EVP_PKEY_id(public_key);
   switch (pkey_id) {
@@ -289,9 +305,79 @@ absl::StatusOr<KeyPair> Object::NewKeyPair(const kms_v1::CryptoKeyVersion& ckv,
                       CKR_GENERAL_ERROR, SOURCE_LOCATION);
   }
 
-  ASSIGN_OR_RETURN(AlgorithmDetails algorithm, GetDetails(ckv.algorithm()));
-  return KeyPair{Object(ckv.name(), CKO_PUBLIC_KEY, algorithm, pub_attrs),
-                 Object(ckv.name(), CKO_PRIVATE_KEY, algorithm, prv_attrs)};
+  ASSIGN_OR_RETURN(const AlgorithmDetails* algorithm,
+                   GetDetails(ckv.algorithm()));
+
+  // Both halves of the key pair share a reference to the caller's key.
+  // EVP_PKEY_up_ref only modifies the key's reference count.
+  EVP_PKEY* shared_key = const_cast<EVP_PKEY*>(public_key);
+  EVP_PKEY_up_ref(shared_key);
+  std::shared_ptr<EVP_PKEY> parsed_key(shared_key, &EVP_PKEY_free);
+
+  return KeyPair{Object(ckv.name(), CKO_PUBLIC_KEY, algorithm, pub_attrs,
+                        nullptr, parsed_key),
+                 Object(ckv.name(), CKO_PRIVATE_KEY, algorithm, prv_attrs,
+                        nullptr, parsed_key)};
+}
+
+absl::StatusOr<KeyPair> Object::NewDeferredKeyPair(
+    const kms_v1::CryptoKeyVersion& ckv) {
+  ASSIGN_OR_RETURN(const AlgorithmDetails* algorithm,
+                   GetDetails(ckv.algorithm()));
+
+  AttributeMap pub_attrs;
+  pub_attrs.PutULong(CKA_CLASS, CKO_PUBLIC_KEY);
+  RETURN_IF_ERROR(AddStorageAttributes(&pub_attrs, ckv));
+  RETURN_IF_ERROR(AddKeyAttributes(&pub_attrs, ckv));
+  RETURN_IF_ERROR(AddPublicKeyAttributes(&pub_attrs, ckv));
+
+  AttributeMap prv_attrs;
+  prv_attrs.PutULong(CKA_CLASS, CKO_PRIVATE_KEY);
+  RETURN_IF_ERROR(AddStorageAttributes(&prv_attrs, ckv));
+  RETURN_IF_ERROR(AddKeyAttributes(&prv_attrs, ckv));
+  RETURN_IF_ERROR(AddPrivateKeyAttributes(&prv_attrs, ckv));
+  AddSensitivePrivateKeyAttributes(&prv_attrs, algorithm->key_type);
+
+  auto deferred_ckv = std::make_shared<const kms_v1::CryptoKeyVersion>(ckv);
+  return KeyPair{
+      Object(ckv.name(), CKO_PUBLIC_KEY, algorithm, pub_attrs, deferred_ckv),
+      Object(ckv.name(), CKO_PRIVATE_KEY, algorithm, prv_attrs, deferred_ckv)};
+}
+
+absl::StatusOr<KeyPair> Object::CompleteKeyPair(
+    BSSL_CONST EVP_PKEY* public_key) const {
+  if (!deferred_ckv_) {
+    return NewInternalError(
+        absl::StrFormat("object for %s is not a deferred key pair",
+                        kms_key_name_),
+        SOURCE_LOCATION);
+  }
+  return NewKeyPair(*deferred_ckv_, public_key);
+}
+
+absl::StatusOr<bssl::UniquePtr<EVP_PKEY>> Object::ParsedPublicKey() const {
+  if (!public_key_) {
+    return NewInternalError(
+        absl::StrFormat("object for %s does not have a public key",
+                        kms_key_name_),
+        SOURCE_LOCATION);
+  }
+  EVP_PKEY_up_ref(public_key_.get());
+  return bssl::UniquePtr<EVP_PKEY>(public_key_.get());
+}
+
+bool Object::IsPublicKeyAttribute(CK_ATTRIBUTE_TYPE type) {
+  switch (type) {
+    case CKA_PUBLIC_KEY_INFO:
+    case CKA_EC_PARAMS:
+    case CKA_EC_POINT:
+    case CKA_MODULUS:
+    case CKA_MODULUS_BITS:
+    case CKA_PUBLIC_EXPONENT:
+      return true;
+    default:
+      return false;
+  }
 }
 
 absl::StatusOr<Object> Object::NewSecretKey(
@@ -302,13 +388,15 @@ absl::StatusOr<Object> Object::NewSecretKey(
   RETURN_IF_ERROR(AddKeyAttributes(&attrs, ckv));
   RETURN_IF_ERROR(AddSecretKeyAttributes(&attrs, ckv));
 
-  ASSIGN_OR_RETURN(AlgorithmDetails algorithm, GetDetails(ckv.algorithm()));
+  ASSIGN_OR_RETURN(const AlgorithmDetails* algorithm,
+                   GetDetails(ckv.algorithm()));
   return Object(ckv.name(), CKO_SECRET_KEY, algorithm, attrs);
 }
 
 absl::StatusOr<Object> Object::NewCertificate(
     const kms_v1::CryptoKeyVersion& ckv, X509* certificate) {
-  ASSIGN_OR_RETURN(AlgorithmDetails algorithm, GetDetails(ckv.algorithm()));
+  ASSIGN_OR_RETURN(const AlgorithmDetails* algorithm,
+                   GetDetails(ckv.algorithm()));
 
   AttributeMap cert_attrs;
   cert_attrs.PutULong(CKA_CLASS, CKO_CERTIFICATE);
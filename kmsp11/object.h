@@ -17,10 +17,12 @@
 #ifndef KMSP11_OBJECT_H_
 #define KMSP11_OBJECT_H_
 
+#include <memory>
 #include <string_view>
 
 #include "absl/status/statusor.h"
 #include "common/kms_v1.h"
+#include "common/openssl.h"
 #include "google/cloud/kms/v1/resources.pb.h"
 #include "kmsp11/algorithm_details.h"
 #include "kmsp11/attribute_map.h"
@@ -38,6 +40,11 @@ class Object {
  public:
   static absl::StatusOr<KeyPair> NewKeyPair(const kms_v1::CryptoKeyVersion& ckv,
                                             BSSL_CONST EVP_PKEY* public_key);
+  // Creates a key pair whose public key is not yet known. Attributes that
+  // depend on the public key (see IsPublicKeyAttribute) are omitted; the
+  // complete key pair can be created later with CompleteKeyPair.
+  static absl::StatusOr<KeyPair> NewDeferredKeyPair(
+      const kms_v1::CryptoKeyVersion& ckv);
   static absl::StatusOr<Object> NewSecretKey(
       const kms_v1::CryptoKeyVersion& ckv);
 
@@ -46,21 +53,44 @@ class Object {
 
   std::string_view kms_key_name() const { return kms_key_name_; }
   CK_OBJECT_CLASS object_class() const { return object_class_; }
-  const AlgorithmDetails& algorithm() const { return algorithm_; }
+  const AlgorithmDetails& algorithm() const { return *algorithm_; }
   const AttributeMap& attributes() const { return attributes_; }
 
+  // Returns a new reference to the public key of this key pair object. The
+  // key is parsed once when the object is created and is shared by every
+  // operation that uses the object, so callers must not modify it.
+  absl::StatusOr<bssl::UniquePtr<EVP_PKEY>> ParsedPublicKey() const;
+
+  // Whether this object is part of a key pair created with NewDeferredKeyPair.
+  bool public_key_deferred() const { return deferred_ckv_ != nullptr; }
+  // Returns the complete key pair that this deferred object is a part of.
+  absl::StatusOr<KeyPair> CompleteKeyPair(
+      BSSL_CONST EVP_PKEY* public_key) const;
+
+  // Whether the value of the provided attribute is derived from the public
+  // key, and so is absent from deferred key pairs.
+  static bool IsPublicKeyAttribute(CK_ATTRIBUTE_TYPE type);
+
  private:
   Object(std::string kms_key_name, CK_OBJECT_CLASS object_class,
-         AlgorithmDetails algorithm, AttributeMap attributes)
+         const AlgorithmDetails* algorithm, AttributeMap attributes,
+         std::shared_ptr<const kms_v1::CryptoKeyVersion> deferred_ckv = nullptr,
+         std::shared_ptr<EVP_PKEY> public_key = nullptr)
       : kms_key_name_(kms_key_name),
         object_class_(object_class),
         algorithm_(algorithm),
-        attributes_(attributes) {}
+        attributes_(attributes),
+        deferred_ckv_(std::move(deferred_ckv)),
+        public_key_(std::move(public_key)) {}
 
   const std::string kms_key_name_;
   const CK_OBJECT_CLASS object_class_;
-  const AlgorithmDetails algorithm_;
+  const AlgorithmDetails* const algorithm_;
   const AttributeMap attributes_;
+  // Set only for deferred key pairs.
+  const std::shared_ptr<const kms_v1::CryptoKeyVersion> deferred_ckv_;
+  // Set only for complete key pairs.
+  const std::shared_ptr<EVP_PKEY> public_key_;
 };
 
 struct KeyPair {
@@ -14,6 +14,10 @@
 
 #include "kmsp11/object_loader.h"
 
+#include <algorithm>
+#include <utility>
+
+#include "absl/strings/match.h"
 #include "common/status_macros.h"
 #include "glog/logging.h"
 #include "kmsp11/algorithm_details.h"
@@ -23,6 +27,14 @@
 namespace cloud_kms::kmsp11 {
 namespace {
 
+// List filters that select the keys and versions that IsLoadable accepts, so
+// that other resources aren't sent to us at all. IsLoadable is still applied
+// to the results, since it also checks for supported algorithms.
+constexpr std::string_view kLoadableKeysFilter =
+    "version_template.protection_level=HSM AND (purpose=ASYMMETRIC_DECRYPT OR "
+    "purpose=ASYMMETRIC_SIGN OR purpose=MAC OR purpose=RAW_ENCRYPT_DECRYPT)";
+constexpr std::string_view kLoadableVersionsFilter = "state=ENABLED";
+
 std::string EnumNameOrValue(std::string name, int value) {
   return name.empty() ? std::to_string(value) : name;
 }
@@ -80,6 +92,49 @@ bool IsLoadable(const kms_v1::CryptoKeyVersion& ckv) {
   return true;
 }
 
+bool CreatedBefore(const kms_v1::CryptoKeyVersion& a,
+                   const kms_v1::CryptoKeyVersion& b) {
+  return std::make_pair(a.create_time().seconds(), a.create_time().nanos()) <
+         std::make_pair(b.create_time().seconds(), b.create_time().nanos());
+}
+
+// Returns true if `key`, which was restored from a previously built state,
+// describes the version `ckv` as it is listed now. If `public_key` is non-null,
+// it is the version's current public key, which the key's public key and
+// certificate must also match.
+bool RestoredKeyMatches(const Key& key, const kms_v1::CryptoKeyVersion& ckv,
+                        BSSL_CONST EVP_PKEY* public_key) {
+  if (key.crypto_key_version().SerializeAsString() !=
+      ckv.SerializeAsString()) {
+    return false;
+  }
+  if (!public_key) {
+    return true;
+  }
+
+  absl::StatusOr<std::string> public_key_der =
+      MarshalX509PublicKeyDer(public_key);
+  if (!public_key_der.ok() || key.public_key_der() != *public_key_der) {
+    return false;
+  }
+  if (!key.has_certificate()) {
+    return true;
+  }
+
+  absl::StatusOr<bssl::UniquePtr<X509>> cert =
+      ParseX509CertificateDer(key.certificate().x509_der());
+  if (!cert.ok()) {
+    return false;
+  }
+  bssl::UniquePtr<EVP_PKEY> cert_public_key(X509_get_pubkey(cert->get()));
+  if (!cert_public_key) {
+    return false;
+  }
+  absl::StatusOr<std::string> cert_public_key_der =
+      MarshalX509PublicKeyDer(cert_public_key.get());
+  return cert_public_key_der.ok() && *cert_public_key_der == *public_key_der;
+}
+
 }  // namespace
 
 Key* ObjectLoader::Cache::Get(std::string_view ckv_name) {
@@ -120,6 +175,55 @@ Key* ObjectLoader::Cache::StoreSecretKey(const kms_v1::CryptoKeyVersion& ckv) {
   return key;
 }
 
+Key* ObjectLoader::Cache::StoreDeferredKeyPair(
+    const kms_v1::CryptoKeyVersion& ckv) {
+  keys_[ckv.name()] = std::make_unique<Key>();
+  Key* key = keys_[ckv.name()].get();
+
+  *key->mutable_crypto_key_version() = ckv;
+  key->set_public_key_handle(NewHandle());
+  key->set_private_key_handle(NewHandle());
+  key->set_public_key_deferred(true);
+
+  return key;
+}
+
+absl::Status ObjectLoader::Cache::Restore(const ObjectStoreState& state) {
+  if (!keys_.empty()) {
+    return FailedPreconditionError("cannot restore into a non-empty cache",
+                                   CKR_GENERAL_ERROR, SOURCE_LOCATION);
+  }
+
+  absl::flat_hash_set<CK_OBJECT_HANDLE> handles;
+  absl::flat_hash_map<std::string, std::unique_ptr<Key>> keys;
+  for (const Key& key : state.keys()) {
+    for (uint64_t handle :
+         {key.public_key_handle(), key.private_key_handle(),
+          key.certificate().handle(), key.secret_key_handle()}) {
+      if (handle != CK_INVALID_HANDLE && !handles.insert(handle).second) {
+        return FailedPreconditionError(
+            absl::StrFormat("duplicate handle %#x", handle), CKR_GENERAL_ERROR,
+            SOURCE_LOCATION);
+      }
+    }
+    if (!keys.try_emplace(key.crypto_key_version().name(),
+                          std::make_unique<Key>(key))
+             .second) {
+      return FailedPreconditionError(
+          absl::StrCat("duplicate crypto key version ",
+                       key.crypto_key_version().name()),
+          CKR_GENERAL_ERROR, SOURCE_LOCATION);
+    }
+  }
+
+  allocated_handles_ = std::move(handles);
+  keys_ = std::move(keys);
+  for (const auto& [ckv_name, key] : keys_) {
+    unverified_.insert(ckv_name);
+  }
+  return absl::OkStatus();
+}
+
 void ObjectLoader::Cache::EvictUnused(const ObjectStoreState& state) {
   absl::flat_hash_set<std::string> items_to_retain;
   for (const Key& key : state.keys()) {
@@ -133,22 +237,41 @@ void ObjectLoader::Cache::EvictUnused(const ObjectStoreState& state) {
       continue;
     }
 
-    if (it->second->public_key_handle() != CK_INVALID_HANDLE) {
-      allocated_handles_.erase(it->second->public_key_handle());
-    }
-    if (it->second->private_key_handle() != CK_INVALID_HANDLE) {
-      allocated_handles_.erase(it->second->private_key_handle());
-    }
-    if (it->second->has_certificate()) {
-      allocated_handles_.erase(it->second->certificate().handle());
-    }
-    if (it->second->secret_key_handle() != CK_INVALID_HANDLE) {
-      allocated_handles_.erase(it->second->secret_key_handle());
-    }
+    ReleaseHandles(*it->second);
+    unverified_.erase(it->first);
     keys_.erase(it++);
   }
 }
 
+void ObjectLoader::Cache::MarkVerified(std::string_view ckv_name) {
+  unverified_.erase(ckv_name);
+}
+
+void ObjectLoader::Cache::Erase(std::string_view ckv_name) {
+  auto it = keys_.find(ckv_name);
+  if (it == keys_.end()) {
+    return;
+  }
+  ReleaseHandles(*it->second);
+  unverified_.erase(ckv_name);
+  keys_.erase(it);
+}
+
+void ObjectLoader::Cache::ReleaseHandles(const Key& key) {
+  if (key.public_key_handle() != CK_INVALID_HANDLE) {
+    allocated_handles_.erase(key.public_key_handle());
+  }
+  if (key.private_key_handle() != CK_INVALID_HANDLE) {
+    allocated_handles_.erase(key.private_key_handle());
+  }
+  if (key.has_certificate()) {
+    allocated_handles_.erase(key.certificate().handle());
+  }
+  if (key.secret_key_handle() != CK_INVALID_HANDLE) {
+    allocated_handles_.erase(key.secret_key_handle());
+  }
+}
+
 CK_OBJECT_HANDLE ObjectLoader::Cache::NewHandle() {
   CK_OBJECT_HANDLE handle;
   do {
@@ -160,7 +283,15 @@ CK_OBJECT_HANDLE ObjectLoader::Cache::NewHandle() {
 
 absl::StatusOr<std::unique_ptr<ObjectLoader>> ObjectLoader::New(
     std::string_view key_ring_name,
-    absl::Span<const std::string* const> pem_user_certs, bool generate_certs) {
+    absl::Span<const std::string* const> pem_user_certs, bool generate_certs,
+    size_t max_concurrent_requests, bool defer_public_keys,
+    bool latest_versions_only, std::string_view key_filter) {
+  if (defer_public_keys && (generate_certs || !pem_user_certs.empty())) {
+    return NewInvalidArgumentError(
+        "deferred public key loading cannot be combined with certificates",
+        CKR_GENERAL_ERROR, SOURCE_LOCATION);
+  }
+
   absl::flat_hash_map<std::string, std::string> user_certs;
   for (const std::string* const pem_cert : pem_user_certs) {
     ASSIGN_OR_RETURN(bssl::UniquePtr<X509> parsed_cert,
@@ -183,8 +314,16 @@ absl::StatusOr<std::unique_ptr<ObjectLoader>> ObjectLoader::New(
     ASSIGN_OR_RETURN(cert_authority, CertAuthority::New());
   }
 
-  return absl::WrapUnique(
-      new ObjectLoader(key_ring_name, user_certs, std::move(cert_authority)));
+  std::string list_keys_filter(kLoadableKeysFilter);
+  if (!key_filter.empty()) {
+    list_keys_filter =
+        absl::StrCat("(", key_filter, ") AND ", list_keys_filter);
+  }
+
+  return absl::WrapUnique(new ObjectLoader(
+      key_ring_name, user_certs, std::move(cert_authority),
+      max_concurrent_requests, defer_public_keys, latest_versions_only,
+      std::move(list_keys_filter)));
 }
 
 absl::StatusOr<ObjectStoreState> ObjectLoader::BuildState(
@@ -194,47 +333,121 @@ absl::StatusOr<ObjectStoreState> ObjectLoader::BuildState(
   // duration of BuildState seems like a pretty cheap way to guard against an
   // unintentional change that causes BuildState calls to overlap.
   absl::MutexLock lock(&cache_mutex_);
-  ObjectStoreState result;
 
   kms_v1::ListCryptoKeysRequest req;
   req.set_parent(key_ring_name_);
-  CryptoKeysRange keys = client.ListCryptoKeys(req);
+  req.set_filter(list_keys_filter_);
+  CryptoKeysRange keys_range = client.ListCryptoKeys(req);
 
-  for (CryptoKeysRange::iterator it = keys.begin(); it != keys.end(); it++) {
+  std::vector<kms_v1::CryptoKey> keys;
+  for (CryptoKeysRange::iterator it = keys_range.begin();
+       it != keys_range.end(); it++) {
     ASSIGN_OR_RETURN(kms_v1::CryptoKey key, *it);
-    if (!IsLoadable(key)) {
-      continue;
+    if (IsLoadable(key)) {
+      keys.push_back(std::move(key));
     }
+  }
 
-    kms_v1::ListCryptoKeyVersionsRequest req;
-    req.set_parent(key.name());
-    CryptoKeyVersionsRange v = client.ListCryptoKeyVersions(req);
+  // List the versions of each key concurrently. Results are stored by key
+  // index, so that the output order doesn't depend on the order in which
+  // requests complete.
+  std::vector<std::vector<kms_v1::CryptoKeyVersion>> versions(keys.size());
+  RETURN_IF_ERROR(workers_.ParallelFor(
+      keys.size(), max_concurrent_requests_, [&](size_t i) -> absl::Status {
+        kms_v1::ListCryptoKeyVersionsRequest versions_req;
+        versions_req.set_parent(keys[i].name());
+        versions_req.set_filter(std::string(kLoadableVersionsFilter));
+        CryptoKeyVersionsRange v = client.ListCryptoKeyVersions(versions_req);
+
+        for (CryptoKeyVersionsRange::iterator it = v.begin(); it != v.end();
+             it++) {
+          ASSIGN_OR_RETURN(kms_v1::CryptoKeyVersion ckv, *it);
+          if (IsLoadable(ckv)) {
+            versions[i].push_back(std::move(ckv));
+          }
+        }
 
-    for (CryptoKeyVersionsRange::iterator it = v.begin(); it != v.end(); it++) {
-      ASSIGN_OR_RETURN(kms_v1::CryptoKeyVersion ckv, *it);
-      if (!IsLoadable(ckv)) {
-        continue;
+        if (latest_versions_only_ && versions[i].size() > 1) {
+          auto latest = std::max_element(versions[i].begin(),
+                                         versions[i].end(), CreatedBefore);
+          versions[i] = {std::move(*latest)};
+        }
+        return absl::OkStatus();
+      }));
+
+  // Collect the asymmetric versions that aren't cached, or whose cached keys
+  // were restored and must be checked, and retrieve their public keys
+  // concurrently.
+  std::vector<const kms_v1::CryptoKeyVersion*> uncached_asymmetric;
+  for (size_t i = 0; i < keys.size() && !defer_public_keys_; i++) {
+    if (keys[i].purpose() == kms_v1::CryptoKey::MAC ||
+        keys[i].purpose() == kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT) {
+      continue;
+    }
+    for (const kms_v1::CryptoKeyVersion& ckv : versions[i]) {
+      if (!cache_.Get(ckv.name()) || cache_.IsUnverified(ckv.name())) {
+        uncached_asymmetric.push_back(&ckv);
       }
+    }
+  }
+
+  std::vector<bssl::UniquePtr<EVP_PKEY>> public_keys(
+      uncached_asymmetric.size());
+  RETURN_IF_ERROR(workers_.ParallelFor(
+      uncached_asymmetric.size(), max_concurrent_requests_,
+      [&](size_t i) -> absl::Status {
+        kms_v1::GetPublicKeyRequest pub_req;
+        pub_req.set_name(uncached_asymmetric[i]->name());
+
+        ASSIGN_OR_RETURN(kms_v1::PublicKey pub_resp,
+                         client.GetPublicKey(pub_req));
+        ASSIGN_OR_RETURN(public_keys[i], ParseX509PublicKeyPem(pub_resp.pem()));
+        return absl::OkStatus();
+      }));
 
+  // Assemble the result sequentially, in listing order. Handles for new keys
+  // are allocated here, and certificates are generated here, so that cache
+  // semantics are unchanged from a sequential load.
+  ObjectStoreState result;
+  result.set_latest_versions_only(latest_versions_only_);
+  result.set_list_keys_filter(list_keys_filter_);
+  size_t public_key_index = 0;
+  for (size_t i = 0; i < keys.size(); i++) {
+    const kms_v1::CryptoKey& key = keys[i];
+    bool is_secret_key =
+        key.purpose() == kms_v1::CryptoKey::MAC ||
+        key.purpose() == kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT;
+    for (const kms_v1::CryptoKeyVersion& ckv : versions[i]) {
       Key* cached_key = cache_.Get(ckv.name());
+      EVP_PKEY* pub = nullptr;
+      if (!is_secret_key && !defer_public_keys_ &&
+          (!cached_key || cache_.IsUnverified(ckv.name()))) {
+        pub = public_keys[public_key_index++].get();
+      }
+
+      if (cached_key && cache_.IsUnverified(ckv.name())) {
+        if (RestoredKeyMatches(*cached_key, ckv, pub)) {
+          cache_.MarkVerified(ckv.name());
+        } else {
+          LOG(WARNING) << "WARNING: version " << ckv.name()
+                       << " does not match its restored state, and is "
+                          "reloaded with new handles";
+          cache_.Erase(ckv.name());
+          cached_key = nullptr;
+        }
+      }
       if (cached_key) {
         *result.add_keys() = *cached_key;
         continue;
       }
 
-      if (key.purpose() == kms_v1::CryptoKey::MAC ||
-          key.purpose() == kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT) {
+      if (is_secret_key) {
         *result.add_keys() = *cache_.StoreSecretKey(ckv);
+      } else if (defer_public_keys_) {
+        *result.add_keys() = *cache_.StoreDeferredKeyPair(ckv);
       } else {
-        kms_v1::GetPublicKeyRequest pub_req;
-        pub_req.set_name(ckv.name());
-
-        ASSIGN_OR_RETURN(kms_v1::PublicKey pub_resp,
-                         client.GetPublicKey(pub_req));
-        ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> pub,
-                         ParseX509PublicKeyPem(pub_resp.pem()));
         ASSIGN_OR_RETURN(std::string public_key_der,
-                         MarshalX509PublicKeyDer(pub.get()));
+                         MarshalX509PublicKeyDer(pub));
 
         std::string cert_der;
         if (auto it = user_certs_.find(public_key_der);
@@ -242,7 +455,7 @@ absl::StatusOr<ObjectStoreState> ObjectLoader::BuildState(
           cert_der = it->second;
         } else if (cert_authority_) {
           ASSIGN_OR_RETURN(bssl::UniquePtr<X509> cert,
-                           cert_authority_->GenerateCert(ckv, pub.get()));
+                           cert_authority_->GenerateCert(ckv, pub));
           ASSIGN_OR_RETURN(cert_der, MarshalX509CertificateDer(cert.get()));
         }
 
@@ -269,4 +482,57 @@ absl::StatusOr<ObjectStoreState> ObjectLoader::BuildState(
   return result;
 }
 
+absl::Status ObjectLoader::RestoreState(const ObjectStoreState& state) {
+  if (state.latest_versions_only() != latest_versions_only_ ||
+      state.list_keys_filter() != list_keys_filter_) {
+    return FailedPreconditionError(
+        "the key selection of the state does not match the current "
+        "configuration",
+        CKR_GENERAL_ERROR, SOURCE_LOCATION);
+  }
+
+  std::string key_prefix = absl::StrCat(key_ring_name_, "/cryptoKeys/");
+  for (const Key& key : state.keys()) {
+    const std::string& ckv_name = key.crypto_key_version().name();
+    if (!absl::StartsWith(ckv_name, key_prefix)) {
+      return FailedPreconditionError(
+          absl::StrFormat("crypto key version %s is not in key ring %s",
+                          ckv_name, key_ring_name_),
+          CKR_GENERAL_ERROR, SOURCE_LOCATION);
+    }
+    if (key.secret_key_handle() != CK_INVALID_HANDLE) {
+      continue;
+    }
+    if (key.public_key_deferred() != defer_public_keys_) {
+      return FailedPreconditionError(
+          absl::StrFormat("the public key for crypto key version %s is %s, "
+                          "which does not match the current configuration",
+                          ckv_name,
+                          key.public_key_deferred() ? "deferred" : "loaded"),
+          CKR_GENERAL_ERROR, SOURCE_LOCATION);
+    }
+
+    // The certificate for each key must match what BuildState would have
+    // produced under the current configuration, since cached keys are not
+    // revisited.
+    bool cert_matches;
+    if (auto it = user_certs_.find(key.public_key_der());
+        it != user_certs_.end()) {
+      cert_matches = key.certificate().x509_der() == it->second;
+    } else {
+      cert_matches = key.has_certificate() == (cert_authority_ != nullptr);
+    }
+    if (!cert_matches) {
+      return FailedPreconditionError(
+          absl::StrFormat("the certificate for crypto key version %s does not "
+                          "match the current configuration",
+                          ckv_name),
+          CKR_GENERAL_ERROR, SOURCE_LOCATION);
+    }
+  }
+
+  absl::MutexLock lock(&cache_mutex_);
+  return cache_.Restore(state);
+}
+
 }  // namespace cloud_kms::kmsp11
@@ -22,6 +22,7 @@
 #include "absl/status/statusor.h"
 #include "absl/synchronization/mutex.h"
 #include "common/kms_client.h"
+#include "common/parallel_for.h"
 #include "kmsp11/cert_authority.h"
 #include "kmsp11/cryptoki.h"
 #include "kmsp11/object_store_state.pb.h"
@@ -30,26 +31,61 @@ namespace cloud_kms::kmsp11 {
 
 class ObjectLoader {
  public:
+  // `max_concurrent_requests` bounds the number of Cloud KMS requests that
+  // BuildState may have in flight at once. If `defer_public_keys` is true,
+  // BuildState doesn't retrieve public keys, and emits asymmetric keys with
+  // `public_key_deferred` set; this can't be combined with certificates. If
+  // `latest_versions_only` is true, BuildState emits only the most recently
+  // created loadable version of each key. A non-empty `key_filter` is a Cloud
+  // KMS list filter that further restricts the keys that are loaded.
   static absl::StatusOr<std::unique_ptr<ObjectLoader>> New(
       std::string_view key_ring_name,
-      absl::Span<const std::string* const> pem_user_certs, bool generate_certs);
+      absl::Span<const std::string* const> pem_user_certs, bool generate_certs,
+      size_t max_concurrent_requests = 1, bool defer_public_keys = false,
+      bool latest_versions_only = false, std::string_view key_filter = "");
 
   inline std::string_view key_ring_name() const { return key_ring_name_; }
 
   absl::StatusOr<ObjectStoreState> BuildState(const KmsClient& client);
 
+  // Seeds the loader with a state that was built previously, for example by
+  // another instance of the library, so that subsequent calls to BuildState
+  // retain its handles. Returns FailedPrecondition if the state is not
+  // consistent with this loader's key ring, key selection and certificate
+  // configuration, or if the loader already holds keys.
+  //
+  // The restored keys are not trusted: the next call to BuildState checks each
+  // of them against Cloud KMS, and replaces any whose version metadata, public
+  // key or certificate do not match with a freshly loaded key.
+  absl::Status RestoreState(const ObjectStoreState& state);
+
  private:
   ObjectLoader(std::string_view key_ring_name,
                absl::flat_hash_map<std::string, std::string> user_certs,
-               std::unique_ptr<CertAuthority> cert_authority)
+               std::unique_ptr<CertAuthority> cert_authority,
+               size_t max_concurrent_requests, bool defer_public_keys,
+               bool latest_versions_only, std::string list_keys_filter)
       : key_ring_name_(key_ring_name),
         user_certs_(user_certs),
-        cert_authority_(std::move(cert_authority)) {}
+        cert_authority_(std::move(cert_authority)),
+        max_concurrent_requests_(max_concurrent_requests),
+        workers_(max_concurrent_requests > 1 ? max_concurrent_requests - 1 : 0),
+        defer_public_keys_(defer_public_keys),
+        latest_versions_only_(latest_versions_only),
+        list_keys_filter_(std::move(list_keys_filter)) {}
 
   std::string key_ring_name_;
   // map from SPKI DER to user-provided certificate DER
   absl::flat_hash_map<std::string, std::string> user_certs_;
   std::unique_ptr<CertAuthority> cert_authority_;
+  size_t max_concurrent_requests_;
+  // Runs BuildState's concurrent requests alongside the calling thread. The
+  // threads are kept for the life of the loader, rather than being started on
+  // each refresh.
+  WorkerPool workers_;
+  bool defer_public_keys_;
+  bool latest_versions_only_;
+  std::string list_keys_filter_;
 
   class Cache {
    public:
@@ -58,13 +94,26 @@ class ObjectLoader {
                std::string_view public_key_der,
                std::string_view certificate_der);
     Key* StoreSecretKey(const kms_v1::CryptoKeyVersion& ckv);
+    Key* StoreDeferredKeyPair(const kms_v1::CryptoKeyVersion& ckv);
+    absl::Status Restore(const ObjectStoreState& state);
     void EvictUnused(const ObjectStoreState& state);
 
+    // Whether the key for `ckv_name` was restored and has not yet been checked
+    // against Cloud KMS.
+    bool IsUnverified(std::string_view ckv_name) const {
+      return unverified_.contains(ckv_name);
+    }
+    void MarkVerified(std::string_view ckv_name);
+    // Removes the key for `ckv_name` and releases its handles.
+    void Erase(std::string_view ckv_name);
+
    private:
     CK_OBJECT_HANDLE NewHandle();
+    void ReleaseHandles(const Key& key);
 
     absl::flat_hash_set<CK_OBJECT_HANDLE> allocated_handles_;
     absl::flat_hash_map<std::string, std::unique_ptr<Key>> keys_;
+    absl::flat_hash_set<std::string> unverified_;
   };
 
   absl::Mutex cache_mutex_;
@@ -17,6 +17,7 @@
 #include "common/test/runfiles.h"
 #include "common/test/test_status_macros.h"
 #include "fakekms/cpp/fakekms.h"
+#include "fakekms/cpp/fault_helpers.h"
 #include "gmock/gmock.h"
 #include "kmsp11/test/matchers.h"
 #include "kmsp11/test/resource_helpers.h"
@@ -280,6 +281,225 @@ TEST_F(BuildStateTest, PreviouslyRetrievedStateIsUnchangedAfterElementIsAdded) {
                            EqualsProto(ckv2))));
 }
 
+TEST_F(BuildStateTest, ConcurrentLoadMatchesSequentialLoad) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> sequential_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, false));
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> concurrent_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, false, 8));
+
+  std::vector<kms_v1::CryptoKeyVersion> ckvs;
+  for (int i = 0; i < 12; i++) {
+    ckvs.push_back(AddKeyAndInitialVersion(
+        absl::StrCat("ck", i), kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+        kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256));
+  }
+  ckvs.push_back(AddKeyAndInitialVersion(
+      "mac", kms_v1::CryptoKey::MAC, kms_v1::CryptoKeyVersion::HMAC_SHA256));
+
+  ASSERT_OK_AND_ASSIGN(ObjectStoreState sequential_state,
+                       sequential_loader->BuildState(*client_));
+  ASSERT_OK_AND_ASSIGN(ObjectStoreState concurrent_state,
+                       concurrent_loader->BuildState(*client_));
+
+  EXPECT_THAT(concurrent_state, EqualsProto(sequential_state));
+  ASSERT_EQ(concurrent_state.keys_size(), ckvs.size());
+  for (int i = 0; i < concurrent_state.keys_size(); i++) {
+    EXPECT_THAT(concurrent_state.keys(i).crypto_key_version(),
+                EqualsProto(ckvs[i]));
+  }
+}
+
+TEST_F(BuildStateTest, ConcurrentLoadReturnsError) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> loader_,
+                       ObjectLoader::New(key_ring_.name(), {}, false, 8));
+  for (int i = 0; i < 4; i++) {
+    AddKeyAndInitialVersion(absl::StrCat("ck", i),
+                            kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                            kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  }
+  fakekms::AddErrorOrDie(*fake_server_, absl::PermissionDeniedError("denied"),
+                         "GetPublicKey");
+
+  EXPECT_THAT(loader_->BuildState(*client_),
+              StatusIs(absl::StatusCode::kPermissionDenied));
+}
+
+TEST_F(BuildStateTest, RestoredStateIsRetainedAfterBuild) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> original_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, true));
+  AddKeyAndInitialVersion("ck", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                          kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  ASSERT_OK_AND_ASSIGN(ObjectStoreState original_state,
+                       original_loader->BuildState(*client_));
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> restored_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, true));
+  ASSERT_OK(restored_loader->RestoreState(original_state));
+
+  EXPECT_THAT(restored_loader->BuildState(*client_),
+              IsOkAndHolds(EqualsProto(original_state)));
+}
+
+TEST_F(BuildStateTest, RestoreStateFailsForOtherKeyRing) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> original_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, false));
+  AddKeyAndInitialVersion("ck", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                          kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  ASSERT_OK_AND_ASSIGN(ObjectStoreState state,
+                       original_loader->BuildState(*client_));
+
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ObjectLoader> loader_,
+      ObjectLoader::New(absl::StrCat(key_ring_.name(), "-other"), {}, false));
+  EXPECT_THAT(loader_->RestoreState(state),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST_F(BuildStateTest, RestoreStateFailsWhenCertConfigDiffers) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> original_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, false));
+  AddKeyAndInitialVersion("ck", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                          kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  ASSERT_OK_AND_ASSIGN(ObjectStoreState state,
+                       original_loader->BuildState(*client_));
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> loader_,
+                       ObjectLoader::New(key_ring_.name(), {}, true));
+  EXPECT_THAT(loader_->RestoreState(state),
+              StatusIs(absl::StatusCode::kFailedPrecondition,
+                       HasSubstr("does not match the current configuration")));
+}
+
+TEST_F(BuildStateTest, RestoreStateFailsWhenKeySelectionDiffers) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> original_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, false));
+  AddKeyAndInitialVersion("ck", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                          kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  ASSERT_OK_AND_ASSIGN(ObjectStoreState state,
+                       original_loader->BuildState(*client_));
+
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ObjectLoader> latest_loader,
+      ObjectLoader::New(key_ring_.name(), {}, false, 1, false, true));
+  EXPECT_THAT(latest_loader->RestoreState(state),
+              StatusIs(absl::StatusCode::kFailedPrecondition,
+                       HasSubstr("does not match the current configuration")));
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> filtered_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, false, 1, false,
+                                         false, "labels.env=prod"));
+  EXPECT_THAT(filtered_loader->RestoreState(state),
+              StatusIs(absl::StatusCode::kFailedPrecondition,
+                       HasSubstr("does not match the current configuration")));
+}
+
+TEST_F(BuildStateTest, RestoredKeyWithAlteredPublicKeyIsReloaded) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> original_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, false));
+  AddKeyAndInitialVersion("ck1", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                          kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  AddKeyAndInitialVersion("ck2", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                          kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  ASSERT_OK_AND_ASSIGN(ObjectStoreState original_state,
+                       original_loader->BuildState(*client_));
+  ASSERT_EQ(original_state.keys_size(), 2);
+
+  // Substitute the second key's public key for the first's.
+  ObjectStoreState altered_state = original_state;
+  altered_state.mutable_keys(0)->set_public_key_der(
+      original_state.keys(1).public_key_der());
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> restored_loader,
+                       ObjectLoader::New(key_ring_.name(), {}, false));
+  ASSERT_OK(restored_loader->RestoreState(altered_state));
+  ASSERT_OK_AND_ASSIGN(ObjectStoreState state,
+                       restored_loader->BuildState(*client_));
+
+  ASSERT_EQ(state.keys_size(), 2);
+  EXPECT_EQ(state.keys(0).public_key_der(),
+            original_state.keys(0).public_key_der());
+  EXPECT_NE(state.keys(0).public_key_handle(),
+            altered_state.keys(0).public_key_handle());
+  EXPECT_NE(state.keys(0).private_key_handle(),
+            altered_state.keys(0).private_key_handle());
+  // The unaltered key is retained as it was restored.
+  EXPECT_THAT(state.keys(1), EqualsProto(original_state.keys(1)));
+}
+
+TEST_F(BuildStateTest, DeferredPublicKeyIsNotRetrieved) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> loader_,
+                       ObjectLoader::New(key_ring_.name(), {}, false, 1, true));
+  AddKeyAndInitialVersion("ck", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                          kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  fakekms::AddErrorOrDie(*fake_server_, absl::PermissionDeniedError("denied"),
+                         "GetPublicKey");
+
+  ASSERT_OK_AND_ASSIGN(ObjectStoreState state, loader_->BuildState(*client_));
+  ASSERT_EQ(state.keys_size(), 1);
+
+  EXPECT_TRUE(state.keys(0).public_key_deferred());
+  EXPECT_THAT(state.keys(0).public_key_der(), IsEmpty());
+  EXPECT_GT(state.keys(0).public_key_handle(), 0);
+  EXPECT_GT(state.keys(0).private_key_handle(), 0);
+}
+
+TEST_F(BuildStateTest, DeferredPublicKeysWithCertsIsInvalid) {
+  EXPECT_THAT(ObjectLoader::New(key_ring_.name(), {}, true, 1, true),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(BuildStateTest, LatestVersionsOnlyEmitsNewestLoadableVersion) {
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ObjectLoader> loader_,
+      ObjectLoader::New(key_ring_.name(), {}, false, 1, false, true));
+  kms_v1::CryptoKeyVersion ckv1 =
+      AddKeyAndInitialVersion("ck", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                              kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  kms_v1::CryptoKeyVersion ckv2;
+  ckv2 = CreateCryptoKeyVersionOrDie(
+      kms_stub_.get(), absl::StrCat(key_ring_.name(), "/cryptoKeys/ck"), ckv2);
+  ckv2 = WaitForEnablement(kms_stub_.get(), ckv2);
+
+  EXPECT_THAT(loader_->BuildState(*client_),
+              IsOkAndHolds(Property(
+                  "keys", &ObjectStoreState::keys,
+                  ElementsAre(Property("crypto_key_version",
+                                       &Key::crypto_key_version,
+                                       EqualsProto(ckv2))))));
+
+  // Once the newest version is disabled, the previous one is emitted instead.
+  ckv2.set_state(kms_v1::CryptoKeyVersion::DISABLED);
+  google::protobuf::FieldMask update_mask;
+  update_mask.add_paths("state");
+  ckv2 = UpdateCryptoKeyVersionOrDie(kms_stub_.get(), ckv2, update_mask);
+
+  EXPECT_THAT(loader_->BuildState(*client_),
+              IsOkAndHolds(Property(
+                  "keys", &ObjectStoreState::keys,
+                  ElementsAre(Property("crypto_key_version",
+                                       &Key::crypto_key_version,
+                                       EqualsProto(ckv1))))));
+}
+
+TEST_F(BuildStateTest, KeyFilterRestrictsLoadedKeys) {
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ObjectLoader> loader_,
+      ObjectLoader::New(key_ring_.name(), {}, false, 1, false, false,
+                        "name:cryptoKeys/prod-"));
+  kms_v1::CryptoKeyVersion prod_ckv =
+      AddKeyAndInitialVersion("prod-ck", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                              kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  AddKeyAndInitialVersion("dev-ck", kms_v1::CryptoKey::ASYMMETRIC_SIGN,
+                          kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+
+  EXPECT_THAT(loader_->BuildState(*client_),
+              IsOkAndHolds(Property(
+                  "keys", &ObjectStoreState::keys,
+                  ElementsAre(Property("crypto_key_version",
+                                       &Key::crypto_key_version,
+                                       EqualsProto(prod_ckv))))));
+}
+
 TEST_F(BuildStateTest, KeyWithPurposeEncryptDecryptIsOmitted) {
   ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectLoader> loader_,
                        ObjectLoader::New(key_ring_.name(), {}, true));
@@ -14,6 +14,9 @@
 
 #include "kmsp11/object_store.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include "common/status_macros.h"
 #include "kmsp11/util/crypto_utils.h"
 #include "kmsp11/util/errors.h"
@@ -30,55 +33,93 @@ static_assert(
 
 using ObjectStoreEntry = ObjectStoreMap::value_type;
 
+// Returns the object with the provided handle in `previous`, if there is one
+// and it refers to the same CryptoKeyVersion and object class, and has the
+// same deferral state. Returns nullptr otherwise.
+std::shared_ptr<Object> FindReusable(const ObjectStoreMap* previous,
+                                     uint64_t handle, std::string_view ckv_name,
+                                     CK_OBJECT_CLASS object_class,
+                                     bool public_key_deferred = false) {
+  if (!previous) {
+    return nullptr;
+  }
+  ObjectStoreMap::const_iterator it = previous->find(handle);
+  if (it == previous->end() || it->second->kms_key_name() != ckv_name ||
+      it->second->object_class() != object_class ||
+      it->second->public_key_deferred() != public_key_deferred) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+absl::StatusOr<KeyPair> NewKeyPairForItem(const Key& item) {
+  if (item.public_key_deferred()) {
+    return Object::NewDeferredKeyPair(item.crypto_key_version());
+  }
+  ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> public_key,
+                   ParseX509PublicKeyDer(item.public_key_der()));
+  return Object::NewKeyPair(item.crypto_key_version(), public_key.get());
+}
+
 absl::StatusOr<std::vector<ObjectStoreEntry>> ParseStoreEntries(
-    const ObjectStoreState& state) {
+    const ObjectStoreState& state, const ObjectStoreMap* previous) {
   std::vector<ObjectStoreEntry> entries;
   for (const Key& item : state.keys()) {
+    const std::string& ckv_name = item.crypto_key_version().name();
     if (item.secret_key_handle() == 0 && item.private_key_handle() == 0) {
       return absl::InvalidArgumentError(
           "both secret_key_handle and private_key_handle are unset, cannot "
           "determine if key is symmetric or asymmetric");
     }
     if (item.secret_key_handle() != 0) {
-      ASSIGN_OR_RETURN(Object key,
-                       Object::NewSecretKey(item.crypto_key_version()));
+      std::shared_ptr<Object> key = FindReusable(
+          previous, item.secret_key_handle(), ckv_name, CKO_SECRET_KEY);
+      if (!key) {
+        ASSIGN_OR_RETURN(Object new_key,
+                         Object::NewSecretKey(item.crypto_key_version()));
+        key = std::make_shared<Object>(std::move(new_key));
+      }
 
-      entries.emplace_back(item.secret_key_handle(),
-                           std::make_shared<Object>(std::move(key)));
+      entries.emplace_back(item.secret_key_handle(), std::move(key));
       continue;
     }
-    ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> public_key,
-                     ParseX509PublicKeyDer(item.public_key_der()));
-    ASSIGN_OR_RETURN(
-        KeyPair keypair,
-        Object::NewKeyPair(item.crypto_key_version(), public_key.get()));
 
     if (item.public_key_handle() == 0) {
       return absl::InvalidArgumentError("public_key_handle is unset");
     }
-    entries.emplace_back(
-        item.public_key_handle(),
-        std::make_shared<Object>(std::move(keypair.public_key)));
-
     if (item.private_key_handle() == 0) {
       return absl::InvalidArgumentError("private_key_handle is unset");
     }
-    entries.emplace_back(
-        item.private_key_handle(),
-        std::make_shared<Object>(std::move(keypair.private_key)));
+    std::shared_ptr<Object> public_key =
+        FindReusable(previous, item.public_key_handle(), ckv_name,
+                     CKO_PUBLIC_KEY, item.public_key_deferred());
+    std::shared_ptr<Object> private_key =
+        FindReusable(previous, item.private_key_handle(), ckv_name,
+                     CKO_PRIVATE_KEY, item.public_key_deferred());
+    if (!public_key || !private_key) {
+      ASSIGN_OR_RETURN(KeyPair keypair, NewKeyPairForItem(item));
+      public_key = std::make_shared<Object>(std::move(keypair.public_key));
+      private_key = std::make_shared<Object>(std::move(keypair.private_key));
+    }
+    entries.emplace_back(item.public_key_handle(), std::move(public_key));
+    entries.emplace_back(item.private_key_handle(), std::move(private_key));
 
     if (item.has_certificate()) {
       if (item.certificate().handle() == 0) {
         return absl::InvalidArgumentError("certificate_handle is unset");
       }
-      ASSIGN_OR_RETURN(
-          bssl::UniquePtr<X509> x509,
-          ParseX509CertificateDer(item.certificate().x509_der()));
-      ASSIGN_OR_RETURN(
-          Object cert,
-          Object::NewCertificate(item.crypto_key_version(), x509.get()));
-      entries.emplace_back(item.certificate().handle(),
-                           std::make_shared<Object>(std::move(cert)));
+      std::shared_ptr<Object> cert = FindReusable(
+          previous, item.certificate().handle(), ckv_name, CKO_CERTIFICATE);
+      if (!cert) {
+        ASSIGN_OR_RETURN(
+            bssl::UniquePtr<X509> x509,
+            ParseX509CertificateDer(item.certificate().x509_der()));
+        ASSIGN_OR_RETURN(
+            Object new_cert,
+            Object::NewCertificate(item.crypto_key_version(), x509.get()));
+        cert = std::make_shared<Object>(std::move(new_cert));
+      }
+      entries.emplace_back(item.certificate().handle(), std::move(cert));
     }
   }
   return entries;
@@ -94,12 +135,38 @@ bool EntryCompare(const ObjectStoreEntry& e1, const ObjectStoreEntry& e2) {
   return name_cmp < 0;
 }
 
+// The attributes that are indexed for Find. These are the attributes that
+// applications most commonly use to locate objects.
+constexpr CK_ATTRIBUTE_TYPE kIndexedAttributes[] = {CKA_CLASS, CKA_LABEL,
+                                                    CKA_ID, CKA_KEY_TYPE};
+
 }  // namespace
 
+ObjectStore::ObjectStore(ObjectStoreMap entries)
+    : entries_(std::move(entries)) {
+  std::vector<std::reference_wrapper<const ObjectStoreEntry>> sorted(
+      entries_.begin(), entries_.end());
+  std::sort(sorted.begin(), sorted.end(), &EntryCompare);
+
+  sorted_entries_.reserve(sorted.size());
+  for (const ObjectStoreEntry& entry : sorted) {
+    size_t position = sorted_entries_.size();
+    sorted_entries_.emplace_back(entry.first, entry.second.get());
+
+    for (CK_ATTRIBUTE_TYPE type : kIndexedAttributes) {
+      absl::StatusOr<std::string_view> value =
+          entry.second->attributes().ProbeValue(type);
+      if (value.ok()) {
+        indexes_[type][std::string(*value)].push_back(position);
+      }
+    }
+  }
+}
+
 absl::StatusOr<std::unique_ptr<ObjectStore>> ObjectStore::New(
-    const ObjectStoreState& state) {
+    const ObjectStoreState& state, const ObjectStore* previous) {
   absl::StatusOr<std::vector<ObjectStoreEntry>> entries =
-      ParseStoreEntries(state);
+      ParseStoreEntries(state, previous ? &previous->entries_ : nullptr);
   if (!entries.ok()) {
     return NewInvalidArgumentError(
         absl::StrCat("failure building ObjectStore: ",
@@ -151,18 +218,55 @@ absl::StatusOr<std::shared_ptr<Object>> ObjectStore::GetKey(
 
 std::vector<CK_OBJECT_HANDLE> ObjectStore::Find(
     std::function<bool(const Object&)> predicate) const {
-  std::vector<std::reference_wrapper<const ObjectStoreEntry>> matches;
-  for (const ObjectStoreEntry& entry : entries_) {
-    if (predicate(*entry.second)) {
-      matches.push_back(entry);
+  std::vector<CK_OBJECT_HANDLE> handles;
+  for (const auto& [handle, object] : sorted_entries_) {
+    if (predicate(*object)) {
+      handles.push_back(handle);
+    }
+  }
+  return handles;
+}
+
+std::vector<CK_OBJECT_HANDLE> ObjectStore::Find(
+    absl::Span<const CK_ATTRIBUTE> attributes,
+    std::function<bool(const Object&)> predicate) const {
+  // Intersect the index entries for each indexed attribute in the template.
+  std::optional<std::vector<size_t>> candidates;
+  for (const CK_ATTRIBUTE& attr : attributes) {
+    auto index = indexes_.find(attr.type);
+    if (index == indexes_.end()) {
+      continue;
+    }
+    auto it = index->second.find(std::string_view(
+        static_cast<const char*>(attr.pValue), attr.ulValueLen));
+    if (it == index->second.end()) {
+      return {};
+    }
+
+    if (!candidates.has_value()) {
+      candidates = it->second;
+    } else {
+      std::vector<size_t> intersection;
+      std::set_intersection(candidates->begin(), candidates->end(),
+                            it->second.begin(), it->second.end(),
+                            std::back_inserter(intersection));
+      candidates = std::move(intersection);
+    }
+    if (candidates->empty()) {
+      return {};
     }
   }
 
-  std::sort(matches.begin(), matches.end(), &EntryCompare);
+  if (!candidates.has_value()) {
+    return Find(predicate);
+  }
 
-  std::vector<CK_OBJECT_HANDLE> handles(matches.size());
-  for (size_t i = 0; i < matches.size(); i++) {
-    handles[i] = matches[i].get().first;
+  std::vector<CK_OBJECT_HANDLE> handles;
+  for (size_t position : *candidates) {
+    const auto& [handle, object] = sorted_entries_[position];
+    if (predicate(*object)) {
+      handles.push_back(handle);
+    }
   }
   return handles;
 }
@@ -19,6 +19,7 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "kmsp11/cryptoki.h"
 #include "kmsp11/object.h"
 #include "kmsp11/object_store_state.pb.h"
@@ -30,9 +31,12 @@ using ObjectStoreMap =
 
 class ObjectStore {
  public:
-  // Create a new ObjectStore with the provided state.
+  // Create a new ObjectStore with the provided state. If `previous` is
+  // provided, objects in `previous` that have the same handle, CryptoKeyVersion
+  // and object class as an item in `state` are shared with the new store
+  // rather than being parsed again.
   static absl::StatusOr<std::unique_ptr<ObjectStore>> New(
-      const ObjectStoreState& state);
+      const ObjectStoreState& state, const ObjectStore* previous = nullptr);
 
   // GetObject retrieves the object with the provided handle, or returns
   // CKR_OBJECT_HANDLE_INVALID if the handle is not valid.
@@ -49,6 +53,14 @@ class ObjectStore {
   std::vector<CK_OBJECT_HANDLE> Find(
       std::function<bool(const Object&)> predicate) const;
 
+  // Like Find(predicate), but the predicate is only evaluated for objects
+  // that contain every indexed attribute in `attributes` (CKA_CLASS,
+  // CKA_LABEL, CKA_ID and CKA_KEY_TYPE). The predicate must still check the
+  // remaining attributes.
+  std::vector<CK_OBJECT_HANDLE> Find(
+      absl::Span<const CK_ATTRIBUTE> attributes,
+      std::function<bool(const Object&)> predicate) const;
+
   // FindSingle retrieves the object that matches the provided predicate, or
   // NotFound if no such object exists, or PreconditionFailed if multiple
   // matching objects exist.
@@ -56,9 +68,16 @@ class ObjectStore {
       std::function<bool(const Object&)> predicate) const;
 
  private:
-  ObjectStore(ObjectStoreMap entries) : entries_(entries) {}
+  // Maps an attribute value to the positions in sorted_entries_ of the objects
+  // that have that value. Positions are in ascending order.
+  using AttributeIndex = absl::flat_hash_map<std::string, std::vector<size_t>>;
+
+  ObjectStore(ObjectStoreMap entries);
 
   const ObjectStoreMap entries_;
+  // The objects in entries_, sorted by KMS key name and then object class.
+  std::vector<std::pair<CK_OBJECT_HANDLE, const Object*>> sorted_entries_;
+  absl::flat_hash_map<CK_ATTRIBUTE_TYPE, AttributeIndex> indexes_;
 };
 
 }  // namespace cloud_kms::kmsp11
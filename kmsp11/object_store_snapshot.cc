@@ -0,0 +1,92 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kmsp11/object_store_snapshot.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "absl/random/random.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_replace.h"
+#include "kmsp11/util/errors.h"
+
+namespace cloud_kms::kmsp11 {
+
+std::string SnapshotPath(std::string_view directory,
+                         std::string_view key_ring_name) {
+  // Key ring names only contain [a-zA-Z0-9_-] and '/' separators.
+  std::string file_name =
+      absl::StrCat(absl::StrReplaceAll(key_ring_name, {{"/", "_"}}), ".pb");
+  return (std::filesystem::path(directory) / file_name).string();
+}
+
+absl::StatusOr<ObjectStoreState> ReadSnapshot(const std::string& path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  if (in.fail()) {
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+      return NewError(absl::StatusCode::kNotFound,
+                      absl::StrCat("no snapshot exists at ", path),
+                      CKR_GENERAL_ERROR, SOURCE_LOCATION);
+    }
+    return FailedPreconditionError(
+        absl::StrCat("failed to open snapshot at ", path), CKR_GENERAL_ERROR,
+        SOURCE_LOCATION);
+  }
+
+  ObjectStoreState state;
+  if (!state.ParseFromIstream(&in)) {
+    return NewInvalidArgumentError(
+        absl::StrCat("failed to parse snapshot at ", path), CKR_GENERAL_ERROR,
+        SOURCE_LOCATION);
+  }
+  return state;
+}
+
+absl::Status WriteSnapshot(const std::string& path,
+                           const ObjectStoreState& state) {
+  // Write to a uniquely named file in the same directory, and then rename it
+  // over the destination, so that concurrent writers and readers never
+  // observe a partially written snapshot.
+  absl::BitGen gen;
+  std::string temp_path =
+      absl::StrFormat("%s.%016x.tmp", path, absl::Uniform<uint64_t>(gen));
+
+  std::error_code ec;
+  std::ofstream out(temp_path,
+                    std::ios::out | std::ios::binary | std::ios::trunc);
+  bool written = !out.fail() && state.SerializeToOstream(&out);
+  out.close();
+  if (!written || out.fail()) {
+    std::filesystem::remove(temp_path, ec);
+    return FailedPreconditionError(
+        absl::StrCat("failed to write snapshot to ", temp_path),
+        CKR_GENERAL_ERROR, SOURCE_LOCATION);
+  }
+
+  std::filesystem::rename(temp_path, path, ec);
+  if (ec) {
+    std::error_code remove_ec;
+    std::filesystem::remove(temp_path, remove_ec);
+    return FailedPreconditionError(
+        absl::StrFormat("failed to replace snapshot at %s: %s", path,
+                        ec.message()),
+        CKR_GENERAL_ERROR, SOURCE_LOCATION);
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace cloud_kms::kmsp11
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMSP11_OBJECT_STORE_SNAPSHOT_H_
+#define KMSP11_OBJECT_STORE_SNAPSHOT_H_
+
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "kmsp11/object_store_state.pb.h"
+
+namespace cloud_kms::kmsp11 {
+
+// Snapshots persist the ObjectStoreState of a key ring across library
+// instances, so that a newly initialized library can serve a key ring's
+// contents before it has finished listing them in Cloud KMS.
+
+// Returns the path of the snapshot file for `key_ring_name` within
+// `directory`.
+std::string SnapshotPath(std::string_view directory,
+                         std::string_view key_ring_name);
+
+// Reads the snapshot at `path`. Returns NotFound if there is no snapshot at
+// `path`, and InvalidArgument if the snapshot could not be parsed.
+absl::StatusOr<ObjectStoreState> ReadSnapshot(const std::string& path);
+
+// Replaces the snapshot at `path` with `state`. Readers in this or other
+// processes observe either the previous snapshot or the new one, and never a
+// partially written file.
+absl::Status WriteSnapshot(const std::string& path,
+                           const ObjectStoreState& state);
+
+}  // namespace cloud_kms::kmsp11
+
+#endif  // KMSP11_OBJECT_STORE_SNAPSHOT_H_
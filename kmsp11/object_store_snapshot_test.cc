@@ -0,0 +1,113 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kmsp11/object_store_snapshot.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "common/test/test_status_macros.h"
+#include "gmock/gmock.h"
+#include "kmsp11/test/matchers.h"
+#include "kmsp11/test/resource_helpers.h"
+
+namespace cloud_kms::kmsp11 {
+namespace {
+
+using ::testing::EndsWith;
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+class SnapshotTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ = std::filesystem::path(testing::TempDir()) / RandomId();
+    ASSERT_TRUE(std::filesystem::create_directories(directory_));
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  std::string Path(std::string_view file_name) {
+    return (directory_ / file_name).string();
+  }
+
+  std::filesystem::path directory_;
+};
+
+ObjectStoreState NewState() {
+  ObjectStoreState state;
+  Key* key = state.add_keys();
+  key->mutable_crypto_key_version()->set_name(
+      "projects/foo/locations/bar/keyRings/baz/cryptoKeys/qux/"
+      "cryptoKeyVersions/1");
+  key->set_public_key_der("public key");
+  key->set_public_key_handle(1001);
+  key->set_private_key_handle(1002);
+  return state;
+}
+
+TEST_F(SnapshotTest, PathIsInDirectory) {
+  std::string path = SnapshotPath(directory_.string(),
+                                  "projects/foo/locations/bar/keyRings/baz");
+
+  EXPECT_EQ(std::filesystem::path(path).parent_path(), directory_);
+  EXPECT_THAT(path, EndsWith("projects_foo_locations_bar_keyRings_baz.pb"));
+}
+
+TEST_F(SnapshotTest, WrittenSnapshotCanBeRead) {
+  ObjectStoreState state = NewState();
+  ASSERT_OK(WriteSnapshot(Path("snapshot.pb"), state));
+
+  EXPECT_THAT(ReadSnapshot(Path("snapshot.pb")),
+              IsOkAndHolds(EqualsProto(state)));
+}
+
+TEST_F(SnapshotTest, WriteReplacesExistingSnapshot) {
+  ASSERT_OK(WriteSnapshot(Path("snapshot.pb"), NewState()));
+  ASSERT_OK(WriteSnapshot(Path("snapshot.pb"), ObjectStoreState()));
+
+  EXPECT_THAT(ReadSnapshot(Path("snapshot.pb")),
+              IsOkAndHolds(EqualsProto(ObjectStoreState())));
+}
+
+TEST_F(SnapshotTest, WriteLeavesNoTemporaryFiles) {
+  ASSERT_OK(WriteSnapshot(Path("snapshot.pb"), NewState()));
+
+  std::vector<std::string> file_names;
+  for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+    file_names.push_back(entry.path().filename().string());
+  }
+  EXPECT_THAT(file_names, testing::ElementsAre("snapshot.pb"));
+}
+
+TEST_F(SnapshotTest, WriteToMissingDirectoryFails) {
+  EXPECT_THAT(WriteSnapshot(Path("missing/snapshot.pb"), NewState()),
+              Not(IsOk()));
+}
+
+TEST_F(SnapshotTest, ReadMissingSnapshotReturnsNotFound) {
+  EXPECT_THAT(ReadSnapshot(Path("snapshot.pb")),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(SnapshotTest, ReadCorruptSnapshotReturnsInvalidArgument) {
+  std::ofstream(Path("snapshot.pb"), std::ios::binary) << "\xff\xff\xff";
+
+  EXPECT_THAT(ReadSnapshot(Path("snapshot.pb")),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("failed to parse snapshot")));
+}
+
+}  // namespace
+}  // namespace cloud_kms::kmsp11
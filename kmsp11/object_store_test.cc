@@ -201,6 +201,18 @@ TEST(ObjectStoreTest, NewStoreFailsInvalidPublicKey) {
                                             HasSubstr("error parsing DER")));
 }
 
+TEST(ObjectStoreTest, NewStoreSuccessWithDeferredPublicKey) {
+  ObjectStoreState s;
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricRsaKey());
+
+  s.mutable_keys(0)->clear_public_key_der();
+  s.mutable_keys(0)->set_public_key_deferred(true);
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> store, ObjectStore::New(s));
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<Object> key, store->GetKey(1002));
+  EXPECT_TRUE(key->public_key_deferred());
+}
+
 TEST(ObjectStoreTest, NewStoreFailsMissingPublicKeyHandle) {
   ObjectStoreState s;
   ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricRsaKey());
@@ -294,6 +306,58 @@ TEST(ObjectStoreTest, NewStoreFailsHandleCollision) {
                        HasSubstr("duplicate handle detected")));
 }
 
+TEST(ObjectStoreTest, NewStoreWithPreviousReusesUnchangedObjects) {
+  ObjectStoreState s;
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricEcKeyAndCert());
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> previous,
+                       ObjectStore::New(s));
+
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricRsaKey());
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> store,
+                       ObjectStore::New(s, previous.get()));
+
+  for (CK_OBJECT_HANDLE handle :
+       {s.keys(0).public_key_handle(), s.keys(0).private_key_handle(),
+        s.keys(0).certificate().handle()}) {
+    ASSERT_OK_AND_ASSIGN(std::shared_ptr<Object> previous_object,
+                         previous->GetObject(handle));
+    EXPECT_THAT(store->GetObject(handle), IsOkAndHolds(previous_object));
+  }
+  EXPECT_OK(store->GetObject(s.keys(1).public_key_handle()));
+  EXPECT_OK(store->GetObject(s.keys(1).private_key_handle()));
+}
+
+TEST(ObjectStoreTest, NewStoreWithPreviousOmitsRemovedObjects) {
+  ObjectStoreState s;
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricRsaKey());
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> previous,
+                       ObjectStore::New(s));
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> store,
+                       ObjectStore::New(ObjectStoreState(), previous.get()));
+
+  EXPECT_THAT(store->GetObject(s.keys(0).public_key_handle()),
+              StatusRvIs(CKR_OBJECT_HANDLE_INVALID));
+}
+
+TEST(ObjectStoreTest, NewStoreWithPreviousDoesNotReuseObjectOfOtherVersion) {
+  ObjectStoreState s;
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricRsaKey());
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> previous,
+                       ObjectStore::New(s));
+
+  s.mutable_keys(0)->mutable_crypto_key_version()->set_name(
+      "projects/foo/locations/bar/keyRings/baz/cryptoKeys/qux/"
+      "cryptoKeyVersions/2");
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> store,
+                       ObjectStore::New(s, previous.get()));
+
+  EXPECT_THAT(store->GetObject(s.keys(0).public_key_handle()),
+              IsOkAndHolds(Pointee(Property(
+                  "kms_key_name", &Object::kms_key_name,
+                  s.keys(0).crypto_key_version().name()))));
+}
+
 TEST(ObjectStoreTest, GetObjectSuccessPublicKey) {
   ObjectStoreState s;
 
@@ -532,6 +596,91 @@ TEST(ObjectStoreTest, FindSortsByNameThenClass) {
                           ));
 }
 
+bool ContainsAll(const Object& o, absl::Span<const CK_ATTRIBUTE> attributes) {
+  for (const CK_ATTRIBUTE& attr : attributes) {
+    if (!o.attributes().Contains(attr)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(ObjectStoreTest, FindWithIndexedAttributesMatchesFullScan) {
+  ObjectStoreState s;
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricEcKeyAndCert());
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricRsaKey());
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewSymmetricHmacKey());
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> store, ObjectStore::New(s));
+
+  CK_OBJECT_CLASS want_class = CKO_PUBLIC_KEY;
+  std::vector<CK_ATTRIBUTE> tmpl = {
+      {CKA_CLASS, &want_class, sizeof(want_class)},
+  };
+  auto predicate = [&](const Object& o) { return ContainsAll(o, tmpl); };
+
+  EXPECT_THAT(store->Find(tmpl, predicate), ElementsAre(1003, 1001));
+  EXPECT_EQ(store->Find(tmpl, predicate), store->Find(predicate));
+}
+
+TEST(ObjectStoreTest, FindWithIndexedAttributesIntersectsIndexes) {
+  ObjectStoreState s;
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricEcKeyAndCert());
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricRsaKey());
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> store, ObjectStore::New(s));
+
+  CK_OBJECT_CLASS want_class = CKO_PRIVATE_KEY;
+  CK_KEY_TYPE want_key_type = CKK_EC;
+  std::string want_label = "luz";
+  std::vector<CK_ATTRIBUTE> tmpl = {
+      {CKA_CLASS, &want_class, sizeof(want_class)},
+      {CKA_KEY_TYPE, &want_key_type, sizeof(want_key_type)},
+      {CKA_LABEL, want_label.data(), want_label.size()},
+  };
+
+  EXPECT_THAT(store->Find(tmpl, [&](const Object& o) {
+    return ContainsAll(o, tmpl);
+  }),
+              ElementsAre(1004));
+}
+
+TEST(ObjectStoreTest, FindWithUnmatchedIndexedAttributeSkipsPredicate) {
+  ObjectStoreState s;
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricEcKeyAndCert());
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> store, ObjectStore::New(s));
+
+  std::string want_label = "missing";
+  std::vector<CK_ATTRIBUTE> tmpl = {
+      {CKA_LABEL, want_label.data(), want_label.size()},
+  };
+
+  EXPECT_THAT(store->Find(tmpl, [](const Object& o) -> bool {
+    ADD_FAILURE() << "unexpected predicate evaluation";
+    return true;
+  }),
+              IsEmpty());
+}
+
+TEST(ObjectStoreTest, FindWithoutIndexedAttributesEvaluatesPredicate) {
+  ObjectStoreState s;
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricEcKeyAndCert());
+  ASSERT_OK_AND_ASSIGN(*s.add_keys(), NewAsymmetricRsaKey());
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<ObjectStore> store, ObjectStore::New(s));
+
+  CK_BBOOL want_sign = CK_TRUE;
+  std::vector<CK_ATTRIBUTE> tmpl = {
+      {CKA_SIGN, &want_sign, sizeof(want_sign)},
+  };
+
+  EXPECT_THAT(store->Find(tmpl, [&](const Object& o) {
+    return ContainsAll(o, tmpl);
+  }),
+              ElementsAre(1004));
+}
+
 TEST(ObjectStoreTest, FindSingleReturnsSingleMatch) {
   ObjectStoreState s;
 
@@ -224,6 +224,70 @@ TEST(NewKeyPairTest, RsaKeyAttributes) {
               StatusRvIs(CKR_ATTRIBUTE_SENSITIVE));
 }
 
+TEST(NewKeyPairTest, ParsedPublicKeyIsSharedByKeyPair) {
+  kms_v1::CryptoKeyVersion ckv = NewTestCkv();
+  ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> pub, GetTestP256Key());
+
+  ASSERT_OK_AND_ASSIGN(KeyPair key_pair, Object::NewKeyPair(ckv, pub.get()));
+  ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> pub_key,
+                       key_pair.public_key.ParsedPublicKey());
+  ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> prv_key,
+                       key_pair.private_key.ParsedPublicKey());
+
+  EXPECT_EQ(pub_key.get(), prv_key.get());
+  EXPECT_EQ(EVP_PKEY_cmp(pub_key.get(), pub.get()), 1);
+}
+
+TEST(NewDeferredKeyPairTest, PublicKeyAttributesAreOmitted) {
+  kms_v1::CryptoKeyVersion ckv = NewTestCkv();
+
+  ASSERT_OK_AND_ASSIGN(KeyPair key_pair, Object::NewDeferredKeyPair(ckv));
+  const AttributeMap& pub_attrs = key_pair.public_key.attributes();
+  const AttributeMap& prv_attrs = key_pair.private_key.attributes();
+
+  EXPECT_TRUE(key_pair.public_key.public_key_deferred());
+  EXPECT_TRUE(key_pair.private_key.public_key_deferred());
+  EXPECT_THAT(pub_attrs.Value(CKA_CLASS),
+              IsOkAndHolds(MarshalULong(CKO_PUBLIC_KEY)));
+  EXPECT_THAT(pub_attrs.Value(CKA_PUBLIC_KEY_INFO),
+              StatusRvIs(CKR_ATTRIBUTE_TYPE_INVALID));
+  EXPECT_THAT(pub_attrs.Value(CKA_EC_POINT),
+              StatusRvIs(CKR_ATTRIBUTE_TYPE_INVALID));
+  EXPECT_THAT(prv_attrs.Value(CKA_SIGN), IsOkAndHolds(MarshalBool(true)));
+  EXPECT_THAT(prv_attrs.Value(CKA_EC_PARAMS),
+              StatusRvIs(CKR_ATTRIBUTE_TYPE_INVALID));
+  EXPECT_THAT(prv_attrs.Value(CKA_VALUE), StatusRvIs(CKR_ATTRIBUTE_SENSITIVE));
+  EXPECT_THAT(key_pair.private_key.ParsedPublicKey(),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(NewDeferredKeyPairTest, CompleteKeyPairMatchesNewKeyPair) {
+  kms_v1::CryptoKeyVersion ckv = NewTestCkv();
+  ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> pub, GetTestP256Key());
+
+  ASSERT_OK_AND_ASSIGN(KeyPair deferred, Object::NewDeferredKeyPair(ckv));
+  ASSERT_OK_AND_ASSIGN(KeyPair completed,
+                       deferred.private_key.CompleteKeyPair(pub.get()));
+  ASSERT_OK_AND_ASSIGN(KeyPair expected, Object::NewKeyPair(ckv, pub.get()));
+
+  EXPECT_FALSE(completed.public_key.public_key_deferred());
+  EXPECT_FALSE(completed.private_key.public_key_deferred());
+  EXPECT_EQ(completed.public_key.attributes().Value(CKA_PUBLIC_KEY_INFO),
+            expected.public_key.attributes().Value(CKA_PUBLIC_KEY_INFO));
+  EXPECT_EQ(completed.private_key.attributes().Value(CKA_EC_POINT),
+            expected.private_key.attributes().Value(CKA_EC_POINT));
+}
+
+TEST(NewDeferredKeyPairTest, CompleteKeyPairFailsForCompleteKeyPair) {
+  kms_v1::CryptoKeyVersion ckv = NewTestCkv();
+  ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> pub, GetTestP256Key());
+
+  ASSERT_OK_AND_ASSIGN(KeyPair key_pair, Object::NewKeyPair(ckv, pub.get()));
+
+  EXPECT_THAT(key_pair.public_key.CompleteKeyPair(pub.get()),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
 TEST(NewCertificateTest, CertificateAttributes) {
   kms_v1::CryptoKeyVersion ckv = NewTestCkv();
   ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> pub, GetTestP256Key());
@@ -14,7 +14,10 @@
 
 #include "kmsp11/operation/aes_cbc.h"
 
+#include <algorithm>
+
 #include "absl/cleanup/cleanup.h"
+#include "common/async_call_queue.h"
 #include "common/status_macros.h"
 #include "kmsp11/kmsp11.h"
 #include "kmsp11/object.h"
@@ -35,32 +38,87 @@ constexpr size_t kBlockSize = 16;
 constexpr size_t kMaxPlaintextBytes = 64 * 1024;
 constexpr size_t kMaxCiphertextBytes = kMaxPlaintextBytes + 16;
 
+// Encrypts `plaintext` with a single request using `iv`, and appends the
+// ciphertext to `ciphertext`. On return, `iv` holds the final ciphertext block,
+// which is the IV for any plaintext that follows in CBC mode.
+absl::Status EncryptChunk(KmsClient* client, std::string_view key_name,
+                          absl::Span<const uint8_t> plaintext,
+                          std::vector<uint8_t>& iv,
+                          std::vector<uint8_t>& ciphertext) {
+  kms_v1::RawEncryptRequest req;
+  req.set_name(std::string(key_name));
+  req.set_plaintext(std::string(reinterpret_cast<const char*>(plaintext.data()),
+                                plaintext.size()));
+  req.set_initialization_vector(
+      std::string(reinterpret_cast<const char*>(iv.data()), iv.size()));
+
+  ASSIGN_OR_RETURN(kms_v1::RawEncryptResponse resp, client->RawEncrypt(req));
+
+  if (req.initialization_vector() != resp.initialization_vector()) {
+    return NewInternalError(
+        "the IV returned by the server does not match user-supplied IV",
+        SOURCE_LOCATION);
+  }
+  if (resp.ciphertext().size() != plaintext.size()) {
+    return NewInternalError(
+        absl::StrFormat("unexpected ciphertext length: got %d bytes, want %d",
+                        resp.ciphertext().size(), plaintext.size()),
+        SOURCE_LOCATION);
+  }
+
+  ciphertext.insert(ciphertext.end(), resp.ciphertext().begin(),
+                    resp.ciphertext().end());
+  if (ciphertext.size() >= kBlockSize) {
+    iv.assign(ciphertext.end() - kBlockSize, ciphertext.end());
+  }
+  return absl::OkStatus();
+}
+
 // An implementation of EncrypterInterface that generates AES-CBC ciphertexts
 // using Cloud KMS.
 class AesCbcEncrypter : public EncrypterInterface {
  public:
   AesCbcEncrypter(std::shared_ptr<Object> object, absl::Span<uint8_t> iv,
-                  PaddingMode padding)
-      : object_(object), iv_(iv.begin(), iv.end()), padding_mode_(padding) {}
+                  PaddingMode padding, const RawEncryptionOptions& options)
+      : object_(object),
+        iv_(iv.begin(), iv.end()),
+        padding_mode_(padding),
+        options_(options),
+        next_iv_(iv_) {}
 
   absl::StatusOr<absl::Span<const uint8_t>> Encrypt(
       KmsClient* client, absl::Span<const uint8_t> ciphertext) override;
-  absl::Status EncryptUpdate(KmsClient* client,
-                             absl::Span<const uint8_t> plaintext_part) override;
+  absl::StatusOr<absl::Span<const uint8_t>> EncryptUpdate(
+      KmsClient* client, absl::Span<const uint8_t> plaintext_part) override;
+  size_t EncryptUpdateOutputLength() override;
   absl::StatusOr<absl::Span<const uint8_t>> EncryptFinal(
       KmsClient* client) override;
 
   virtual ~AesCbcEncrypter() {}
 
  private:
+  using CallQueue = AsyncCallQueue<kms_v1::RawEncryptResponse>;
+
   absl::StatusOr<absl::Span<const uint8_t>> EncryptInternal(
       KmsClient* client, absl::Span<const uint8_t> plaintext);
+  // Waits for the streamed chunk that is in flight, if any, and appends its
+  // ciphertext to `streamed_ciphertext_`.
+  absl::Status ReceiveStreamed();
 
   std::shared_ptr<Object> object_;
   std::vector<uint8_t> iv_;
   PaddingMode padding_mode_;
+  const RawEncryptionOptions options_;
   std::optional<std::vector<uint8_t, ZeroDeallocator<uint8_t>>>
       plaintext_;  // for multi-part
+  // In chunked mode, each full chunk of multi-part plaintext is sent as soon
+  // as it is buffered. Since each chunk's IV is the last ciphertext block of
+  // the chunk before it, at most one chunk is in flight in `streamed_`.
+  // `streamed_ciphertext_` holds ciphertext that has been received but not yet
+  // returned, and `next_iv_` is the IV for the chunk that follows it.
+  std::unique_ptr<CallQueue> streamed_;
+  std::vector<uint8_t> streamed_ciphertext_;
+  std::vector<uint8_t> next_iv_;
   std::vector<uint8_t> ciphertext_;
 };
 
@@ -72,7 +130,7 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCbcEncrypter::Encrypt(
         CKR_FUNCTION_FAILED, SOURCE_LOCATION);
   }
 
-  if (plaintext.size() > kMaxPlaintextBytes) {
+  if (!options_.chunked && plaintext.size() > kMaxPlaintextBytes) {
     return NewInvalidArgumentError(
         absl::StrFormat(
             "plaintext length (%d bytes) exceeds maximum allowed %d",
@@ -83,26 +141,66 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCbcEncrypter::Encrypt(
   return EncryptInternal(client, plaintext);
 }
 
-absl::Status AesCbcEncrypter::EncryptUpdate(
+absl::StatusOr<absl::Span<const uint8_t>> AesCbcEncrypter::EncryptUpdate(
     KmsClient* client, absl::Span<const uint8_t> plaintext_part) {
   if (!plaintext_) {
     plaintext_.emplace();
   }
 
-  if (plaintext_part.size() + plaintext_->size() > kMaxPlaintextBytes) {
-    return NewInvalidArgumentError(
-        absl::StrFormat("plaintext length (%u bytes) exceeds maximum "
-                        "allowed (%u bytes)",
-                        plaintext_part.size() + plaintext_->size(),
-                        kMaxPlaintextBytes),
-        CKR_DATA_LEN_RANGE, SOURCE_LOCATION);
+  if (!options_.chunked) {
+    if (plaintext_part.size() + plaintext_->size() > kMaxPlaintextBytes) {
+      return NewInvalidArgumentError(
+          absl::StrFormat("plaintext length (%u bytes) exceeds maximum "
+                          "allowed (%u bytes)",
+                          plaintext_part.size() + plaintext_->size(),
+                          kMaxPlaintextBytes),
+          CKR_DATA_LEN_RANGE, SOURCE_LOCATION);
+    }
+
+    plaintext_->reserve(plaintext_->size() + plaintext_part.size());
+    plaintext_->insert(plaintext_->end(), plaintext_part.begin(),
+                       plaintext_part.end());
+    return absl::Span<const uint8_t>();
   }
 
+  // Return the ciphertext of chunks that were sent by earlier calls, and then
+  // send every chunk that this part completes. Padding only affects the last
+  // chunk, which is encrypted by EncryptFinal.
+  RETURN_IF_ERROR(ReceiveStreamed());
+  ciphertext_ = std::move(streamed_ciphertext_);
+  streamed_ciphertext_.clear();
+
   plaintext_->reserve(plaintext_->size() + plaintext_part.size());
   plaintext_->insert(plaintext_->end(), plaintext_part.begin(),
                      plaintext_part.end());
 
-  return absl::OkStatus();
+  if (!streamed_) {
+    streamed_ = std::make_unique<CallQueue>(1);
+  }
+  absl::Span<const uint8_t> buffered(*plaintext_);
+  while (buffered.size() >= kMaxPlaintextBytes) {
+    RETURN_IF_ERROR(ReceiveStreamed());
+
+    absl::Span<const uint8_t> chunk = buffered.subspan(0, kMaxPlaintextBytes);
+    kms_v1::RawEncryptRequest req;
+    req.set_name(std::string(object_->kms_key_name()));
+    req.set_plaintext(std::string(reinterpret_cast<const char*>(chunk.data()),
+                                  chunk.size()));
+    req.set_initialization_vector(std::string(
+        reinterpret_cast<const char*>(next_iv_.data()), next_iv_.size()));
+    streamed_->Start([&](AsyncCallback<kms_v1::RawEncryptResponse> callback) {
+      client->RawEncryptAsync(std::move(req), std::move(callback));
+    });
+    buffered.remove_prefix(kMaxPlaintextBytes);
+  }
+  plaintext_->erase(plaintext_->begin(), plaintext_->end() - buffered.size());
+
+  return ciphertext_;
+}
+
+size_t AesCbcEncrypter::EncryptUpdateOutputLength() {
+  return streamed_ciphertext_.size() +
+         (streamed_ ? streamed_->size() * kMaxPlaintextBytes : 0);
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> AesCbcEncrypter::EncryptFinal(
@@ -114,6 +212,7 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCbcEncrypter::EncryptFinal(
         CKR_FUNCTION_FAILED, SOURCE_LOCATION);
   }
 
+  RETURN_IF_ERROR(ReceiveStreamed());
   return EncryptInternal(client, *plaintext_);
 }
 
@@ -128,40 +227,64 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCbcEncrypter::EncryptInternal(
         CKR_DATA_LEN_RANGE, SOURCE_LOCATION);
   }
 
-  kms_v1::RawEncryptRequest req;
-  req.set_name(std::string(object_->kms_key_name()));
   std::vector<uint8_t> padded_plaintext;
   switch (padding_mode_) {
     case PaddingMode::kPkcs7:
       padded_plaintext = Pad(plaintext);
-      req.set_plaintext(
-          std::string(reinterpret_cast<const char*>(padded_plaintext.data()),
-                      padded_plaintext.size()));
+      plaintext = padded_plaintext;
       break;
     case PaddingMode::kNone:
-      req.set_plaintext(std::string(
-          reinterpret_cast<const char*>(plaintext.data()), plaintext.size()));
       break;
     default:
       return NewInternalError("unsupported padding mode", SOURCE_LOCATION);
   }
 
-  req.set_initialization_vector(
-      std::string(reinterpret_cast<const char*>(iv_.data()), iv_.size()));
+  // This may be invoked more than once for the same message (for example, to
+  // query the output length), so the streamed state is not modified.
+  ciphertext_ = streamed_ciphertext_;
+  std::vector<uint8_t> iv = next_iv_;
 
-  ASSIGN_OR_RETURN(kms_v1::RawEncryptResponse resp, client->RawEncrypt(req));
+  if (!options_.chunked) {
+    RETURN_IF_ERROR(EncryptChunk(client, object_->kms_key_name(), plaintext,
+                                 iv, ciphertext_));
+    return ciphertext_;
+  }
 
-  if (req.initialization_vector() != resp.initialization_vector()) {
+  for (size_t offset = 0; offset < plaintext.size();
+       offset += kMaxPlaintextBytes) {
+    RETURN_IF_ERROR(EncryptChunk(client, object_->kms_key_name(),
+                                 plaintext.subspan(offset, kMaxPlaintextBytes),
+                                 iv, ciphertext_));
+  }
+  return ciphertext_;
+}
+
+absl::Status AesCbcEncrypter::ReceiveStreamed() {
+  if (!streamed_ || streamed_->empty()) {
+    return absl::OkStatus();
+  }
+
+  ASSIGN_OR_RETURN(kms_v1::RawEncryptResponse resp, streamed_->Pop());
+  if (resp.initialization_vector() !=
+      std::string_view(reinterpret_cast<const char*>(next_iv_.data()),
+                       next_iv_.size())) {
     return NewInternalError(
-        "the IV returned by the server does not match user-supplied IV",
+        "the IV returned by the server does not match the chunk IV",
+        SOURCE_LOCATION);
+  }
+  if (resp.ciphertext().size() != kMaxPlaintextBytes) {
+    return NewInternalError(
+        absl::StrFormat("unexpected ciphertext length: got %d bytes, want %d",
+                        resp.ciphertext().size(), kMaxPlaintextBytes),
         SOURCE_LOCATION);
   }
 
-  ciphertext_.resize(resp.ciphertext().size());
-  std::copy_n(resp.ciphertext().begin(), resp.ciphertext().size(),
-              ciphertext_.begin());
-
-  return ciphertext_;
+  streamed_ciphertext_.insert(streamed_ciphertext_.end(),
+                              resp.ciphertext().begin(),
+                              resp.ciphertext().end());
+  next_iv_.assign(resp.ciphertext().end() - kBlockSize,
+                  resp.ciphertext().end());
+  return absl::OkStatus();
 }
 
 // An implementation of DecrypterInterface that decrypts AES-CBC ciphertexts
@@ -169,32 +292,68 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCbcEncrypter::EncryptInternal(
 class AesCbcDecrypter : public DecrypterInterface {
  public:
   AesCbcDecrypter(std::shared_ptr<Object> object, absl::Span<uint8_t> iv,
-                  PaddingMode padding)
-      : object_(object), iv_(iv.begin(), iv.end()), padding_mode_(padding) {}
+                  PaddingMode padding, const RawEncryptionOptions& options)
+      : object_(object),
+        iv_(iv.begin(), iv.end()),
+        padding_mode_(padding),
+        options_(options),
+        next_iv_(iv_) {}
 
   absl::StatusOr<absl::Span<const uint8_t>> Decrypt(
       KmsClient* client, absl::Span<const uint8_t> ciphertext) override;
-  absl::Status DecryptUpdate(
+  absl::StatusOr<absl::Span<const uint8_t>> DecryptUpdate(
       KmsClient* client, absl::Span<const uint8_t> ciphertext_part) override;
+  size_t DecryptUpdateOutputLength() override;
   absl::StatusOr<absl::Span<const uint8_t>> DecryptFinal(
       KmsClient* client) override;
 
   virtual ~AesCbcDecrypter() {}
 
  private:
+  using CallQueue = AsyncCallQueue<kms_v1::RawDecryptResponse>;
+
   absl::StatusOr<absl::Span<const uint8_t>> DecryptInternal(
       KmsClient* client, absl::Span<const uint8_t> ciphertext);
+  absl::Status DecryptChunked(KmsClient* client,
+                              absl::Span<const uint8_t> ciphertext);
+  absl::StatusOr<absl::Span<const uint8_t>> DecryptFinalStreamed(
+      KmsClient* client);
+
+  // Starts decrypting `chunk`, using `chunk_iv` as its IV.
+  void StartChunk(KmsClient* client, CallQueue& calls,
+                  absl::Span<const uint8_t> chunk,
+                  absl::Span<const uint8_t> chunk_iv);
+  // Waits for the earliest call in `calls`, which decrypted `size` bytes at
+  // `offset`, and appends its plaintext to `plaintext`, which must have
+  // capacity for it.
+  absl::Status ReceiveChunk(CallQueue& calls, uint64_t offset, size_t size,
+                            std::string& plaintext);
+  // Appends the plaintext of every streamed chunk to `plaintext`.
+  absl::Status ReceiveStreamed(std::string& plaintext);
 
   std::shared_ptr<Object> object_;
   std::vector<uint8_t> iv_;
   PaddingMode padding_mode_;
+  const RawEncryptionOptions options_;
   std::optional<std::vector<uint8_t>> ciphertext_;  // for multi-part
+  // In chunked mode, each full chunk of multi-part ciphertext is sent as soon
+  // as it is buffered, except that with padding the final block is held back
+  // for DecryptFinal. `streamed_` holds the calls whose plaintext has not yet
+  // been returned, `streamed_bytes_` counts the ciphertext bytes sent, and
+  // `next_iv_` is the last ciphertext block sent.
+  std::unique_ptr<CallQueue> streamed_;
+  uint64_t streamed_bytes_ = 0;
+  std::vector<uint8_t> next_iv_;
+  // Plaintext received by DecryptFinal, which is kept so that DecryptFinal may
+  // be called again after a length query.
+  std::unique_ptr<std::string, ZeroDelete<std::string>>
+      final_streamed_plaintext_;
   std::unique_ptr<std::string, ZeroDelete<std::string>> plaintext_;
 };
 
 absl::StatusOr<absl::Span<const uint8_t>> AesCbcDecrypter::Decrypt(
     KmsClient* client, absl::Span<const uint8_t> ciphertext) {
-  if (ciphertext.size() > kMaxCiphertextBytes) {
+  if (!options_.chunked && ciphertext.size() > kMaxCiphertextBytes) {
     return NewInvalidArgumentError(
         absl::StrFormat(
             "ciphertext length (%u bytes) exceeds maximum allowed %u",
@@ -205,26 +364,61 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCbcDecrypter::Decrypt(
   return DecryptInternal(client, ciphertext);
 }
 
-absl::Status AesCbcDecrypter::DecryptUpdate(
+absl::StatusOr<absl::Span<const uint8_t>> AesCbcDecrypter::DecryptUpdate(
     KmsClient* client, absl::Span<const uint8_t> ciphertext_part) {
   if (!ciphertext_) {
     ciphertext_.emplace();
   }
 
-  if (ciphertext_part.size() + ciphertext_->size() > kMaxCiphertextBytes) {
-    return NewInvalidArgumentError(
-        absl::StrFormat("ciphertext length (%u bytes) exceeds maximum "
-                        "allowed (%u bytes)",
-                        ciphertext_part.size() + ciphertext_->size(),
-                        kMaxCiphertextBytes),
-        CKR_DATA_LEN_RANGE, SOURCE_LOCATION);
+  if (!options_.chunked) {
+    if (ciphertext_part.size() + ciphertext_->size() > kMaxCiphertextBytes) {
+      return NewInvalidArgumentError(
+          absl::StrFormat("ciphertext length (%u bytes) exceeds maximum "
+                          "allowed (%u bytes)",
+                          ciphertext_part.size() + ciphertext_->size(),
+                          kMaxCiphertextBytes),
+          CKR_DATA_LEN_RANGE, SOURCE_LOCATION);
+    }
+
+    ciphertext_->reserve(ciphertext_->size() + ciphertext_part.size());
+    ciphertext_->insert(ciphertext_->end(), ciphertext_part.begin(),
+                        ciphertext_part.end());
+    return absl::Span<const uint8_t>();
   }
 
+  // Return the plaintext of chunks that were sent by earlier calls, and then
+  // send every chunk that this part completes.
+  plaintext_.reset(new std::string());
+  RETURN_IF_ERROR(ReceiveStreamed(*plaintext_));
+
   ciphertext_->reserve(ciphertext_->size() + ciphertext_part.size());
   ciphertext_->insert(ciphertext_->end(), ciphertext_part.begin(),
                       ciphertext_part.end());
 
-  return absl::OkStatus();
+  if (!streamed_) {
+    streamed_ = std::make_unique<CallQueue>(options_.max_concurrent_chunks);
+  }
+  // With padding, a chunk is only sent once at least one more byte follows
+  // it, so that the block containing the padding is decrypted by
+  // DecryptFinal.
+  size_t min_remaining = padding_mode_ == PaddingMode::kPkcs7 ? 1 : 0;
+  absl::Span<const uint8_t> buffered(*ciphertext_);
+  while (buffered.size() >= kMaxPlaintextBytes + min_remaining) {
+    absl::Span<const uint8_t> chunk = buffered.subspan(0, kMaxPlaintextBytes);
+    StartChunk(client, *streamed_, chunk, next_iv_);
+    next_iv_.assign(chunk.end() - kBlockSize, chunk.end());
+    streamed_bytes_ += kMaxPlaintextBytes;
+    buffered.remove_prefix(kMaxPlaintextBytes);
+  }
+  ciphertext_->erase(ciphertext_->begin(),
+                     ciphertext_->end() - buffered.size());
+
+  return absl::MakeConstSpan(
+      reinterpret_cast<const uint8_t*>(plaintext_->data()), plaintext_->size());
+}
+
+size_t AesCbcDecrypter::DecryptUpdateOutputLength() {
+  return streamed_ ? streamed_->size() * kMaxPlaintextBytes : 0;
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> AesCbcDecrypter::DecryptFinal(
@@ -236,21 +430,109 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCbcDecrypter::DecryptFinal(
         CKR_FUNCTION_FAILED, SOURCE_LOCATION);
   }
 
+  if (streamed_bytes_ > 0) {
+    return DecryptFinalStreamed(client);
+  }
   return DecryptInternal(client, *ciphertext_);
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> AesCbcDecrypter::DecryptInternal(
     KmsClient* client, absl::Span<const uint8_t> ciphertext) {
-  kms_v1::RawDecryptRequest req;
-  req.set_name(std::string(object_->kms_key_name()));
-  req.set_ciphertext(std::string(
-      reinterpret_cast<const char*>(ciphertext.data()), ciphertext.size()));
-  req.set_initialization_vector(
-      std::string(reinterpret_cast<const char*>(iv_.data()), iv_.size()));
+  if (options_.chunked && ciphertext.size() > kMaxCiphertextBytes) {
+    RETURN_IF_ERROR(DecryptChunked(client, ciphertext));
+  } else {
+    kms_v1::RawDecryptRequest req;
+    req.set_name(std::string(object_->kms_key_name()));
+    req.set_ciphertext(std::string(
+        reinterpret_cast<const char*>(ciphertext.data()), ciphertext.size()));
+    req.set_initialization_vector(
+        std::string(reinterpret_cast<const char*>(iv_.data()), iv_.size()));
+
+    ASSIGN_OR_RETURN(kms_v1::RawDecryptResponse resp,
+                     client->RawDecrypt(req));
+    plaintext_.reset(resp.release_plaintext());
+  }
+
+  absl::Span<const uint8_t> full_plaintext(
+      reinterpret_cast<const uint8_t*>(plaintext_->data()), plaintext_->size());
+
+  switch (padding_mode_) {
+    case PaddingMode::kNone:
+      return full_plaintext;
+    case PaddingMode::kPkcs7:
+      return Unpad(full_plaintext);
+  }
+}
+
+// Decrypts `ciphertext` in chunks of kMaxPlaintextBytes with concurrent
+// requests. A CBC plaintext block depends only on its own ciphertext block and
+// the one before it, so each chunk can be decrypted independently, using the
+// final ciphertext block of the previous chunk as its IV.
+absl::Status AesCbcDecrypter::DecryptChunked(
+    KmsClient* client, absl::Span<const uint8_t> ciphertext) {
+  if (ciphertext.size() % kBlockSize != 0) {
+    return NewInvalidArgumentError(
+        absl::StrFormat("ciphertext length (%u bytes) should be a multiple of "
+                        "the block size (%u bytes)",
+                        ciphertext.size(), kBlockSize),
+        CKR_ENCRYPTED_DATA_LEN_RANGE, SOURCE_LOCATION);
+  }
+
+  CallQueue calls(options_.max_concurrent_chunks);
+  plaintext_.reset(new std::string());
+  plaintext_->reserve(ciphertext.size());
+
+  auto receive_front = [&]() -> absl::Status {
+    return ReceiveChunk(
+        calls, plaintext_->size(),
+        std::min(kMaxPlaintextBytes, ciphertext.size() - plaintext_->size()),
+        *plaintext_);
+  };
+
+  for (size_t offset = 0; offset < ciphertext.size();
+       offset += kMaxPlaintextBytes) {
+    if (calls.size() >= options_.max_concurrent_chunks) {
+      RETURN_IF_ERROR(receive_front());
+    }
+    StartChunk(client, calls, ciphertext.subspan(offset, kMaxPlaintextBytes),
+               offset == 0
+                   ? absl::MakeConstSpan(iv_)
+                   : ciphertext.subspan(offset - kBlockSize, kBlockSize));
+  }
+
+  while (!calls.empty()) {
+    RETURN_IF_ERROR(receive_front());
+  }
+  return absl::OkStatus();
+}
+
+// Completes a multi-part decryption in chunked mode, where all but the last
+// chunk of ciphertext has already been sent.
+absl::StatusOr<absl::Span<const uint8_t>> AesCbcDecrypter::DecryptFinalStreamed(
+    KmsClient* client) {
+  if (ciphertext_->size() % kBlockSize != 0) {
+    return NewInvalidArgumentError(
+        absl::StrFormat("ciphertext length (%u bytes) should be a multiple of "
+                        "the block size (%u bytes)",
+                        streamed_bytes_ + ciphertext_->size(), kBlockSize),
+        CKR_ENCRYPTED_DATA_LEN_RANGE, SOURCE_LOCATION);
+  }
 
-  ASSIGN_OR_RETURN(kms_v1::RawDecryptResponse resp, client->RawDecrypt(req));
+  if (!final_streamed_plaintext_) {
+    final_streamed_plaintext_.reset(new std::string());
+  }
+  RETURN_IF_ERROR(ReceiveStreamed(*final_streamed_plaintext_));
+
+  plaintext_.reset(new std::string());
+  plaintext_->reserve(final_streamed_plaintext_->size() + ciphertext_->size());
+  plaintext_->append(*final_streamed_plaintext_);
+  if (!ciphertext_->empty()) {
+    CallQueue calls(1);
+    StartChunk(client, calls, *ciphertext_, next_iv_);
+    RETURN_IF_ERROR(ReceiveChunk(calls, streamed_bytes_, ciphertext_->size(),
+                                 *plaintext_));
+  }
 
-  plaintext_.reset(resp.release_plaintext());
   absl::Span<const uint8_t> full_plaintext(
       reinterpret_cast<const uint8_t*>(plaintext_->data()), plaintext_->size());
 
@@ -262,10 +544,56 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCbcDecrypter::DecryptInternal(
   }
 }
 
+void AesCbcDecrypter::StartChunk(KmsClient* client, CallQueue& calls,
+                                 absl::Span<const uint8_t> chunk,
+                                 absl::Span<const uint8_t> chunk_iv) {
+  kms_v1::RawDecryptRequest req;
+  req.set_name(std::string(object_->kms_key_name()));
+  req.set_ciphertext(
+      std::string(reinterpret_cast<const char*>(chunk.data()), chunk.size()));
+  req.set_initialization_vector(std::string(
+      reinterpret_cast<const char*>(chunk_iv.data()), chunk_iv.size()));
+  calls.Start([&](AsyncCallback<kms_v1::RawDecryptResponse> callback) {
+    client->RawDecryptAsync(std::move(req), std::move(callback));
+  });
+}
+
+absl::Status AesCbcDecrypter::ReceiveChunk(CallQueue& calls, uint64_t offset,
+                                           size_t size,
+                                           std::string& plaintext) {
+  ASSIGN_OR_RETURN(kms_v1::RawDecryptResponse resp, calls.Pop());
+  std::unique_ptr<std::string, ZeroDelete<std::string>> chunk_plaintext(
+      resp.release_plaintext());
+  if (chunk_plaintext->size() != size) {
+    return NewInternalError(
+        absl::StrFormat("unexpected plaintext length for chunk at offset "
+                        "%d: got %d bytes, want %d",
+                        offset, chunk_plaintext->size(), size),
+        SOURCE_LOCATION);
+  }
+  plaintext.append(*chunk_plaintext);
+  return absl::OkStatus();
+}
+
+absl::Status AesCbcDecrypter::ReceiveStreamed(std::string& plaintext) {
+  if (!streamed_) {
+    return absl::OkStatus();
+  }
+  plaintext.reserve(plaintext.size() + streamed_->size() * kMaxPlaintextBytes);
+  while (!streamed_->empty()) {
+    uint64_t offset =
+        streamed_bytes_ - streamed_->size() * kMaxPlaintextBytes;
+    RETURN_IF_ERROR(
+        ReceiveChunk(*streamed_, offset, kMaxPlaintextBytes, plaintext));
+  }
+  return absl::OkStatus();
+}
+
 }  // namespace
 
 absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewAesCbcEncrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism) {
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options) {
   RETURN_IF_ERROR(CheckKeyPreconditions(CKK_AES, CKO_SECRET_KEY,
                                         mechanism->mechanism, key.get()));
   if (!mechanism->pParameter || mechanism->ulParameterLen != kIvBytes) {
@@ -281,12 +609,12 @@ absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewAesCbcEncrypter(
       iv = reinterpret_cast<CK_BYTE*>(mechanism->pParameter);
       return std::make_unique<AesCbcEncrypter>(
           key, absl::MakeSpan(iv, mechanism->ulParameterLen),
-          PaddingMode::kNone);
+          PaddingMode::kNone, options);
     case CKM_AES_CBC_PAD:
       iv = reinterpret_cast<CK_BYTE*>(mechanism->pParameter);
       return std::make_unique<AesCbcEncrypter>(
           key, absl::MakeSpan(iv, mechanism->ulParameterLen),
-          PaddingMode::kPkcs7);
+          PaddingMode::kPkcs7, options);
     default:
       return NewInternalError(
           absl::StrFormat("Mechanism %#x not supported for AES-CBC encryption",
@@ -296,7 +624,8 @@ absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewAesCbcEncrypter(
 }
 
 absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewAesCbcDecrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism) {
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options) {
   RETURN_IF_ERROR(CheckKeyPreconditions(CKK_AES, CKO_SECRET_KEY,
                                         mechanism->mechanism, key.get()));
   if (!mechanism->pParameter || mechanism->ulParameterLen != kIvBytes) {
@@ -311,11 +640,11 @@ absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewAesCbcDecrypter(
     case CKM_AES_CBC:
       return std::make_unique<AesCbcDecrypter>(
           key, absl::MakeSpan(iv, mechanism->ulParameterLen),
-          PaddingMode::kNone);
+          PaddingMode::kNone, options);
     case CKM_AES_CBC_PAD:
       return std::make_unique<AesCbcDecrypter>(
           key, absl::MakeSpan(iv, mechanism->ulParameterLen),
-          PaddingMode::kPkcs7);
+          PaddingMode::kPkcs7, options);
     default:
       return NewInternalError(
           absl::StrFormat("Mechanism %#x not supported for AES-CBC decryption",
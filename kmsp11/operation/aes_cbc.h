@@ -28,11 +28,13 @@ namespace cloud_kms::kmsp11 {
 
 // Returns an AesCbcEncrypter.
 absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewAesCbcEncrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism);
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options = RawEncryptionOptions());
 
 // Returns an AesCbcDecrypter.
 absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewAesCbcDecrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism);
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options = RawEncryptionOptions());
 
 }  // namespace cloud_kms::kmsp11
 
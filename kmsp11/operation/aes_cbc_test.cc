@@ -15,6 +15,7 @@
 #include "kmsp11/operation/aes_cbc.h"
 
 #include "common/kms_client.h"
+#include "common/status_macros.h"
 #include "common/test/runfiles.h"
 #include "common/test/test_status_macros.h"
 #include "fakekms/cpp/fakekms.h"
@@ -362,5 +363,155 @@ TEST_F(AesCbcTest, DecryptFailureKeyDisabled) {
               StatusRvIs(CKR_DEVICE_ERROR));
 }
 
+class AesCbcChunkedTest : public AesCbcTest {
+ protected:
+  void SetUp() override {
+    ASSERT_NO_FATAL_FAILURE(AesCbcTest::SetUp());
+
+    CK_MECHANISM mechanism = NewAesCbcPaddingMechanism(iv_.data());
+    RawEncryptionOptions options{.chunked = true, .max_concurrent_chunks = 2};
+
+    ASSERT_OK_AND_ASSIGN(encrypter_,
+                         NewAesCbcEncrypter(prv_, &mechanism, options));
+    ASSERT_OK_AND_ASSIGN(decrypter_,
+                         NewAesCbcDecrypter(prv_, &mechanism, options));
+  }
+
+  // Encrypts `plaintext`, which must be a multiple of the block size, with one
+  // sequential request per 64 KiB chunk. Each chunk uses the final ciphertext
+  // block of the previous chunk as its IV.
+  absl::StatusOr<std::vector<uint8_t>> ReferenceEncrypt(
+      absl::Span<const uint8_t> plaintext) {
+    std::string iv(iv_.begin(), iv_.end());
+    std::vector<uint8_t> ciphertext;
+
+    for (size_t offset = 0; offset < plaintext.size(); offset += kChunkSize) {
+      absl::Span<const uint8_t> chunk = plaintext.subspan(offset, kChunkSize);
+      kms_v1::RawEncryptRequest req;
+      req.set_name(kms_key_name_);
+      req.set_plaintext(chunk.data(), chunk.size());
+      req.set_initialization_vector(iv);
+      ASSIGN_OR_RETURN(kms_v1::RawEncryptResponse resp,
+                       client_->RawEncrypt(req));
+      ciphertext.insert(ciphertext.end(), resp.ciphertext().begin(),
+                        resp.ciphertext().end());
+      iv.assign(ciphertext.end() - 16, ciphertext.end());
+    }
+    return ciphertext;
+  }
+
+  static constexpr size_t kChunkSize = 64 * 1024;
+};
+
+TEST_F(AesCbcChunkedTest, EncryptMatchesReference) {
+  std::string plaintext = RandBytes(3 * kChunkSize + 5);
+  std::vector<uint8_t> plaintext_bytes(plaintext.begin(), plaintext.end());
+
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> ciphertext,
+                       encrypter_->Encrypt(client_.get(), plaintext_bytes));
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> expected,
+                       ReferenceEncrypt(Pad(plaintext_bytes)));
+
+  EXPECT_EQ(std::vector<uint8_t>(ciphertext.begin(), ciphertext.end()),
+            expected);
+}
+
+TEST_F(AesCbcChunkedTest, EncryptUpdateMatchesReference) {
+  std::string plaintext = RandBytes(2 * kChunkSize + 50);
+  std::vector<uint8_t> plaintext_bytes(plaintext.begin(), plaintext.end());
+  absl::Span<const uint8_t> plaintext_span(plaintext_bytes);
+
+  // The first part fills less than a chunk, and the second completes two,
+  // whose ciphertext is returned by the third call.
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> output,
+                       encrypter_->EncryptUpdate(
+                           client_.get(), plaintext_span.subspan(0, 1000)));
+  EXPECT_TRUE(output.empty());
+  ASSERT_OK_AND_ASSIGN(
+      output,
+      encrypter_->EncryptUpdate(
+          client_.get(), plaintext_span.subspan(1000, 2 * kChunkSize - 1000)));
+  EXPECT_TRUE(output.empty());
+
+  EXPECT_EQ(encrypter_->EncryptUpdateOutputLength(), 2 * kChunkSize);
+  ASSERT_OK_AND_ASSIGN(
+      output, encrypter_->EncryptUpdate(
+                  client_.get(), plaintext_span.subspan(2 * kChunkSize)));
+  std::vector<uint8_t> ciphertext(output.begin(), output.end());
+  EXPECT_EQ(ciphertext.size(), 2 * kChunkSize);
+
+  ASSERT_OK_AND_ASSIGN(output, encrypter_->EncryptFinal(client_.get()));
+  ciphertext.insert(ciphertext.end(), output.begin(), output.end());
+
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> expected,
+                       ReferenceEncrypt(Pad(plaintext_bytes)));
+  EXPECT_EQ(ciphertext, expected);
+}
+
+TEST_F(AesCbcChunkedTest, EncryptFinalMayBeRepeated) {
+  std::vector<uint8_t> plaintext(kChunkSize + 100, 'a');
+
+  ASSERT_OK(encrypter_->EncryptUpdate(client_.get(), plaintext));
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> ciphertext,
+                       encrypter_->EncryptFinal(client_.get()));
+  std::vector<uint8_t> first(ciphertext.begin(), ciphertext.end());
+  ASSERT_OK_AND_ASSIGN(ciphertext, encrypter_->EncryptFinal(client_.get()));
+
+  EXPECT_EQ(first.size(), kChunkSize + 112);
+  EXPECT_EQ(std::vector<uint8_t>(ciphertext.begin(), ciphertext.end()), first);
+}
+
+TEST_F(AesCbcChunkedTest, DecryptRecoversReferencePlaintext) {
+  std::string plaintext = RandBytes(4 * kChunkSize + 31);
+  std::vector<uint8_t> plaintext_bytes(plaintext.begin(), plaintext.end());
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       ReferenceEncrypt(Pad(plaintext_bytes)));
+
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> recovered_plaintext,
+                       decrypter_->Decrypt(client_.get(), ciphertext));
+
+  EXPECT_EQ(recovered_plaintext, plaintext_bytes);
+}
+
+TEST_F(AesCbcChunkedTest, DecryptUpdateRecoversReferencePlaintext) {
+  std::string plaintext = RandBytes(2 * kChunkSize);
+  std::vector<uint8_t> plaintext_bytes(plaintext.begin(), plaintext.end());
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       ReferenceEncrypt(Pad(plaintext_bytes)));
+  absl::Span<const uint8_t> ciphertext_span(ciphertext);
+
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> output,
+                       decrypter_->DecryptUpdate(
+                           client_.get(), ciphertext_span.subspan(0, 12345)));
+  EXPECT_TRUE(output.empty());
+  // The block that holds the padding is not sent until more data follows it,
+  // so only the first of these chunks is sent.
+  ASSERT_OK_AND_ASSIGN(
+      output,
+      decrypter_->DecryptUpdate(
+          client_.get(),
+          ciphertext_span.subspan(12345, 2 * kChunkSize - 12345)));
+  EXPECT_TRUE(output.empty());
+
+  EXPECT_EQ(decrypter_->DecryptUpdateOutputLength(), kChunkSize);
+  ASSERT_OK_AND_ASSIGN(
+      output, decrypter_->DecryptUpdate(
+                  client_.get(), ciphertext_span.subspan(2 * kChunkSize)));
+  std::vector<uint8_t> recovered_plaintext(output.begin(), output.end());
+  EXPECT_EQ(recovered_plaintext.size(), kChunkSize);
+
+  ASSERT_OK_AND_ASSIGN(output, decrypter_->DecryptFinal(client_.get()));
+  recovered_plaintext.insert(recovered_plaintext.end(), output.begin(),
+                             output.end());
+
+  EXPECT_EQ(recovered_plaintext, plaintext_bytes);
+}
+
+TEST_F(AesCbcChunkedTest, DecryptFailurePartialBlock) {
+  std::vector<uint8_t> ciphertext(2 * kChunkSize + 1);
+  EXPECT_THAT(decrypter_->Decrypt(client_.get(), ciphertext),
+              StatusRvIs(CKR_ENCRYPTED_DATA_LEN_RANGE));
+}
+
 }  // namespace
 }  // namespace cloud_kms::kmsp11
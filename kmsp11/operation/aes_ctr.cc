@@ -14,7 +14,10 @@
 
 #include "kmsp11/operation/aes_ctr.h"
 
+#include <algorithm>
+
 #include "absl/cleanup/cleanup.h"
+#include "common/async_call_queue.h"
 #include "common/status_macros.h"
 #include "kmsp11/kmsp11.h"
 #include "kmsp11/object.h"
@@ -31,30 +34,74 @@ constexpr size_t kIvBits = kIvBytes * 8;
 constexpr size_t kMaxPlaintextBytes = 64 * 1024;
 constexpr size_t kMaxCiphertextBytes = kMaxPlaintextBytes + 16;
 
+// Returns the counter block for the AES block that begins at byte `offset` of
+// a message whose first block uses `initial_counter`. Counter blocks are
+// incremented as 128-bit big-endian integers.
+std::string CounterBlockAt(absl::Span<const uint8_t> initial_counter,
+                           uint64_t offset) {
+  std::string block(reinterpret_cast<const char*>(initial_counter.data()),
+                    initial_counter.size());
+  uint64_t carry = offset / kIvBytes;
+  for (size_t i = block.size(); i > 0 && carry > 0; i--) {
+    carry += static_cast<uint8_t>(block[i - 1]);
+    block[i - 1] = static_cast<char>(carry & 0xff);
+    carry >>= 8;
+  }
+  return block;
+}
+
 // An implementation of EncrypterInterface that generates AES-CTR ciphertexts
 // using Cloud KMS.
 class AesCtrEncrypter : public EncrypterInterface {
  public:
-  AesCtrEncrypter(std::shared_ptr<Object> object, absl::Span<const uint8_t> iv)
-      : object_(object), iv_(iv.begin(), iv.end()) {}
+  AesCtrEncrypter(std::shared_ptr<Object> object, absl::Span<const uint8_t> iv,
+                  const RawEncryptionOptions& options)
+      : object_(object), iv_(iv.begin(), iv.end()), options_(options) {}
 
   absl::StatusOr<absl::Span<const uint8_t>> Encrypt(
       KmsClient* client, absl::Span<const uint8_t> ciphertext) override;
-  absl::Status EncryptUpdate(KmsClient* client,
-                             absl::Span<const uint8_t> plaintext_part) override;
+  absl::StatusOr<absl::Span<const uint8_t>> EncryptUpdate(
+      KmsClient* client, absl::Span<const uint8_t> plaintext_part) override;
+  size_t EncryptUpdateOutputLength() override;
   absl::StatusOr<absl::Span<const uint8_t>> EncryptFinal(
       KmsClient* client) override;
 
   virtual ~AesCtrEncrypter() {}
 
  private:
+  using CallQueue = AsyncCallQueue<kms_v1::RawEncryptResponse>;
+
   absl::StatusOr<absl::Span<const uint8_t>> EncryptInternal(
       KmsClient* client, absl::Span<const uint8_t> plaintext);
+  absl::StatusOr<absl::Span<const uint8_t>> EncryptChunked(
+      KmsClient* client, absl::Span<const uint8_t> plaintext);
+  absl::StatusOr<absl::Span<const uint8_t>> EncryptFinalStreamed(
+      KmsClient* client);
+
+  // Starts encrypting the chunk of plaintext that begins at byte `offset` of
+  // the message.
+  void StartChunk(KmsClient* client, CallQueue& calls,
+                  absl::Span<const uint8_t> chunk, uint64_t offset);
+  // Waits for the earliest call in `calls`, which encrypted `size` bytes at
+  // `offset`, and appends its ciphertext to `ciphertext`.
+  absl::Status ReceiveChunk(CallQueue& calls, uint64_t offset, size_t size,
+                            std::vector<uint8_t>& ciphertext);
+  // Appends the ciphertext of every streamed chunk to `ciphertext`.
+  absl::Status ReceiveStreamed(std::vector<uint8_t>& ciphertext);
 
   std::shared_ptr<Object> object_;
   const std::vector<uint8_t> iv_;
+  const RawEncryptionOptions options_;
   std::optional<std::vector<uint8_t, ZeroDeallocator<uint8_t>>>
       plaintext_;  // for multi-part only
+  // In chunked mode, each full chunk of multi-part plaintext is sent as soon
+  // as it is buffered. `streamed_` holds the calls whose ciphertext has not yet
+  // been returned, and `streamed_bytes_` counts the plaintext bytes sent.
+  std::unique_ptr<CallQueue> streamed_;
+  uint64_t streamed_bytes_ = 0;
+  // Ciphertext received by EncryptFinal, which is kept so that EncryptFinal
+  // may be called again after a length query.
+  std::vector<uint8_t> final_streamed_ciphertext_;
   std::vector<uint8_t> ciphertext_;
 };
 
@@ -68,26 +115,54 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCtrEncrypter::Encrypt(
   return EncryptInternal(client, plaintext);
 }
 
-absl::Status AesCtrEncrypter::EncryptUpdate(
+absl::StatusOr<absl::Span<const uint8_t>> AesCtrEncrypter::EncryptUpdate(
     KmsClient* client, absl::Span<const uint8_t> plaintext_part) {
   if (!plaintext_) {
     plaintext_.emplace();
   }
 
-  if (plaintext_part.size() + plaintext_->size() > kMaxPlaintextBytes) {
-    return NewInvalidArgumentError(
-        absl::StrFormat("plaintext length (%u bytes) exceeds maximum "
-                        "allowed (%u bytes)",
-                        plaintext_part.size() + plaintext_->size(),
-                        kMaxPlaintextBytes),
-        CKR_DATA_LEN_RANGE, SOURCE_LOCATION);
+  if (!options_.chunked) {
+    if (plaintext_part.size() + plaintext_->size() > kMaxPlaintextBytes) {
+      return NewInvalidArgumentError(
+          absl::StrFormat("plaintext length (%u bytes) exceeds maximum "
+                          "allowed (%u bytes)",
+                          plaintext_part.size() + plaintext_->size(),
+                          kMaxPlaintextBytes),
+          CKR_DATA_LEN_RANGE, SOURCE_LOCATION);
+    }
+
+    plaintext_->reserve(plaintext_->size() + plaintext_part.size());
+    plaintext_->insert(plaintext_->end(), plaintext_part.begin(),
+                       plaintext_part.end());
+    return absl::Span<const uint8_t>();
   }
 
+  // Return the ciphertext of chunks that were sent by earlier calls, and then
+  // send every chunk that this part completes.
+  ciphertext_.clear();
+  RETURN_IF_ERROR(ReceiveStreamed(ciphertext_));
+
   plaintext_->reserve(plaintext_->size() + plaintext_part.size());
   plaintext_->insert(plaintext_->end(), plaintext_part.begin(),
                      plaintext_part.end());
 
-  return absl::OkStatus();
+  if (!streamed_) {
+    streamed_ = std::make_unique<CallQueue>(options_.max_concurrent_chunks);
+  }
+  absl::Span<const uint8_t> buffered(*plaintext_);
+  while (buffered.size() >= kMaxPlaintextBytes) {
+    StartChunk(client, *streamed_, buffered.subspan(0, kMaxPlaintextBytes),
+               streamed_bytes_);
+    streamed_bytes_ += kMaxPlaintextBytes;
+    buffered.remove_prefix(kMaxPlaintextBytes);
+  }
+  plaintext_->erase(plaintext_->begin(), plaintext_->end() - buffered.size());
+
+  return ciphertext_;
+}
+
+size_t AesCtrEncrypter::EncryptUpdateOutputLength() {
+  return streamed_ ? streamed_->size() * kMaxPlaintextBytes : 0;
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> AesCtrEncrypter::EncryptFinal(
@@ -98,12 +173,18 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCtrEncrypter::EncryptFinal(
         "encryption operation",
         CKR_FUNCTION_FAILED, SOURCE_LOCATION);
   }
+  if (options_.chunked) {
+    return EncryptFinalStreamed(client);
+  }
   return EncryptInternal(client, *plaintext_);
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> AesCtrEncrypter::EncryptInternal(
     KmsClient* client, absl::Span<const uint8_t> plaintext) {
   if (plaintext.size() > kMaxPlaintextBytes) {
+    if (options_.chunked) {
+      return EncryptChunked(client, plaintext);
+    }
     return NewInvalidArgumentError(
         absl::StrFormat(
             "plaintext length (%d bytes) exceeds maximum allowed %d",
@@ -133,35 +214,168 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCtrEncrypter::EncryptInternal(
   return ciphertext_;
 }
 
+// Encrypts `plaintext` in chunks of kMaxPlaintextBytes. Each chunk begins on a
+// block boundary, so its counter block can be derived from its offset, and the
+// chunks can be encrypted concurrently.
+absl::StatusOr<absl::Span<const uint8_t>> AesCtrEncrypter::EncryptChunked(
+    KmsClient* client, absl::Span<const uint8_t> plaintext) {
+  CallQueue calls(options_.max_concurrent_chunks);
+  ciphertext_.clear();
+  ciphertext_.reserve(plaintext.size());
+
+  auto receive_front = [&]() -> absl::Status {
+    return ReceiveChunk(
+        calls, ciphertext_.size(),
+        std::min(kMaxPlaintextBytes, plaintext.size() - ciphertext_.size()),
+        ciphertext_);
+  };
+
+  for (size_t offset = 0; offset < plaintext.size();
+       offset += kMaxPlaintextBytes) {
+    if (calls.size() >= options_.max_concurrent_chunks) {
+      RETURN_IF_ERROR(receive_front());
+    }
+    StartChunk(client, calls, plaintext.subspan(offset, kMaxPlaintextBytes),
+               offset);
+  }
+
+  while (!calls.empty()) {
+    RETURN_IF_ERROR(receive_front());
+  }
+  return ciphertext_;
+}
+
+// Completes a multi-part encryption in chunked mode, where all but the last
+// partial chunk of plaintext has already been sent.
+absl::StatusOr<absl::Span<const uint8_t>> AesCtrEncrypter::EncryptFinalStreamed(
+    KmsClient* client) {
+  RETURN_IF_ERROR(ReceiveStreamed(final_streamed_ciphertext_));
+  ciphertext_ = final_streamed_ciphertext_;
+
+  if (!plaintext_->empty() || streamed_bytes_ == 0) {
+    CallQueue calls(1);
+    StartChunk(client, calls, *plaintext_, streamed_bytes_);
+    RETURN_IF_ERROR(ReceiveChunk(calls, streamed_bytes_, plaintext_->size(),
+                                 ciphertext_));
+  }
+  return ciphertext_;
+}
+
+void AesCtrEncrypter::StartChunk(KmsClient* client, CallQueue& calls,
+                                 absl::Span<const uint8_t> chunk,
+                                 uint64_t offset) {
+  kms_v1::RawEncryptRequest req;
+  req.set_name(std::string(object_->kms_key_name()));
+  req.set_plaintext(
+      std::string(reinterpret_cast<const char*>(chunk.data()), chunk.size()));
+  req.set_initialization_vector(CounterBlockAt(iv_, offset));
+  calls.Start([&](AsyncCallback<kms_v1::RawEncryptResponse> callback) {
+    client->RawEncryptAsync(std::move(req), std::move(callback));
+  });
+}
+
+absl::Status AesCtrEncrypter::ReceiveChunk(CallQueue& calls, uint64_t offset,
+                                           size_t size,
+                                           std::vector<uint8_t>& ciphertext) {
+  ASSIGN_OR_RETURN(kms_v1::RawEncryptResponse resp, calls.Pop());
+  if (resp.ciphertext().size() != size) {
+    return NewInternalError(
+        absl::StrFormat("unexpected ciphertext length for chunk at offset "
+                        "%d: got %d bytes, want %d",
+                        offset, resp.ciphertext().size(), size),
+        SOURCE_LOCATION);
+  }
+  if (resp.initialization_vector() != CounterBlockAt(iv_, offset)) {
+    return NewInternalError(
+        "the IV returned by the server does not match the chunk IV",
+        SOURCE_LOCATION);
+  }
+  ciphertext.insert(ciphertext.end(), resp.ciphertext().begin(),
+                    resp.ciphertext().end());
+  return absl::OkStatus();
+}
+
+absl::Status AesCtrEncrypter::ReceiveStreamed(
+    std::vector<uint8_t>& ciphertext) {
+  if (!streamed_) {
+    return absl::OkStatus();
+  }
+  ciphertext.reserve(ciphertext.size() +
+                     streamed_->size() * kMaxPlaintextBytes);
+  while (!streamed_->empty()) {
+    uint64_t offset =
+        streamed_bytes_ - streamed_->size() * kMaxPlaintextBytes;
+    RETURN_IF_ERROR(
+        ReceiveChunk(*streamed_, offset, kMaxPlaintextBytes, ciphertext));
+  }
+  return absl::OkStatus();
+}
+
 // An implementation of DecrypterInterface that decrypts AES-CTR ciphertexts
 // using Cloud KMS.
 class AesCtrDecrypter : public DecrypterInterface {
  public:
-  AesCtrDecrypter(std::shared_ptr<Object> object, absl::Span<const uint8_t> iv)
-      : object_(object), iv_(iv.begin(), iv.end()) {}
+  AesCtrDecrypter(std::shared_ptr<Object> object, absl::Span<const uint8_t> iv,
+                  const RawEncryptionOptions& options)
+      : object_(object), iv_(iv.begin(), iv.end()), options_(options) {}
 
   absl::StatusOr<absl::Span<const uint8_t>> Decrypt(
       KmsClient* client, absl::Span<const uint8_t> ciphertext) override;
-  absl::Status DecryptUpdate(
+  absl::StatusOr<absl::Span<const uint8_t>> DecryptUpdate(
       KmsClient* client, absl::Span<const uint8_t> ciphertext_part) override;
+  size_t DecryptUpdateOutputLength() override;
   absl::StatusOr<absl::Span<const uint8_t>> DecryptFinal(
       KmsClient* client) override;
 
   virtual ~AesCtrDecrypter() {}
 
  private:
+  using CallQueue = AsyncCallQueue<kms_v1::RawDecryptResponse>;
+
   absl::StatusOr<absl::Span<const uint8_t>> DecryptInternal(
       KmsClient* client, absl::Span<const uint8_t> ciphertext);
+  absl::StatusOr<absl::Span<const uint8_t>> DecryptChunked(
+      KmsClient* client, absl::Span<const uint8_t> ciphertext);
+  absl::StatusOr<absl::Span<const uint8_t>> DecryptFinalStreamed(
+      KmsClient* client);
+
+  // Starts decrypting the chunk of ciphertext that begins at byte `offset` of
+  // the message.
+  void StartChunk(KmsClient* client, CallQueue& calls,
+                  absl::Span<const uint8_t> chunk, uint64_t offset);
+  // Waits for the earliest call in `calls`, which decrypted `size` bytes at
+  // `offset`, and appends its plaintext to `plaintext`, which must have
+  // capacity for it.
+  absl::Status ReceiveChunk(CallQueue& calls, uint64_t offset, size_t size,
+                            std::string& plaintext);
+  // Appends the plaintext of every streamed chunk to `plaintext`.
+  absl::Status ReceiveStreamed(std::string& plaintext);
+
+  absl::Span<const uint8_t> PlaintextSpan() const {
+    return absl::MakeConstSpan(
+        reinterpret_cast<const uint8_t*>(plaintext_->data()),
+        plaintext_->size());
+  }
 
   std::shared_ptr<Object> object_;
   const std::vector<uint8_t> iv_;
+  const RawEncryptionOptions options_;
   std::optional<std::vector<uint8_t>> ciphertext_;  // for multi-part
+  // In chunked mode, each full chunk of multi-part ciphertext is sent as soon
+  // as it is buffered. `streamed_` holds the calls whose plaintext has not yet
+  // been returned, and `streamed_bytes_` counts the ciphertext bytes sent.
+  std::unique_ptr<CallQueue> streamed_;
+  uint64_t streamed_bytes_ = 0;
+  // Plaintext received by DecryptFinal, which is kept so that DecryptFinal may
+  // be called again after a length query.
+  std::unique_ptr<std::string, ZeroDelete<std::string>>
+      final_streamed_plaintext_;
   std::unique_ptr<std::string, ZeroDelete<std::string>> plaintext_;
 };
 
 absl::StatusOr<absl::Span<const uint8_t>> AesCtrDecrypter::Decrypt(
     KmsClient* client, absl::Span<const uint8_t> ciphertext) {
-  if (ciphertext.size() > kMaxCiphertextBytes) {
+  if (!options_.chunked && ciphertext.size() > kMaxCiphertextBytes) {
     return NewInvalidArgumentError(
         absl::StrFormat(
             "ciphertext length (%d bytes) exceeds maximum allowed %d",
@@ -171,26 +385,55 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCtrDecrypter::Decrypt(
   return DecryptInternal(client, ciphertext);
 }
 
-absl::Status AesCtrDecrypter::DecryptUpdate(
+absl::StatusOr<absl::Span<const uint8_t>> AesCtrDecrypter::DecryptUpdate(
     KmsClient* client, absl::Span<const uint8_t> ciphertext_part) {
   if (!ciphertext_) {
     ciphertext_.emplace();
   }
 
-  if (ciphertext_part.size() + ciphertext_->size() > kMaxCiphertextBytes) {
-    return NewInvalidArgumentError(
-        absl::StrFormat("ciphertext length (%d bytes) exceeds maximum "
-                        "allowed (%d bytes)",
-                        ciphertext_part.size() + ciphertext_->size(),
-                        kMaxCiphertextBytes),
-        CKR_DATA_LEN_RANGE, SOURCE_LOCATION);
+  if (!options_.chunked) {
+    if (ciphertext_part.size() + ciphertext_->size() > kMaxCiphertextBytes) {
+      return NewInvalidArgumentError(
+          absl::StrFormat("ciphertext length (%d bytes) exceeds maximum "
+                          "allowed (%d bytes)",
+                          ciphertext_part.size() + ciphertext_->size(),
+                          kMaxCiphertextBytes),
+          CKR_DATA_LEN_RANGE, SOURCE_LOCATION);
+    }
+
+    ciphertext_->reserve(ciphertext_->size() + ciphertext_part.size());
+    ciphertext_->insert(ciphertext_->end(), ciphertext_part.begin(),
+                        ciphertext_part.end());
+    return absl::Span<const uint8_t>();
   }
 
+  // Return the plaintext of chunks that were sent by earlier calls, and then
+  // send every chunk that this part completes.
+  plaintext_.reset(new std::string());
+  RETURN_IF_ERROR(ReceiveStreamed(*plaintext_));
+
   ciphertext_->reserve(ciphertext_->size() + ciphertext_part.size());
   ciphertext_->insert(ciphertext_->end(), ciphertext_part.begin(),
                       ciphertext_part.end());
 
-  return absl::OkStatus();
+  if (!streamed_) {
+    streamed_ = std::make_unique<CallQueue>(options_.max_concurrent_chunks);
+  }
+  absl::Span<const uint8_t> buffered(*ciphertext_);
+  while (buffered.size() >= kMaxPlaintextBytes) {
+    StartChunk(client, *streamed_, buffered.subspan(0, kMaxPlaintextBytes),
+               streamed_bytes_);
+    streamed_bytes_ += kMaxPlaintextBytes;
+    buffered.remove_prefix(kMaxPlaintextBytes);
+  }
+  ciphertext_->erase(ciphertext_->begin(),
+                     ciphertext_->end() - buffered.size());
+
+  return PlaintextSpan();
+}
+
+size_t AesCtrDecrypter::DecryptUpdateOutputLength() {
+  return streamed_ ? streamed_->size() * kMaxPlaintextBytes : 0;
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> AesCtrDecrypter::DecryptFinal(
@@ -201,11 +444,18 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCtrDecrypter::DecryptFinal(
         "decryption operation",
         CKR_FUNCTION_FAILED, SOURCE_LOCATION);
   }
+  if (options_.chunked) {
+    return DecryptFinalStreamed(client);
+  }
   return DecryptInternal(client, *ciphertext_);
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> AesCtrDecrypter::DecryptInternal(
     KmsClient* client, absl::Span<const uint8_t> ciphertext) {
+  if (options_.chunked && ciphertext.size() > kMaxCiphertextBytes) {
+    return DecryptChunked(client, ciphertext);
+  }
+
   kms_v1::RawDecryptRequest req;
   req.set_name(std::string(object_->kms_key_name()));
   req.set_ciphertext(std::string(
@@ -215,8 +465,103 @@ absl::StatusOr<absl::Span<const uint8_t>> AesCtrDecrypter::DecryptInternal(
   ASSIGN_OR_RETURN(kms_v1::RawDecryptResponse resp, client->RawDecrypt(req));
 
   plaintext_.reset(resp.release_plaintext());
-  return absl::MakeConstSpan(
-      reinterpret_cast<const uint8_t*>(plaintext_->data()), plaintext_->size());
+  return PlaintextSpan();
+}
+
+// Decrypts `ciphertext` in chunks of kMaxPlaintextBytes, which are processed
+// concurrently in the same way as in AesCtrEncrypter::EncryptChunked.
+absl::StatusOr<absl::Span<const uint8_t>> AesCtrDecrypter::DecryptChunked(
+    KmsClient* client, absl::Span<const uint8_t> ciphertext) {
+  CallQueue calls(options_.max_concurrent_chunks);
+  plaintext_.reset(new std::string());
+  plaintext_->reserve(ciphertext.size());
+
+  auto receive_front = [&]() -> absl::Status {
+    return ReceiveChunk(
+        calls, plaintext_->size(),
+        std::min(kMaxPlaintextBytes, ciphertext.size() - plaintext_->size()),
+        *plaintext_);
+  };
+
+  for (size_t offset = 0; offset < ciphertext.size();
+       offset += kMaxPlaintextBytes) {
+    if (calls.size() >= options_.max_concurrent_chunks) {
+      RETURN_IF_ERROR(receive_front());
+    }
+    StartChunk(client, calls, ciphertext.subspan(offset, kMaxPlaintextBytes),
+               offset);
+  }
+
+  while (!calls.empty()) {
+    RETURN_IF_ERROR(receive_front());
+  }
+  return PlaintextSpan();
+}
+
+// Completes a multi-part decryption in chunked mode, where all but the last
+// partial chunk of ciphertext has already been sent.
+absl::StatusOr<absl::Span<const uint8_t>> AesCtrDecrypter::DecryptFinalStreamed(
+    KmsClient* client) {
+  if (!final_streamed_plaintext_) {
+    final_streamed_plaintext_.reset(new std::string());
+  }
+  RETURN_IF_ERROR(ReceiveStreamed(*final_streamed_plaintext_));
+
+  plaintext_.reset(new std::string());
+  plaintext_->reserve(final_streamed_plaintext_->size() + ciphertext_->size());
+  plaintext_->append(*final_streamed_plaintext_);
+
+  if (!ciphertext_->empty() || streamed_bytes_ == 0) {
+    CallQueue calls(1);
+    StartChunk(client, calls, *ciphertext_, streamed_bytes_);
+    RETURN_IF_ERROR(ReceiveChunk(calls, streamed_bytes_, ciphertext_->size(),
+                                 *plaintext_));
+  }
+  return PlaintextSpan();
+}
+
+void AesCtrDecrypter::StartChunk(KmsClient* client, CallQueue& calls,
+                                 absl::Span<const uint8_t> chunk,
+                                 uint64_t offset) {
+  kms_v1::RawDecryptRequest req;
+  req.set_name(std::string(object_->kms_key_name()));
+  req.set_ciphertext(
+      std::string(reinterpret_cast<const char*>(chunk.data()), chunk.size()));
+  req.set_initialization_vector(CounterBlockAt(iv_, offset));
+  calls.Start([&](AsyncCallback<kms_v1::RawDecryptResponse> callback) {
+    client->RawDecryptAsync(std::move(req), std::move(callback));
+  });
+}
+
+absl::Status AesCtrDecrypter::ReceiveChunk(CallQueue& calls, uint64_t offset,
+                                           size_t size,
+                                           std::string& plaintext) {
+  ASSIGN_OR_RETURN(kms_v1::RawDecryptResponse resp, calls.Pop());
+  std::unique_ptr<std::string, ZeroDelete<std::string>> chunk_plaintext(
+      resp.release_plaintext());
+  if (chunk_plaintext->size() != size) {
+    return NewInternalError(
+        absl::StrFormat("unexpected plaintext length for chunk at offset "
+                        "%d: got %d bytes, want %d",
+                        offset, chunk_plaintext->size(), size),
+        SOURCE_LOCATION);
+  }
+  plaintext.append(*chunk_plaintext);
+  return absl::OkStatus();
+}
+
+absl::Status AesCtrDecrypter::ReceiveStreamed(std::string& plaintext) {
+  if (!streamed_) {
+    return absl::OkStatus();
+  }
+  plaintext.reserve(plaintext.size() + streamed_->size() * kMaxPlaintextBytes);
+  while (!streamed_->empty()) {
+    uint64_t offset =
+        streamed_bytes_ - streamed_->size() * kMaxPlaintextBytes;
+    RETURN_IF_ERROR(
+        ReceiveChunk(*streamed_, offset, kMaxPlaintextBytes, plaintext));
+  }
+  return absl::OkStatus();
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> ExtractIv(void* parameters,
@@ -242,7 +587,8 @@ absl::StatusOr<absl::Span<const uint8_t>> ExtractIv(void* parameters,
 }  // namespace
 
 absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewAesCtrEncrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism) {
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options) {
   RETURN_IF_ERROR(CheckKeyPreconditions(CKK_AES, CKO_SECRET_KEY,
                                         mechanism->mechanism, key.get()));
 
@@ -251,7 +597,7 @@ absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewAesCtrEncrypter(
       ASSIGN_OR_RETURN(
           absl::Span<const uint8_t> iv,
           ExtractIv(mechanism->pParameter, mechanism->ulParameterLen));
-      return std::make_unique<AesCtrEncrypter>(key, iv);
+      return std::make_unique<AesCtrEncrypter>(key, iv, options);
     }
     default:
       return NewInternalError(
@@ -262,7 +608,8 @@ absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewAesCtrEncrypter(
 }
 
 absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewAesCtrDecrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism) {
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options) {
   RETURN_IF_ERROR(CheckKeyPreconditions(CKK_AES, CKO_SECRET_KEY,
                                         mechanism->mechanism, key.get()));
 
@@ -271,7 +618,7 @@ absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewAesCtrDecrypter(
       ASSIGN_OR_RETURN(
           absl::Span<const uint8_t> iv,
           ExtractIv(mechanism->pParameter, mechanism->ulParameterLen));
-      return std::make_unique<AesCtrDecrypter>(key, iv);
+      return std::make_unique<AesCtrDecrypter>(key, iv, options);
     }
     default:
       return NewInternalError(
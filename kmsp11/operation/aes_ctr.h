@@ -28,11 +28,13 @@ namespace cloud_kms::kmsp11 {
 
 // Returns an AesCtrEncrypter.
 absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewAesCtrEncrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism);
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options = RawEncryptionOptions());
 
 // Returns an AesCtrDecrypter.
 absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewAesCtrDecrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism);
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options = RawEncryptionOptions());
 
 }  // namespace cloud_kms::kmsp11
 
@@ -15,6 +15,8 @@
 #include "kmsp11/operation/aes_ctr.h"
 
 #include "common/kms_client.h"
+#include "common/openssl.h"
+#include "common/status_macros.h"
 #include "common/test/runfiles.h"
 #include "common/test/test_status_macros.h"
 #include "fakekms/cpp/fakekms.h"
@@ -307,5 +309,219 @@ TEST_F(AesCtrTest, DecryptFailureKeyDisabled) {
               StatusRvIs(CKR_DEVICE_ERROR));
 }
 
+class AesCtrChunkedTest : public AesCtrTest {
+ protected:
+  void SetUp() override {
+    ASSERT_NO_FATAL_FAILURE(AesCtrTest::SetUp());
+
+    // The low 64 bits of the counter overflow during the second chunk.
+    iv_ = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+           0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf0, 0x00};
+    CK_AES_CTR_PARAMS params = NewCtrParams(iv_.data());
+    CK_MECHANISM mechanism = NewAesCtrMechanism(&params);
+    RawEncryptionOptions options{.chunked = true, .max_concurrent_chunks = 2};
+
+    ASSERT_OK_AND_ASSIGN(encrypter_,
+                         NewAesCtrEncrypter(prv_, &mechanism, options));
+    ASSERT_OK_AND_ASSIGN(decrypter_,
+                         NewAesCtrDecrypter(prv_, &mechanism, options));
+  }
+
+  // Returns the counter block that is `blocks` blocks after `iv`, computed with
+  // BoringSSL's BIGNUM arithmetic.
+  static std::string CounterBlockAfter(absl::Span<const uint8_t> iv,
+                                       uint64_t blocks) {
+    bssl::UniquePtr<BIGNUM> counter(BN_bin2bn(iv.data(), iv.size(), nullptr));
+    BN_add_word(counter.get(), blocks);
+    BN_mask_bits(counter.get(), 128);
+
+    std::string block(16, '\0');
+    BN_bn2bin(counter.get(), reinterpret_cast<uint8_t*>(block.data()) +
+                                 block.size() - BN_num_bytes(counter.get()));
+    return block;
+  }
+
+  // Encrypts `plaintext` with a single RawEncrypt request, in which Cloud KMS
+  // advances the counter from `initial_counter` itself.
+  absl::StatusOr<std::vector<uint8_t>> EncryptInOneRequest(
+      absl::Span<const uint8_t> plaintext, const std::string& initial_counter) {
+    kms_v1::RawEncryptRequest req;
+    req.set_name(kms_key_name_);
+    req.set_plaintext(plaintext.data(), plaintext.size());
+    req.set_initialization_vector(initial_counter);
+    ASSIGN_OR_RETURN(kms_v1::RawEncryptResponse resp, client_->RawEncrypt(req));
+    return std::vector<uint8_t>(resp.ciphertext().begin(),
+                                resp.ciphertext().end());
+  }
+
+  // Encrypts `plaintext` with one sequential request per 64 KiB chunk, using
+  // counter blocks computed with BoringSSL's BIGNUM arithmetic.
+  absl::StatusOr<std::vector<uint8_t>> ReferenceEncrypt(
+      absl::Span<const uint8_t> plaintext) {
+    std::vector<uint8_t> ciphertext;
+    for (size_t offset = 0; offset < plaintext.size(); offset += kChunkSize) {
+      ASSIGN_OR_RETURN(
+          std::vector<uint8_t> chunk_ciphertext,
+          EncryptInOneRequest(plaintext.subspan(offset, kChunkSize),
+                              CounterBlockAfter(iv_, offset / 16)));
+      ciphertext.insert(ciphertext.end(), chunk_ciphertext.begin(),
+                        chunk_ciphertext.end());
+    }
+    return ciphertext;
+  }
+
+  static constexpr size_t kChunkSize = 64 * 1024;
+};
+
+TEST_F(AesCtrChunkedTest, EncryptMatchesReference) {
+  std::string plaintext = RandBytes(3 * kChunkSize + 123);
+  std::vector<uint8_t> plaintext_bytes(plaintext.begin(), plaintext.end());
+
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> ciphertext,
+                       encrypter_->Encrypt(client_.get(), plaintext_bytes));
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> expected,
+                       ReferenceEncrypt(plaintext_bytes));
+
+  EXPECT_EQ(std::vector<uint8_t>(ciphertext.begin(), ciphertext.end()),
+            expected);
+}
+
+// EncryptMatchesReference splits the message at the same boundaries as the
+// encrypter, so it can't tell whether the counter block that starts each chunk
+// is the one Cloud KMS would reach within a single request. Check that here
+// instead: a single request that starts halfway through the first chunk must
+// produce the same ciphertext as the encrypter does across the boundary.
+TEST_F(AesCtrChunkedTest, ChunkBoundaryCounterMatchesServerCounter) {
+  std::vector<std::vector<uint8_t>> ivs = {
+      // The low 64 bits of the counter carry at the chunk boundary.
+      iv_,
+      // The counter wraps around 128 bits at the chunk boundary.
+      {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+       0xff, 0xff, 0xf0, 0x00},
+      // No carry beyond the low bytes.
+      std::vector<uint8_t>(16, 0x01),
+  };
+  std::string plaintext = RandBytes(kChunkSize + kChunkSize / 2);
+  std::vector<uint8_t> plaintext_bytes(plaintext.begin(), plaintext.end());
+  absl::Span<const uint8_t> plaintext_span(plaintext_bytes);
+  constexpr size_t kOffset = kChunkSize / 2;
+
+  for (size_t i = 0; i < ivs.size(); i++) {
+    CK_AES_CTR_PARAMS params = NewCtrParams(ivs[i].data());
+    CK_MECHANISM mechanism = NewAesCtrMechanism(&params);
+    RawEncryptionOptions options{.chunked = true};
+    ASSERT_OK_AND_ASSIGN(std::unique_ptr<EncrypterInterface> encrypter,
+                         NewAesCtrEncrypter(prv_, &mechanism, options));
+    ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> ciphertext,
+                         encrypter->Encrypt(client_.get(), plaintext_bytes));
+
+    ASSERT_OK_AND_ASSIGN(
+        std::vector<uint8_t> spanning,
+        EncryptInOneRequest(plaintext_span.subspan(kOffset, kChunkSize),
+                            CounterBlockAfter(ivs[i], kOffset / 16)));
+    EXPECT_EQ(std::vector<uint8_t>(ciphertext.begin() + kOffset,
+                                   ciphertext.end()),
+              spanning)
+        << "ivs[" << i << "]";
+  }
+}
+
+TEST_F(AesCtrChunkedTest, EncryptUpdateMatchesReference) {
+  std::string plaintext = RandBytes(2 * kChunkSize + 17);
+  std::vector<uint8_t> plaintext_bytes(plaintext.begin(), plaintext.end());
+  absl::Span<const uint8_t> plaintext_span(plaintext_bytes);
+
+  // Each full chunk is sent when it is buffered, and its ciphertext is
+  // returned by the next call.
+  EXPECT_EQ(encrypter_->EncryptUpdateOutputLength(), 0);
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> output,
+                       encrypter_->EncryptUpdate(
+                           client_.get(), plaintext_span.subspan(0, 70000)));
+  EXPECT_TRUE(output.empty());
+
+  EXPECT_EQ(encrypter_->EncryptUpdateOutputLength(), kChunkSize);
+  ASSERT_OK_AND_ASSIGN(
+      output,
+      encrypter_->EncryptUpdate(client_.get(), plaintext_span.subspan(70000)));
+  std::vector<uint8_t> ciphertext(output.begin(), output.end());
+  EXPECT_EQ(ciphertext.size(), kChunkSize);
+
+  ASSERT_OK_AND_ASSIGN(output, encrypter_->EncryptFinal(client_.get()));
+  EXPECT_EQ(output.size(), kChunkSize + 17);
+  ciphertext.insert(ciphertext.end(), output.begin(), output.end());
+
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> expected,
+                       ReferenceEncrypt(plaintext_bytes));
+  EXPECT_EQ(ciphertext, expected);
+}
+
+TEST_F(AesCtrChunkedTest, EncryptFinalMayBeRepeated) {
+  std::vector<uint8_t> plaintext(kChunkSize + 100, 'a');
+
+  ASSERT_OK(encrypter_->EncryptUpdate(client_.get(), plaintext));
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> ciphertext,
+                       encrypter_->EncryptFinal(client_.get()));
+  std::vector<uint8_t> first(ciphertext.begin(), ciphertext.end());
+  ASSERT_OK_AND_ASSIGN(ciphertext, encrypter_->EncryptFinal(client_.get()));
+
+  EXPECT_EQ(first.size(), plaintext.size());
+  EXPECT_EQ(std::vector<uint8_t>(ciphertext.begin(), ciphertext.end()), first);
+}
+
+TEST_F(AesCtrChunkedTest, DecryptRecoversReferencePlaintext) {
+  std::string plaintext = RandBytes(4 * kChunkSize);
+  std::vector<uint8_t> plaintext_bytes(plaintext.begin(), plaintext.end());
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       ReferenceEncrypt(plaintext_bytes));
+
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> recovered_plaintext,
+                       decrypter_->Decrypt(client_.get(), ciphertext));
+
+  EXPECT_EQ(recovered_plaintext, plaintext_bytes);
+}
+
+TEST_F(AesCtrChunkedTest, DecryptUpdateRecoversReferencePlaintext) {
+  std::string plaintext = RandBytes(kChunkSize + 1);
+  std::vector<uint8_t> plaintext_bytes(plaintext.begin(), plaintext.end());
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       ReferenceEncrypt(plaintext_bytes));
+  absl::Span<const uint8_t> ciphertext_span(ciphertext);
+
+  ASSERT_OK_AND_ASSIGN(
+      absl::Span<const uint8_t> output,
+      decrypter_->DecryptUpdate(client_.get(),
+                                ciphertext_span.subspan(0, kChunkSize)));
+  EXPECT_TRUE(output.empty());
+
+  EXPECT_EQ(decrypter_->DecryptUpdateOutputLength(), kChunkSize);
+  ASSERT_OK_AND_ASSIGN(
+      output, decrypter_->DecryptUpdate(client_.get(),
+                                        ciphertext_span.subspan(kChunkSize)));
+  std::vector<uint8_t> recovered_plaintext(output.begin(), output.end());
+  EXPECT_EQ(recovered_plaintext.size(), kChunkSize);
+
+  ASSERT_OK_AND_ASSIGN(output, decrypter_->DecryptFinal(client_.get()));
+  recovered_plaintext.insert(recovered_plaintext.end(), output.begin(),
+                             output.end());
+
+  EXPECT_EQ(recovered_plaintext, plaintext_bytes);
+}
+
+TEST_F(AesCtrChunkedTest, EncryptFailureKeyDisabled) {
+  kms_v1::CryptoKeyVersion ckv;
+  ckv.set_name(kms_key_name_);
+  ckv.set_state(kms_v1::CryptoKeyVersion::DISABLED);
+
+  google::protobuf::FieldMask update_mask;
+  update_mask.add_paths("state");
+
+  UpdateCryptoKeyVersionOrDie(fake_server_->NewClient().get(), ckv,
+                              update_mask);
+
+  std::vector<uint8_t> plaintext(3 * kChunkSize);
+  EXPECT_THAT(encrypter_->Encrypt(client_.get(), plaintext),
+              StatusRvIs(CKR_DEVICE_ERROR));
+}
+
 }  // namespace
 }  // namespace cloud_kms::kmsp11
@@ -44,8 +44,8 @@ class AesGcmEncrypter : public EncrypterInterface {
 
   absl::StatusOr<absl::Span<const uint8_t>> Encrypt(
       KmsClient* client, absl::Span<const uint8_t> ciphertext) override;
-  absl::Status EncryptUpdate(KmsClient* client,
-                             absl::Span<const uint8_t> plaintext_part) override;
+  absl::StatusOr<absl::Span<const uint8_t>> EncryptUpdate(
+      KmsClient* client, absl::Span<const uint8_t> plaintext_part) override;
   absl::StatusOr<absl::Span<const uint8_t>> EncryptFinal(
       KmsClient* client) override;
 
@@ -82,7 +82,7 @@ absl::StatusOr<absl::Span<const uint8_t>> AesGcmEncrypter::Encrypt(
   return EncryptInternal(client, plaintext);
 }
 
-absl::Status AesGcmEncrypter::EncryptUpdate(
+absl::StatusOr<absl::Span<const uint8_t>> AesGcmEncrypter::EncryptUpdate(
     KmsClient* client, absl::Span<const uint8_t> plaintext_part) {
   if (!plaintext_) {
     plaintext_.emplace();
@@ -101,7 +101,8 @@ absl::Status AesGcmEncrypter::EncryptUpdate(
   plaintext_->insert(plaintext_->end(), plaintext_part.begin(),
                      plaintext_part.end());
 
-  return absl::OkStatus();
+  // The ciphertext is produced by EncryptFinal.
+  return absl::Span<const uint8_t>();
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> AesGcmEncrypter::EncryptFinal(
@@ -148,7 +149,7 @@ class AesGcmDecrypter : public DecrypterInterface {
 
   absl::StatusOr<absl::Span<const uint8_t>> Decrypt(
       KmsClient* client, absl::Span<const uint8_t> ciphertext) override;
-  absl::Status DecryptUpdate(
+  absl::StatusOr<absl::Span<const uint8_t>> DecryptUpdate(
       KmsClient* client, absl::Span<const uint8_t> ciphertext_part) override;
   absl::StatusOr<absl::Span<const uint8_t>> DecryptFinal(
       KmsClient* client) override;
@@ -179,7 +180,7 @@ absl::StatusOr<absl::Span<const uint8_t>> AesGcmDecrypter::Decrypt(
   return DecryptInternal(client, ciphertext);
 }
 
-absl::Status AesGcmDecrypter::DecryptUpdate(
+absl::StatusOr<absl::Span<const uint8_t>> AesGcmDecrypter::DecryptUpdate(
     KmsClient* client, absl::Span<const uint8_t> ciphertext_part) {
   if (!ciphertext_) {
     ciphertext_.emplace();
@@ -198,7 +199,8 @@ absl::Status AesGcmDecrypter::DecryptUpdate(
   ciphertext_->insert(ciphertext_->end(), ciphertext_part.begin(),
                       ciphertext_part.end());
 
-  return absl::OkStatus();
+  // The plaintext is produced by DecryptFinal.
+  return absl::Span<const uint8_t>();
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> AesGcmDecrypter::DecryptFinal(
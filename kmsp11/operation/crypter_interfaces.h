@@ -24,18 +24,47 @@
 
 namespace cloud_kms::kmsp11 {
 
+class DataKeyCache;
+class DecryptResultCache;
+
+// Library-wide options for encryption and decryption operations. Most apply
+// to operations that use raw symmetric encryption keys.
+struct RawEncryptionOptions {
+  // If true, messages that exceed the size limit of a single Cloud KMS request
+  // are split into chunks that are processed with concurrent requests, where
+  // the mode of operation allows it. Multi-part operations send each chunk as
+  // soon as it is buffered, and return its output from a later Update call.
+  bool chunked = false;
+  // The maximum number of chunk requests in flight at once for a single
+  // operation.
+  size_t max_concurrent_chunks = 16;
+  // The data keys shared by CKM_CLOUDKMS_ENVELOPE_AES_GCM operations. If null,
+  // each operation uses its own data key.
+  DataKeyCache* data_key_cache = nullptr;
+  // Plaintexts of earlier CKM_RSA_PKCS_OAEP decryptions. If null, each
+  // decryption calls Cloud KMS.
+  DecryptResultCache* decrypt_result_cache = nullptr;
+};
+
 class EncrypterInterface {
  public:
   virtual absl::StatusOr<absl::Span<const uint8_t>> Encrypt(
       KmsClient* client, absl::Span<const uint8_t> plaintext) = 0;
 
-  virtual absl::Status EncryptUpdate(KmsClient* client,
-                                     absl::Span<const uint8_t> plaintext_part) {
+  // Continues a multi-part encryption, and returns any ciphertext that is ready
+  // to be passed to the caller. The returned ciphertext was produced by
+  // earlier parts, so its length is known before `plaintext_part` is accepted.
+  virtual absl::StatusOr<absl::Span<const uint8_t>> EncryptUpdate(
+      KmsClient* client, absl::Span<const uint8_t> plaintext_part) {
     return FailedPreconditionError(
         "provided mechanism does not support multi-part encryption",
         CKR_FUNCTION_FAILED, SOURCE_LOCATION);
   }
 
+  // Returns the length of the ciphertext that the next call to EncryptUpdate
+  // will return.
+  virtual size_t EncryptUpdateOutputLength() { return 0; }
+
   virtual absl::StatusOr<absl::Span<const uint8_t>> EncryptFinal(
       KmsClient* client) {
     return FailedPreconditionError(
@@ -51,13 +80,20 @@ class DecrypterInterface {
   virtual absl::StatusOr<absl::Span<const uint8_t>> Decrypt(
       KmsClient* client, absl::Span<const uint8_t> ciphertext) = 0;
 
-  virtual absl::Status DecryptUpdate(KmsClient* client,
-                                     absl::Span<const uint8_t> ciphertext) {
+  // Continues a multi-part decryption, and returns any plaintext that is ready
+  // to be passed to the caller. The returned plaintext was produced by earlier
+  // parts, so its length is known before `ciphertext` is accepted.
+  virtual absl::StatusOr<absl::Span<const uint8_t>> DecryptUpdate(
+      KmsClient* client, absl::Span<const uint8_t> ciphertext) {
     return FailedPreconditionError(
         "provided mechanism does not support multi-part decryption",
         CKR_FUNCTION_FAILED, SOURCE_LOCATION);
   }
 
+  // Returns the length of the plaintext that the next call to DecryptUpdate
+  // will return.
+  virtual size_t DecryptUpdateOutputLength() { return 0; }
+
   virtual absl::StatusOr<absl::Span<const uint8_t>> DecryptFinal(
       KmsClient* client) {
     return FailedPreconditionError(
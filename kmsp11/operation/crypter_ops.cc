@@ -19,6 +19,7 @@
 #include "kmsp11/operation/aes_ctr.h"
 #include "kmsp11/operation/aes_gcm.h"
 #include "kmsp11/operation/ecdsa.h"
+#include "kmsp11/operation/envelope_aes_gcm.h"
 #include "kmsp11/operation/hmac.h"
 #include "kmsp11/operation/rsaes_oaep.h"
 #include "kmsp11/operation/rsassa_pkcs1.h"
@@ -28,12 +29,13 @@
 
 namespace cloud_kms::kmsp11 {
 
-absl::StatusOr<DecryptOp> NewDecryptOp(std::shared_ptr<Object> key,
-                                       const CK_MECHANISM* mechanism,
-                                       bool allow_raw_encryption_keys) {
+absl::StatusOr<DecryptOp> NewDecryptOp(
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    bool allow_raw_encryption_keys,
+    const RawEncryptionOptions& raw_encryption_options) {
   switch (mechanism->mechanism) {
     case CKM_RSA_PKCS_OAEP:
-      return NewRsaOaepDecrypter(key, mechanism);
+      return NewRsaOaepDecrypter(key, mechanism, raw_encryption_options);
     case CKM_AES_GCM:
       return NewInvalidArgumentError(
           absl::StrFormat(
@@ -47,15 +49,21 @@ absl::StatusOr<DecryptOp> NewDecryptOp(std::shared_ptr<Object> key,
         return NewAesGcmDecrypter(key, mechanism);
       }
       ABSL_FALLTHROUGH_INTENDED;
+    case CKM_CLOUDKMS_ENVELOPE_AES_GCM:
+      if (allow_raw_encryption_keys) {
+        return NewEnvelopeAesGcmDecrypter(key, mechanism,
+                                          raw_encryption_options);
+      }
+      ABSL_FALLTHROUGH_INTENDED;
     case CKM_AES_CTR:
       if (allow_raw_encryption_keys) {
-        return NewAesCtrDecrypter(key, mechanism);
+        return NewAesCtrDecrypter(key, mechanism, raw_encryption_options);
       }
       ABSL_FALLTHROUGH_INTENDED;
     case CKM_AES_CBC:
     case CKM_AES_CBC_PAD:
       if (allow_raw_encryption_keys) {
-        return NewAesCbcDecrypter(key, mechanism);
+        return NewAesCbcDecrypter(key, mechanism, raw_encryption_options);
       }
       ABSL_FALLTHROUGH_INTENDED;
     default:
@@ -64,9 +72,10 @@ absl::StatusOr<DecryptOp> NewDecryptOp(std::shared_ptr<Object> key,
   }
 }
 
-absl::StatusOr<EncryptOp> NewEncryptOp(std::shared_ptr<Object> key,
-                                       const CK_MECHANISM* mechanism,
-                                       bool allow_raw_encryption_keys) {
+absl::StatusOr<EncryptOp> NewEncryptOp(
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    bool allow_raw_encryption_keys,
+    const RawEncryptionOptions& raw_encryption_options) {
   switch (mechanism->mechanism) {
     case CKM_RSA_PKCS_OAEP:
       return NewRsaOaepEncrypter(key, mechanism);
@@ -83,15 +92,21 @@ absl::StatusOr<EncryptOp> NewEncryptOp(std::shared_ptr<Object> key,
         return NewAesGcmEncrypter(key, mechanism);
       }
       ABSL_FALLTHROUGH_INTENDED;
+    case CKM_CLOUDKMS_ENVELOPE_AES_GCM:
+      if (allow_raw_encryption_keys) {
+        return NewEnvelopeAesGcmEncrypter(key, mechanism,
+                                          raw_encryption_options);
+      }
+      ABSL_FALLTHROUGH_INTENDED;
     case CKM_AES_CTR:
       if (allow_raw_encryption_keys) {
-        return NewAesCtrEncrypter(key, mechanism);
+        return NewAesCtrEncrypter(key, mechanism, raw_encryption_options);
       }
       ABSL_FALLTHROUGH_INTENDED;
     case CKM_AES_CBC:
     case CKM_AES_CBC_PAD:
       if (allow_raw_encryption_keys) {
-        return NewAesCbcEncrypter(key, mechanism);
+        return NewAesCbcEncrypter(key, mechanism, raw_encryption_options);
       }
       ABSL_FALLTHROUGH_INTENDED;
     default:
@@ -23,15 +23,19 @@ namespace cloud_kms::kmsp11 {
 
 using DecryptOp = std::unique_ptr<DecrypterInterface>;
 
-absl::StatusOr<DecryptOp> NewDecryptOp(std::shared_ptr<Object> key,
-                                       const CK_MECHANISM* mechanism,
-                                       bool allow_raw_encryption_keys = false);
+absl::StatusOr<DecryptOp> NewDecryptOp(
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    bool allow_raw_encryption_keys = false,
+    const RawEncryptionOptions& raw_encryption_options =
+        RawEncryptionOptions());
 
 using EncryptOp = std::unique_ptr<EncrypterInterface>;
 
-absl::StatusOr<EncryptOp> NewEncryptOp(std::shared_ptr<Object> key,
-                                       const CK_MECHANISM* mechanism,
-                                       bool allow_raw_encryption_keys = false);
+absl::StatusOr<EncryptOp> NewEncryptOp(
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    bool allow_raw_encryption_keys = false,
+    const RawEncryptionOptions& raw_encryption_options =
+        RawEncryptionOptions());
 
 using SignOp = std::unique_ptr<SignerInterface>;
 
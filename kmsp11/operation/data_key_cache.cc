@@ -0,0 +1,151 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kmsp11/operation/data_key_cache.h"
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "common/openssl.h"
+#include "common/status_macros.h"
+
+namespace cloud_kms::kmsp11 {
+
+absl::StatusOr<std::shared_ptr<const DataKey>> NewDataKey(size_t key_length,
+                                                          WrapFunction wrap) {
+  auto key = std::make_shared<DataKey>();
+  key->key.resize(key_length);
+  RAND_bytes(key->key.data(), key->key.size());
+  ASSIGN_OR_RETURN(key->wrapped_key, wrap(key->key));
+  return key;
+}
+
+absl::StatusOr<std::shared_ptr<const DataKey>> UnwrapDataKey(
+    std::string_view wrapped_key, UnwrapFunction unwrap) {
+  using ZeroizedString = std::unique_ptr<std::string, ZeroDelete<std::string>>;
+  ASSIGN_OR_RETURN(ZeroizedString bytes, unwrap(wrapped_key));
+  auto key = std::make_shared<DataKey>();
+  key->key.assign(bytes->begin(), bytes->end());
+  key->wrapped_key = std::string(wrapped_key);
+  return key;
+}
+
+absl::StatusOr<std::shared_ptr<const DataKey>> DataKeyCache::GetEncryptionKey(
+    std::string_view kek_name, WrapFunction wrap, absl::Time now) {
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = encryption_keys_.find(kek_name);
+    if (it != encryption_keys_.end() &&
+        it->second.messages < options_.max_messages &&
+        now - it->second.created < options_.max_lifetime) {
+      it->second.messages++;
+      return it->second.key;
+    }
+  }
+
+  // Wrapping the new key is a Cloud KMS call, so the lock is not held while it
+  // happens. Concurrent callers may each generate a key, in which case the last
+  // one to be generated becomes the current key.
+  ASSIGN_OR_RETURN(std::shared_ptr<const DataKey> key,
+                   NewDataKey(options_.key_length, wrap));
+
+  absl::MutexLock lock(&mutex_);
+  encryption_keys_.insert_or_assign(std::string(kek_name),
+                                    EncryptionKey{key, now, 1});
+  // Messages encrypted in this process may also be decrypted here, so make the
+  // key available for decryption without unwrapping it.
+  InsertUnwrappedKey(kek_name, key, now);
+  return key;
+}
+
+absl::StatusOr<std::shared_ptr<const DataKey>> DataKeyCache::GetDecryptionKey(
+    std::string_view kek_name, std::string_view wrapped_key,
+    UnwrapFunction unwrap, absl::Time now) {
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = unwrapped_key_index_.find(
+        UnwrappedKeyId(std::string(kek_name), std::string(wrapped_key)));
+    if (it != unwrapped_key_index_.end()) {
+      if (now - it->second->created < options_.max_lifetime) {
+        unwrapped_keys_.splice(unwrapped_keys_.begin(), unwrapped_keys_,
+                               it->second);
+        return it->second->key;
+      }
+      unwrapped_keys_.erase(it->second);
+      unwrapped_key_index_.erase(it);
+    }
+  }
+
+  ASSIGN_OR_RETURN(std::shared_ptr<const DataKey> key,
+                   UnwrapDataKey(wrapped_key, unwrap));
+
+  absl::MutexLock lock(&mutex_);
+  InsertUnwrappedKey(kek_name, key, now);
+  return key;
+}
+
+void DataKeyCache::RetainKeyVersions(
+    std::string_view key_ring_name,
+    const absl::flat_hash_set<std::string>& kek_names) {
+  std::string prefix = absl::StrCat(key_ring_name, "/");
+  auto is_missing = [&](const std::string& kek_name) {
+    return absl::StartsWith(kek_name, prefix) && !kek_names.contains(kek_name);
+  };
+
+  absl::MutexLock lock(&mutex_);
+  absl::erase_if(encryption_keys_,
+                 [&](const auto& entry) { return is_missing(entry.first); });
+  for (auto it = unwrapped_keys_.begin(); it != unwrapped_keys_.end();) {
+    if (is_missing(it->id.first)) {
+      unwrapped_key_index_.erase(it->id);
+      it = unwrapped_keys_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t DataKeyCache::unwrapped_key_count() const {
+  absl::MutexLock lock(&mutex_);
+  return unwrapped_keys_.size();
+}
+
+void DataKeyCache::InsertUnwrappedKey(std::string_view kek_name,
+                                      std::shared_ptr<const DataKey> key,
+                                      absl::Time now) {
+  if (options_.max_unwrapped_keys == 0) {
+    return;
+  }
+
+  UnwrappedKeyId id(std::string(kek_name), key->wrapped_key);
+  auto it = unwrapped_key_index_.find(id);
+  if (it != unwrapped_key_index_.end()) {
+    unwrapped_keys_.erase(it->second);
+    unwrapped_key_index_.erase(it);
+  }
+
+  unwrapped_keys_.push_front(UnwrappedKey{id, std::move(key), now});
+  unwrapped_key_index_.emplace(std::move(id), unwrapped_keys_.begin());
+
+  while (!unwrapped_keys_.empty() &&
+         (unwrapped_keys_.size() > options_.max_unwrapped_keys ||
+          now - unwrapped_keys_.back().created >= options_.max_lifetime)) {
+    unwrapped_key_index_.erase(unwrapped_keys_.back().id);
+    unwrapped_keys_.pop_back();
+  }
+}
+
+}  // namespace cloud_kms::kmsp11
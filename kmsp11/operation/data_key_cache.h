@@ -0,0 +1,151 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMSP11_OPERATION_DATA_KEY_CACHE_H_
+#define KMSP11_OPERATION_DATA_KEY_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "kmsp11/util/crypto_utils.h"
+
+namespace cloud_kms::kmsp11 {
+
+// A data encryption key (DEK) for envelope encryption.
+struct DataKey {
+  // The key bytes, which are zeroed when the key is destroyed.
+  std::vector<uint8_t, ZeroDeallocator<uint8_t>> key;
+  // The key, encrypted with the Cloud KMS key version that protects it.
+  std::string wrapped_key;
+};
+
+// Encrypts a data key with a Cloud KMS key version.
+using WrapFunction =
+    absl::FunctionRef<absl::StatusOr<std::string>(absl::Span<const uint8_t>)>;
+
+// Decrypts a wrapped data key with a Cloud KMS key version.
+using UnwrapFunction = absl::FunctionRef<absl::StatusOr<
+    std::unique_ptr<std::string, ZeroDelete<std::string>>>(std::string_view)>;
+
+// Generates a random data key of `key_length` bytes, and wraps it with `wrap`.
+absl::StatusOr<std::shared_ptr<const DataKey>> NewDataKey(size_t key_length,
+                                                          WrapFunction wrap);
+
+// Unwraps `wrapped_key` with `unwrap`.
+absl::StatusOr<std::shared_ptr<const DataKey>> UnwrapDataKey(
+    std::string_view wrapped_key, UnwrapFunction unwrap);
+
+// Caches the data keys used by CKM_CLOUDKMS_ENVELOPE_AES_GCM operations, so
+// that the Cloud KMS key is called once per data key rather than once per
+// message.
+//
+// For encryption, one data key is held for each Cloud KMS key version. It is
+// replaced once it has been used for `max_messages` messages, or once it is
+// older than `max_lifetime`. For decryption, up to `max_unwrapped_keys`
+// unwrapped data keys are held, and are evicted in least recently used order or
+// once they are older than `max_lifetime`. Key bytes are zeroed when the last
+// reference to a key is released.
+//
+// This class is thread-safe.
+class DataKeyCache {
+ public:
+  struct Options {
+    // The length of generated data keys, in bytes.
+    size_t key_length = 32;
+    uint64_t max_messages = 1000000;
+    absl::Duration max_lifetime = absl::Hours(1);
+    size_t max_unwrapped_keys = 1024;
+  };
+
+  explicit DataKeyCache(Options options) : options_(options) {}
+
+  DataKeyCache(const DataKeyCache&) = delete;
+  DataKeyCache& operator=(const DataKeyCache&) = delete;
+
+  // Returns the data key to use for the next message encrypted under the Cloud
+  // KMS key version `kek_name`. A new data key is generated and wrapped with
+  // `wrap` if there is no current data key for `kek_name`, or if the current
+  // data key has reached its message or lifetime limit.
+  absl::StatusOr<std::shared_ptr<const DataKey>> GetEncryptionKey(
+      std::string_view kek_name, WrapFunction wrap,
+      absl::Time now = absl::Now());
+
+  // Returns the data key that `wrapped_key` holds, which was wrapped with the
+  // Cloud KMS key version `kek_name`. The key is unwrapped with `unwrap` if it
+  // is not cached.
+  absl::StatusOr<std::shared_ptr<const DataKey>> GetDecryptionKey(
+      std::string_view kek_name, std::string_view wrapped_key,
+      UnwrapFunction unwrap, absl::Time now = absl::Now());
+
+  // Discards the data keys of key versions in the key ring `key_ring_name` that
+  // are not named in `kek_names`, so that a version that is disabled or
+  // destroyed no longer protects new messages or decrypts cached ones.
+  void RetainKeyVersions(std::string_view key_ring_name,
+                         const absl::flat_hash_set<std::string>& kek_names);
+
+  // Returns the number of unwrapped data keys that are held for decryption.
+  size_t unwrapped_key_count() const;
+
+ private:
+  struct EncryptionKey {
+    std::shared_ptr<const DataKey> key;
+    absl::Time created;
+    uint64_t messages;
+  };
+
+  // Unwrapped keys are indexed by the name of the wrapping key version and the
+  // wrapped key, so that a wrapped key is only ever matched with the key
+  // version that wrapped it.
+  using UnwrappedKeyId = std::pair<std::string, std::string>;
+
+  struct UnwrappedKey {
+    UnwrappedKeyId id;
+    std::shared_ptr<const DataKey> key;
+    absl::Time created;
+  };
+
+  void InsertUnwrappedKey(std::string_view kek_name,
+                          std::shared_ptr<const DataKey> key, absl::Time now)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const Options options_;
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, EncryptionKey> encryption_keys_
+      ABSL_GUARDED_BY(mutex_);
+  // Ordered from most to least recently used.
+  std::list<UnwrappedKey> unwrapped_keys_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<UnwrappedKeyId, std::list<UnwrappedKey>::iterator>
+      unwrapped_key_index_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace cloud_kms::kmsp11
+
+#endif  // KMSP11_OPERATION_DATA_KEY_CACHE_H_
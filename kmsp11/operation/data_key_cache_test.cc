@@ -0,0 +1,257 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kmsp11/operation/data_key_cache.h"
+
+#include "common/test/test_status_macros.h"
+#include "gmock/gmock.h"
+#include "kmsp11/test/matchers.h"
+
+namespace cloud_kms::kmsp11 {
+namespace {
+
+using ::testing::ElementsAreArray;
+using ::testing::Not;
+
+constexpr std::string_view kKek1 =
+    "projects/p/locations/l/keyRings/r/cryptoKeys/k/cryptoKeyVersions/1";
+constexpr std::string_view kKek2 =
+    "projects/p/locations/l/keyRings/r/cryptoKeys/k/cryptoKeyVersions/2";
+constexpr std::string_view kKeyRing = "projects/p/locations/l/keyRings/r";
+constexpr std::string_view kOtherRingKek =
+    "projects/p/locations/l/keyRings/r2/cryptoKeys/k/cryptoKeyVersions/1";
+
+// A reversible stand-in for Cloud KMS, which counts its calls.
+class FakeWrapper {
+ public:
+  absl::StatusOr<std::string> Wrap(absl::Span<const uint8_t> key) {
+    wraps_++;
+    return std::string(key.rbegin(), key.rend());
+  }
+
+  absl::StatusOr<std::unique_ptr<std::string, ZeroDelete<std::string>>> Unwrap(
+      std::string_view wrapped_key) {
+    unwraps_++;
+    return std::unique_ptr<std::string, ZeroDelete<std::string>>(
+        new std::string(wrapped_key.rbegin(), wrapped_key.rend()));
+  }
+
+  int wraps() const { return wraps_; }
+  int unwraps() const { return unwraps_; }
+
+ private:
+  int wraps_ = 0;
+  int unwraps_ = 0;
+};
+
+TEST(DataKeyCacheTest, EncryptionKeyIsReusedUntilMessageLimit) {
+  DataKeyCache cache(DataKeyCache::Options{.max_messages = 3});
+  FakeWrapper wrapper;
+  auto wrap = [&](absl::Span<const uint8_t> key) { return wrapper.Wrap(key); };
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> first,
+                       cache.GetEncryptionKey(kKek1, wrap));
+  EXPECT_EQ(first->key.size(), 32);
+  for (int i = 0; i < 2; i++) {
+    ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> key,
+                         cache.GetEncryptionKey(kKek1, wrap));
+    EXPECT_EQ(key, first);
+  }
+  EXPECT_EQ(wrapper.wraps(), 1);
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> second,
+                       cache.GetEncryptionKey(kKek1, wrap));
+  EXPECT_NE(second, first);
+  EXPECT_THAT(second->key, Not(ElementsAreArray(first->key)));
+  EXPECT_EQ(wrapper.wraps(), 2);
+}
+
+TEST(DataKeyCacheTest, EncryptionKeyIsReplacedAfterLifetime) {
+  DataKeyCache cache(DataKeyCache::Options{.max_lifetime = absl::Minutes(5)});
+  FakeWrapper wrapper;
+  auto wrap = [&](absl::Span<const uint8_t> key) { return wrapper.Wrap(key); };
+  absl::Time start = absl::Now();
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> first,
+                       cache.GetEncryptionKey(kKek1, wrap, start));
+  ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<const DataKey> reused,
+      cache.GetEncryptionKey(kKek1, wrap, start + absl::Minutes(4)));
+  EXPECT_EQ(reused, first);
+
+  ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<const DataKey> replaced,
+      cache.GetEncryptionKey(kKek1, wrap, start + absl::Minutes(5)));
+  EXPECT_NE(replaced, first);
+  EXPECT_EQ(wrapper.wraps(), 2);
+}
+
+TEST(DataKeyCacheTest, EncryptionKeysAreSeparatePerKeyVersion) {
+  DataKeyCache cache(DataKeyCache::Options{});
+  FakeWrapper wrapper;
+  auto wrap = [&](absl::Span<const uint8_t> key) { return wrapper.Wrap(key); };
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> key1,
+                       cache.GetEncryptionKey(kKek1, wrap));
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> key2,
+                       cache.GetEncryptionKey(kKek2, wrap));
+  EXPECT_NE(key1, key2);
+  EXPECT_EQ(wrapper.wraps(), 2);
+}
+
+TEST(DataKeyCacheTest, WrapFailureIsReturnedAndNotCached) {
+  DataKeyCache cache(DataKeyCache::Options{});
+  FakeWrapper wrapper;
+  auto fail = [](absl::Span<const uint8_t> key) -> absl::StatusOr<std::string> {
+    return absl::UnavailableError("unavailable");
+  };
+  auto wrap = [&](absl::Span<const uint8_t> key) { return wrapper.Wrap(key); };
+
+  EXPECT_THAT(cache.GetEncryptionKey(kKek1, fail),
+              StatusIs(absl::StatusCode::kUnavailable));
+  EXPECT_OK(cache.GetEncryptionKey(kKek1, wrap));
+  EXPECT_EQ(wrapper.wraps(), 1);
+}
+
+TEST(DataKeyCacheTest, GeneratedKeyIsAvailableForDecryption) {
+  DataKeyCache cache(DataKeyCache::Options{});
+  FakeWrapper wrapper;
+  auto wrap = [&](absl::Span<const uint8_t> key) { return wrapper.Wrap(key); };
+  auto unwrap = [&](std::string_view wrapped_key) {
+    return wrapper.Unwrap(wrapped_key);
+  };
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> encryption_key,
+                       cache.GetEncryptionKey(kKek1, wrap));
+  ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<const DataKey> decryption_key,
+      cache.GetDecryptionKey(kKek1, encryption_key->wrapped_key, unwrap));
+  EXPECT_EQ(decryption_key, encryption_key);
+  EXPECT_EQ(wrapper.unwraps(), 0);
+}
+
+TEST(DataKeyCacheTest, UnwrappedKeyIsCached) {
+  DataKeyCache cache(DataKeyCache::Options{});
+  FakeWrapper wrapper;
+  auto unwrap = [&](std::string_view wrapped_key) {
+    return wrapper.Unwrap(wrapped_key);
+  };
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> first,
+                       cache.GetDecryptionKey(kKek1, "wrapped", unwrap));
+  EXPECT_EQ(std::string(first->key.begin(), first->key.end()), "depparw");
+  EXPECT_EQ(first->wrapped_key, "wrapped");
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> second,
+                       cache.GetDecryptionKey(kKek1, "wrapped", unwrap));
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(wrapper.unwraps(), 1);
+}
+
+TEST(DataKeyCacheTest, UnwrappedKeyIsOnlyMatchedWithItsKeyVersion) {
+  DataKeyCache cache(DataKeyCache::Options{});
+  FakeWrapper wrapper;
+  auto unwrap = [&](std::string_view wrapped_key) {
+    return wrapper.Unwrap(wrapped_key);
+  };
+
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "wrapped", unwrap));
+  EXPECT_OK(cache.GetDecryptionKey(kKek2, "wrapped", unwrap));
+  EXPECT_EQ(wrapper.unwraps(), 2);
+}
+
+TEST(DataKeyCacheTest, UnwrappedKeysAreEvictedLeastRecentlyUsedFirst) {
+  DataKeyCache cache(DataKeyCache::Options{.max_unwrapped_keys = 2});
+  FakeWrapper wrapper;
+  auto unwrap = [&](std::string_view wrapped_key) {
+    return wrapper.Unwrap(wrapped_key);
+  };
+
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "a", unwrap));
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "b", unwrap));
+  // Use "a", so that "b" is evicted when "c" is inserted.
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "a", unwrap));
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "c", unwrap));
+  EXPECT_EQ(cache.unwrapped_key_count(), 2);
+  EXPECT_EQ(wrapper.unwraps(), 3);
+
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "a", unwrap));
+  EXPECT_EQ(wrapper.unwraps(), 3);
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "b", unwrap));
+  EXPECT_EQ(wrapper.unwraps(), 4);
+}
+
+TEST(DataKeyCacheTest, UnwrappedKeyExpiresAfterLifetime) {
+  DataKeyCache cache(DataKeyCache::Options{.max_lifetime = absl::Minutes(5)});
+  FakeWrapper wrapper;
+  auto unwrap = [&](std::string_view wrapped_key) {
+    return wrapper.Unwrap(wrapped_key);
+  };
+  absl::Time start = absl::Now();
+
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "wrapped", unwrap, start));
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "wrapped", unwrap,
+                                   start + absl::Minutes(4)));
+  EXPECT_EQ(wrapper.unwraps(), 1);
+
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, "wrapped", unwrap,
+                                   start + absl::Minutes(5)));
+  EXPECT_EQ(wrapper.unwraps(), 2);
+}
+
+TEST(DataKeyCacheTest, UnwrapFailureIsReturnedAndNotCached) {
+  DataKeyCache cache(DataKeyCache::Options{});
+  auto fail = [](std::string_view wrapped_key)
+      -> absl::StatusOr<std::unique_ptr<std::string, ZeroDelete<std::string>>> {
+    return absl::InvalidArgumentError("bad key");
+  };
+
+  EXPECT_THAT(cache.GetDecryptionKey(kKek1, "wrapped", fail),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_EQ(cache.unwrapped_key_count(), 0);
+}
+
+TEST(DataKeyCacheTest, RetainKeyVersionsDiscardsMissingVersions) {
+  DataKeyCache cache(DataKeyCache::Options{});
+  FakeWrapper wrapper;
+  auto wrap = [&](absl::Span<const uint8_t> key) { return wrapper.Wrap(key); };
+  auto unwrap = [&](std::string_view wrapped_key) {
+    return wrapper.Unwrap(wrapped_key);
+  };
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> key1,
+                       cache.GetEncryptionKey(kKek1, wrap));
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> key2,
+                       cache.GetEncryptionKey(kKek2, wrap));
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> other,
+                       cache.GetEncryptionKey(kOtherRingKek, wrap));
+  EXPECT_EQ(cache.unwrapped_key_count(), 3);
+
+  cache.RetainKeyVersions(kKeyRing, {std::string(kKek2)});
+
+  // Entries for other key rings are left alone.
+  EXPECT_EQ(cache.unwrapped_key_count(), 2);
+  EXPECT_THAT(cache.GetEncryptionKey(kKek2, wrap), IsOkAndHolds(key2));
+  EXPECT_THAT(cache.GetEncryptionKey(kOtherRingKek, wrap), IsOkAndHolds(other));
+  EXPECT_EQ(wrapper.wraps(), 3);
+
+  // The discarded key is unwrapped again, and replaced for encryption.
+  EXPECT_OK(cache.GetDecryptionKey(kKek1, key1->wrapped_key, unwrap));
+  EXPECT_EQ(wrapper.unwraps(), 1);
+  EXPECT_THAT(cache.GetEncryptionKey(kKek1, wrap), IsOkAndHolds(Not(key1)));
+  EXPECT_EQ(wrapper.wraps(), 4);
+}
+
+}  // namespace
+}  // namespace cloud_kms::kmsp11
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kmsp11/operation/decrypt_result_cache.h"
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "common/openssl.h"
+
+namespace cloud_kms::kmsp11 {
+namespace {
+
+std::string CiphertextDigest(absl::Span<const uint8_t> ciphertext) {
+  std::string digest(SHA256_DIGEST_LENGTH, '\0');
+  SHA256(ciphertext.data(), ciphertext.size(),
+         reinterpret_cast<uint8_t*>(digest.data()));
+  return digest;
+}
+
+}  // namespace
+
+std::shared_ptr<const DecryptResultCache::Plaintext> DecryptResultCache::Get(
+    std::string_view ckv_name, absl::Span<const uint8_t> ciphertext,
+    absl::Time now) {
+  EntryId id(std::string(ckv_name), CiphertextDigest(ciphertext));
+
+  absl::MutexLock lock(&mutex_);
+  auto it = index_.find(id);
+  if (it == index_.end()) {
+    misses_++;
+    return nullptr;
+  }
+  if (now - it->second->created >= options_.ttl) {
+    entries_.erase(it->second);
+    index_.erase(it);
+    misses_++;
+    return nullptr;
+  }
+
+  entries_.splice(entries_.begin(), entries_, it->second);
+  hits_++;
+  return it->second->plaintext;
+}
+
+std::shared_ptr<const DecryptResultCache::Plaintext> DecryptResultCache::Insert(
+    std::string_view ckv_name, absl::Span<const uint8_t> ciphertext,
+    absl::Span<const uint8_t> plaintext, absl::Time now) {
+  auto cached = std::make_shared<const Plaintext>(plaintext.begin(),
+                                                  plaintext.end());
+  if (options_.max_entries == 0) {
+    return cached;
+  }
+  EntryId id(std::string(ckv_name), CiphertextDigest(ciphertext));
+
+  absl::MutexLock lock(&mutex_);
+  auto it = index_.find(id);
+  if (it != index_.end()) {
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+
+  entries_.push_front(Entry{id, cached, now});
+  index_.emplace(std::move(id), entries_.begin());
+
+  while (!entries_.empty() &&
+         (entries_.size() > options_.max_entries ||
+          now - entries_.back().created >= options_.ttl)) {
+    index_.erase(entries_.back().id);
+    entries_.pop_back();
+  }
+  return cached;
+}
+
+void DecryptResultCache::RetainKeyVersions(
+    std::string_view key_ring_name,
+    const absl::flat_hash_set<std::string>& ckv_names) {
+  std::string prefix = absl::StrCat(key_ring_name, "/");
+
+  absl::MutexLock lock(&mutex_);
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    const std::string& ckv_name = it->id.first;
+    if (absl::StartsWith(ckv_name, prefix) && !ckv_names.contains(ckv_name)) {
+      index_.erase(it->id);
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t DecryptResultCache::size() const {
+  absl::MutexLock lock(&mutex_);
+  return entries_.size();
+}
+
+uint64_t DecryptResultCache::hits() const {
+  absl::MutexLock lock(&mutex_);
+  return hits_;
+}
+
+uint64_t DecryptResultCache::misses() const {
+  absl::MutexLock lock(&mutex_);
+  return misses_;
+}
+
+std::string DecryptResultCache::ToString() const {
+  absl::MutexLock lock(&mutex_);
+  return absl::StrFormat(
+      "AsymmetricDecrypt cache: entries=%d hits=%d misses=%d\n",
+      entries_.size(), hits_, misses_);
+}
+
+}  // namespace cloud_kms::kmsp11
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMSP11_OPERATION_DECRYPT_RESULT_CACHE_H_
+#define KMSP11_OPERATION_DECRYPT_RESULT_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "kmsp11/util/crypto_utils.h"
+
+namespace cloud_kms::kmsp11 {
+
+// Caches the plaintexts of RSAES-OAEP decryptions, so that a ciphertext that
+// is decrypted repeatedly (typically a wrapped data key) only costs one
+// AsymmetricDecrypt call.
+//
+// Entries are indexed by the name of the Cloud KMS key version and the SHA-256
+// digest of the ciphertext, so ciphertexts are not retained. Up to
+// `max_entries` plaintexts are held, and are evicted in least recently used
+// order or once they are older than `ttl`. Plaintexts are allocated from
+// LockedArena::Default(), so they are kept out of swap where the platform
+// allows it, and are zeroed when the last reference to them is released.
+//
+// This class is thread-safe.
+class DecryptResultCache {
+ public:
+  struct Options {
+    size_t max_entries = 1024;
+    absl::Duration ttl = absl::Minutes(5);
+  };
+
+  using Plaintext = std::vector<uint8_t, LockedZeroDeallocator<uint8_t>>;
+
+  explicit DecryptResultCache(Options options) : options_(options) {}
+
+  DecryptResultCache(const DecryptResultCache&) = delete;
+  DecryptResultCache& operator=(const DecryptResultCache&) = delete;
+
+  // Returns the cached plaintext of `ciphertext`, which was decrypted with the
+  // Cloud KMS key version `ckv_name`, or nullptr if there is none.
+  std::shared_ptr<const Plaintext> Get(std::string_view ckv_name,
+                                       absl::Span<const uint8_t> ciphertext,
+                                       absl::Time now = absl::Now());
+
+  // Caches `plaintext` as the result of decrypting `ciphertext` with the Cloud
+  // KMS key version `ckv_name`, and returns the cached copy.
+  std::shared_ptr<const Plaintext> Insert(std::string_view ckv_name,
+                                          absl::Span<const uint8_t> ciphertext,
+                                          absl::Span<const uint8_t> plaintext,
+                                          absl::Time now = absl::Now());
+
+  // Evicts the entries for key versions in the key ring `key_ring_name` that
+  // are not named in `ckv_names`.
+  void RetainKeyVersions(std::string_view key_ring_name,
+                         const absl::flat_hash_set<std::string>& ckv_names);
+
+  size_t size() const;
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+  // Returns a one-line report of the cache's hit and miss counts.
+  std::string ToString() const;
+
+ private:
+  // The key version name and the ciphertext digest.
+  using EntryId = std::pair<std::string, std::string>;
+
+  struct Entry {
+    EntryId id;
+    std::shared_ptr<const Plaintext> plaintext;
+    absl::Time created;
+  };
+
+  const Options options_;
+
+  mutable absl::Mutex mutex_;
+  // Ordered from most to least recently used.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<EntryId, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+  uint64_t hits_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t misses_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace cloud_kms::kmsp11
+
+#endif  // KMSP11_OPERATION_DECRYPT_RESULT_CACHE_H_
@@ -0,0 +1,125 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kmsp11/operation/decrypt_result_cache.h"
+
+#include "gmock/gmock.h"
+
+namespace cloud_kms::kmsp11 {
+namespace {
+
+using ::testing::ElementsAreArray;
+using ::testing::IsNull;
+using ::testing::NotNull;
+using ::testing::Pointee;
+
+constexpr std::string_view kKeyRing = "projects/p/locations/l/keyRings/r";
+constexpr std::string_view kCkv1 =
+    "projects/p/locations/l/keyRings/r/cryptoKeys/k/cryptoKeyVersions/1";
+constexpr std::string_view kCkv2 =
+    "projects/p/locations/l/keyRings/r/cryptoKeys/k/cryptoKeyVersions/2";
+constexpr std::string_view kOtherRingCkv =
+    "projects/p/locations/l/keyRings/r2/cryptoKeys/k/cryptoKeyVersions/1";
+
+const std::vector<uint8_t> kCiphertext1 = {0x01, 0x02, 0x03};
+const std::vector<uint8_t> kCiphertext2 = {0x04, 0x05, 0x06};
+const std::vector<uint8_t> kPlaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+
+TEST(DecryptResultCacheTest, InsertedPlaintextIsReturned) {
+  DecryptResultCache cache(DecryptResultCache::Options{});
+
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext1), IsNull());
+  EXPECT_THAT(cache.Insert(kCkv1, kCiphertext1, kPlaintext),
+              Pointee(ElementsAreArray(kPlaintext)));
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext1),
+              Pointee(ElementsAreArray(kPlaintext)));
+
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.misses(), 1);
+}
+
+TEST(DecryptResultCacheTest, PlaintextIsOnlyMatchedWithItsKeyVersion) {
+  DecryptResultCache cache(DecryptResultCache::Options{});
+  cache.Insert(kCkv1, kCiphertext1, kPlaintext);
+
+  EXPECT_THAT(cache.Get(kCkv2, kCiphertext1), IsNull());
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext2), IsNull());
+  EXPECT_EQ(cache.misses(), 2);
+}
+
+TEST(DecryptResultCacheTest, EntriesAreEvictedLeastRecentlyUsedFirst) {
+  DecryptResultCache cache(DecryptResultCache::Options{.max_entries = 2});
+  std::vector<uint8_t> ciphertext3 = {0x07, 0x08, 0x09};
+
+  cache.Insert(kCkv1, kCiphertext1, kPlaintext);
+  cache.Insert(kCkv1, kCiphertext2, kPlaintext);
+  // Use the first entry, so that the second is evicted by the third.
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext1), NotNull());
+  cache.Insert(kCkv1, ciphertext3, kPlaintext);
+
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext1), NotNull());
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext2), IsNull());
+  EXPECT_THAT(cache.Get(kCkv1, ciphertext3), NotNull());
+}
+
+TEST(DecryptResultCacheTest, EntryExpiresAfterTtl) {
+  DecryptResultCache cache(
+      DecryptResultCache::Options{.ttl = absl::Minutes(5)});
+  absl::Time start = absl::Now();
+
+  cache.Insert(kCkv1, kCiphertext1, kPlaintext, start);
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext1, start + absl::Minutes(4)),
+              NotNull());
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext1, start + absl::Minutes(5)),
+              IsNull());
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(DecryptResultCacheTest, ZeroMaxEntriesDisablesCaching) {
+  DecryptResultCache cache(DecryptResultCache::Options{.max_entries = 0});
+
+  EXPECT_THAT(cache.Insert(kCkv1, kCiphertext1, kPlaintext),
+              Pointee(ElementsAreArray(kPlaintext)));
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext1), IsNull());
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(DecryptResultCacheTest, RetainKeyVersionsEvictsMissingVersions) {
+  DecryptResultCache cache(DecryptResultCache::Options{});
+  cache.Insert(kCkv1, kCiphertext1, kPlaintext);
+  cache.Insert(kCkv2, kCiphertext1, kPlaintext);
+  cache.Insert(kOtherRingCkv, kCiphertext1, kPlaintext);
+
+  cache.RetainKeyVersions(kKeyRing, {std::string(kCkv2)});
+
+  EXPECT_THAT(cache.Get(kCkv1, kCiphertext1), IsNull());
+  EXPECT_THAT(cache.Get(kCkv2, kCiphertext1), NotNull());
+  // Entries for other key rings are left alone.
+  EXPECT_THAT(cache.Get(kOtherRingCkv, kCiphertext1), NotNull());
+}
+
+TEST(DecryptResultCacheTest, ToStringReportsCounters) {
+  DecryptResultCache cache(DecryptResultCache::Options{});
+  cache.Insert(kCkv1, kCiphertext1, kPlaintext);
+  cache.Get(kCkv1, kCiphertext1);
+  cache.Get(kCkv1, kCiphertext2);
+
+  EXPECT_EQ(cache.ToString(),
+            "AsymmetricDecrypt cache: entries=1 hits=1 misses=1\n");
+}
+
+}  // namespace
+}  // namespace cloud_kms::kmsp11
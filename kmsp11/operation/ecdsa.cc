@@ -75,10 +75,8 @@ absl::StatusOr<std::unique_ptr<SignerInterface>> EcdsaSigner::New(
                                         mechanism->mechanism, key.get()));
   RETURN_IF_ERROR(EnsureNoParameters(mechanism));
 
-  ASSIGN_OR_RETURN(std::string_view key_der,
-                   key->attributes().Value(CKA_PUBLIC_KEY_INFO));
   ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> parsed_key,
-                   ParseX509PublicKeyDer(key_der));
+                   key->ParsedPublicKey());
 
   return std::unique_ptr<SignerInterface>(new EcdsaSigner(
       key, bssl::UniquePtr<EC_KEY>(EVP_PKEY_get1_EC_KEY(parsed_key.get()))));
@@ -147,10 +145,8 @@ absl::StatusOr<std::unique_ptr<VerifierInterface>> EcdsaVerifier::New(
       CheckKeyPreconditions(CKK_EC, CKO_PUBLIC_KEY, CKM_ECDSA, key.get()));
   RETURN_IF_ERROR(EnsureNoParameters(mechanism));
 
-  ASSIGN_OR_RETURN(std::string_view key_der,
-                   key->attributes().Value(CKA_PUBLIC_KEY_INFO));
   ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> parsed_key,
-                   ParseX509PublicKeyDer(key_der));
+                   key->ParsedPublicKey());
 
   return std::unique_ptr<VerifierInterface>(new EcdsaVerifier(
       key, bssl::UniquePtr<EC_KEY>(EVP_PKEY_get1_EC_KEY(parsed_key.get()))));
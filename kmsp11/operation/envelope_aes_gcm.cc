@@ -0,0 +1,597 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kmsp11/operation/envelope_aes_gcm.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "absl/cleanup/cleanup.h"
+#include "absl/strings/str_cat.h"
+#include "common/openssl.h"
+#include "common/status_macros.h"
+#include "kmsp11/kmsp11.h"
+#include "kmsp11/object.h"
+#include "kmsp11/operation/data_key_cache.h"
+#include "kmsp11/operation/preconditions.h"
+#include "kmsp11/util/crypto_utils.h"
+#include "kmsp11/util/errors.h"
+
+namespace cloud_kms::kmsp11 {
+namespace {
+
+constexpr uint8_t kFormatVersion = 0x01;
+constexpr uint8_t kWrappedWithRawEncrypt = 0x01;
+constexpr uint8_t kWrappedWithRsaOaep = 0x02;
+// The version, the wrapping method, and the length of the wrapped key.
+constexpr size_t kHeaderPrefixBytes = 4;
+constexpr size_t kRawEncryptIvBytes = 12;
+constexpr size_t kDataKeyBytes = 32;
+constexpr size_t kNonceBytes = 12;
+constexpr size_t kTagBytes = 16;
+// EVP_EncryptUpdate and EVP_DecryptUpdate take int lengths, so large messages
+// are passed to them in pieces of this size.
+constexpr size_t kMaxUpdateBytes = 1 << 30;
+
+uint8_t WrappingMethod(const Object& key) {
+  return key.algorithm().key_type == CKK_AES ? kWrappedWithRawEncrypt
+                                             : kWrappedWithRsaOaep;
+}
+
+absl::Status NewUnwrapError(const absl::Status& status) {
+  switch (status.code()) {
+    case absl::StatusCode::kInvalidArgument:
+      return NewInvalidArgumentError(status.message(),
+                                     CKR_ENCRYPTED_DATA_INVALID,
+                                     SOURCE_LOCATION);
+    default:
+      return NewError(status.code(), status.message(), CKR_DEVICE_ERROR,
+                      SOURCE_LOCATION);
+  }
+}
+
+// Encrypts `plaintext` with AES-256-GCM, and writes the ciphertext followed by
+// the tag to `ciphertext`.
+absl::Status SealAesGcm(absl::Span<const uint8_t> key,
+                        absl::Span<const uint8_t> nonce,
+                        absl::Span<const uint8_t> aad,
+                        absl::Span<const uint8_t> plaintext,
+                        absl::Span<uint8_t> ciphertext) {
+  bssl::UniquePtr<EVP_CIPHER_CTX> ctx(EVP_CIPHER_CTX_new());
+  int len;
+  if (!ctx ||
+      EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, nullptr,
+                         nullptr) != 1 ||
+      EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_IVLEN, nonce.size(),
+                          nullptr) != 1 ||
+      EVP_EncryptInit_ex(ctx.get(), nullptr, nullptr, key.data(),
+                         nonce.data()) != 1 ||
+      EVP_EncryptUpdate(ctx.get(), nullptr, &len, aad.data(), aad.size()) !=
+          1) {
+    return NewInternalError(
+        absl::StrCat("error initializing AES-GCM: ", SslErrorToString()),
+        SOURCE_LOCATION);
+  }
+
+  size_t offset = 0;
+  while (offset < plaintext.size()) {
+    size_t piece = std::min(plaintext.size() - offset, kMaxUpdateBytes);
+    if (EVP_EncryptUpdate(ctx.get(), ciphertext.data() + offset, &len,
+                          plaintext.data() + offset, piece) != 1) {
+      return NewInternalError(
+          absl::StrCat("error encrypting with AES-GCM: ", SslErrorToString()),
+          SOURCE_LOCATION);
+    }
+    offset += piece;
+  }
+
+  if (EVP_EncryptFinal_ex(ctx.get(), ciphertext.data() + offset, &len) != 1 ||
+      EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, kTagBytes,
+                          ciphertext.data() + plaintext.size()) != 1) {
+    return NewInternalError(
+        absl::StrCat("error finishing AES-GCM encryption: ",
+                     SslErrorToString()),
+        SOURCE_LOCATION);
+  }
+  return absl::OkStatus();
+}
+
+// Decrypts `ciphertext`, which is followed by its tag, with AES-256-GCM, and
+// writes the plaintext to `plaintext`.
+absl::Status OpenAesGcm(absl::Span<const uint8_t> key,
+                        absl::Span<const uint8_t> nonce,
+                        absl::Span<const uint8_t> aad,
+                        absl::Span<const uint8_t> ciphertext,
+                        absl::Span<uint8_t> plaintext) {
+  absl::Span<const uint8_t> tag = ciphertext.subspan(plaintext.size());
+  bssl::UniquePtr<EVP_CIPHER_CTX> ctx(EVP_CIPHER_CTX_new());
+  int len;
+  if (!ctx ||
+      EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, nullptr,
+                         nullptr) != 1 ||
+      EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_IVLEN, nonce.size(),
+                          nullptr) != 1 ||
+      EVP_DecryptInit_ex(ctx.get(), nullptr, nullptr, key.data(),
+                         nonce.data()) != 1 ||
+      EVP_DecryptUpdate(ctx.get(), nullptr, &len, aad.data(), aad.size()) !=
+          1 ||
+      EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, tag.size(),
+                          const_cast<uint8_t*>(tag.data())) != 1) {
+    return NewInternalError(
+        absl::StrCat("error initializing AES-GCM: ", SslErrorToString()),
+        SOURCE_LOCATION);
+  }
+
+  size_t offset = 0;
+  while (offset < plaintext.size()) {
+    size_t piece = std::min(plaintext.size() - offset, kMaxUpdateBytes);
+    if (EVP_DecryptUpdate(ctx.get(), plaintext.data() + offset, &len,
+                          ciphertext.data() + offset, piece) != 1) {
+      return NewInternalError(
+          absl::StrCat("error decrypting with AES-GCM: ", SslErrorToString()),
+          SOURCE_LOCATION);
+    }
+    offset += piece;
+  }
+
+  if (EVP_DecryptFinal_ex(ctx.get(), plaintext.data() + offset, &len) != 1) {
+    ERR_clear_error();
+    return NewInvalidArgumentError("ciphertext failed authentication",
+                                   CKR_ENCRYPTED_DATA_INVALID,
+                                   SOURCE_LOCATION);
+  }
+  return absl::OkStatus();
+}
+
+// Returns the AES-GCM additional authenticated data for a message: its header,
+// followed by the caller's AAD.
+std::vector<uint8_t> MessageAad(absl::Span<const uint8_t> header,
+                                absl::Span<const uint8_t> aad) {
+  std::vector<uint8_t> result;
+  result.reserve(header.size() + aad.size());
+  result.insert(result.end(), header.begin(), header.end());
+  result.insert(result.end(), aad.begin(), aad.end());
+  return result;
+}
+
+// An implementation of EncrypterInterface that encrypts messages locally with a
+// data key that is wrapped by Cloud KMS.
+class EnvelopeAesGcmEncrypter : public EncrypterInterface {
+ public:
+  EnvelopeAesGcmEncrypter(std::shared_ptr<Object> object,
+                          bssl::UniquePtr<EVP_PKEY> public_key,
+                          absl::Span<const uint8_t> aad,
+                          DataKeyCache* data_key_cache)
+      : object_(object),
+        public_key_(std::move(public_key)),
+        aad_(aad.begin(), aad.end()),
+        data_key_cache_(data_key_cache) {}
+
+  absl::StatusOr<absl::Span<const uint8_t>> Encrypt(
+      KmsClient* client, absl::Span<const uint8_t> plaintext) override;
+  absl::StatusOr<absl::Span<const uint8_t>> EncryptUpdate(
+      KmsClient* client, absl::Span<const uint8_t> plaintext_part) override;
+  absl::StatusOr<absl::Span<const uint8_t>> EncryptFinal(
+      KmsClient* client) override;
+
+  virtual ~EnvelopeAesGcmEncrypter() {}
+
+ private:
+  absl::StatusOr<std::string> WrapKey(KmsClient* client,
+                                      absl::Span<const uint8_t> key);
+  absl::StatusOr<absl::Span<const uint8_t>> EncryptInternal(
+      KmsClient* client, absl::Span<const uint8_t> plaintext);
+
+  std::shared_ptr<Object> object_;
+  // Only set for RSA-OAEP keys.
+  bssl::UniquePtr<EVP_PKEY> public_key_;
+  std::vector<uint8_t> aad_;
+  DataKeyCache* data_key_cache_;
+  std::optional<std::vector<uint8_t, ZeroDeallocator<uint8_t>>>
+      plaintext_;  // for multi-part only
+  // Set once the message has been encrypted, so that a call that follows a
+  // length query returns the same ciphertext.
+  std::optional<std::vector<uint8_t>> ciphertext_;
+};
+
+absl::StatusOr<absl::Span<const uint8_t>> EnvelopeAesGcmEncrypter::Encrypt(
+    KmsClient* client, absl::Span<const uint8_t> plaintext) {
+  if (plaintext_) {
+    return FailedPreconditionError(
+        "Encrypt cannot be used to terminate a multi-part encryption operation",
+        CKR_FUNCTION_FAILED, SOURCE_LOCATION);
+  }
+  if (ciphertext_) {
+    return absl::MakeConstSpan(*ciphertext_);
+  }
+
+  return EncryptInternal(client, plaintext);
+}
+
+absl::StatusOr<absl::Span<const uint8_t>>
+EnvelopeAesGcmEncrypter::EncryptUpdate(
+    KmsClient* client, absl::Span<const uint8_t> plaintext_part) {
+  if (ciphertext_) {
+    return FailedPreconditionError(
+        "EncryptUpdate cannot be called after the operation has completed",
+        CKR_FUNCTION_FAILED, SOURCE_LOCATION);
+  }
+  if (!plaintext_) {
+    plaintext_.emplace();
+  }
+
+  plaintext_->reserve(plaintext_->size() + plaintext_part.size());
+  plaintext_->insert(plaintext_->end(), plaintext_part.begin(),
+                     plaintext_part.end());
+
+  // The ciphertext is produced by EncryptFinal.
+  return absl::Span<const uint8_t>();
+}
+
+absl::StatusOr<absl::Span<const uint8_t>> EnvelopeAesGcmEncrypter::EncryptFinal(
+    KmsClient* client) {
+  if (!plaintext_) {
+    return FailedPreconditionError(
+        "EncryptUpdate needs to be called prior to terminating a multi-part "
+        "encryption operation",
+        CKR_FUNCTION_FAILED, SOURCE_LOCATION);
+  }
+  if (ciphertext_) {
+    return absl::MakeConstSpan(*ciphertext_);
+  }
+
+  return EncryptInternal(client, *plaintext_);
+}
+
+absl::StatusOr<std::string> EnvelopeAesGcmEncrypter::WrapKey(
+    KmsClient* client, absl::Span<const uint8_t> key) {
+  if (public_key_) {
+    ASSIGN_OR_RETURN(const EVP_MD* digest,
+                     DigestForMechanism(*object_->algorithm().digest_mechanism));
+    std::string wrapped_key(object_->algorithm().key_bit_length / 8, '\0');
+    RETURN_IF_ERROR(EncryptRsaOaep(
+        public_key_.get(), digest, key,
+        absl::MakeSpan(reinterpret_cast<uint8_t*>(wrapped_key.data()),
+                       wrapped_key.size())));
+    return wrapped_key;
+  }
+
+  kms_v1::RawEncryptRequest req;
+  req.set_name(std::string(object_->kms_key_name()));
+  req.set_plaintext(
+      std::string(reinterpret_cast<const char*>(key.data()), key.size()));
+  absl::Cleanup cleanse_plaintext = [&req] {
+    OPENSSL_cleanse(req.mutable_plaintext()->data(), req.plaintext().size());
+  };
+
+  ASSIGN_OR_RETURN(kms_v1::RawEncryptResponse resp, client->RawEncrypt(req));
+  if (resp.initialization_vector().size() != kRawEncryptIvBytes) {
+    return NewInternalError(
+        absl::StrFormat("unexpected IV length from RawEncrypt (got %d, want "
+                        "%d)",
+                        resp.initialization_vector().size(),
+                        kRawEncryptIvBytes),
+        SOURCE_LOCATION);
+  }
+  return absl::StrCat(resp.initialization_vector(), resp.ciphertext());
+}
+
+absl::StatusOr<absl::Span<const uint8_t>>
+EnvelopeAesGcmEncrypter::EncryptInternal(KmsClient* client,
+                                         absl::Span<const uint8_t> plaintext) {
+  auto wrap = [this, client](absl::Span<const uint8_t> key) {
+    return WrapKey(client, key);
+  };
+  absl::StatusOr<std::shared_ptr<const DataKey>> data_key =
+      data_key_cache_
+          ? data_key_cache_->GetEncryptionKey(object_->kms_key_name(), wrap)
+          : NewDataKey(kDataKeyBytes, wrap);
+  if (!data_key.ok()) {
+    return data_key.status();
+  }
+  if ((*data_key)->key.size() != kDataKeyBytes) {
+    return NewInternalError(
+        absl::StrFormat("unexpected data key length (got %d, want %d)",
+                        (*data_key)->key.size(), kDataKeyBytes),
+        SOURCE_LOCATION);
+  }
+
+  const std::string& wrapped_key = (*data_key)->wrapped_key;
+  if (wrapped_key.size() > UINT16_MAX) {
+    return NewInternalError(
+        absl::StrFormat("wrapped key length %d exceeds the maximum of %d",
+                        wrapped_key.size(), UINT16_MAX),
+        SOURCE_LOCATION);
+  }
+
+  size_t header_size = kHeaderPrefixBytes + wrapped_key.size() + kNonceBytes;
+  std::vector<uint8_t> ciphertext(header_size + plaintext.size() + kTagBytes);
+  ciphertext[0] = kFormatVersion;
+  ciphertext[1] = WrappingMethod(*object_);
+  ciphertext[2] = static_cast<uint8_t>(wrapped_key.size() >> 8);
+  ciphertext[3] = static_cast<uint8_t>(wrapped_key.size());
+  std::copy(wrapped_key.begin(), wrapped_key.end(),
+            ciphertext.begin() + kHeaderPrefixBytes);
+  uint8_t* nonce = ciphertext.data() + header_size - kNonceBytes;
+  RAND_bytes(nonce, kNonceBytes);
+
+  absl::Span<const uint8_t> header =
+      absl::MakeConstSpan(ciphertext).first(header_size);
+  RETURN_IF_ERROR(SealAesGcm((*data_key)->key,
+                             absl::MakeConstSpan(nonce, kNonceBytes),
+                             MessageAad(header, aad_), plaintext,
+                             absl::MakeSpan(ciphertext).subspan(header_size)));
+
+  ciphertext_ = std::move(ciphertext);
+  return absl::MakeConstSpan(*ciphertext_);
+}
+
+// An implementation of DecrypterInterface that decrypts messages locally with a
+// data key that is unwrapped by Cloud KMS.
+class EnvelopeAesGcmDecrypter : public DecrypterInterface {
+ public:
+  EnvelopeAesGcmDecrypter(std::shared_ptr<Object> object,
+                          absl::Span<const uint8_t> aad,
+                          DataKeyCache* data_key_cache)
+      : object_(object),
+        aad_(aad.begin(), aad.end()),
+        data_key_cache_(data_key_cache) {}
+
+  absl::StatusOr<absl::Span<const uint8_t>> Decrypt(
+      KmsClient* client, absl::Span<const uint8_t> ciphertext) override;
+  absl::StatusOr<absl::Span<const uint8_t>> DecryptUpdate(
+      KmsClient* client, absl::Span<const uint8_t> ciphertext_part) override;
+  absl::StatusOr<absl::Span<const uint8_t>> DecryptFinal(
+      KmsClient* client) override;
+
+  virtual ~EnvelopeAesGcmDecrypter() {}
+
+ private:
+  absl::StatusOr<std::unique_ptr<std::string, ZeroDelete<std::string>>>
+  UnwrapKey(KmsClient* client, std::string_view wrapped_key);
+  absl::StatusOr<absl::Span<const uint8_t>> DecryptInternal(
+      KmsClient* client, absl::Span<const uint8_t> ciphertext);
+
+  std::shared_ptr<Object> object_;
+  std::vector<uint8_t> aad_;
+  DataKeyCache* data_key_cache_;
+  std::optional<std::vector<uint8_t>> ciphertext_;  // for multi-part only
+  // Set once the message has been decrypted, so that a call that follows a
+  // length query returns the same plaintext.
+  std::optional<std::vector<uint8_t, ZeroDeallocator<uint8_t>>> plaintext_;
+};
+
+absl::StatusOr<absl::Span<const uint8_t>> EnvelopeAesGcmDecrypter::Decrypt(
+    KmsClient* client, absl::Span<const uint8_t> ciphertext) {
+  if (ciphertext_) {
+    return FailedPreconditionError(
+        "Decrypt cannot be used to terminate a multi-part decryption operation",
+        CKR_FUNCTION_FAILED, SOURCE_LOCATION);
+  }
+  if (plaintext_) {
+    return absl::MakeConstSpan(*plaintext_);
+  }
+
+  return DecryptInternal(client, ciphertext);
+}
+
+absl::StatusOr<absl::Span<const uint8_t>>
+EnvelopeAesGcmDecrypter::DecryptUpdate(
+    KmsClient* client, absl::Span<const uint8_t> ciphertext_part) {
+  if (plaintext_) {
+    return FailedPreconditionError(
+        "DecryptUpdate cannot be called after the operation has completed",
+        CKR_FUNCTION_FAILED, SOURCE_LOCATION);
+  }
+  if (!ciphertext_) {
+    ciphertext_.emplace();
+  }
+
+  ciphertext_->reserve(ciphertext_->size() + ciphertext_part.size());
+  ciphertext_->insert(ciphertext_->end(), ciphertext_part.begin(),
+                      ciphertext_part.end());
+
+  // The plaintext is produced by DecryptFinal, once the tag has been verified.
+  return absl::Span<const uint8_t>();
+}
+
+absl::StatusOr<absl::Span<const uint8_t>> EnvelopeAesGcmDecrypter::DecryptFinal(
+    KmsClient* client) {
+  if (!ciphertext_) {
+    return FailedPreconditionError(
+        "DecryptUpdate needs to be called prior to terminating a multi-part "
+        "decryption operation",
+        CKR_FUNCTION_FAILED, SOURCE_LOCATION);
+  }
+  if (plaintext_) {
+    return absl::MakeConstSpan(*plaintext_);
+  }
+
+  return DecryptInternal(client, *ciphertext_);
+}
+
+absl::StatusOr<std::unique_ptr<std::string, ZeroDelete<std::string>>>
+EnvelopeAesGcmDecrypter::UnwrapKey(KmsClient* client,
+                                   std::string_view wrapped_key) {
+  std::unique_ptr<std::string, ZeroDelete<std::string>> key;
+
+  if (object_->algorithm().key_type == CKK_AES) {
+    if (wrapped_key.size() <= kRawEncryptIvBytes) {
+      return NewInvalidArgumentError(
+          absl::StrFormat("wrapped key length %d is too short",
+                          wrapped_key.size()),
+          CKR_ENCRYPTED_DATA_INVALID, SOURCE_LOCATION);
+    }
+    kms_v1::RawDecryptRequest req;
+    req.set_name(std::string(object_->kms_key_name()));
+    req.set_initialization_vector(
+        std::string(wrapped_key.substr(0, kRawEncryptIvBytes)));
+    req.set_ciphertext(std::string(wrapped_key.substr(kRawEncryptIvBytes)));
+
+    absl::StatusOr<kms_v1::RawDecryptResponse> resp = client->RawDecrypt(req);
+    if (!resp.ok()) {
+      return NewUnwrapError(resp.status());
+    }
+    key.reset(resp->release_plaintext());
+  } else {
+    size_t expected_size = object_->algorithm().key_bit_length / 8;
+    if (wrapped_key.size() != expected_size) {
+      return NewInvalidArgumentError(
+          absl::StrFormat("wrapped key size mismatch (got %d, want %d)",
+                          wrapped_key.size(), expected_size),
+          CKR_ENCRYPTED_DATA_INVALID, SOURCE_LOCATION);
+    }
+    kms_v1::AsymmetricDecryptRequest req;
+    req.set_name(std::string(object_->kms_key_name()));
+    req.set_ciphertext(std::string(wrapped_key));
+
+    absl::StatusOr<kms_v1::AsymmetricDecryptResponse> resp =
+        client->AsymmetricDecrypt(req);
+    if (!resp.ok()) {
+      return NewUnwrapError(resp.status());
+    }
+    key.reset(resp->release_plaintext());
+  }
+
+  if (key->size() != kDataKeyBytes) {
+    return NewInvalidArgumentError(
+        absl::StrFormat("unwrapped key has length %d, want %d", key->size(),
+                        kDataKeyBytes),
+        CKR_ENCRYPTED_DATA_INVALID, SOURCE_LOCATION);
+  }
+  return key;
+}
+
+absl::StatusOr<absl::Span<const uint8_t>>
+EnvelopeAesGcmDecrypter::DecryptInternal(KmsClient* client,
+                                         absl::Span<const uint8_t> ciphertext) {
+  if (ciphertext.size() < kHeaderPrefixBytes) {
+    return NewInvalidArgumentError(
+        absl::StrFormat("ciphertext length %d is too short", ciphertext.size()),
+        CKR_ENCRYPTED_DATA_LEN_RANGE, SOURCE_LOCATION);
+  }
+  if (ciphertext[0] != kFormatVersion) {
+    return NewInvalidArgumentError(
+        absl::StrFormat("unsupported ciphertext format version %d",
+                        ciphertext[0]),
+        CKR_ENCRYPTED_DATA_INVALID, SOURCE_LOCATION);
+  }
+  if (ciphertext[1] != WrappingMethod(*object_)) {
+    return NewInvalidArgumentError(
+        absl::StrFormat("ciphertext wrapping method %d does not match key %s",
+                        ciphertext[1], object_->kms_key_name()),
+        CKR_ENCRYPTED_DATA_INVALID, SOURCE_LOCATION);
+  }
+
+  size_t wrapped_key_size = (size_t{ciphertext[2]} << 8) | ciphertext[3];
+  size_t header_size = kHeaderPrefixBytes + wrapped_key_size + kNonceBytes;
+  if (ciphertext.size() < header_size + kTagBytes) {
+    return NewInvalidArgumentError(
+        absl::StrFormat("ciphertext length %d is too short", ciphertext.size()),
+        CKR_ENCRYPTED_DATA_LEN_RANGE, SOURCE_LOCATION);
+  }
+
+  std::string_view wrapped_key(
+      reinterpret_cast<const char*>(ciphertext.data()) + kHeaderPrefixBytes,
+      wrapped_key_size);
+  auto unwrap = [this, client](std::string_view wrapped_key) {
+    return UnwrapKey(client, wrapped_key);
+  };
+  absl::StatusOr<std::shared_ptr<const DataKey>> data_key =
+      data_key_cache_ ? data_key_cache_->GetDecryptionKey(
+                            object_->kms_key_name(), wrapped_key, unwrap)
+                      : UnwrapDataKey(wrapped_key, unwrap);
+  if (!data_key.ok()) {
+    return data_key.status();
+  }
+  if ((*data_key)->key.size() != kDataKeyBytes) {
+    return NewInternalError(
+        absl::StrFormat("unexpected data key length (got %d, want %d)",
+                        (*data_key)->key.size(), kDataKeyBytes),
+        SOURCE_LOCATION);
+  }
+
+  absl::Span<const uint8_t> header = ciphertext.first(header_size);
+  std::vector<uint8_t, ZeroDeallocator<uint8_t>> plaintext(
+      ciphertext.size() - header_size - kTagBytes);
+  RETURN_IF_ERROR(OpenAesGcm((*data_key)->key, header.last(kNonceBytes),
+                             MessageAad(header, aad_),
+                             ciphertext.subspan(header_size),
+                             absl::MakeSpan(plaintext)));
+
+  plaintext_ = std::move(plaintext);
+  return absl::MakeConstSpan(*plaintext_);
+}
+
+absl::StatusOr<absl::Span<const uint8_t>> ExtractAad(
+    const CK_MECHANISM* mechanism) {
+  if (mechanism->ulParameterLen > 0 && !mechanism->pParameter) {
+    return InvalidMechanismParamError(
+        "AAD length specified but the AAD pointer is invalid", SOURCE_LOCATION);
+  }
+  return absl::MakeConstSpan(static_cast<uint8_t*>(mechanism->pParameter),
+                             mechanism->ulParameterLen);
+}
+
+// Checks that `key` may wrap data keys: it must be an AES-GCM key, or an
+// RSA-OAEP key of class `rsa_object_class`, and it must list the envelope
+// mechanism in its allowed mechanisms.
+absl::Status CheckWrappingKeyPreconditions(Object* key,
+                                           CK_OBJECT_CLASS rsa_object_class) {
+  switch (key->algorithm().key_type) {
+    case CKK_AES:
+      return CheckKeyPreconditions(CKK_AES, CKO_SECRET_KEY,
+                                   CKM_CLOUDKMS_ENVELOPE_AES_GCM, key);
+    case CKK_RSA:
+      return CheckKeyPreconditions(CKK_RSA, rsa_object_class,
+                                   CKM_CLOUDKMS_ENVELOPE_AES_GCM, key);
+    default:
+      return FailedPreconditionError(
+          absl::StrFormat("object %s has type %#x, which cannot be used for "
+                          "envelope encryption",
+                          key->kms_key_name(), key->algorithm().key_type),
+          CKR_KEY_TYPE_INCONSISTENT, SOURCE_LOCATION);
+  }
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewEnvelopeAesGcmEncrypter(
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options) {
+  RETURN_IF_ERROR(CheckWrappingKeyPreconditions(key.get(), CKO_PUBLIC_KEY));
+  ASSIGN_OR_RETURN(absl::Span<const uint8_t> aad, ExtractAad(mechanism));
+
+  bssl::UniquePtr<EVP_PKEY> public_key;
+  if (key->algorithm().key_type == CKK_RSA) {
+    ASSIGN_OR_RETURN(public_key, key->ParsedPublicKey());
+  }
+
+  return std::make_unique<EnvelopeAesGcmEncrypter>(
+      key, std::move(public_key), aad, options.data_key_cache);
+}
+
+absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewEnvelopeAesGcmDecrypter(
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options) {
+  RETURN_IF_ERROR(CheckWrappingKeyPreconditions(key.get(), CKO_PRIVATE_KEY));
+  ASSIGN_OR_RETURN(absl::Span<const uint8_t> aad, ExtractAad(mechanism));
+
+  return std::make_unique<EnvelopeAesGcmDecrypter>(key, aad,
+                                                   options.data_key_cache);
+}
+
+}  // namespace cloud_kms::kmsp11
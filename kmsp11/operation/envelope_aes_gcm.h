@@ -0,0 +1,40 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMSP11_OPERATION_ENVELOPE_AES_GCM_H_
+#define KMSP11_OPERATION_ENVELOPE_AES_GCM_H_
+
+#include "kmsp11/operation/crypter_interfaces.h"
+
+namespace cloud_kms::kmsp11 {
+
+// Returns an EnvelopeAesGcmEncrypter. Data keys are taken from
+// `options.data_key_cache` if it is set; otherwise, each operation generates
+// its own data key.
+absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewEnvelopeAesGcmEncrypter(
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options = RawEncryptionOptions());
+
+// Returns an EnvelopeAesGcmDecrypter. Unwrapped data keys are taken from
+// `options.data_key_cache` if it is set; otherwise, each operation unwraps its
+// data key.
+absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewEnvelopeAesGcmDecrypter(
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options = RawEncryptionOptions());
+
+}  // namespace cloud_kms::kmsp11
+
+#endif  // KMSP11_OPERATION_ENVELOPE_AES_GCM_H_
@@ -0,0 +1,366 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kmsp11/operation/envelope_aes_gcm.h"
+
+#include "common/kms_client.h"
+#include "common/test/runfiles.h"
+#include "common/test/test_status_macros.h"
+#include "fakekms/cpp/fakekms.h"
+#include "gmock/gmock.h"
+#include "kmsp11/kmsp11.h"
+#include "kmsp11/object.h"
+#include "kmsp11/operation/data_key_cache.h"
+#include "kmsp11/test/matchers.h"
+#include "kmsp11/test/resource_helpers.h"
+#include "kmsp11/util/crypto_utils.h"
+
+namespace cloud_kms::kmsp11 {
+namespace {
+
+using ::testing::ElementsAreArray;
+using ::testing::IsEmpty;
+
+CK_MECHANISM NewEnvelopeMechanism(std::vector<uint8_t>* aad) {
+  return CK_MECHANISM{
+      CKM_CLOUDKMS_ENVELOPE_AES_GCM,                // mechanism
+      aad->data(),                                  // pParameter
+      static_cast<unsigned long int>(aad->size()),  // ulParameterLen
+  };
+}
+
+// Returns the wrapped data key from an envelope ciphertext.
+std::vector<uint8_t> WrappedKey(absl::Span<const uint8_t> ciphertext) {
+  size_t length = (size_t{ciphertext[2]} << 8) | ciphertext[3];
+  return std::vector<uint8_t>(ciphertext.begin() + 4,
+                              ciphertext.begin() + 4 + length);
+}
+
+TEST(NewEnvelopeAesGcmEncrypterTest, SuccessAesGcmKey) {
+  ASSERT_OK_AND_ASSIGN(Object prv,
+                       NewMockSecretKey(kms_v1::CryptoKeyVersion::AES_256_GCM));
+  std::shared_ptr<Object> key = std::make_shared<Object>(prv);
+
+  std::vector<uint8_t> aad = {0xDE, 0xAD, 0xBE, 0xEF};
+  CK_MECHANISM mechanism = NewEnvelopeMechanism(&aad);
+
+  EXPECT_OK(NewEnvelopeAesGcmEncrypter(key, &mechanism));
+}
+
+TEST(NewEnvelopeAesGcmEncrypterTest, SuccessRsaOaepPublicKey) {
+  ASSERT_OK_AND_ASSIGN(
+      KeyPair kp,
+      NewMockKeyPair(kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_2048_SHA256,
+                     "rsa_2048_public.pem"));
+  std::shared_ptr<Object> key = std::make_shared<Object>(kp.public_key);
+
+  CK_MECHANISM mechanism = {CKM_CLOUDKMS_ENVELOPE_AES_GCM, nullptr, 0};
+
+  EXPECT_OK(NewEnvelopeAesGcmEncrypter(key, &mechanism));
+}
+
+TEST(NewEnvelopeAesGcmEncrypterTest, FailureWrongKeyType) {
+  ASSERT_OK_AND_ASSIGN(Object prv,
+                       NewMockSecretKey(kms_v1::CryptoKeyVersion::HMAC_SHA256));
+  std::shared_ptr<Object> key = std::make_shared<Object>(prv);
+
+  CK_MECHANISM mechanism = {CKM_CLOUDKMS_ENVELOPE_AES_GCM, nullptr, 0};
+
+  EXPECT_THAT(NewEnvelopeAesGcmEncrypter(key, &mechanism),
+              StatusRvIs(CKR_KEY_TYPE_INCONSISTENT));
+}
+
+TEST(NewEnvelopeAesGcmEncrypterTest, FailureAesCbcKey) {
+  ASSERT_OK_AND_ASSIGN(Object prv,
+                       NewMockSecretKey(kms_v1::CryptoKeyVersion::AES_256_CBC));
+  std::shared_ptr<Object> key = std::make_shared<Object>(prv);
+
+  CK_MECHANISM mechanism = {CKM_CLOUDKMS_ENVELOPE_AES_GCM, nullptr, 0};
+
+  EXPECT_THAT(NewEnvelopeAesGcmEncrypter(key, &mechanism),
+              StatusRvIs(CKR_KEY_FUNCTION_NOT_PERMITTED));
+}
+
+TEST(NewEnvelopeAesGcmEncrypterTest, FailureRsaPrivateKey) {
+  ASSERT_OK_AND_ASSIGN(
+      KeyPair kp,
+      NewMockKeyPair(kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_2048_SHA256,
+                     "rsa_2048_public.pem"));
+  std::shared_ptr<Object> key = std::make_shared<Object>(kp.private_key);
+
+  CK_MECHANISM mechanism = {CKM_CLOUDKMS_ENVELOPE_AES_GCM, nullptr, 0};
+
+  EXPECT_THAT(NewEnvelopeAesGcmEncrypter(key, &mechanism),
+              StatusRvIs(CKR_KEY_FUNCTION_NOT_PERMITTED));
+}
+
+TEST(NewEnvelopeAesGcmEncrypterTest, FailureAadPointerMissing) {
+  ASSERT_OK_AND_ASSIGN(Object prv,
+                       NewMockSecretKey(kms_v1::CryptoKeyVersion::AES_256_GCM));
+  std::shared_ptr<Object> key = std::make_shared<Object>(prv);
+
+  CK_MECHANISM mechanism = {CKM_CLOUDKMS_ENVELOPE_AES_GCM, nullptr, 4};
+
+  EXPECT_THAT(NewEnvelopeAesGcmEncrypter(key, &mechanism),
+              StatusRvIs(CKR_MECHANISM_PARAM_INVALID));
+}
+
+TEST(NewEnvelopeAesGcmDecrypterTest, FailureRsaPublicKey) {
+  ASSERT_OK_AND_ASSIGN(
+      KeyPair kp,
+      NewMockKeyPair(kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_2048_SHA256,
+                     "rsa_2048_public.pem"));
+  std::shared_ptr<Object> key = std::make_shared<Object>(kp.public_key);
+
+  CK_MECHANISM mechanism = {CKM_CLOUDKMS_ENVELOPE_AES_GCM, nullptr, 0};
+
+  EXPECT_THAT(NewEnvelopeAesGcmDecrypter(key, &mechanism),
+              StatusRvIs(CKR_KEY_FUNCTION_NOT_PERMITTED));
+}
+
+class EnvelopeAesGcmTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_OK_AND_ASSIGN(fake_server_, fakekms::Server::New());
+    client_ = std::make_unique<KmsClient>(KmsClient::Options{
+        .endpoint_address = fake_server_->listen_addr(),
+        .rpc_timeout = absl::Seconds(1),
+        .error_decorator =
+            [](absl::Status& status) { SetErrorRv(status, CKR_DEVICE_ERROR); },
+    });
+
+    auto fake_client = fake_server_->NewClient();
+
+    kms_v1::KeyRing kr;
+    kr = CreateKeyRingOrDie(fake_client.get(), kTestLocation, RandomId(), kr);
+
+    kms_v1::CryptoKey aes_ck;
+    aes_ck.set_purpose(kms_v1::CryptoKey::RAW_ENCRYPT_DECRYPT);
+    aes_ck.mutable_version_template()->set_algorithm(
+        kms_v1::CryptoKeyVersion::AES_256_GCM);
+    aes_ck = CreateCryptoKeyOrDie(fake_client.get(), kr.name(), "aes", aes_ck,
+                                  true);
+
+    kms_v1::CryptoKeyVersion aes_ckv;
+    aes_ckv = CreateCryptoKeyVersionOrDie(fake_client.get(), aes_ck.name(),
+                                          aes_ckv);
+    aes_ckv = WaitForEnablement(fake_client.get(), aes_ckv);
+
+    ASSERT_OK_AND_ASSIGN(Object aes_key, Object::NewSecretKey(aes_ckv));
+    aes_key_ = std::make_shared<Object>(aes_key);
+
+    kms_v1::CryptoKey rsa_ck;
+    rsa_ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_DECRYPT);
+    rsa_ck.mutable_version_template()->set_algorithm(
+        kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_2048_SHA256);
+    rsa_ck = CreateCryptoKeyOrDie(fake_client.get(), kr.name(), "rsa", rsa_ck,
+                                  true);
+
+    kms_v1::CryptoKeyVersion rsa_ckv;
+    rsa_ckv = CreateCryptoKeyVersionOrDie(fake_client.get(), rsa_ck.name(),
+                                          rsa_ckv);
+    rsa_ckv = WaitForEnablement(fake_client.get(), rsa_ckv);
+
+    kms_v1::PublicKey pub_proto = GetPublicKeyOrDie(fake_client.get(), rsa_ckv);
+    ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> public_key,
+                         ParseX509PublicKeyPem(pub_proto.pem()));
+    ASSERT_OK_AND_ASSIGN(KeyPair kp,
+                         Object::NewKeyPair(rsa_ckv, public_key.get()));
+    rsa_public_key_ = std::make_shared<Object>(kp.public_key);
+    rsa_private_key_ = std::make_shared<Object>(kp.private_key);
+
+    aad_ = {'a', 'a', 'd'};
+    options_.data_key_cache = &cache_;
+  }
+
+  absl::StatusOr<std::vector<uint8_t>> Encrypt(
+      std::shared_ptr<Object> key, absl::Span<const uint8_t> plaintext) {
+    CK_MECHANISM mechanism = NewEnvelopeMechanism(&aad_);
+    ASSIGN_OR_RETURN(std::unique_ptr<EncrypterInterface> encrypter,
+                     NewEnvelopeAesGcmEncrypter(key, &mechanism, options_));
+    ASSIGN_OR_RETURN(absl::Span<const uint8_t> ciphertext,
+                     encrypter->Encrypt(client_.get(), plaintext));
+    return std::vector<uint8_t>(ciphertext.begin(), ciphertext.end());
+  }
+
+  absl::StatusOr<std::vector<uint8_t>> Decrypt(
+      std::shared_ptr<Object> key, absl::Span<const uint8_t> ciphertext,
+      const RawEncryptionOptions& options) {
+    CK_MECHANISM mechanism = NewEnvelopeMechanism(&aad_);
+    ASSIGN_OR_RETURN(std::unique_ptr<DecrypterInterface> decrypter,
+                     NewEnvelopeAesGcmDecrypter(key, &mechanism, options));
+    ASSIGN_OR_RETURN(absl::Span<const uint8_t> plaintext,
+                     decrypter->Decrypt(client_.get(), ciphertext));
+    return std::vector<uint8_t>(plaintext.begin(), plaintext.end());
+  }
+
+  std::unique_ptr<fakekms::Server> fake_server_;
+  std::unique_ptr<KmsClient> client_;
+  std::shared_ptr<Object> aes_key_;
+  std::shared_ptr<Object> rsa_public_key_;
+  std::shared_ptr<Object> rsa_private_key_;
+  std::vector<uint8_t> aad_;
+  DataKeyCache cache_{DataKeyCache::Options{}};
+  RawEncryptionOptions options_;
+};
+
+TEST_F(EnvelopeAesGcmTest, EncryptDecryptLargeMessageAesGcmKey) {
+  std::vector<uint8_t> plaintext(1 << 20);
+  RAND_bytes(plaintext.data(), plaintext.size());
+
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       Encrypt(aes_key_, plaintext));
+  EXPECT_EQ(ciphertext[0], 0x01);
+  EXPECT_EQ(ciphertext[1], 0x01);
+  // The header, then the ciphertext and tag.
+  EXPECT_EQ(ciphertext.size(),
+            4 + WrappedKey(ciphertext).size() + 12 + plaintext.size() + 16);
+
+  // Decrypt without the cache, so that the data key is unwrapped with Cloud
+  // KMS.
+  EXPECT_THAT(Decrypt(aes_key_, ciphertext, RawEncryptionOptions()),
+              IsOkAndHolds(ElementsAreArray(plaintext)));
+}
+
+TEST_F(EnvelopeAesGcmTest, EncryptDecryptRsaOaepKey) {
+  std::vector<uint8_t> plaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       Encrypt(rsa_public_key_, plaintext));
+  EXPECT_EQ(ciphertext[1], 0x02);
+  EXPECT_EQ(WrappedKey(ciphertext).size(), 256);
+
+  EXPECT_THAT(Decrypt(rsa_private_key_, ciphertext, RawEncryptionOptions()),
+              IsOkAndHolds(ElementsAreArray(plaintext)));
+  EXPECT_THAT(Decrypt(rsa_private_key_, ciphertext, options_),
+              IsOkAndHolds(ElementsAreArray(plaintext)));
+}
+
+TEST_F(EnvelopeAesGcmTest, EncryptDecryptEmptyMessage) {
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       Encrypt(aes_key_, std::vector<uint8_t>()));
+  EXPECT_THAT(Decrypt(aes_key_, ciphertext, options_),
+              IsOkAndHolds(IsEmpty()));
+}
+
+TEST_F(EnvelopeAesGcmTest, DataKeyIsReusedAcrossOperations) {
+  std::vector<uint8_t> plaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext1,
+                       Encrypt(aes_key_, plaintext));
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext2,
+                       Encrypt(aes_key_, plaintext));
+
+  EXPECT_EQ(WrappedKey(ciphertext1), WrappedKey(ciphertext2));
+  EXPECT_NE(ciphertext1, ciphertext2);
+  EXPECT_THAT(Decrypt(aes_key_, ciphertext2, options_),
+              IsOkAndHolds(ElementsAreArray(plaintext)));
+}
+
+TEST_F(EnvelopeAesGcmTest, DataKeyIsNotReusedWithoutCache) {
+  std::vector<uint8_t> plaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+  options_.data_key_cache = nullptr;
+
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext1,
+                       Encrypt(aes_key_, plaintext));
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext2,
+                       Encrypt(aes_key_, plaintext));
+
+  EXPECT_NE(WrappedKey(ciphertext1), WrappedKey(ciphertext2));
+}
+
+TEST_F(EnvelopeAesGcmTest, EncryptMayBeRepeated) {
+  std::vector<uint8_t> plaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+  CK_MECHANISM mechanism = NewEnvelopeMechanism(&aad_);
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<EncrypterInterface> encrypter,
+      NewEnvelopeAesGcmEncrypter(aes_key_, &mechanism, options_));
+
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> first,
+                       encrypter->Encrypt(client_.get(), plaintext));
+  std::vector<uint8_t> first_bytes(first.begin(), first.end());
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> second,
+                       encrypter->Encrypt(client_.get(), plaintext));
+  EXPECT_THAT(second, ElementsAreArray(first_bytes));
+}
+
+TEST_F(EnvelopeAesGcmTest, EncryptDecryptMultiPart) {
+  std::vector<uint8_t> part1(100000, 0x01), part2(50000, 0x02);
+  std::vector<uint8_t> plaintext(part1);
+  plaintext.insert(plaintext.end(), part2.begin(), part2.end());
+
+  CK_MECHANISM mechanism = NewEnvelopeMechanism(&aad_);
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<EncrypterInterface> encrypter,
+      NewEnvelopeAesGcmEncrypter(aes_key_, &mechanism, options_));
+  EXPECT_THAT(encrypter->EncryptUpdate(client_.get(), part1),
+              IsOkAndHolds(IsEmpty()));
+  EXPECT_THAT(encrypter->EncryptUpdate(client_.get(), part2),
+              IsOkAndHolds(IsEmpty()));
+  ASSERT_OK_AND_ASSIGN(absl::Span<const uint8_t> ciphertext,
+                       encrypter->EncryptFinal(client_.get()));
+
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DecrypterInterface> decrypter,
+      NewEnvelopeAesGcmDecrypter(aes_key_, &mechanism, options_));
+  EXPECT_THAT(decrypter->DecryptUpdate(client_.get(), ciphertext.first(10)),
+              IsOkAndHolds(IsEmpty()));
+  EXPECT_THAT(decrypter->DecryptUpdate(client_.get(), ciphertext.subspan(10)),
+              IsOkAndHolds(IsEmpty()));
+  EXPECT_THAT(decrypter->DecryptFinal(client_.get()),
+              IsOkAndHolds(ElementsAreArray(plaintext)));
+}
+
+TEST_F(EnvelopeAesGcmTest, DecryptFailureWrongAad) {
+  std::vector<uint8_t> plaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       Encrypt(aes_key_, plaintext));
+
+  aad_ = {'o', 't', 'h', 'e', 'r'};
+  EXPECT_THAT(Decrypt(aes_key_, ciphertext, options_),
+              StatusRvIs(CKR_ENCRYPTED_DATA_INVALID));
+}
+
+TEST_F(EnvelopeAesGcmTest, DecryptFailureModifiedHeader) {
+  std::vector<uint8_t> plaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       Encrypt(aes_key_, plaintext));
+
+  // Modify the nonce, which immediately precedes the ciphertext and tag.
+  ciphertext[ciphertext.size() - plaintext.size() - 16 - 1] ^= 0x01;
+  EXPECT_THAT(Decrypt(aes_key_, ciphertext, options_),
+              StatusRvIs(CKR_ENCRYPTED_DATA_INVALID));
+}
+
+TEST_F(EnvelopeAesGcmTest, DecryptFailureTruncated) {
+  std::vector<uint8_t> plaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       Encrypt(aes_key_, plaintext));
+
+  ciphertext.resize(4 + WrappedKey(ciphertext).size() + 12 + 15);
+  EXPECT_THAT(Decrypt(aes_key_, ciphertext, options_),
+              StatusRvIs(CKR_ENCRYPTED_DATA_LEN_RANGE));
+}
+
+TEST_F(EnvelopeAesGcmTest, DecryptFailureWrongKey) {
+  std::vector<uint8_t> plaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+  ASSERT_OK_AND_ASSIGN(std::vector<uint8_t> ciphertext,
+                       Encrypt(aes_key_, plaintext));
+
+  EXPECT_THAT(Decrypt(rsa_private_key_, ciphertext, options_),
+              StatusRvIs(CKR_ENCRYPTED_DATA_INVALID));
+}
+
+}  // namespace
+}  // namespace cloud_kms::kmsp11
@@ -63,7 +63,7 @@ absl::Status KmsPrehashedSigner::Sign(KmsClient* client,
   }
 
   ASSIGN_OR_RETURN(kms_v1::AsymmetricSignResponse resp,
-                   client->AsymmetricSign(req));
+                   client->AsymmetricSign(req, deterministic()));
   RETURN_IF_ERROR(CopySignature(resp.signature(), signature));
   return absl::OkStatus();
 }
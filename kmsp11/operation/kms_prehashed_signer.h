@@ -42,6 +42,10 @@ class KmsPrehashedSigner : public SignerInterface {
   virtual absl::Status CopySignature(std::string_view src,
                                      absl::Span<uint8_t> dest);
 
+  // Whether signatures made by this signer are deterministic. Requests for
+  // deterministic signatures may be hedged by the KMS client.
+  virtual bool deterministic() { return false; }
+
  private:
   std::shared_ptr<Object> object_;
 };
@@ -38,7 +38,7 @@ absl::Status CheckKeyPreconditions(CK_KEY_TYPE key_type,
         CKR_KEY_FUNCTION_NOT_PERMITTED, SOURCE_LOCATION);
   }
 
-  const std::vector<CK_MECHANISM_TYPE>& m =
+  absl::Span<const CK_MECHANISM_TYPE> m =
       object->algorithm().allowed_mechanisms;
   if (std::find(m.begin(), m.end(), mechanism_type) == m.end()) {
     return FailedPreconditionError(
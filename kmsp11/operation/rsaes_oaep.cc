@@ -17,6 +17,7 @@
 #include "absl/cleanup/cleanup.h"
 #include "common/status_macros.h"
 #include "kmsp11/object.h"
+#include "kmsp11/operation/decrypt_result_cache.h"
 #include "kmsp11/operation/preconditions.h"
 #include "kmsp11/util/crypto_utils.h"
 #include "kmsp11/util/errors.h"
@@ -62,7 +63,9 @@ absl::StatusOr<absl::Span<const uint8_t>> RsaOaepEncrypter::Encrypt(
 // using Cloud KMS.
 class RsaOaepDecrypter : public DecrypterInterface {
  public:
-  RsaOaepDecrypter(std::shared_ptr<Object> key) : key_(key) {}
+  RsaOaepDecrypter(std::shared_ptr<Object> key,
+                   DecryptResultCache* decrypt_result_cache)
+      : key_(key), decrypt_result_cache_(decrypt_result_cache) {}
 
   // Decrypt returns a span whose underlying bytes are bound to the lifetime of
   // this decrypter.
@@ -73,7 +76,11 @@ class RsaOaepDecrypter : public DecrypterInterface {
 
  private:
   std::shared_ptr<Object> key_;
+  DecryptResultCache* decrypt_result_cache_;
+  // Set when the plaintext was not cached.
   std::unique_ptr<std::string, ZeroDelete<std::string>> plaintext_;
+  // Set when the plaintext was cached.
+  std::shared_ptr<const DecryptResultCache::Plaintext> cached_plaintext_;
 };
 
 absl::StatusOr<absl::Span<const uint8_t>> RsaOaepDecrypter::Decrypt(
@@ -86,6 +93,14 @@ absl::StatusOr<absl::Span<const uint8_t>> RsaOaepDecrypter::Decrypt(
         CKR_ENCRYPTED_DATA_LEN_RANGE, SOURCE_LOCATION);
   }
 
+  if (decrypt_result_cache_) {
+    cached_plaintext_ =
+        decrypt_result_cache_->Get(key_->kms_key_name(), ciphertext);
+    if (cached_plaintext_) {
+      return absl::MakeConstSpan(*cached_plaintext_);
+    }
+  }
+
   kms_v1::AsymmetricDecryptRequest req;
   req.set_name(std::string(key_->kms_key_name()));
   req.set_ciphertext(ciphertext.data(), ciphertext.size());
@@ -107,8 +122,15 @@ absl::StatusOr<absl::Span<const uint8_t>> RsaOaepDecrypter::Decrypt(
   }
 
   plaintext_.reset(resp->release_plaintext());
-  return absl::MakeConstSpan(reinterpret_cast<uint8_t*>(plaintext_->data()),
-                             plaintext_->size());
+  absl::Span<const uint8_t> plaintext = absl::MakeConstSpan(
+      reinterpret_cast<uint8_t*>(plaintext_->data()), plaintext_->size());
+  if (decrypt_result_cache_) {
+    cached_plaintext_ = decrypt_result_cache_->Insert(key_->kms_key_name(),
+                                                      ciphertext, plaintext);
+    plaintext_.reset();
+    return absl::MakeConstSpan(*cached_plaintext_);
+  }
+  return plaintext;
 }
 
 absl::Status ValidateRsaOaepParameters(Object* key, void* parameters,
@@ -151,21 +173,21 @@ absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewRsaOaepEncrypter(
   RETURN_IF_ERROR(ValidateRsaOaepParameters(key.get(), mechanism->pParameter,
                                             mechanism->ulParameterLen));
 
-  ASSIGN_OR_RETURN(std::string_view key_der,
-                   key->attributes().Value(CKA_PUBLIC_KEY_INFO));
   ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> parsed_key,
-                   ParseX509PublicKeyDer(key_der));
+                   key->ParsedPublicKey());
 
   return std::make_unique<RsaOaepEncrypter>(key, std::move(parsed_key));
 }
 
 absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewRsaOaepDecrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism) {
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options) {
   RETURN_IF_ERROR(CheckKeyPreconditions(CKK_RSA, CKO_PRIVATE_KEY,
                                         CKM_RSA_PKCS_OAEP, key.get()));
   RETURN_IF_ERROR(ValidateRsaOaepParameters(key.get(), mechanism->pParameter,
                                             mechanism->ulParameterLen));
-  return std::make_unique<RsaOaepDecrypter>(key);
+  return std::make_unique<RsaOaepDecrypter>(key,
+                                            options.decrypt_result_cache);
 }
 
 }  // namespace cloud_kms::kmsp11
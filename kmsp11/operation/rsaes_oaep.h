@@ -26,9 +26,11 @@ namespace cloud_kms::kmsp11 {
 absl::StatusOr<std::unique_ptr<EncrypterInterface>> NewRsaOaepEncrypter(
     std::shared_ptr<Object> key, const CK_MECHANISM* mechanism);
 
-// Returns an RsaOaepDecrypter.
+// Returns an RsaOaepDecrypter. Plaintexts are taken from and added to
+// `options.decrypt_result_cache` if it is set.
 absl::StatusOr<std::unique_ptr<DecrypterInterface>> NewRsaOaepDecrypter(
-    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism);
+    std::shared_ptr<Object> key, const CK_MECHANISM* mechanism,
+    const RawEncryptionOptions& options = RawEncryptionOptions());
 
 }  // namespace cloud_kms::kmsp11
 
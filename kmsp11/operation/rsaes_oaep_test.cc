@@ -20,6 +20,7 @@
 #include "fakekms/cpp/fakekms.h"
 #include "gmock/gmock.h"
 #include "kmsp11/object.h"
+#include "kmsp11/operation/decrypt_result_cache.h"
 #include "kmsp11/test/matchers.h"
 #include "kmsp11/test/resource_helpers.h"
 #include "kmsp11/util/crypto_utils.h"
@@ -372,20 +373,34 @@ class OaepCryptTest : public testing::Test {
 
     ASSERT_OK_AND_ASSIGN(KeyPair kp,
                          Object::NewKeyPair(ckv, public_key_.get()));
-    std::shared_ptr<Object> prv = std::make_shared<Object>(kp.private_key);
+    private_key_ = std::make_shared<Object>(kp.private_key);
     std::shared_ptr<Object> pub = std::make_shared<Object>(kp.public_key);
 
     CK_RSA_PKCS_OAEP_PARAMS params = NewOaepParams();
     CK_MECHANISM mechanism = NewOaepMechanism(&params);
 
     ASSERT_OK_AND_ASSIGN(encrypter_, NewRsaOaepEncrypter(pub, &mechanism));
-    ASSERT_OK_AND_ASSIGN(decrypter_, NewRsaOaepDecrypter(prv, &mechanism));
+    ASSERT_OK_AND_ASSIGN(decrypter_,
+                         NewRsaOaepDecrypter(private_key_, &mechanism));
+  }
+
+  void DisableKeyVersion() {
+    kms_v1::CryptoKeyVersion ckv;
+    ckv.set_name(kms_key_name_);
+    ckv.set_state(kms_v1::CryptoKeyVersion::DISABLED);
+
+    google::protobuf::FieldMask update_mask;
+    update_mask.add_paths("state");
+
+    UpdateCryptoKeyVersionOrDie(fake_server_->NewClient().get(), ckv,
+                                update_mask);
   }
 
   std::unique_ptr<fakekms::Server> fake_server_;
   std::unique_ptr<KmsClient> client_;
   std::string kms_key_name_;
   bssl::UniquePtr<EVP_PKEY> public_key_;
+  std::shared_ptr<Object> private_key_;
   std::unique_ptr<EncrypterInterface> encrypter_;
   std::unique_ptr<DecrypterInterface> decrypter_;
 };
@@ -421,15 +436,7 @@ TEST_F(OaepCryptTest, DecryptFailureCiphertextInvalid) {
 }
 
 TEST_F(OaepCryptTest, DecryptFailureKeyDisabled) {
-  kms_v1::CryptoKeyVersion ckv;
-  ckv.set_name(kms_key_name_);
-  ckv.set_state(kms_v1::CryptoKeyVersion::DISABLED);
-
-  google::protobuf::FieldMask update_mask;
-  update_mask.add_paths("state");
-
-  UpdateCryptoKeyVersionOrDie(fake_server_->NewClient().get(), ckv,
-                              update_mask);
+  DisableKeyVersion();
 
   uint8_t ciphertext[256];
   EXPECT_THAT(decrypter_->Decrypt(client_.get(), ciphertext),
@@ -452,5 +459,46 @@ TEST_F(OaepCryptTest, DecryptReturnsCorrectResultOnCiphertextChange) {
               IsOkAndHolds(plaintext2));
 }
 
+TEST_F(OaepCryptTest, DecryptUsesCachedResult) {
+  std::vector<uint8_t> plaintext = {0xDE, 0xAD, 0xBE, 0xEF};
+  uint8_t ciphertext[256];
+  EXPECT_OK(
+      EncryptRsaOaep(public_key_.get(), EVP_sha256(), plaintext, ciphertext));
+
+  DecryptResultCache cache(DecryptResultCache::Options{});
+  RawEncryptionOptions options{.decrypt_result_cache = &cache};
+  CK_RSA_PKCS_OAEP_PARAMS params = NewOaepParams();
+  CK_MECHANISM mechanism = NewOaepMechanism(&params);
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<DecrypterInterface> first,
+                       NewRsaOaepDecrypter(private_key_, &mechanism, options));
+  EXPECT_THAT(first->Decrypt(client_.get(), ciphertext),
+              IsOkAndHolds(plaintext));
+
+  // The second decryption must not reach Cloud KMS.
+  DisableKeyVersion();
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<DecrypterInterface> second,
+                       NewRsaOaepDecrypter(private_key_, &mechanism, options));
+  EXPECT_THAT(second->Decrypt(client_.get(), ciphertext),
+              IsOkAndHolds(plaintext));
+
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.misses(), 1);
+}
+
+TEST_F(OaepCryptTest, DecryptFailureIsNotCached) {
+  DecryptResultCache cache(DecryptResultCache::Options{});
+  RawEncryptionOptions options{.decrypt_result_cache = &cache};
+  CK_RSA_PKCS_OAEP_PARAMS params = NewOaepParams();
+  CK_MECHANISM mechanism = NewOaepMechanism(&params);
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<DecrypterInterface> decrypter,
+                       NewRsaOaepDecrypter(private_key_, &mechanism, options));
+
+  uint8_t ciphertext[256] = {0};
+  EXPECT_THAT(decrypter->Decrypt(client_.get(), ciphertext),
+              StatusRvIs(CKR_ENCRYPTED_DATA_INVALID));
+  EXPECT_EQ(cache.size(), 0);
+}
+
 }  // namespace
 }  // namespace cloud_kms::kmsp11
@@ -77,6 +77,9 @@ class RsaPkcs1Signer : public KmsPrehashedSigner {
 
   virtual ~RsaPkcs1Signer() {}
 
+ protected:
+  bool deterministic() override { return true; }
+
  private:
   RsaPkcs1Signer(std::shared_ptr<Object> object, bssl::UniquePtr<RSA> key,
                  ExpectedInput input_type)
@@ -117,10 +120,8 @@ absl::StatusOr<std::unique_ptr<SignerInterface>> RsaPkcs1Signer::New(
       CheckKeyPreconditions(CKK_RSA, CKO_PRIVATE_KEY, CKM_RSA_PKCS, key.get()));
   RETURN_IF_ERROR(EnsureNoParameters(mechanism));
 
-  ASSIGN_OR_RETURN(std::string_view key_der,
-                   key->attributes().Value(CKA_PUBLIC_KEY_INFO));
   ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> parsed_key,
-                   ParseX509PublicKeyDer(key_der));
+                   key->ParsedPublicKey());
 
   return std::unique_ptr<SignerInterface>(new RsaPkcs1Signer(
       key, bssl::UniquePtr<RSA>(EVP_PKEY_get1_RSA(parsed_key.get())),
@@ -196,10 +197,8 @@ absl::StatusOr<std::unique_ptr<VerifierInterface>> RsaPkcs1Verifier::New(
       CheckKeyPreconditions(CKK_RSA, CKO_PUBLIC_KEY, CKM_RSA_PKCS, key.get()));
   RETURN_IF_ERROR(EnsureNoParameters(mechanism));
 
-  ASSIGN_OR_RETURN(std::string_view key_der,
-                   key->attributes().Value(CKA_PUBLIC_KEY_INFO));
   ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> parsed_key,
-                   ParseX509PublicKeyDer(key_der));
+                   key->ParsedPublicKey());
 
   return std::unique_ptr<VerifierInterface>(new RsaPkcs1Verifier(
       key, bssl::UniquePtr<RSA>(EVP_PKEY_get1_RSA(parsed_key.get())),
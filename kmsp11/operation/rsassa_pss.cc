@@ -102,10 +102,8 @@ absl::StatusOr<std::unique_ptr<SignerInterface>> RsaPssSigner::New(
   RETURN_IF_ERROR(ValidatePssParameters(key.get(), mechanism->pParameter,
                                         mechanism->ulParameterLen));
 
-  ASSIGN_OR_RETURN(std::string_view key_der,
-                   key->attributes().Value(CKA_PUBLIC_KEY_INFO));
   ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> parsed_key,
-                   ParseX509PublicKeyDer(key_der));
+                   key->ParsedPublicKey());
 
   return std::unique_ptr<SignerInterface>(
       new RsaPssSigner(key, std::move(parsed_key)));
@@ -162,10 +160,8 @@ absl::StatusOr<std::unique_ptr<VerifierInterface>> RsaPssVerifier::New(
   RETURN_IF_ERROR(ValidatePssParameters(key.get(), mechanism->pParameter,
                                         mechanism->ulParameterLen));
 
-  ASSIGN_OR_RETURN(std::string_view key_der,
-                   key->attributes().Value(CKA_PUBLIC_KEY_INFO));
   ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> parsed_key,
-                   ParseX509PublicKeyDer(key_der));
+                   key->ParsedPublicKey());
 
   return std::unique_ptr<VerifierInterface>(
       new RsaPssVerifier(key, std::move(parsed_key)));
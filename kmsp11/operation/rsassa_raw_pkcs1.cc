@@ -78,10 +78,8 @@ absl::StatusOr<std::unique_ptr<SignerInterface>> RsaRawPkcs1Signer::New(
       CheckKeyPreconditions(CKK_RSA, CKO_PRIVATE_KEY, CKM_RSA_PKCS, key.get()));
   RETURN_IF_ERROR(EnsureNoParameters(mechanism));
 
-  ASSIGN_OR_RETURN(std::string_view key_der,
-                   key->attributes().Value(CKA_PUBLIC_KEY_INFO));
   ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> parsed_key,
-                   ParseX509PublicKeyDer(key_der));
+                   key->ParsedPublicKey());
 
   return std::unique_ptr<SignerInterface>(new RsaRawPkcs1Signer(
       key, bssl::UniquePtr<RSA>(EVP_PKEY_get1_RSA(parsed_key.get()))));
@@ -121,8 +119,9 @@ absl::Status RsaRawPkcs1Signer::Sign(KmsClient* client,
   req.set_data(
       std::string(reinterpret_cast<const char*>(data.data()), data.size()));
 
+  // RSASSA-PKCS1-v1_5 signatures are deterministic.
   ASSIGN_OR_RETURN(kms_v1::AsymmetricSignResponse resp,
-                   client->AsymmetricSign(req));
+                   client->AsymmetricSign(req, /*deterministic=*/true));
   std::copy(resp.signature().begin(), resp.signature().end(),
             signature.begin());
   return absl::OkStatus();
@@ -176,10 +175,8 @@ absl::StatusOr<std::unique_ptr<VerifierInterface>> RsaRawPkcs1Verifier::New(
       CheckKeyPreconditions(CKK_RSA, CKO_PUBLIC_KEY, CKM_RSA_PKCS, key.get()));
   RETURN_IF_ERROR(EnsureNoParameters(mechanism));
 
-  ASSIGN_OR_RETURN(std::string_view key_der,
-                   key->attributes().Value(CKA_PUBLIC_KEY_INFO));
   ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> parsed_key,
-                   ParseX509PublicKeyDer(key_der));
+                   key->ParsedPublicKey());
 
   return std::unique_ptr<VerifierInterface>(new RsaRawPkcs1Verifier(
       key, bssl::UniquePtr<RSA>(EVP_PKEY_get1_RSA(parsed_key.get()))));
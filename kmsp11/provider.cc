@@ -14,7 +14,11 @@
 
 #include "kmsp11/provider.h"
 
+#include <fstream>
+
+#include "absl/strings/str_cat.h"
 #include "common/kms_client.h"
+#include "common/retry_policy.h"
 #include "common/status_macros.h"
 #include "glog/logging.h"
 #include "kmsp11/cert_authority.h"
@@ -27,6 +31,10 @@ namespace {
 
 static const char* kDefaultKmsEndpoint = "cloudkms.googleapis.com:443";
 constexpr absl::Duration kDefaultRpcTimeout = absl::Seconds(30);
+constexpr double kDefaultRetryBudgetPerSecond = 10;
+constexpr size_t kDefaultKeyLoadConcurrency = 32;
+constexpr absl::Duration kDefaultRpcStatsDumpInterval = absl::Seconds(60);
+constexpr absl::Duration kDefaultDecryptResultCacheTtl = absl::Minutes(5);
 
 absl::StatusOr<CK_INFO> NewCkInfo() {
   CK_INFO info = {
@@ -42,7 +50,8 @@ absl::StatusOr<CK_INFO> NewCkInfo() {
   return info;
 }
 
-std::unique_ptr<KmsClient> NewKmsClient(const LibraryConfig& config) {
+std::unique_ptr<KmsClient> NewKmsClient(const LibraryConfig& config,
+                                        std::shared_ptr<RpcStats> rpc_stats) {
   KmsClient::Options options;
   options.endpoint_address = config.kms_endpoint().empty()
                                  ? kDefaultKmsEndpoint
@@ -60,28 +69,106 @@ std::unique_ptr<KmsClient> NewKmsClient(const LibraryConfig& config) {
   };
   options.rpc_feature_flags = config.experimental_rpc_feature_flags();
   options.user_project_override = config.user_project_override();
+  options.channel_count = config.grpc_channel_count() == 0
+                              ? 1
+                              : static_cast<int>(config.grpc_channel_count());
+  options.hedging_delay = absl::Milliseconds(config.rpc_hedging_delay_ms());
+  if (config.rpc_max_attempts() > 1) {
+    options.retry_policies = DefaultRetryPolicies(config.rpc_max_attempts());
+    double retries_per_second = config.rpc_retry_budget_per_second() == 0
+                                    ? kDefaultRetryBudgetPerSecond
+                                    : config.rpc_retry_budget_per_second();
+    // The provider owns the only client in the process, so this budget is
+    // effectively process-wide. Allow a burst of one second's worth of retries.
+    options.retry_budget =
+        std::make_shared<RetryBudget>(retries_per_second, retries_per_second);
+  }
+  options.rpc_stats = std::move(rpc_stats);
 
   return std::make_unique<KmsClient>(options);
 }
 
+// Returns the file that RPC stats are written to, or an empty string if they
+// are written to the log.
+std::string RpcStatsPath(const LibraryConfig& config) {
+  if (config.log_directory().empty()) {
+    return "";
+  }
+  std::string path =
+      absl::StrCat(config.log_directory(), "/libkmsp11.rpc_stats");
+  if (!config.log_filename_suffix().empty()) {
+    absl::StrAppend(&path, "-", config.log_filename_suffix());
+  }
+  return path;
+}
+
+DataKeyCache::Options GetDataKeyCacheOptions(const LibraryConfig& config) {
+  DataKeyCache::Options options;
+  if (config.envelope_data_key_max_messages() > 0) {
+    options.max_messages = config.envelope_data_key_max_messages();
+  }
+  if (config.envelope_data_key_lifetime_secs() > 0) {
+    options.max_lifetime =
+        absl::Seconds(config.envelope_data_key_lifetime_secs());
+  }
+  if (config.envelope_unwrapped_key_cache_size() > 0) {
+    options.max_unwrapped_keys = config.envelope_unwrapped_key_cache_size();
+  }
+  return options;
+}
+
+// Returns nullptr if the decrypt result cache is not enabled.
+std::unique_ptr<DecryptResultCache> NewDecryptResultCache(
+    const LibraryConfig& config) {
+  if (config.decrypt_result_cache_size() == 0) {
+    return nullptr;
+  }
+  return std::make_unique<DecryptResultCache>(DecryptResultCache::Options{
+      .max_entries = config.decrypt_result_cache_size(),
+      .ttl = config.decrypt_result_cache_ttl_secs() == 0
+                 ? kDefaultDecryptResultCacheTtl
+                 : absl::Seconds(config.decrypt_result_cache_ttl_secs()),
+  });
+}
+
 }  // namespace
 
 absl::StatusOr<std::unique_ptr<Provider>> Provider::New(LibraryConfig config) {
   ASSIGN_OR_RETURN(CK_INFO info, NewCkInfo());
-  std::unique_ptr<KmsClient> client = NewKmsClient(config);
+  std::shared_ptr<RpcStats> rpc_stats;
+  if (config.enable_rpc_stats()) {
+    rpc_stats = std::make_shared<RpcStats>(RpcStats::Options{
+        .per_resource = config.rpc_stats_per_key(),
+    });
+  }
+  std::unique_ptr<KmsClient> client = NewKmsClient(config, rpc_stats);
+
+  size_t key_load_concurrency = config.key_load_concurrency() == 0
+                                    ? kDefaultKeyLoadConcurrency
+                                    : config.key_load_concurrency();
+
+  auto data_key_cache =
+      std::make_unique<DataKeyCache>(GetDataKeyCacheOptions(config));
+  std::unique_ptr<DecryptResultCache> decrypt_result_cache =
+      NewDecryptResultCache(config);
 
   std::vector<std::unique_ptr<Token>> tokens;
   tokens.reserve(config.tokens_size());
   for (const TokenConfig& tokenConfig : config.tokens()) {
     ASSIGN_OR_RETURN(std::unique_ptr<Token> token,
                      Token::New(tokens.size(), tokenConfig, client.get(),
-                                config.generate_certs()));
+                                config.generate_certs(), key_load_concurrency,
+                                config.state_snapshot_directory(),
+                                decrypt_result_cache.get(),
+                                data_key_cache.get()));
     tokens.emplace_back(std::move(token));
   }
 
   // using `new` to invoke a private constructor
   return std::unique_ptr<Provider>(
       new Provider(config, info, std::move(tokens), std::move(client),
+                   std::move(rpc_stats), std::move(data_key_cache),
+                   std::move(decrypt_result_cache),
                    absl::Seconds(config.refresh_interval_secs())));
 }
 
@@ -116,19 +203,43 @@ absl::Status Provider::CloseAllSessions(CK_SLOT_ID slot_id) {
   return absl::OkStatus();
 }
 
+std::string Provider::RpcStatsReport() const {
+  std::string report = rpc_stats_->ToString();
+  if (decrypt_result_cache_) {
+    absl::StrAppend(&report, decrypt_result_cache_->ToString());
+  }
+  return report;
+}
+
+void Provider::RefreshToken(Token* token) {
+  absl::Status refresh_result = token->RefreshState(*kms_client_);
+  if (!refresh_result.ok()) {
+    LOG(ERROR) << "error refreshing state for key ring "
+               << token->key_ring_name() << ": " << refresh_result;
+  }
+}
+
 Provider::Refresher::Refresher(Provider* provider, absl::Duration interval)
     : thread_(
           [](Provider* provider, const absl::Duration interval,
              const absl::Notification* shutdown) {
+            // Tokens that were initialized from a snapshot are reconciled
+            // with Cloud KMS right away, rather than after the first interval.
+            for (const std::unique_ptr<Token>& token : provider->tokens_) {
+              if (shutdown->HasBeenNotified()) {
+                return;
+              }
+              if (token->loaded_from_snapshot()) {
+                provider->RefreshToken(token.get());
+              }
+            }
+            if (interval <= absl::ZeroDuration()) {
+              return;
+            }
+
             while (!shutdown->WaitForNotificationWithTimeout(interval)) {
               for (const std::unique_ptr<Token>& token : provider->tokens_) {
-                absl::Status refresh_result =
-                    token->RefreshState(*provider->kms_client_);
-                if (!refresh_result.ok()) {
-                  LOG(ERROR)
-                      << "error refreshing state for key ring "
-                      << token->key_ring_name() << ": " << refresh_result;
-                }
+                provider->RefreshToken(token.get());
               }
             }
           },
@@ -139,6 +250,45 @@ Provider::Refresher::~Refresher() {
   thread_.join();
 }
 
+Provider::RpcStatsDumper::RpcStatsDumper(const Provider* provider,
+                                         const LibraryConfig& config)
+    : provider_(provider),
+      path_(RpcStatsPath(config)),
+      thread_(
+          [](const RpcStatsDumper* dumper, const absl::Duration interval,
+             const absl::Notification* shutdown) {
+            while (!shutdown->WaitForNotificationWithTimeout(interval)) {
+              dumper->Dump();
+            }
+          },
+          this,
+          config.rpc_stats_dump_interval_secs() == 0
+              ? kDefaultRpcStatsDumpInterval
+              : absl::Seconds(config.rpc_stats_dump_interval_secs()),
+          &shutdown_) {}
+
+Provider::RpcStatsDumper::~RpcStatsDumper() {
+  shutdown_.Notify();
+  thread_.join();
+  Dump();
+}
+
+void Provider::RpcStatsDumper::Dump() const {
+  std::string stats = provider_->RpcStatsReport();
+  if (path_.empty()) {
+    LOG(INFO) << "RPC stats:\n" << stats;
+    return;
+  }
+
+  // Each dump replaces the previous one; the counters are cumulative.
+  std::ofstream out(path_, std::ios::out | std::ios::trunc);
+  out << stats;
+  out.close();
+  if (out.fail()) {
+    LOG(WARNING) << "failed to write RPC stats to " << path_;
+  }
+}
+
 absl::Span<const CK_MECHANISM_TYPE> Provider::Mechanisms() {
   return mechanism_types_;
 }
@@ -17,13 +17,17 @@
 #ifndef KMSP11_PROVIDER_H_
 #define KMSP11_PROVIDER_H_
 
+#include <algorithm>
 #include <thread>
 
 #include "absl/status/statusor.h"
 #include "absl/synchronization/notification.h"
+#include "common/rpc_stats.h"
 #include "kmsp11/config/config.pb.h"
 #include "kmsp11/cryptoki.h"
 #include "kmsp11/mechanism.h"
+#include "kmsp11/operation/data_key_cache.h"
+#include "kmsp11/operation/decrypt_result_cache.h"
 #include "kmsp11/session.h"
 #include "kmsp11/token.h"
 #include "kmsp11/util/errors.h"
@@ -43,6 +47,17 @@ class Provider {
   const CK_INFO& info() const { return info_; }
   const unsigned long token_count() const { return tokens_.size(); }
   KmsClient* kms_client() { return kms_client_.get(); }
+  // Returns nullptr if RPC stats are not enabled.
+  const RpcStats* rpc_stats() const { return rpc_stats_.get(); }
+  DataKeyCache* data_key_cache() { return data_key_cache_.get(); }
+  // Returns nullptr if the decrypt result cache is not enabled.
+  DecryptResultCache* decrypt_result_cache() {
+    return decrypt_result_cache_.get();
+  }
+
+  // Returns the RPC stats report, followed by the decrypt result cache's
+  // counters if it is enabled. RPC stats must be enabled.
+  std::string RpcStatsReport() const;
 
   absl::StatusOr<Token*> TokenAt(CK_SLOT_ID slot_id);
 
@@ -69,18 +84,49 @@ class Provider {
     std::thread thread_;
   };
 
+  // Writes RPC stats on an interval, and once more on destruction.
+  class RpcStatsDumper {
+   public:
+    RpcStatsDumper(const Provider* provider, const LibraryConfig& config);
+    virtual ~RpcStatsDumper();
+
+   private:
+    void Dump() const;
+
+    const Provider* provider_;
+    // Empty if stats are written to the log.
+    const std::string path_;
+    absl::Notification shutdown_;
+    std::thread thread_;
+  };
+
+  void RefreshToken(Token* token);
+
   Provider(LibraryConfig library_config, CK_INFO info,
            std::vector<std::unique_ptr<Token>>&& tokens,
            std::unique_ptr<KmsClient> kms_client,
+           std::shared_ptr<RpcStats> rpc_stats,
+           std::unique_ptr<DataKeyCache> data_key_cache,
+           std::unique_ptr<DecryptResultCache> decrypt_result_cache,
            absl::Duration refresh_interval)
       : library_config_(library_config),
         info_(info),
+        data_key_cache_(std::move(data_key_cache)),
+        decrypt_result_cache_(std::move(decrypt_result_cache)),
         tokens_(std::move(tokens)),
         sessions_(CKR_SESSION_HANDLE_INVALID),
-        kms_client_(std::move(kms_client)) {
-    if (refresh_interval > absl::ZeroDuration()) {
+        kms_client_(std::move(kms_client)),
+        rpc_stats_(std::move(rpc_stats)) {
+    if (refresh_interval > absl::ZeroDuration() ||
+        std::any_of(tokens_.begin(), tokens_.end(),
+                    [](const std::unique_ptr<Token>& token) {
+                      return token->loaded_from_snapshot();
+                    })) {
       refresher_.emplace(this, refresh_interval);
     }
+    if (rpc_stats_) {
+      rpc_stats_dumper_.emplace(this, library_config_);
+    }
     auto all_mechanisms = AllMechanisms();
     auto all_mac_mechanisms = AllMacMechanisms();
     auto all_raw_encryption_mechanisms = AllRawEncryptionMechanisms();
@@ -109,10 +155,15 @@ class Provider {
 
   const LibraryConfig library_config_;
   const CK_INFO info_;
+  // Declared before tokens_, since tokens may refer to the caches.
+  std::unique_ptr<DataKeyCache> data_key_cache_;
+  std::unique_ptr<DecryptResultCache> decrypt_result_cache_;
   const std::vector<std::unique_ptr<Token>> tokens_;
   HandleMap<Session> sessions_;
   std::unique_ptr<KmsClient> kms_client_;
+  std::shared_ptr<RpcStats> rpc_stats_;
   std::optional<Refresher> refresher_;
+  std::optional<RpcStatsDumper> rpc_stats_dumper_;
   std::vector<CK_MECHANISM_TYPE> mechanism_types_;
 };
 
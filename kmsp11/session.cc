@@ -14,6 +14,7 @@
 
 #include "kmsp11/session.h"
 
+#include <algorithm>
 #include <regex>
 
 #include "common/kms_client.h"
@@ -82,14 +83,15 @@ absl::StatusOr<KeyGenerationParams> ExtractKeyGenerationParams(
         CKR_TEMPLATE_INCOMPLETE, SOURCE_LOCATION);
   }
 
-  absl::StatusOr<AlgorithmDetails> algorithm_details = GetDetails(*algorithm);
+  absl::StatusOr<const AlgorithmDetails*> algorithm_details =
+      GetDetails(*algorithm);
   if (!algorithm_details.ok()) {
     return NewInvalidArgumentError(algorithm_details.status().message(),
                                    CKR_ATTRIBUTE_VALUE_INVALID,
                                    SOURCE_LOCATION);
   }
 
-  return KeyGenerationParams{*label, *algorithm_details};
+  return KeyGenerationParams{*label, **algorithm_details};
 }
 
 absl::StatusOr<kms_v1::CryptoKeyVersion> CreateNewVersionOfExistingKey(
@@ -211,16 +213,58 @@ absl::Status Session::FindObjectsInit(
     return OperationActiveError(SOURCE_LOCATION);
   }
 
-  std::vector<CK_OBJECT_HANDLE> results =
-      token_->FindObjects([&attributes](const Object& o) -> bool {
-        for (const CK_ATTRIBUTE& attr : attributes) {
-          if (!o.attributes().Contains(attr)) {
-            return false;
-          }
-        }
-        return true;
+  auto matches = [&attributes](const Object& o,
+                                bool skip_public_key_attributes) -> bool {
+    for (const CK_ATTRIBUTE& attr : attributes) {
+      if (skip_public_key_attributes &&
+          Object::IsPublicKeyAttribute(attr.type)) {
+        continue;
+      }
+      if (!o.attributes().Contains(attr)) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  // Objects whose public key has not yet been retrieved are matched on their
+  // other attributes first.
+  std::vector<CK_OBJECT_HANDLE> results = token_->FindObjects(
+      attributes, [&matches](const Object& o) -> bool {
+        return matches(o, o.public_key_deferred());
       });
 
+  bool has_public_key_attribute =
+      std::any_of(attributes.begin(), attributes.end(),
+                  [](const CK_ATTRIBUTE& attr) {
+                    return Object::IsPublicKeyAttribute(attr.type);
+                  });
+  if (has_public_key_attribute) {
+    std::vector<CK_OBJECT_HANDLE> candidates = std::move(results);
+    results.clear();
+    for (CK_OBJECT_HANDLE handle : candidates) {
+      absl::StatusOr<std::shared_ptr<Object>> object =
+          token_->GetObject(handle);
+      if (!object.ok()) {
+        continue;  // The object was removed by a concurrent refresh.
+      }
+      if ((*object)->public_key_deferred()) {
+        object = token_->ResolvePublicKey(*std::move(object));
+        if (!object.ok()) {
+          // The public key couldn't be retrieved, for example because the
+          // version was disabled. The key is left out of this search rather
+          // than failing it, and later searches try again.
+          continue;
+        }
+      }
+      // The token's search only matched a deferred object on its other
+      // attributes, even if its public key has since been retrieved.
+      if (matches(**object, false)) {
+        results.push_back(handle);
+      }
+    }
+  }
+
   op_ = FindOp(results);
   return absl::OkStatus();
 }
@@ -248,17 +292,18 @@ absl::Status Session::FindObjectsFinal() {
   return absl::OkStatus();
 }
 
-absl::Status Session::DecryptInit(std::shared_ptr<Object> key,
-                                  CK_MECHANISM* mechanism,
-                                  bool allow_raw_encryption_keys) {
+absl::Status Session::DecryptInit(
+    std::shared_ptr<Object> key, CK_MECHANISM* mechanism,
+    bool allow_raw_encryption_keys,
+    const RawEncryptionOptions& raw_encryption_options) {
   absl::MutexLock l(&op_mutex_);
 
   if (op_.has_value()) {
     return OperationActiveError(SOURCE_LOCATION);
   }
 
-  ASSIGN_OR_RETURN(op_,
-                   NewDecryptOp(key, mechanism, allow_raw_encryption_keys));
+  ASSIGN_OR_RETURN(op_, NewDecryptOp(key, mechanism, allow_raw_encryption_keys,
+                                     raw_encryption_options));
   return absl::OkStatus();
 }
 
@@ -273,14 +318,44 @@ absl::StatusOr<absl::Span<const uint8_t>> Session::Decrypt(
   return std::get<DecryptOp>(*op_)->Decrypt(kms_client_, ciphertext);
 }
 
-absl::Status Session::DecryptUpdate(absl::Span<const uint8_t> ciphertext) {
+absl::StatusOr<size_t> Session::DecryptUpdate(
+    absl::Span<const uint8_t> ciphertext, absl::Span<uint8_t> plaintext) {
+  absl::MutexLock l(&op_mutex_);
+
+  if (!op_.has_value() || !std::holds_alternative<DecryptOp>(*op_)) {
+    return OperationNotInitializedError("decrypt", SOURCE_LOCATION);
+  }
+  DecryptOp& op = std::get<DecryptOp>(*op_);
+
+  size_t plaintext_size = op->DecryptUpdateOutputLength();
+  if (plaintext_size > plaintext.size()) {
+    return OutOfRangeError(
+        absl::StrFormat(
+            "plaintext of length %d cannot fit in buffer of length %d",
+            plaintext_size, plaintext.size()),
+        SOURCE_LOCATION);
+  }
+
+  ASSIGN_OR_RETURN(absl::Span<const uint8_t> result,
+                   op->DecryptUpdate(kms_client_, ciphertext));
+  if (result.size() != plaintext_size) {
+    return NewInternalError(
+        absl::StrFormat("DecryptUpdate returned %d bytes, but reported %d",
+                        result.size(), plaintext_size),
+        SOURCE_LOCATION);
+  }
+  std::copy(result.begin(), result.end(), plaintext.begin());
+  return result.size();
+}
+
+absl::StatusOr<size_t> Session::DecryptUpdateOutputLength() {
   absl::MutexLock l(&op_mutex_);
 
   if (!op_.has_value() || !std::holds_alternative<DecryptOp>(*op_)) {
     return OperationNotInitializedError("decrypt", SOURCE_LOCATION);
   }
 
-  return std::get<DecryptOp>(*op_)->DecryptUpdate(kms_client_, ciphertext);
+  return std::get<DecryptOp>(*op_)->DecryptUpdateOutputLength();
 }
 
 absl::StatusOr<absl::Span<const uint8_t>> Session::DecryptFinal() {
@@ -293,17 +368,18 @@ absl::StatusOr<absl::Span<const uint8_t>> Session::DecryptFinal() {
   return std::get<DecryptOp>(*op_)->DecryptFinal(kms_client_);
 }
 
-absl::Status Session::EncryptInit(std::shared_ptr<Object> key,
-                                  CK_MECHANISM* mechanism,
-                                  bool allow_raw_encryption_keys) {
+absl::Status Session::EncryptInit(
+    std::shared_ptr<Object> key, CK_MECHANISM* mechanism,
+    bool allow_raw_encryption_keys,
+    const RawEncryptionOptions& raw_encryption_options) {
   absl::MutexLock l(&op_mutex_);
 
   if (op_.has_value()) {
     return OperationActiveError(SOURCE_LOCATION);
   }
 
-  ASSIGN_OR_RETURN(op_,
-                   NewEncryptOp(key, mechanism, allow_raw_encryption_keys));
+  ASSIGN_OR_RETURN(op_, NewEncryptOp(key, mechanism, allow_raw_encryption_keys,
+                                     raw_encryption_options));
   return absl::OkStatus();
 }
 
@@ -318,15 +394,46 @@ absl::StatusOr<absl::Span<const uint8_t>> Session::Encrypt(
   return std::get<EncryptOp>(*op_)->Encrypt(kms_client_, plaintext);
 }
 
-absl::Status Session::EncryptUpdate(absl::Span<const uint8_t> plaintext) {
+absl::StatusOr<size_t> Session::EncryptUpdate(
+    absl::Span<const uint8_t> plaintext, absl::Span<uint8_t> ciphertext) {
   absl::MutexLock l(&op_mutex_);
 
   if (!op_.has_value() || !std::holds_alternative<EncryptOp>(*op_)) {
     return OperationNotInitializedError("encrypt", SOURCE_LOCATION);
   }
+  EncryptOp& op = std::get<EncryptOp>(*op_);
 
-  return std::get<EncryptOp>(*op_)->EncryptUpdate(kms_client_, plaintext);
+  size_t ciphertext_size = op->EncryptUpdateOutputLength();
+  if (ciphertext_size > ciphertext.size()) {
+    return OutOfRangeError(
+        absl::StrFormat(
+            "ciphertext of length %d cannot fit in buffer of length %d",
+            ciphertext_size, ciphertext.size()),
+        SOURCE_LOCATION);
+  }
+
+  ASSIGN_OR_RETURN(absl::Span<const uint8_t> result,
+                   op->EncryptUpdate(kms_client_, plaintext));
+  if (result.size() != ciphertext_size) {
+    return NewInternalError(
+        absl::StrFormat("EncryptUpdate returned %d bytes, but reported %d",
+                        result.size(), ciphertext_size),
+        SOURCE_LOCATION);
+  }
+  std::copy(result.begin(), result.end(), ciphertext.begin());
+  return result.size();
+}
+
+absl::StatusOr<size_t> Session::EncryptUpdateOutputLength() {
+  absl::MutexLock l(&op_mutex_);
+
+  if (!op_.has_value() || !std::holds_alternative<EncryptOp>(*op_)) {
+    return OperationNotInitializedError("encrypt", SOURCE_LOCATION);
+  }
+
+  return std::get<EncryptOp>(*op_)->EncryptUpdateOutputLength();
 }
+
 absl::StatusOr<absl::Span<const uint8_t>> Session::EncryptFinal() {
   absl::MutexLock l(&op_mutex_);
 
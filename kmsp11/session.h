@@ -48,17 +48,30 @@ class Session {
   absl::Status FindObjectsFinal();
 
   absl::Status DecryptInit(std::shared_ptr<Object> key, CK_MECHANISM* mechanism,
-                           bool allow_raw_encryption_keys = false);
+                           bool allow_raw_encryption_keys = false,
+                           const RawEncryptionOptions& raw_encryption_options =
+                               RawEncryptionOptions());
   absl::StatusOr<absl::Span<const uint8_t>> Decrypt(
       absl::Span<const uint8_t> ciphertext);
-  absl::Status DecryptUpdate(absl::Span<const uint8_t> ciphertext);
+  // Continues a multi-part decrypt and copies any plaintext it returns into
+  // `plaintext`, returning the number of bytes copied. The length check and the
+  // update are done under one lock, so that a concurrent call on this session
+  // cannot change the length after it was checked.
+  absl::StatusOr<size_t> DecryptUpdate(absl::Span<const uint8_t> ciphertext,
+                                       absl::Span<uint8_t> plaintext);
+  absl::StatusOr<size_t> DecryptUpdateOutputLength();
   absl::StatusOr<absl::Span<const uint8_t>> DecryptFinal();
 
   absl::Status EncryptInit(std::shared_ptr<Object> key, CK_MECHANISM* mechanism,
-                           bool allow_raw_encryption_keys = false);
+                           bool allow_raw_encryption_keys = false,
+                           const RawEncryptionOptions& raw_encryption_options =
+                               RawEncryptionOptions());
   absl::StatusOr<absl::Span<const uint8_t>> Encrypt(
       absl::Span<const uint8_t> plaintext);
-  absl::Status EncryptUpdate(absl::Span<const uint8_t> plaintext);
+  // Like DecryptUpdate, for a multi-part encrypt.
+  absl::StatusOr<size_t> EncryptUpdate(absl::Span<const uint8_t> plaintext,
+                                       absl::Span<uint8_t> ciphertext);
+  absl::StatusOr<size_t> EncryptUpdateOutputLength();
   absl::StatusOr<absl::Span<const uint8_t>> EncryptFinal();
 
   absl::Status SignInit(std::shared_ptr<Object> key, CK_MECHANISM* mechanism,
@@ -266,6 +266,114 @@ TEST_F(SessionTest, FindPublicKeysMultiPage) {
   EXPECT_OK(s.FindObjectsFinal());
 }
 
+TEST_F(SessionTest, FindByPublicKeyInfoWithLazyPublicKeys) {
+  auto kms_client = fake_server_->NewClient();
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::EC_SIGN_P384_SHA384);
+  ck.mutable_version_template()->set_protection_level(
+      kms_v1::ProtectionLevel::HSM);
+  ck = CreateCryptoKeyOrDie(kms_client.get(), key_ring_.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv1;
+  ckv1 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv1);
+  ckv1 = WaitForEnablement(kms_client.get(), ckv1);
+
+  kms_v1::CryptoKeyVersion ckv2;
+  ckv2 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv2);
+  ckv2 = WaitForEnablement(kms_client.get(), ckv2);
+
+  kms_v1::PublicKey public_key = GetPublicKeyOrDie(kms_client.get(), ckv2);
+  ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> pub,
+                       ParseX509PublicKeyPem(public_key.pem()));
+  ASSERT_OK_AND_ASSIGN(std::string pub_der, MarshalX509PublicKeyDer(pub.get()));
+
+  config_.set_lazy_public_keys(true);
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Token> token,
+                       Token::New(0, config_, client_.get()));
+  Session s(token.get(), SessionType::kReadOnly, client_.get());
+
+  CK_OBJECT_CLASS want_class = CKO_PUBLIC_KEY;
+  std::vector<CK_ATTRIBUTE> attr_template = {
+      {CKA_CLASS, &want_class, sizeof(want_class)},
+      {CKA_PUBLIC_KEY_INFO, pub_der.data(), pub_der.size()},
+  };
+
+  EXPECT_OK(s.FindObjectsInit(attr_template));
+
+  ASSERT_OK_AND_ASSIGN(absl::Span<const CK_OBJECT_HANDLE> handles,
+                       s.FindObjects(5));
+  ASSERT_EQ(handles.size(), 1);
+  EXPECT_THAT(
+      token->GetObject(handles[0]),
+      IsOkAndHolds(Pointee(AllOf(
+          Property("kms_key_name", &Object::kms_key_name, ckv2.name()),
+          Property("object_class", &Object::object_class, CKO_PUBLIC_KEY)))));
+
+  EXPECT_OK(s.FindObjectsFinal());
+}
+
+TEST_F(SessionTest, FindLazyPublicKeySkipsUnresolvableKeys) {
+  auto kms_client = fake_server_->NewClient();
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::EC_SIGN_P384_SHA384);
+  ck.mutable_version_template()->set_protection_level(
+      kms_v1::ProtectionLevel::HSM);
+  ck = CreateCryptoKeyOrDie(kms_client.get(), key_ring_.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv1;
+  ckv1 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv1);
+  ckv1 = WaitForEnablement(kms_client.get(), ckv1);
+
+  kms_v1::CryptoKeyVersion ckv2;
+  ckv2 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv2);
+  ckv2 = WaitForEnablement(kms_client.get(), ckv2);
+
+  kms_v1::PublicKey public_key = GetPublicKeyOrDie(kms_client.get(), ckv2);
+  ASSERT_OK_AND_ASSIGN(bssl::UniquePtr<EVP_PKEY> pub,
+                       ParseX509PublicKeyPem(public_key.pem()));
+  ASSERT_OK_AND_ASSIGN(std::string pub_der, MarshalX509PublicKeyDer(pub.get()));
+
+  config_.set_lazy_public_keys(true);
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Token> token,
+                       Token::New(0, config_, client_.get()));
+  Session s(token.get(), SessionType::kReadOnly, client_.get());
+
+  // Disabling the first version after the token is loaded makes its public key
+  // unavailable.
+  ckv1.set_state(kms_v1::CryptoKeyVersion::DISABLED);
+  google::protobuf::FieldMask update_mask;
+  update_mask.add_paths("state");
+  ckv1 = UpdateCryptoKeyVersionOrDie(kms_client.get(), ckv1, update_mask);
+
+  CK_OBJECT_CLASS want_class = CKO_PUBLIC_KEY;
+  std::vector<CK_ATTRIBUTE> attr_template = {
+      {CKA_CLASS, &want_class, sizeof(want_class)},
+      {CKA_PUBLIC_KEY_INFO, pub_der.data(), pub_der.size()},
+  };
+
+  // Searching twice also matches the second version once it has been
+  // resolved.
+  for (int i = 0; i < 2; i++) {
+    EXPECT_OK(s.FindObjectsInit(attr_template));
+    ASSERT_OK_AND_ASSIGN(absl::Span<const CK_OBJECT_HANDLE> handles,
+                         s.FindObjects(5));
+    ASSERT_EQ(handles.size(), 1);
+    EXPECT_THAT(token->GetObject(handles[0]),
+                IsOkAndHolds(Pointee(AllOf(
+                    Property("kms_key_name", &Object::kms_key_name,
+                             ckv2.name()),
+                    Property("public_key_deferred",
+                             &Object::public_key_deferred, false)))));
+    EXPECT_OK(s.FindObjectsFinal());
+  }
+}
+
 TEST_F(SessionTest, FindInitAlreadyActive) {
   ASSERT_OK_AND_ASSIGN(std::unique_ptr<Token> token,
                        Token::New(0, config_, client_.get()));
@@ -389,7 +497,9 @@ TEST_F(SessionTest, DecryptUpdateNotInitialized) {
   Session s(token.get(), SessionType::kReadOnly, client_.get());
 
   uint8_t data[32];
-  EXPECT_THAT(s.DecryptUpdate(data), StatusRvIs(CKR_OPERATION_NOT_INITIALIZED));
+  uint8_t plaintext[32];
+  EXPECT_THAT(s.DecryptUpdate(data, plaintext),
+              StatusRvIs(CKR_OPERATION_NOT_INITIALIZED));
 }
 
 TEST_F(SessionTest, DecryptFinalNotInitialized) {
@@ -537,7 +647,9 @@ TEST_F(SessionTest, EncryptUpdateNotInitialized) {
   Session s(token.get(), SessionType::kReadOnly, client_.get());
 
   uint8_t data[32];
-  EXPECT_THAT(s.EncryptUpdate(data), StatusRvIs(CKR_OPERATION_NOT_INITIALIZED));
+  uint8_t ciphertext[32];
+  EXPECT_THAT(s.EncryptUpdate(data, ciphertext),
+              StatusRvIs(CKR_OPERATION_NOT_INITIALIZED));
 }
 
 TEST_F(SessionTest, EncryptFinalNotInitialized) {
@@ -0,0 +1,88 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fakekmsbenchmark
+
+import (
+	"testing"
+	"time"
+
+	kms "cloud.google.com/go/kms/apiv1"
+	"cloud.google.com/kms/integrations/fakekms"
+	"github.com/miekg/pkcs11"
+)
+
+// BenchmarkAttributeProbe measures the throughput of C_GetAttributeValue calls
+// that probe an EC private key for attributes it does not have or will not
+// reveal, as applications commonly do when discovering a key's type. Each
+// sub-benchmark requests a single attribute, and expects the provided return
+// value.
+func BenchmarkAttributeProbe(b *testing.B) {
+	env := newBenchEnv(b, fakekms.ServerOptions{},
+		func(client *kms.KeyManagementClient) { createSigningKeys(b, client, 1) }, "")
+	defer env.Close()
+
+	session, closeSession := newSessionHandle(b)
+	defer closeSession()
+	key := findPrivateKey(b, session, "key-0")
+
+	for _, c := range []struct {
+		name      string
+		attribute uint
+		want      error
+	}{
+		{"present", pkcs11.CKA_LABEL, nil},
+		{"absent", pkcs11.CKA_MODULUS, pkcs11.Error(pkcs11.CKR_ATTRIBUTE_TYPE_INVALID)},
+		{"sensitive", pkcs11.CKA_VALUE, pkcs11.Error(pkcs11.CKR_ATTRIBUTE_SENSITIVE)},
+	} {
+		b.Run(c.name, func(b *testing.B) {
+			template := []*pkcs11.Attribute{pkcs11.NewAttribute(c.attribute, nil)}
+
+			b.ResetTimer()
+			start := time.Now()
+			for i := 0; i < b.N; i++ {
+				_, err := p.GetAttributeValue(session, key, template)
+				if err != c.want {
+					b.Fatalf("GetAttributeValue returned err=%v, want %v", err, c.want)
+				}
+			}
+			b.StopTimer()
+
+			b.ReportMetric(float64(b.N)/time.Since(start).Seconds(), "probes/s")
+		})
+	}
+}
+
+// findPrivateKey returns the handle of the private key with the provided label.
+func findPrivateKey(tb testing.TB, session pkcs11.SessionHandle, label string) pkcs11.ObjectHandle {
+	tb.Helper()
+	template := []*pkcs11.Attribute{
+		pkcs11.NewAttribute(pkcs11.CKA_CLASS, pkcs11.CKO_PRIVATE_KEY),
+		pkcs11.NewAttribute(pkcs11.CKA_LABEL, label),
+	}
+	if err := p.FindObjectsInit(session, template); err != nil {
+		tb.Fatalf("FindObjectsInit: %v", err)
+	}
+	handles, _, err := p.FindObjects(session, 1)
+	if err != nil {
+		tb.Fatalf("FindObjects: %v", err)
+	}
+	if err := p.FindObjectsFinal(session); err != nil {
+		tb.Fatalf("FindObjectsFinal: %v", err)
+	}
+	if len(handles) != 1 {
+		tb.Fatalf("found %d private keys with label %q, want 1", len(handles), label)
+	}
+	return handles[0]
+}
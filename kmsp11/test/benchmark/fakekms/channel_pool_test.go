@@ -0,0 +1,93 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fakekmsbenchmark
+
+import (
+	"crypto/rand"
+	"fmt"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"cloud.google.com/kms/integrations/fakekms"
+	"github.com/miekg/pkcs11"
+)
+
+// BenchmarkSignChannelPool measures C_Sign latency as the number of concurrent
+// callers grows, for several sizes of the library's gRPC channel pool. Each
+// sub-benchmark reports the p99 latency of a single sign operation.
+func BenchmarkSignChannelPool(b *testing.B) {
+	for _, channels := range []int{1, 4, 16} {
+		for _, concurrency := range []int{1, 8, 64, 128, 256, 512} {
+			name := fmt.Sprintf("channels=%d/concurrency=%d", channels, concurrency)
+			b.Run(name, func(b *testing.B) {
+				benchmarkSignConcurrent(b, channels, concurrency)
+			})
+		}
+	}
+}
+
+func benchmarkSignConcurrent(b *testing.B, channels, concurrency int) {
+	env := newBenchEnv(b, fakekms.ServerOptions{}, nil, fmt.Sprintf("grpc_channel_count: %d\n", channels))
+	defer env.Close()
+	key := createECSigningKey(b, "sign-key")
+
+	digest := make([]byte, 32)
+	if _, err := rand.Read(digest); err != nil {
+		b.Fatalf("failed to generate digest: %v", err)
+	}
+
+	// Sessions are opened up front, since newSessionHandle must be called from
+	// the benchmark goroutine.
+	sessions := make([]pkcs11.SessionHandle, concurrency)
+	for i := range sessions {
+		session, closeSession := newSessionHandle(b)
+		defer closeSession()
+		sessions[i] = session
+	}
+
+	latencies := make([]time.Duration, b.N)
+	var next int64 = -1
+	var wg sync.WaitGroup
+
+	b.ResetTimer()
+	for _, session := range sessions {
+		wg.Add(1)
+		go func(session pkcs11.SessionHandle) {
+			defer wg.Done()
+			for {
+				op := atomic.AddInt64(&next, 1)
+				if op >= int64(b.N) {
+					return
+				}
+				start := time.Now()
+				if err := p.SignInit(session, []*pkcs11.Mechanism{pkcs11.NewMechanism(pkcs11.CKM_ECDSA, nil)}, key); err != nil {
+					b.Errorf("SignInit: %v", err)
+					return
+				}
+				if _, err := p.Sign(session, digest); err != nil {
+					b.Errorf("failed to sign: %v", err)
+					return
+				}
+				latencies[op] = time.Since(start)
+			}
+		}(session)
+	}
+	wg.Wait()
+	b.StopTimer()
+
+	b.ReportMetric(float64(percentile(latencies, 0.99).Microseconds()), "p99-us")
+}
@@ -0,0 +1,239 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Package fakekmsbenchmark contains benchmarks that exercise the library
+// against an in-process fakekms server, so that they can be run without access
+// to Cloud KMS.
+package fakekmsbenchmark
+
+import (
+	"context"
+	"fmt"
+	"os"
+	"path"
+	"sort"
+	"testing"
+	"time"
+
+	kms "cloud.google.com/go/kms/apiv1"
+	"cloud.google.com/kms/integrations/fakekms"
+	"github.com/bazelbuild/rules_go/go/tools/bazel"
+	"github.com/miekg/pkcs11"
+	"google.golang.org/api/option"
+	"google.golang.org/grpc"
+
+	kmspb "google.golang.org/genproto/googleapis/cloud/kms/v1"
+)
+
+const (
+	GoogleDefined = (0x80000000 | 0x1E100)
+	KMSAlgorithm  = (GoogleDefined | 0x01)
+
+	keyRingParent = "projects/oss-tools-test/locations/us-central1"
+	keyRingID     = "benchmark"
+)
+
+var p *pkcs11.Ctx
+
+func init() {
+	lib, err := bazel.Runfile("kmsp11/main/libkmsp11.so")
+	if err != nil {
+		errorString := fmt.Sprintf("error locating KMS PKCS11 .so library: %v", err)
+		panic(errorString)
+	}
+	p = pkcs11.New(lib)
+}
+
+const configVar = "KMS_PKCS11_CONFIG"
+
+// benchEnv is a fakekms server with a single empty key ring, and the PKCS #11
+// library initialized against it.
+type benchEnv struct {
+	tb                     testing.TB
+	server                 *fakekms.Server
+	client                 *kms.KeyManagementClient
+	testDir, logDir        string
+	envVarSet, initialized bool
+}
+
+func (env *benchEnv) Close() {
+	if env.initialized {
+		if err := p.Finalize(); err != nil {
+			env.tb.Errorf("error calling C_Finalize: %v", err)
+		}
+	}
+	if env.envVarSet {
+		if err := os.Unsetenv(configVar); err != nil {
+			env.tb.Errorf("error unsetting %q: %v", configVar, err)
+		}
+	}
+	if env.client != nil {
+		env.client.Close()
+	}
+	if env.server != nil {
+		env.server.Close()
+	}
+
+	if env.tb.Failed() {
+		env.tb.Log("attempting to extract library logs to supplmement test failure information")
+		entries, err := os.ReadDir(env.logDir)
+		if err != nil {
+			env.tb.Logf("failed to read from log directory: %v", err)
+		}
+
+		for _, entry := range entries {
+			fullPath := path.Join(env.logDir, entry.Name())
+			fileBytes, err := os.ReadFile(fullPath)
+			if err != nil {
+				env.tb.Logf("error reading file %q: %v", fullPath, err)
+			}
+			env.tb.Logf("contents of %q: %s", fullPath, string(fileBytes))
+		}
+	}
+
+	os.RemoveAll(env.testDir)
+}
+
+const configTemplate = `---
+kms_endpoint: %q
+tokens:
+  - key_ring: %s/keyRings/%s
+log_directory: %q
+use_insecure_grpc_channel_credentials: 1
+`
+
+// newBenchEnv starts a fakekms server with the provided options and creates the
+// benchmark key ring. setup, if non-nil, is invoked with a KMS client before the library is
+// initialized, so that it can populate the key ring. extraConfig is appended
+// to the library's YAML configuration.
+func newBenchEnv(tb testing.TB, opts fakekms.ServerOptions, setup func(*kms.KeyManagementClient), extraConfig string) *benchEnv {
+	tb.Helper()
+	env := &benchEnv{tb: tb}
+
+	var err error
+	if env.server, err = fakekms.NewServerWithOptions(opts); err != nil {
+		tb.Fatalf("error starting fakekms server: %v", err)
+	}
+
+	cc, err := grpc.Dial(env.server.Addr.String(), grpc.WithInsecure())
+	if err != nil {
+		env.Close()
+		tb.Fatalf("error opening gRPC client connection to fakekms: %v", err)
+	}
+
+	ctx := context.Background()
+	if env.client, err = kms.NewKeyManagementClient(ctx, option.WithGRPCConn(cc)); err != nil {
+		env.Close()
+		tb.Fatalf("error creating KMS client: %v", err)
+	}
+	_, err = env.client.CreateKeyRing(ctx, &kmspb.CreateKeyRingRequest{
+		Parent:    keyRingParent,
+		KeyRingId: keyRingID,
+	})
+	if err != nil {
+		env.Close()
+		tb.Fatalf("error creating KMS keyring: %v", err)
+	}
+	if setup != nil {
+		setup(env.client)
+	}
+
+	if env.testDir, err = os.MkdirTemp("", "pkcs11-benchmark"); err != nil {
+		env.Close()
+		tb.Fatalf("error creating test directory: %v", err)
+	}
+
+	env.logDir = path.Join(env.testDir, "log")
+	if err = os.Mkdir(env.logDir, 0755); err != nil {
+		env.Close()
+		tb.Fatalf("error creating log directory: %v", err)
+	}
+
+	config := fmt.Sprintf(configTemplate, env.server.Addr.String(), keyRingParent,
+		keyRingID, env.logDir) + extraConfig
+	configFile := path.Join(env.testDir, "config.yaml")
+	if err = os.WriteFile(configFile, []byte(config), 0644); err != nil {
+		env.Close()
+		tb.Fatalf("error writing config file: %v", err)
+	}
+
+	if err = os.Setenv(configVar, configFile); err != nil {
+		env.Close()
+		tb.Fatalf("error setting %q: %v", configVar, err)
+	}
+	env.envVarSet = true
+
+	if err := p.Initialize(); err != nil {
+		env.Close()
+		tb.Fatalf("error initializing: %v", err)
+	}
+	env.initialized = true
+
+	return env
+}
+
+func newSessionHandle(tb testing.TB) (pkcs11.SessionHandle, func()) {
+	tb.Helper()
+
+	// Slots are always assigned 0-index according to how they exist in YAML config,
+	// hardcoding 0 here. Making the session read-write in case test resources need
+	// to be generated.
+	session, err := p.OpenSession(0, pkcs11.CKF_SERIAL_SESSION|pkcs11.CKF_RW_SESSION)
+	if err != nil {
+		tb.Fatalf("OpenSession: %v", err)
+	}
+
+	return session, func() {
+		if err := p.CloseSession(session); err != nil {
+			tb.Fatal(err)
+		}
+	}
+}
+
+// createECSigningKey generates an EC_SIGN_P256_SHA256 key pair through the
+// library and returns a handle to its private key.
+func createECSigningKey(tb testing.TB, label string) pkcs11.ObjectHandle {
+	tb.Helper()
+	session, closeSession := newSessionHandle(tb)
+	defer closeSession()
+
+	privateKeyTemplate := []*pkcs11.Attribute{
+		pkcs11.NewAttribute(pkcs11.CKA_LABEL, label),
+		pkcs11.NewAttribute(KMSAlgorithm, uint(kmspb.CryptoKeyVersion_EC_SIGN_P256_SHA256)),
+	}
+	_, prv, err := p.GenerateKeyPair(session,
+		[]*pkcs11.Mechanism{pkcs11.NewMechanism(pkcs11.CKM_EC_KEY_PAIR_GEN, nil)},
+		nil, privateKeyTemplate)
+	if err != nil {
+		tb.Fatalf("failed to generate keypair: %v", err)
+	}
+	return prv
+}
+
+// percentile returns the q-th percentile (0 < q <= 1) of the provided
+// latencies. The slice is sorted in place.
+func percentile(latencies []time.Duration, q float64) time.Duration {
+	if len(latencies) == 0 {
+		return 0
+	}
+	sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+	idx := int(float64(len(latencies))*q+0.5) - 1
+	if idx < 0 {
+		idx = 0
+	}
+	if idx >= len(latencies) {
+		idx = len(latencies) - 1
+	}
+	return latencies[idx]
+}
@@ -0,0 +1,92 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fakekmsbenchmark
+
+import (
+	"bufio"
+	"os"
+	"runtime"
+	"strconv"
+	"strings"
+	"testing"
+
+	kms "cloud.google.com/go/kms/apiv1"
+	"cloud.google.com/kms/integrations/fakekms"
+
+	kmspb "google.golang.org/genproto/googleapis/cloud/kms/v1"
+)
+
+// BenchmarkObjectFootprint reports the memory retained by the library for each
+// key after loading a key ring of 10,000 RSA-4096 signing keys. Each key is
+// represented by a public key object and a private key object.
+//
+// The library shares an address space with the Go runtime and the fakekms
+// server, so memory is measured as the growth in resident set size across
+// C_Initialize, less the growth in memory obtained by the Go runtime over the
+// same period.
+func BenchmarkObjectFootprint(b *testing.B) {
+	if runtime.GOOS != "linux" {
+		b.Skip("resident set size is only measured on Linux")
+	}
+	const keys = 10000
+
+	for i := 0; i < b.N; i++ {
+		var rssBefore, goBefore uint64
+		env := newBenchEnv(b, fakekms.ServerOptions{},
+			func(client *kms.KeyManagementClient) {
+				createKeys(b, client, keys, kmspb.CryptoKeyVersion_RSA_SIGN_PKCS1_4096_SHA256)
+				rssBefore, goBefore = residentBytes(b), goSysBytes()
+			}, "")
+		rssAfter, goAfter := residentBytes(b), goSysBytes()
+		env.Close()
+
+		libraryBytes := int64(rssAfter-rssBefore) - int64(goAfter-goBefore)
+		b.ReportMetric(float64(libraryBytes)/keys, "bytes/key")
+	}
+}
+
+// goSysBytes returns the total memory obtained from the OS by the Go runtime.
+func goSysBytes() uint64 {
+	runtime.GC()
+	var stats runtime.MemStats
+	runtime.ReadMemStats(&stats)
+	return stats.Sys
+}
+
+// residentBytes returns the resident set size of this process.
+func residentBytes(tb testing.TB) uint64 {
+	tb.Helper()
+	f, err := os.Open("/proc/self/status")
+	if err != nil {
+		tb.Fatalf("error opening process status: %v", err)
+	}
+	defer f.Close()
+
+	scanner := bufio.NewScanner(f)
+	for scanner.Scan() {
+		// The line has the form "VmRSS:	  123456 kB".
+		fields := strings.Fields(scanner.Text())
+		if len(fields) != 3 || fields[0] != "VmRSS:" {
+			continue
+		}
+		kb, err := strconv.ParseUint(fields[1], 10, 64)
+		if err != nil {
+			tb.Fatalf("error parsing VmRSS: %v", err)
+		}
+		return kb * 1024
+	}
+	tb.Fatalf("VmRSS not found in process status")
+	return 0
+}
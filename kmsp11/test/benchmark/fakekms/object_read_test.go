@@ -0,0 +1,111 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fakekmsbenchmark
+
+import (
+	"fmt"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	kms "cloud.google.com/go/kms/apiv1"
+	"cloud.google.com/kms/integrations/fakekms"
+	"github.com/miekg/pkcs11"
+)
+
+// BenchmarkObjectReadsDuringRefresh measures the throughput of object lookups
+// (C_FindObjects followed by C_GetAttributeValue) from a growing number of
+// concurrent callers, while the library refreshes its view of the key ring
+// every second in the background.
+func BenchmarkObjectReadsDuringRefresh(b *testing.B) {
+	const keys = 1000
+	env := newBenchEnv(b, fakekms.ServerOptions{},
+		func(client *kms.KeyManagementClient) { createSigningKeys(b, client, keys) },
+		"refresh_interval_secs: 1\n")
+	defer env.Close()
+
+	for _, concurrency := range []int{1, 8, 64} {
+		b.Run(fmt.Sprintf("concurrency=%d", concurrency), func(b *testing.B) {
+			benchmarkObjectReads(b, keys, concurrency)
+		})
+	}
+}
+
+func benchmarkObjectReads(b *testing.B, keys, concurrency int) {
+	// Sessions are opened up front, since newSessionHandle must be called from
+	// the benchmark goroutine.
+	sessions := make([]pkcs11.SessionHandle, concurrency)
+	for i := range sessions {
+		session, closeSession := newSessionHandle(b)
+		defer closeSession()
+		sessions[i] = session
+	}
+
+	var next int64 = -1
+	var wg sync.WaitGroup
+
+	b.ResetTimer()
+	start := time.Now()
+	for _, session := range sessions {
+		wg.Add(1)
+		go func(session pkcs11.SessionHandle) {
+			defer wg.Done()
+			for {
+				op := atomic.AddInt64(&next, 1)
+				if op >= int64(b.N) {
+					return
+				}
+				if err := readObject(session, fmt.Sprintf("key-%d", op%int64(keys))); err != nil {
+					b.Error(err)
+					return
+				}
+			}
+		}(session)
+	}
+	wg.Wait()
+	b.StopTimer()
+
+	b.ReportMetric(float64(b.N)/time.Since(start).Seconds(), "reads/s")
+}
+
+// readObject finds the private key with the provided label, and reads its
+// CKA_ID attribute.
+func readObject(session pkcs11.SessionHandle, label string) error {
+	template := []*pkcs11.Attribute{
+		pkcs11.NewAttribute(pkcs11.CKA_CLASS, pkcs11.CKO_PRIVATE_KEY),
+		pkcs11.NewAttribute(pkcs11.CKA_LABEL, label),
+	}
+	if err := p.FindObjectsInit(session, template); err != nil {
+		return fmt.Errorf("FindObjectsInit: %v", err)
+	}
+	handles, _, err := p.FindObjects(session, 1)
+	if err != nil {
+		return fmt.Errorf("FindObjects: %v", err)
+	}
+	if err := p.FindObjectsFinal(session); err != nil {
+		return fmt.Errorf("FindObjectsFinal: %v", err)
+	}
+	if len(handles) != 1 {
+		return fmt.Errorf("found %d objects with label %q, want 1", len(handles), label)
+	}
+
+	if _, err := p.GetAttributeValue(session, handles[0], []*pkcs11.Attribute{
+		pkcs11.NewAttribute(pkcs11.CKA_ID, nil),
+	}); err != nil {
+		return fmt.Errorf("GetAttributeValue: %v", err)
+	}
+	return nil
+}
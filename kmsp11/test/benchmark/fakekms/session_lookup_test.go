@@ -0,0 +1,71 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fakekmsbenchmark
+
+import (
+	"fmt"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"cloud.google.com/kms/integrations/fakekms"
+	"github.com/miekg/pkcs11"
+)
+
+// BenchmarkSessionLookup measures the throughput of C_GetSessionInfo, which
+// does no work beyond looking up its session, as the number of concurrent
+// callers grows. Each caller uses its own session.
+func BenchmarkSessionLookup(b *testing.B) {
+	env := newBenchEnv(b, fakekms.ServerOptions{}, nil, "")
+	defer env.Close()
+
+	for _, concurrency := range []int{1, 2, 4, 8, 16, 32, 64} {
+		b.Run(fmt.Sprintf("concurrency=%d", concurrency), func(b *testing.B) {
+			benchmarkSessionLookup(b, concurrency)
+		})
+	}
+}
+
+func benchmarkSessionLookup(b *testing.B, concurrency int) {
+	sessions := make([]pkcs11.SessionHandle, concurrency)
+	for i := range sessions {
+		session, closeSession := newSessionHandle(b)
+		defer closeSession()
+		sessions[i] = session
+	}
+
+	var next int64 = -1
+	var wg sync.WaitGroup
+
+	b.ResetTimer()
+	start := time.Now()
+	for _, session := range sessions {
+		wg.Add(1)
+		go func(session pkcs11.SessionHandle) {
+			defer wg.Done()
+			for atomic.AddInt64(&next, 1) < int64(b.N) {
+				if _, err := p.GetSessionInfo(session); err != nil {
+					b.Errorf("GetSessionInfo: %v", err)
+					return
+				}
+			}
+		}(session)
+	}
+	wg.Wait()
+	b.StopTimer()
+
+	b.ReportMetric(float64(b.N)/time.Since(start).Seconds(), "lookups/s")
+}
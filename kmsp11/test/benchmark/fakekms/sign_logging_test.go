@@ -0,0 +1,81 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fakekmsbenchmark
+
+import (
+	"crypto/rand"
+	"testing"
+	"time"
+
+	"cloud.google.com/kms/integrations/fakekms"
+	"github.com/miekg/pkcs11"
+)
+
+// BenchmarkSignLogging measures the overhead of file logging on the C_Sign
+// path. Each operation signs a digest and makes one failing call, which the
+// library writes to its log file. Each sub-benchmark reports the p99 latency
+// of a single operation.
+func BenchmarkSignLogging(b *testing.B) {
+	for _, tc := range []struct {
+		name   string
+		config string
+	}{
+		{"sync", ""},
+		{"async", "async_logging: true\n"},
+		{"async_block", "async_logging: true\nasync_log_block_when_full: true\n"},
+	} {
+		b.Run(tc.name, func(b *testing.B) {
+			benchmarkSignLogging(b, tc.config)
+		})
+	}
+}
+
+func benchmarkSignLogging(b *testing.B, extraConfig string) {
+	env := newBenchEnv(b, fakekms.ServerOptions{}, nil, extraConfig)
+	defer env.Close()
+	key := createECSigningKey(b, "sign-key")
+
+	session, closeSession := newSessionHandle(b)
+	defer closeSession()
+
+	digest := make([]byte, 32)
+	if _, err := rand.Read(digest); err != nil {
+		b.Fatalf("failed to generate digest: %v", err)
+	}
+	mech := []*pkcs11.Mechanism{pkcs11.NewMechanism(pkcs11.CKM_ECDSA, nil)}
+	// No object has this handle, so C_SignInit fails with
+	// CKR_KEY_HANDLE_INVALID, and the failure is logged.
+	invalidKey := key + 1<<20
+
+	latencies := make([]time.Duration, b.N)
+
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		start := time.Now()
+		if err := p.SignInit(session, mech, invalidKey); err == nil {
+			b.Fatal("SignInit with an invalid key handle succeeded")
+		}
+		if err := p.SignInit(session, mech, key); err != nil {
+			b.Fatalf("SignInit: %v", err)
+		}
+		if _, err := p.Sign(session, digest); err != nil {
+			b.Fatalf("failed to sign: %v", err)
+		}
+		latencies[i] = time.Since(start)
+	}
+	b.StopTimer()
+
+	b.ReportMetric(float64(percentile(latencies, 0.99).Microseconds()), "p99-us")
+}
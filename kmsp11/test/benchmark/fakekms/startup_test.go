@@ -0,0 +1,114 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fakekmsbenchmark
+
+import (
+	"context"
+	"fmt"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	kms "cloud.google.com/go/kms/apiv1"
+	"cloud.google.com/kms/integrations/fakekms"
+
+	kmspb "google.golang.org/genproto/googleapis/cloud/kms/v1"
+)
+
+// rpcDelay approximates the latency of a Cloud KMS request made from within
+// the same region.
+const rpcDelay = 5 * time.Millisecond
+
+// BenchmarkInitialize measures the time taken by C_Initialize to load a key
+// ring containing a varying number of keys, as the number of concurrent key
+// loading requests grows.
+func BenchmarkInitialize(b *testing.B) {
+	for _, keys := range []int{100, 1000, 10000} {
+		for _, concurrency := range []int{1, 8, 32} {
+			name := fmt.Sprintf("keys=%d/concurrency=%d", keys, concurrency)
+			b.Run(name, func(b *testing.B) {
+				benchmarkInitialize(b, keys, concurrency)
+			})
+		}
+	}
+}
+
+func benchmarkInitialize(b *testing.B, keys, concurrency int) {
+	env := newBenchEnv(b, fakekms.ServerOptions{Delay: rpcDelay},
+		func(client *kms.KeyManagementClient) { createSigningKeys(b, client, keys) },
+		fmt.Sprintf("key_load_concurrency: %d\n", concurrency))
+	defer env.Close()
+
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if err := p.Finalize(); err != nil {
+			b.Fatalf("error calling C_Finalize: %v", err)
+		}
+		if err := p.Initialize(); err != nil {
+			// Close would otherwise attempt to finalize the library again.
+			env.initialized = false
+			b.Fatalf("error calling C_Initialize: %v", err)
+		}
+	}
+}
+
+// createSigningKeys populates the benchmark key ring with count HSM-protected
+// EC signing keys, each with a single enabled version.
+func createSigningKeys(b *testing.B, client *kms.KeyManagementClient, count int) {
+	b.Helper()
+	createKeys(b, client, count, kmspb.CryptoKeyVersion_EC_SIGN_P256_SHA256)
+}
+
+// createKeys populates the benchmark key ring with count HSM-protected signing
+// keys of the provided algorithm, each with a single enabled version.
+func createKeys(b *testing.B, client *kms.KeyManagementClient, count int, algorithm kmspb.CryptoKeyVersion_CryptoKeyVersionAlgorithm) {
+	b.Helper()
+
+	const workers = 64
+	var next int64 = -1
+	errs := make(chan error, workers)
+	var wg sync.WaitGroup
+
+	for w := 0; w < workers; w++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for i := atomic.AddInt64(&next, 1); i < int64(count); i = atomic.AddInt64(&next, 1) {
+				_, err := client.CreateCryptoKey(context.Background(), &kmspb.CreateCryptoKeyRequest{
+					Parent:      fmt.Sprintf("%s/keyRings/%s", keyRingParent, keyRingID),
+					CryptoKeyId: fmt.Sprintf("key-%d", i),
+					CryptoKey: &kmspb.CryptoKey{
+						Purpose: kmspb.CryptoKey_ASYMMETRIC_SIGN,
+						VersionTemplate: &kmspb.CryptoKeyVersionTemplate{
+							Algorithm:       algorithm,
+							ProtectionLevel: kmspb.ProtectionLevel_HSM,
+						},
+					},
+				})
+				if err != nil {
+					errs <- err
+					return
+				}
+			}
+		}()
+	}
+
+	wg.Wait()
+	close(errs)
+	if err := <-errs; err != nil {
+		b.Fatalf("error creating crypto key: %v", err)
+	}
+}
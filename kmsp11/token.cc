@@ -20,8 +20,11 @@
 #include "absl/status/statusor.h"
 #include "common/kms_client.h"
 #include "common/status_macros.h"
+#include "glog/logging.h"
 #include "kmsp11/object_loader.h"
+#include "kmsp11/object_store_snapshot.h"
 #include "kmsp11/object_store_state.pb.h"
+#include "kmsp11/util/crypto_utils.h"
 #include "kmsp11/util/errors.h"
 #include "kmsp11/util/string_utils.h"
 
@@ -73,12 +76,31 @@ absl::StatusOr<CK_TOKEN_INFO> NewTokenInfo(std::string_view token_label) {
   return info;
 }
 
+// Builds an ObjectStore from the snapshot at `snapshot_path`, and seeds
+// `loader` with its contents.
+absl::StatusOr<std::unique_ptr<ObjectStore>> RestoreFromSnapshot(
+    const std::string& snapshot_path, ObjectLoader* loader) {
+  ASSIGN_OR_RETURN(ObjectStoreState state, ReadSnapshot(snapshot_path));
+  ASSIGN_OR_RETURN(std::unique_ptr<ObjectStore> store, ObjectStore::New(state));
+  RETURN_IF_ERROR(loader->RestoreState(state));
+  return std::move(store);
+}
+
+void WriteSnapshotOrWarn(const std::string& snapshot_path,
+                         const ObjectStoreState& state) {
+  absl::Status result = WriteSnapshot(snapshot_path, state);
+  if (!result.ok()) {
+    LOG(WARNING) << "error writing snapshot: " << result;
+  }
+}
+
 }  // namespace
 
-absl::StatusOr<std::unique_ptr<Token>> Token::New(CK_SLOT_ID slot_id,
-                                                  TokenConfig token_config,
-                                                  KmsClient* kms_client,
-                                                  bool generate_certs) {
+absl::StatusOr<std::unique_ptr<Token>> Token::New(
+    CK_SLOT_ID slot_id, TokenConfig token_config, KmsClient* kms_client,
+    bool generate_certs, size_t max_concurrent_loads,
+    std::string_view snapshot_directory,
+    DecryptResultCache* decrypt_result_cache, DataKeyCache* data_key_cache) {
   ASSIGN_OR_RETURN(CK_SLOT_INFO slot_info, NewSlotInfo());
   ASSIGN_OR_RETURN(CK_TOKEN_INFO token_info,
                    NewTokenInfo(token_config.label()));
@@ -86,13 +108,40 @@ absl::StatusOr<std::unique_ptr<Token>> Token::New(CK_SLOT_ID slot_id,
   ASSIGN_OR_RETURN(
       std::unique_ptr<ObjectLoader> loader,
       ObjectLoader::New(token_config.key_ring(),
-                        token_config.experimental_certs(), generate_certs));
+                        token_config.experimental_certs(), generate_certs,
+                        max_concurrent_loads, token_config.lazy_public_keys(),
+                        token_config.latest_versions_only(),
+                        token_config.key_filter()));
+
+  std::string snapshot_path;
+  if (!snapshot_directory.empty()) {
+    snapshot_path = SnapshotPath(snapshot_directory, token_config.key_ring());
+    absl::StatusOr<std::unique_ptr<ObjectStore>> store =
+        RestoreFromSnapshot(snapshot_path, loader.get());
+    if (store.ok()) {
+      // using `new` to invoke a private constructor
+      return std::unique_ptr<Token>(
+          new Token(slot_id, slot_info, token_info, kms_client,
+                    std::move(loader), *std::move(store), snapshot_path, true,
+                    decrypt_result_cache, data_key_cache));
+    }
+    if (!absl::IsNotFound(store.status())) {
+      LOG(WARNING) << "ignoring snapshot for key ring "
+                   << token_config.key_ring() << ": " << store.status();
+    }
+  }
+
   ASSIGN_OR_RETURN(ObjectStoreState state, loader->BuildState(*kms_client));
   ASSIGN_OR_RETURN(std::unique_ptr<ObjectStore> store, ObjectStore::New(state));
+  if (!snapshot_path.empty()) {
+    WriteSnapshotOrWarn(snapshot_path, state);
+  }
 
   // using `new` to invoke a private constructor
-  return std::unique_ptr<Token>(new Token(slot_id, slot_info, token_info,
-                                          std::move(loader), std::move(store)));
+  return std::unique_ptr<Token>(
+      new Token(slot_id, slot_info, token_info, kms_client, std::move(loader),
+                std::move(store), snapshot_path, false,
+                decrypt_result_cache, data_key_cache));
 }
 
 bool Token::is_logged_in() const {
@@ -139,12 +188,126 @@ absl::Status Token::Logout() {
   return absl::OkStatus();
 }
 
+absl::StatusOr<std::shared_ptr<Object>> Token::GetObject(
+    CK_OBJECT_HANDLE object_handle) const {
+  ASSIGN_OR_RETURN(std::shared_ptr<Object> object,
+                   objects_.Load()->GetObject(object_handle));
+  if (!object->public_key_deferred()) {
+    return object;
+  }
+
+  std::shared_ptr<PublicKeyFetch> fetch;
+  {
+    absl::MutexLock lock(&fetches_mutex_);
+    auto it = fetches_.find(object->kms_key_name());
+    if (it == fetches_.end()) {
+      return object;
+    }
+    fetch = it->second;
+  }
+  if (!fetch->done.HasBeenNotified() || !fetch->status.ok()) {
+    return object;
+  }
+  return object->object_class() == CKO_PUBLIC_KEY ? fetch->public_key
+                                                  : fetch->private_key;
+}
+
+absl::StatusOr<std::shared_ptr<Object>> Token::GetKey(
+    CK_OBJECT_HANDLE handle) const {
+  ASSIGN_OR_RETURN(std::shared_ptr<Object> key,
+                   objects_.Load()->GetKey(handle));
+  return ResolvePublicKey(std::move(key));
+}
+
+absl::StatusOr<std::shared_ptr<Object>> Token::ResolvePublicKey(
+    std::shared_ptr<Object> object) const {
+  if (!object->public_key_deferred()) {
+    return object;
+  }
+
+  std::string ckv_name(object->kms_key_name());
+  std::shared_ptr<PublicKeyFetch> fetch;
+  bool fetch_here = false;
+  {
+    absl::MutexLock lock(&fetches_mutex_);
+    std::shared_ptr<PublicKeyFetch>& entry = fetches_[ckv_name];
+    if (!entry) {
+      entry = std::make_shared<PublicKeyFetch>();
+      fetch_here = true;
+    }
+    fetch = entry;
+  }
+
+  if (!fetch_here) {
+    fetch->done.WaitForNotification();
+  } else {
+    fetch->status = [&]() -> absl::Status {
+      kms_v1::GetPublicKeyRequest req;
+      req.set_name(ckv_name);
+      ASSIGN_OR_RETURN(kms_v1::PublicKey resp, kms_client_->GetPublicKey(req));
+      ASSIGN_OR_RETURN(bssl::UniquePtr<EVP_PKEY> public_key,
+                       ParseX509PublicKeyPem(resp.pem()));
+      ASSIGN_OR_RETURN(KeyPair key_pair,
+                       object->CompleteKeyPair(public_key.get()));
+      fetch->public_key =
+          std::make_shared<Object>(std::move(key_pair.public_key));
+      fetch->private_key =
+          std::make_shared<Object>(std::move(key_pair.private_key));
+      return absl::OkStatus();
+    }();
+
+    if (!fetch->status.ok()) {
+      // Forget the failure, so that a later caller can try again.
+      absl::MutexLock lock(&fetches_mutex_);
+      auto it = fetches_.find(ckv_name);
+      if (it != fetches_.end() && it->second == fetch) {
+        fetches_.erase(it);
+      }
+    }
+    fetch->done.Notify();
+  }
+
+  RETURN_IF_ERROR(fetch->status);
+  return object->object_class() == CKO_PUBLIC_KEY ? fetch->public_key
+                                                  : fetch->private_key;
+}
+
 absl::Status Token::RefreshState(const KmsClient& client) {
   ASSIGN_OR_RETURN(ObjectStoreState state, object_loader_->BuildState(client));
-  ASSIGN_OR_RETURN(std::unique_ptr<ObjectStore> store, ObjectStore::New(state));
 
-  absl::WriterMutexLock lock(&objects_mutex_);
-  objects_.swap(store);
+  // Objects for versions that are unchanged since the last refresh are carried
+  // over from the current store, so only new versions need to be parsed.
+  ASSIGN_OR_RETURN(std::unique_ptr<ObjectStore> store,
+                   ObjectStore::New(state, objects_.Load().get()));
+  if (!snapshot_path_.empty()) {
+    WriteSnapshotOrWarn(snapshot_path_, state);
+  }
+
+  absl::flat_hash_set<std::string> ckv_names;
+  for (const Key& key : state.keys()) {
+    ckv_names.insert(key.crypto_key_version().name());
+  }
+
+  {
+    // Forget public keys for versions that are no longer present.
+    absl::MutexLock lock(&fetches_mutex_);
+    absl::erase_if(fetches_, [&](const auto& entry) {
+      return !ckv_names.contains(entry.first);
+    });
+  }
+
+  if (decrypt_result_cache_) {
+    // Drop cached plaintexts for versions that are no longer present, so that
+    // a disabled or destroyed version stops decrypting.
+    decrypt_result_cache_->RetainKeyVersions(key_ring_name(), ckv_names);
+  }
+  if (data_key_cache_) {
+    // Likewise for envelope data keys, so that a disabled or destroyed version
+    // stops protecting new messages and decrypting cached ones.
+    data_key_cache_->RetainKeyVersions(key_ring_name(), ckv_names);
+  }
+
+  objects_.Store(std::move(store));
   return absl::OkStatus();
 }
 
@@ -17,15 +17,20 @@
 #ifndef KMSP11_TOKEN_H_
 #define KMSP11_TOKEN_H_
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "common/atomic_shared_ptr.h"
 #include "common/kms_client.h"
 #include "kmsp11/config/config.pb.h"
 #include "kmsp11/cryptoki.h"
 #include "kmsp11/object.h"
 #include "kmsp11/object_loader.h"
 #include "kmsp11/object_store.h"
+#include "kmsp11/operation/data_key_cache.h"
+#include "kmsp11/operation/decrypt_result_cache.h"
 
 namespace cloud_kms::kmsp11 {
 
@@ -35,9 +40,20 @@ namespace cloud_kms::kmsp11 {
 // See go/kms-pkcs11-model
 class Token {
  public:
+  // If `snapshot_directory` is non-empty, the token's state is written there
+  // after each successful load from Cloud KMS, and a token whose key ring has
+  // a usable snapshot is initialized from it without contacting Cloud KMS.
+  // Callers should reconcile such a token with RefreshState.
+  //
+  // If `decrypt_result_cache` or `data_key_cache` is non-null, RefreshState
+  // evicts its entries for key versions that are no longer present in the key
+  // ring. The caches must outlive the token.
   static absl::StatusOr<std::unique_ptr<Token>> New(
       CK_SLOT_ID slot_id, TokenConfig token_config, KmsClient* kms_client,
-      bool generate_certs = false);
+      bool generate_certs = false, size_t max_concurrent_loads = 1,
+      std::string_view snapshot_directory = "",
+      DecryptResultCache* decrypt_result_cache = nullptr,
+      DataKeyCache* data_key_cache = nullptr);
 
   CK_SLOT_ID slot_id() const { return slot_id_; }
   const CK_SLOT_INFO& slot_info() const { return slot_info_; }
@@ -45,44 +61,72 @@ class Token {
   std::string_view key_ring_name() const {
     return object_loader_->key_ring_name();
   }
+  // Whether this token's initial state was read from a snapshot.
+  bool loaded_from_snapshot() const { return loaded_from_snapshot_; }
 
   bool is_logged_in() const;
   absl::Status Login(CK_USER_TYPE user_type);
   absl::Status Logout();
 
-  inline absl::StatusOr<std::shared_ptr<Object>> GetObject(
-      CK_OBJECT_HANDLE object_handle) const {
-    absl::ReaderMutexLock lock(&objects_mutex_);
-    return objects_->GetObject(object_handle);
-  }
+  // Returns the object with handle `object_handle`. If the object is part of a
+  // deferred key pair whose public key has already been retrieved by
+  // ResolvePublicKey, the complete object is returned; no request is made to
+  // retrieve a public key that has not been.
+  absl::StatusOr<std::shared_ptr<Object>> GetObject(
+      CK_OBJECT_HANDLE object_handle) const;
+
+  // Like ObjectStore::GetKey, but a key in a deferred key pair is returned
+  // with its public key; see ResolvePublicKey.
+  absl::StatusOr<std::shared_ptr<Object>> GetKey(CK_OBJECT_HANDLE handle) const;
+
+  // Returns `object` unchanged unless it is part of a deferred key pair. In
+  // that case, the key pair's public key is retrieved from Cloud KMS, and the
+  // complete equivalent of `object` is returned. Concurrent callers share a
+  // single request, and the result is retained for later callers.
+  absl::StatusOr<std::shared_ptr<Object>> ResolvePublicKey(
+      std::shared_ptr<Object> object) const;
 
-  inline absl::StatusOr<std::shared_ptr<Object>> GetKey(
-      CK_OBJECT_HANDLE handle) const {
-    absl::ReaderMutexLock lock(&objects_mutex_);
-    return objects_->GetKey(handle);
+  inline std::vector<CK_OBJECT_HANDLE> FindObjects(
+      std::function<bool(const Object&)> predicate) const {
+    return objects_.Load()->Find(predicate);
   }
 
+  // See ObjectStore::Find(attributes, predicate).
   inline std::vector<CK_OBJECT_HANDLE> FindObjects(
+      absl::Span<const CK_ATTRIBUTE> attributes,
       std::function<bool(const Object&)> predicate) const {
-    absl::ReaderMutexLock lock(&objects_mutex_);
-    return objects_->Find(predicate);
+    return objects_.Load()->Find(attributes, predicate);
   }
 
   inline absl::StatusOr<CK_OBJECT_HANDLE> FindSingleObject(
       std::function<bool(const Object&)> predicate) const {
-    absl::ReaderMutexLock lock(&objects_mutex_);
-    return objects_->FindSingle(predicate);
+    return objects_.Load()->FindSingle(predicate);
   }
 
   absl::Status RefreshState(const KmsClient& client);
 
  private:
+  // The outcome of retrieving the public key for a deferred key pair.
+  struct PublicKeyFetch {
+    absl::Notification done;
+    absl::Status status;
+    std::shared_ptr<Object> public_key;
+    std::shared_ptr<Object> private_key;
+  };
+
   Token(CK_SLOT_ID slot_id, CK_SLOT_INFO slot_info, CK_TOKEN_INFO token_info,
-        std::unique_ptr<ObjectLoader> object_loader,
-        std::unique_ptr<ObjectStore> objects)
+        KmsClient* kms_client, std::unique_ptr<ObjectLoader> object_loader,
+        std::unique_ptr<ObjectStore> objects, std::string snapshot_path,
+        bool loaded_from_snapshot, DecryptResultCache* decrypt_result_cache,
+        DataKeyCache* data_key_cache)
       : slot_id_(slot_id),
         slot_info_(slot_info),
         token_info_(token_info),
+        kms_client_(kms_client),
+        snapshot_path_(std::move(snapshot_path)),
+        loaded_from_snapshot_(loaded_from_snapshot),
+        decrypt_result_cache_(decrypt_result_cache),
+        data_key_cache_(data_key_cache),
         object_loader_(std::move(object_loader)),
         objects_(std::move(objects)),
         is_logged_in_(false) {}
@@ -90,10 +134,26 @@ class Token {
   const CK_SLOT_ID slot_id_;
   const CK_SLOT_INFO slot_info_;
   const CK_TOKEN_INFO token_info_;
+  KmsClient* const kms_client_;
+  // Empty if snapshots are disabled.
+  const std::string snapshot_path_;
+  const bool loaded_from_snapshot_;
+  // May be nullptr.
+  DecryptResultCache* const decrypt_result_cache_;
+  // May be nullptr.
+  DataKeyCache* const data_key_cache_;
 
   std::unique_ptr<ObjectLoader> object_loader_;
-  mutable absl::Mutex objects_mutex_;
-  std::unique_ptr<ObjectStore> objects_ ABSL_GUARDED_BY(objects_mutex_);
+  // The current object store. Stores are immutable once published, so readers
+  // use whichever store they load, and RefreshState publishes a replacement
+  // without waiting for them.
+  AtomicSharedPtr<const ObjectStore> objects_;
+
+  // Public key retrievals for deferred key pairs, keyed by CryptoKeyVersion
+  // name.
+  mutable absl::Mutex fetches_mutex_;
+  mutable absl::flat_hash_map<std::string, std::shared_ptr<PublicKeyFetch>>
+      fetches_ ABSL_GUARDED_BY(fetches_mutex_);
 
   // All sessions with the same token have the same login state (rather than
   // login state being per-session, which seems like the more obvious choice.)
@@ -14,6 +14,9 @@
 
 #include "kmsp11/token.h"
 
+#include <filesystem>
+#include <thread>
+
 #include "common/kms_client.h"
 #include "common/test/test_status_macros.h"
 #include "fakekms/cpp/fakekms.h"
@@ -30,6 +33,7 @@ using ::testing::Eq;
 using ::testing::Field;
 using ::testing::IsEmpty;
 using ::testing::Le;
+using ::testing::Ne;
 using ::testing::Pointee;
 using ::testing::Property;
 
@@ -465,6 +469,137 @@ TEST_F(TokenTest, DisabledKeyUnavailableAfterRefresh) {
   EXPECT_EQ(handles.size(), 0);
 }
 
+TEST_F(TokenTest, RefreshEvictsCachedPlaintextsForMissingVersions) {
+  auto kms_client = fake_server_->NewClient();
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_DECRYPT);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_2048_SHA256);
+  ck.mutable_version_template()->set_protection_level(
+      kms_v1::ProtectionLevel::HSM);
+  ck = CreateCryptoKeyOrDie(kms_client.get(), key_ring_.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv1;
+  ckv1 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv1);
+  ckv1 = WaitForEnablement(kms_client.get(), ckv1);
+  kms_v1::CryptoKeyVersion ckv2;
+  ckv2 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv2);
+  ckv2 = WaitForEnablement(kms_client.get(), ckv2);
+
+  DecryptResultCache cache(DecryptResultCache::Options{});
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<Token> token,
+      Token::New(0, config_, client_.get(), false, 1, "", &cache));
+
+  std::vector<uint8_t> ciphertext = {0x01, 0x02, 0x03};
+  std::vector<uint8_t> plaintext = {0x04, 0x05, 0x06};
+  cache.Insert(ckv1.name(), ciphertext, plaintext);
+  cache.Insert(ckv2.name(), ciphertext, plaintext);
+
+  ckv1.set_state(kms_v1::CryptoKeyVersion::DISABLED);
+  google::protobuf::FieldMask update_mask;
+  update_mask.add_paths("state");
+  ckv1 = UpdateCryptoKeyVersionOrDie(kms_client.get(), ckv1, update_mask);
+
+  EXPECT_OK(token->RefreshState(*client_));
+
+  EXPECT_EQ(cache.Get(ckv1.name(), ciphertext), nullptr);
+  EXPECT_NE(cache.Get(ckv2.name(), ciphertext), nullptr);
+}
+
+TEST_F(TokenTest, RefreshDiscardsDataKeysForMissingVersions) {
+  auto kms_client = fake_server_->NewClient();
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_DECRYPT);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::RSA_DECRYPT_OAEP_2048_SHA256);
+  ck.mutable_version_template()->set_protection_level(
+      kms_v1::ProtectionLevel::HSM);
+  ck = CreateCryptoKeyOrDie(kms_client.get(), key_ring_.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv1;
+  ckv1 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv1);
+  ckv1 = WaitForEnablement(kms_client.get(), ckv1);
+  kms_v1::CryptoKeyVersion ckv2;
+  ckv2 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv2);
+  ckv2 = WaitForEnablement(kms_client.get(), ckv2);
+
+  DataKeyCache cache(DataKeyCache::Options{});
+  ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<Token> token,
+      Token::New(0, config_, client_.get(), false, 1, "", nullptr, &cache));
+
+  int wraps = 0;
+  auto wrap =
+      [&](absl::Span<const uint8_t> key) -> absl::StatusOr<std::string> {
+    wraps++;
+    return std::string(key.begin(), key.end());
+  };
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> key1,
+                       cache.GetEncryptionKey(ckv1.name(), wrap));
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<const DataKey> key2,
+                       cache.GetEncryptionKey(ckv2.name(), wrap));
+
+  ckv1.set_state(kms_v1::CryptoKeyVersion::DISABLED);
+  google::protobuf::FieldMask update_mask;
+  update_mask.add_paths("state");
+  ckv1 = UpdateCryptoKeyVersionOrDie(kms_client.get(), ckv1, update_mask);
+
+  EXPECT_OK(token->RefreshState(*client_));
+
+  EXPECT_EQ(cache.unwrapped_key_count(), 1);
+  EXPECT_THAT(cache.GetEncryptionKey(ckv2.name(), wrap), IsOkAndHolds(key2));
+  EXPECT_THAT(cache.GetEncryptionKey(ckv1.name(), wrap),
+              IsOkAndHolds(Ne(key1)));
+  EXPECT_EQ(wraps, 3);
+}
+
+TEST_F(TokenTest, UnchangedObjectsAreRetainedAfterRefresh) {
+  auto kms_client = fake_server_->NewClient();
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::EC_SIGN_P384_SHA384);
+  ck.mutable_version_template()->set_protection_level(
+      kms_v1::ProtectionLevel::HSM);
+  ck = CreateCryptoKeyOrDie(kms_client.get(), key_ring_.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv1;
+  ckv1 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv1);
+  ckv1 = WaitForEnablement(kms_client.get(), ckv1);
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Token> token,
+                       Token::New(0, config_, client_.get()));
+
+  std::vector<CK_OBJECT_HANDLE> handles =
+      token->FindObjects([](const Object& o) -> bool { return true; });
+  ASSERT_EQ(handles.size(), 2);
+  std::vector<std::shared_ptr<Object>> objects;
+  for (CK_OBJECT_HANDLE handle : handles) {
+    ASSERT_OK_AND_ASSIGN(std::shared_ptr<Object> object,
+                         token->GetObject(handle));
+    objects.push_back(object);
+  }
+
+  kms_v1::CryptoKeyVersion ckv2;
+  ckv2 = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv2);
+  ckv2 = WaitForEnablement(kms_client.get(), ckv2);
+
+  EXPECT_OK(token->RefreshState(*client_));
+
+  // The objects for the first version are the same instances as before the
+  // refresh, and the objects for the second version have been added.
+  for (size_t i = 0; i < handles.size(); i++) {
+    EXPECT_THAT(token->GetObject(handles[i]), IsOkAndHolds(objects[i]));
+  }
+  EXPECT_EQ(
+      token->FindObjects([](const Object& o) -> bool { return true; }).size(),
+      4);
+}
+
 TEST_F(TokenTest, CertGeneratedWhenConfigIsSet) {
   auto kms_client = fake_server_->NewClient();
 
@@ -520,5 +655,132 @@ TEST_F(TokenTest, CertNotGeneratedWhenConfigIsUnset) {
               IsEmpty());
 }
 
+TEST_F(TokenTest, SnapshotIsWrittenAndUsedByNextToken) {
+  auto kms_client = fake_server_->NewClient();
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  ck.mutable_version_template()->set_protection_level(
+      kms_v1::ProtectionLevel::HSM);
+  ck = CreateCryptoKeyOrDie(kms_client.get(), key_ring_.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv;
+  ckv = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv);
+  ckv = WaitForEnablement(kms_client.get(), ckv);
+
+  std::filesystem::path snapshot_dir =
+      std::filesystem::path(testing::TempDir()) / RandomId();
+  ASSERT_TRUE(std::filesystem::create_directories(snapshot_dir));
+
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Token> first,
+                       Token::New(0, config_, client_.get(), false, 1,
+                                  snapshot_dir.string()));
+  EXPECT_FALSE(first->loaded_from_snapshot());
+  std::vector<CK_OBJECT_HANDLE> first_handles =
+      first->FindObjects([](const Object& o) -> bool { return true; });
+
+  // The second token must not need Cloud KMS to initialize.
+  KmsClient unreachable_client(
+      KmsClient::Options{.endpoint_address = "localhost:1",
+                         .rpc_timeout = absl::Milliseconds(100)});
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Token> second,
+                       Token::New(0, config_, &unreachable_client, false, 1,
+                                  snapshot_dir.string()));
+  EXPECT_TRUE(second->loaded_from_snapshot());
+  EXPECT_THAT(
+      second->FindObjects([](const Object& o) -> bool { return true; }),
+      testing::UnorderedElementsAreArray(first_handles));
+
+  // Reconciling with Cloud KMS retains the handles from the snapshot.
+  EXPECT_OK(second->RefreshState(*client_));
+  EXPECT_THAT(
+      second->FindObjects([](const Object& o) -> bool { return true; }),
+      testing::UnorderedElementsAreArray(first_handles));
+
+  std::filesystem::remove_all(snapshot_dir);
+}
+
+TEST_F(TokenTest, LazyPublicKeyIsRetrievedByGetKey) {
+  auto kms_client = fake_server_->NewClient();
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  ck.mutable_version_template()->set_protection_level(
+      kms_v1::ProtectionLevel::HSM);
+  ck = CreateCryptoKeyOrDie(kms_client.get(), key_ring_.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv;
+  ckv = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv);
+  ckv = WaitForEnablement(kms_client.get(), ckv);
+
+  config_.set_lazy_public_keys(true);
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Token> token,
+                       Token::New(0, config_, client_.get()));
+
+  std::vector<CK_OBJECT_HANDLE> handles =
+      token->FindObjects([](const Object& o) -> bool {
+        return o.object_class() == CKO_PRIVATE_KEY;
+      });
+  ASSERT_EQ(handles.size(), 1);
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<Object> deferred,
+                       token->GetObject(handles[0]));
+  EXPECT_TRUE(deferred->public_key_deferred());
+  EXPECT_THAT(deferred->attributes().Value(CKA_PUBLIC_KEY_INFO),
+              StatusRvIs(CKR_ATTRIBUTE_TYPE_INVALID));
+
+  ASSERT_OK_AND_ASSIGN(std::shared_ptr<Object> key, token->GetKey(handles[0]));
+  EXPECT_FALSE(key->public_key_deferred());
+  EXPECT_EQ(key->object_class(), CKO_PRIVATE_KEY);
+  EXPECT_OK(key->attributes().Value(CKA_PUBLIC_KEY_INFO));
+
+  // Once retrieved, the complete object is also returned by handle.
+  EXPECT_THAT(token->GetObject(handles[0]), IsOkAndHolds(key));
+}
+
+TEST_F(TokenTest, ConcurrentLazyPublicKeyRequestsShareResult) {
+  auto kms_client = fake_server_->NewClient();
+
+  kms_v1::CryptoKey ck;
+  ck.set_purpose(kms_v1::CryptoKey::ASYMMETRIC_SIGN);
+  ck.mutable_version_template()->set_algorithm(
+      kms_v1::CryptoKeyVersion::EC_SIGN_P256_SHA256);
+  ck.mutable_version_template()->set_protection_level(
+      kms_v1::ProtectionLevel::HSM);
+  ck = CreateCryptoKeyOrDie(kms_client.get(), key_ring_.name(), "ck", ck, true);
+
+  kms_v1::CryptoKeyVersion ckv;
+  ckv = CreateCryptoKeyVersionOrDie(kms_client.get(), ck.name(), ckv);
+  ckv = WaitForEnablement(kms_client.get(), ckv);
+
+  config_.set_lazy_public_keys(true);
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<Token> token,
+                       Token::New(0, config_, client_.get()));
+
+  std::vector<CK_OBJECT_HANDLE> handles =
+      token->FindObjects([](const Object& o) -> bool {
+        return o.object_class() == CKO_PUBLIC_KEY;
+      });
+  ASSERT_EQ(handles.size(), 1);
+
+  std::vector<absl::StatusOr<std::shared_ptr<Object>>> results(8);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < results.size(); i++) {
+    threads.emplace_back([&, i]() { results[i] = token->GetKey(handles[0]); });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_OK(results[0]);
+  for (const absl::StatusOr<std::shared_ptr<Object>>& result : results) {
+    EXPECT_THAT(result, IsOkAndHolds(*results[0]));
+  }
+}
+
 }  // namespace
 }  // namespace cloud_kms::kmsp11
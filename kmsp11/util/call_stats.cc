@@ -0,0 +1,207 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kmsp11/util/call_stats.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+
+namespace cloud_kms::kmsp11 {
+namespace {
+
+std::atomic<uint64_t> next_call_stats_id(1);
+
+// Counters are only written by their owning thread, so a plain load and store
+// suffices where an atomic increment would otherwise be needed.
+void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+}  // namespace
+
+CallStats::ThreadCounters::ThreadCounters(size_t function_count)
+    : in_use(true), functions(new FunctionCounters[function_count]()) {}
+
+CallStats::CallStats(absl::Span<const std::string_view> function_names)
+    : function_names_(function_names.begin(), function_names.end()),
+      id_(next_call_stats_id.fetch_add(1, std::memory_order_relaxed)),
+      enabled_(false) {}
+
+CallStats::ThreadCounters& CallStats::CountersForCurrentThread() {
+  // Releases this thread's counters for adoption when the thread exits.
+  struct Cache {
+    ~Cache() {
+      if (counters) {
+        counters->in_use.store(false, std::memory_order_release);
+      }
+    }
+
+    uint64_t owner_id = 0;
+    std::shared_ptr<ThreadCounters> counters;
+  };
+  thread_local Cache cache;
+
+  if (cache.owner_id == id_) {
+    return *cache.counters;
+  }
+  if (cache.counters) {
+    cache.counters->in_use.store(false, std::memory_order_release);
+  }
+
+  absl::MutexLock lock(&mutex_);
+  cache.owner_id = id_;
+  for (const std::shared_ptr<ThreadCounters>& counters : threads_) {
+    if (!counters->in_use.exchange(true, std::memory_order_acquire)) {
+      cache.counters = counters;
+      return *counters;
+    }
+  }
+  cache.counters = std::make_shared<ThreadCounters>(function_names_.size());
+  threads_.push_back(cache.counters);
+  return *cache.counters;
+}
+
+void CallStats::Record(size_t function_index, CK_RV rv,
+                       int64_t latency_nanos, int64_t ssl_error_check_nanos) {
+  FunctionCounters& counters =
+      CountersForCurrentThread().functions[function_index];
+
+  Add(counters.calls, 1);
+  Add(counters.ssl_error_check_nanos,
+      static_cast<uint64_t>(std::max<int64_t>(ssl_error_check_nanos, 0)));
+  size_t latency_bucket = LatencyBucket(absl::Nanoseconds(latency_nanos));
+  Add(counters.latency_buckets[latency_bucket], 1);
+
+  if (rv == CKR_OK) {
+    return;
+  }
+  Add(counters.errors, 1);
+  for (ErrorRvSlot& slot : counters.errors_by_rv) {
+    CK_RV slot_rv = slot.rv.load(std::memory_order_relaxed);
+    if (slot_rv == CKR_OK) {
+      slot.rv.store(rv, std::memory_order_relaxed);
+    } else if (slot_rv != rv) {
+      continue;
+    }
+    Add(slot.count, 1);
+    return;
+  }
+}
+
+std::vector<CallStats::FunctionStats> CallStats::Snapshot() const {
+  std::vector<FunctionStats> result(function_names_.size());
+  for (size_t i = 0; i < result.size(); i++) {
+    result[i].name = function_names_[i];
+  }
+
+  absl::MutexLock lock(&mutex_);
+  for (const std::shared_ptr<ThreadCounters>& thread : threads_) {
+    for (size_t i = 0; i < result.size(); i++) {
+      const FunctionCounters& counters = thread->functions[i];
+      FunctionStats& stats = result[i];
+
+      stats.calls += counters.calls.load(std::memory_order_relaxed);
+      stats.errors += counters.errors.load(std::memory_order_relaxed);
+      stats.ssl_error_check_nanos +=
+          counters.ssl_error_check_nanos.load(std::memory_order_relaxed);
+      for (size_t j = 0; j < kLatencyBucketCount; j++) {
+        stats.latency_buckets[j] +=
+            counters.latency_buckets[j].load(std::memory_order_relaxed);
+      }
+      for (const ErrorRvSlot& slot : counters.errors_by_rv) {
+        CK_RV rv = slot.rv.load(std::memory_order_relaxed);
+        uint64_t count = slot.count.load(std::memory_order_relaxed);
+        if (rv != CKR_OK && count > 0) {
+          stats.errors_by_rv[rv] += count;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+std::string CallStats::ToString() const {
+  std::string result;
+  for (const FunctionStats& stats : Snapshot()) {
+    if (stats.calls == 0) {
+      continue;
+    }
+    absl::StrAppendFormat(&result,
+                          "%s: calls=%d errors=%d ssl_error_check_ns=%d\n",
+                          stats.name, stats.calls, stats.errors,
+                          stats.ssl_error_check_nanos);
+    if (!stats.errors_by_rv.empty()) {
+      absl::StrAppend(&result, "  errors_by_rv:");
+      for (const auto& [rv, count] : stats.errors_by_rv) {
+        absl::StrAppendFormat(&result, " %#x=%d", rv, count);
+      }
+      absl::StrAppend(&result, "\n");
+    }
+    absl::StrAppend(&result, "  latency_us:");
+    AppendLatencyBuckets(&result, stats.latency_buckets);
+    absl::StrAppend(&result, "\n");
+  }
+  return result;
+}
+
+void CallStats::Reset() {
+  absl::MutexLock lock(&mutex_);
+  for (const std::shared_ptr<ThreadCounters>& thread : threads_) {
+    for (size_t i = 0; i < function_names_.size(); i++) {
+      FunctionCounters& counters = thread->functions[i];
+      counters.calls.store(0, std::memory_order_relaxed);
+      counters.errors.store(0, std::memory_order_relaxed);
+      counters.ssl_error_check_nanos.store(0, std::memory_order_relaxed);
+      for (std::atomic<uint64_t>& bucket : counters.latency_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+      }
+      for (ErrorRvSlot& slot : counters.errors_by_rv) {
+        slot.count.store(0, std::memory_order_relaxed);
+        slot.rv.store(CKR_OK, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+CallRecorder::CallRecorder(CallStats& stats, size_t function_index)
+    : stats_(stats),
+      function_index_(function_index),
+      enabled_(stats.enabled()) {
+  if (enabled_) {
+    start_nanos_ = absl::GetCurrentTimeNanos();
+  }
+}
+
+void CallRecorder::SslErrorCheckDone() {
+  if (enabled_) {
+    ssl_error_check_nanos_ = absl::GetCurrentTimeNanos() - start_nanos_;
+  }
+}
+
+CK_RV CallRecorder::Done(CK_RV rv) {
+  if (enabled_) {
+    stats_.Record(function_index_, rv,
+                  absl::GetCurrentTimeNanos() - start_nanos_,
+                  ssl_error_check_nanos_);
+  }
+  return rv;
+}
+
+}  // namespace cloud_kms::kmsp11
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KMSP11_UTIL_CALL_STATS_H_
+#define KMSP11_UTIL_CALL_STATS_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/btree_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "common/latency_histogram.h"
+#include "kmsp11/cryptoki.h"
+
+namespace cloud_kms::kmsp11 {
+
+// Call counts, error counts and latency histograms for a fixed set of
+// functions, identified by their index in the list of names provided at
+// construction.
+//
+// Each thread records into its own set of counters, which only that thread
+// writes, so recording a call takes no locks and performs no read-modify-write
+// operations. Snapshot sums the counters of every thread. Counters belonging
+// to a thread that has exited are adopted by the next new recording thread.
+class CallStats {
+ public:
+  // Latency is bucketed as described in common/latency_histogram.h.
+  static constexpr size_t kLatencyBucketCount = cloud_kms::kLatencyBucketCount;
+
+  // The number of distinct error CK_RVs that are tracked per function, per
+  // thread. Errors beyond this are included in FunctionStats::errors, but not
+  // in FunctionStats::errors_by_rv.
+  static constexpr size_t kErrorRvSlotCount = 8;
+
+  struct FunctionStats {
+    std::string_view name;
+    uint64_t calls;
+    uint64_t errors;
+    absl::btree_map<CK_RV, uint64_t> errors_by_rv;
+    // The total time spent clearing the OpenSSL error queue on entry.
+    uint64_t ssl_error_check_nanos;
+    std::array<uint64_t, kLatencyBucketCount> latency_buckets;
+  };
+
+  explicit CallStats(absl::Span<const std::string_view> function_names);
+
+  CallStats(const CallStats&) = delete;
+  CallStats& operator=(const CallStats&) = delete;
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+  void set_enabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  // Records a call to the function at `function_index` that returned `rv`.
+  void Record(size_t function_index, CK_RV rv, int64_t latency_nanos,
+              int64_t ssl_error_check_nanos);
+
+  // Returns the statistics for every function, in index order. Calls that are
+  // recorded concurrently may or may not be reflected.
+  std::vector<FunctionStats> Snapshot() const;
+
+  // Renders the statistics for every function that has been called as text.
+  std::string ToString() const;
+
+  // Sets every counter to zero. Calls that are recorded concurrently may be
+  // lost.
+  void Reset();
+
+ private:
+  struct ErrorRvSlot {
+    std::atomic<CK_RV> rv;
+    std::atomic<uint64_t> count;
+  };
+
+  struct FunctionCounters {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> errors;
+    std::array<ErrorRvSlot, kErrorRvSlotCount> errors_by_rv;
+    std::atomic<uint64_t> ssl_error_check_nanos;
+    std::array<std::atomic<uint64_t>, kLatencyBucketCount> latency_buckets;
+  };
+
+  struct ThreadCounters {
+    explicit ThreadCounters(size_t function_count);
+
+    std::atomic<bool> in_use;
+    std::unique_ptr<FunctionCounters[]> functions;
+  };
+
+  ThreadCounters& CountersForCurrentThread();
+
+  const std::vector<std::string_view> function_names_;
+  // A process-unique identifier, used to tell instances apart in thread-local
+  // storage even when one is allocated at the address of another.
+  const uint64_t id_;
+  std::atomic<bool> enabled_;
+
+  mutable absl::Mutex mutex_;
+  std::vector<std::shared_ptr<ThreadCounters>> threads_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+// Measures a single call to an entry point, and records it in a CallStats
+// on completion. Does nothing, including reading the clock, if the CallStats
+// is not enabled when the call begins.
+class CallRecorder {
+ public:
+  CallRecorder(CallStats& stats, size_t function_index);
+
+  // Marks the end of the OpenSSL error queue check that precedes each call.
+  void SslErrorCheckDone();
+
+  // Records the call and returns `rv`.
+  CK_RV Done(CK_RV rv);
+
+ private:
+  CallStats& stats_;
+  const size_t function_index_;
+  const bool enabled_;
+  int64_t start_nanos_ = 0;
+  int64_t ssl_error_check_nanos_ = 0;
+};
+
+}  // namespace cloud_kms::kmsp11
+
+#endif  // KMSP11_UTIL_CALL_STATS_H_
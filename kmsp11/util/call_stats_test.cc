@@ -0,0 +1,167 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kmsp11/util/call_stats.h"
+
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace cloud_kms::kmsp11 {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Not;
+using ::testing::Pair;
+
+constexpr std::string_view kNames[] = {"C_Foo", "C_Bar"};
+
+TEST(CallStatsTest, SnapshotIncludesEveryFunction) {
+  CallStats stats(kNames);
+
+  std::vector<CallStats::FunctionStats> snapshot = stats.Snapshot();
+  ASSERT_EQ(snapshot.size(), 2);
+  EXPECT_EQ(snapshot[0].name, "C_Foo");
+  EXPECT_EQ(snapshot[0].calls, 0);
+  EXPECT_EQ(snapshot[1].name, "C_Bar");
+  EXPECT_EQ(snapshot[1].calls, 0);
+}
+
+TEST(CallStatsTest, RecordCountsCallsAndErrors) {
+  CallStats stats(kNames);
+
+  stats.Record(1, CKR_OK, 1000, 10);
+  stats.Record(1, CKR_BUFFER_TOO_SMALL, 1000, 20);
+  stats.Record(1, CKR_BUFFER_TOO_SMALL, 1000, 30);
+  stats.Record(1, CKR_ARGUMENTS_BAD, 1000, 40);
+
+  CallStats::FunctionStats bar = stats.Snapshot()[1];
+  EXPECT_EQ(bar.calls, 4);
+  EXPECT_EQ(bar.errors, 3);
+  EXPECT_THAT(bar.errors_by_rv, ElementsAre(Pair(CKR_ARGUMENTS_BAD, 1),
+                                            Pair(CKR_BUFFER_TOO_SMALL, 2)));
+  EXPECT_EQ(bar.ssl_error_check_nanos, 100);
+  EXPECT_EQ(stats.Snapshot()[0].calls, 0);
+}
+
+TEST(CallStatsTest, RecordBucketsLatency) {
+  CallStats stats(kNames);
+
+  stats.Record(0, CKR_OK, 500, 0);   // < 1us
+  stats.Record(0, CKR_OK, 3000, 0);  // [2us, 4us)
+  stats.Record(0, CKR_OK, 3999, 0);  // [2us, 4us)
+  stats.Record(0, CKR_OK, int64_t{3600} * 1000 * 1000 * 1000, 0);  // 1 hour
+
+  CallStats::FunctionStats foo = stats.Snapshot()[0];
+  EXPECT_EQ(foo.latency_buckets[0], 1);
+  EXPECT_EQ(foo.latency_buckets[2], 2);
+  EXPECT_EQ(foo.latency_buckets[CallStats::kLatencyBucketCount - 1], 1);
+}
+
+TEST(CallStatsTest, ErrorsBeyondSlotCountAreCountedInTotal) {
+  CallStats stats(kNames);
+
+  for (CK_RV rv = 1; rv <= CallStats::kErrorRvSlotCount + 1; rv++) {
+    stats.Record(0, rv, 0, 0);
+  }
+
+  CallStats::FunctionStats foo = stats.Snapshot()[0];
+  EXPECT_EQ(foo.errors, CallStats::kErrorRvSlotCount + 1);
+  EXPECT_EQ(foo.errors_by_rv.size(), CallStats::kErrorRvSlotCount);
+}
+
+TEST(CallStatsTest, SnapshotSumsThreads) {
+  CallStats stats(kNames);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&stats] {
+      for (int j = 0; j < 1000; j++) {
+        stats.Record(0, j % 2 ? CKR_OK : CKR_FUNCTION_FAILED, 0, 0);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  CallStats::FunctionStats foo = stats.Snapshot()[0];
+  EXPECT_EQ(foo.calls, 8000);
+  EXPECT_EQ(foo.errors, 4000);
+  EXPECT_THAT(foo.errors_by_rv, ElementsAre(Pair(CKR_FUNCTION_FAILED, 4000)));
+}
+
+TEST(CallStatsTest, CountersOfExitedThreadsAreRetained) {
+  CallStats stats(kNames);
+
+  for (int i = 0; i < 4; i++) {
+    std::thread([&stats] { stats.Record(1, CKR_OK, 0, 0); }).join();
+  }
+
+  EXPECT_EQ(stats.Snapshot()[1].calls, 4);
+}
+
+TEST(CallStatsTest, ResetClearsCounters) {
+  CallStats stats(kNames);
+  stats.Record(0, CKR_FUNCTION_FAILED, 1000, 10);
+
+  stats.Reset();
+
+  CallStats::FunctionStats foo = stats.Snapshot()[0];
+  EXPECT_EQ(foo.calls, 0);
+  EXPECT_EQ(foo.errors, 0);
+  EXPECT_THAT(foo.errors_by_rv, IsEmpty());
+  EXPECT_EQ(foo.ssl_error_check_nanos, 0);
+  EXPECT_EQ(foo.latency_buckets[0], 0);
+}
+
+TEST(CallStatsTest, ToStringOmitsUncalledFunctions) {
+  CallStats stats(kNames);
+  stats.Record(1, CKR_BUFFER_TOO_SMALL, 3000, 0);
+
+  std::string text = stats.ToString();
+  EXPECT_THAT(text, HasSubstr("C_Bar: calls=1 errors=1"));
+  EXPECT_THAT(text, HasSubstr("errors_by_rv: 0x150=1"));
+  EXPECT_THAT(text, HasSubstr("latency_us: <4=1"));
+  EXPECT_THAT(text, Not(HasSubstr("C_Foo")));
+}
+
+TEST(CallRecorderTest, RecordsWhenEnabled) {
+  CallStats stats(kNames);
+  stats.set_enabled(true);
+
+  CallRecorder recorder(stats, 0);
+  recorder.SslErrorCheckDone();
+  EXPECT_EQ(recorder.Done(CKR_ARGUMENTS_BAD), CKR_ARGUMENTS_BAD);
+
+  CallStats::FunctionStats foo = stats.Snapshot()[0];
+  EXPECT_EQ(foo.calls, 1);
+  EXPECT_EQ(foo.errors, 1);
+}
+
+TEST(CallRecorderTest, DoesNotRecordWhenDisabled) {
+  CallStats stats(kNames);
+
+  CallRecorder recorder(stats, 0);
+  EXPECT_EQ(recorder.Done(CKR_OK), CKR_OK);
+
+  EXPECT_EQ(stats.Snapshot()[0].calls, 0);
+}
+
+}  // namespace
+}  // namespace cloud_kms::kmsp11
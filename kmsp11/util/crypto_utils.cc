@@ -14,11 +14,14 @@
 
 #include "kmsp11/util/crypto_utils.h"
 
+#include <algorithm>
 #include <limits>
+#include <new>
 
 #include "absl/random/random.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "common/platform.h"
 #include "common/status_macros.h"
 #include "glog/logging.h"
 #include "kmsp11/util/errors.h"
@@ -645,6 +648,11 @@ absl::StatusOr<std::vector<uint8_t>> BuildRsaDigestInfo(
 
 std::string SslErrorToString(std::string_view default_message) {
   CHECK(kCryptoLibraryInitialized);
+  // This is called on entry to every PKCS #11 function; avoid allocating a BIO
+  // in the common case that there are no errors.
+  if (ERR_peek_error() == 0) {
+    return std::string(default_message);
+  }
   bssl::UniquePtr<BIO> bio(BIO_new(BIO_s_mem()));
   ERR_print_errors(bio.get());
   char* contents;
@@ -655,4 +663,97 @@ std::string SslErrorToString(std::string_view default_message) {
   return std::string(contents, size_t(len));
 }
 
+LockedArena& LockedArena::Default() {
+  static LockedArena* const kArena = new LockedArena();
+  return *kArena;
+}
+
+LockedArena::LockedArena(size_t region_size)
+    : page_size_(GetPageSize()),
+      region_size_((std::max(region_size, kMaxBlockSize) + page_size_ - 1) /
+                   page_size_ * page_size_) {}
+
+LockedArena::~LockedArena() {
+  absl::MutexLock lock(&mutex_);
+  for (const Region& region : regions_) {
+    OPENSSL_cleanse(region.addr, region.len);
+    UnmapLockedPages(region.addr, region.len);
+  }
+}
+
+size_t LockedArena::SizeClass(size_t len) {
+  size_t size_class = 0;
+  while ((kMinBlockSize << size_class) < len) {
+    size_class++;
+  }
+  return size_class;
+}
+
+void* LockedArena::MapRegion(size_t len) {
+  bool locked;
+  void* addr = MapLockedPages(len, &locked);
+  if (!addr) {
+    throw std::bad_alloc();
+  }
+  if (!locked && all_locked_) {
+    LOG(WARNING) << "unable to lock memory for secrets, which may be written "
+                    "to swap; consider raising the locked memory limit "
+                    "(RLIMIT_MEMLOCK)";
+  }
+  all_locked_ = all_locked_ && locked;
+  return addr;
+}
+
+void* LockedArena::Allocate(size_t len) {
+  len = std::max<size_t>(len, 1);
+  absl::MutexLock lock(&mutex_);
+
+  if (len > kMaxBlockSize) {
+    // Pages of its own, so that unmapping it does not affect other blocks.
+    return MapRegion((len + page_size_ - 1) / page_size_ * page_size_);
+  }
+
+  size_t size_class = SizeClass(len);
+  std::vector<void*>& free_blocks = free_blocks_[size_class];
+  if (!free_blocks.empty()) {
+    void* block = free_blocks.back();
+    free_blocks.pop_back();
+    return block;
+  }
+
+  size_t block_size = kMinBlockSize << size_class;
+  if (static_cast<size_t>(end_ - next_) < block_size) {
+    next_ = static_cast<uint8_t*>(MapRegion(region_size_));
+    end_ = next_ + region_size_;
+    regions_.push_back(Region{next_, region_size_});
+  }
+  void* block = next_;
+  next_ += block_size;
+  return block;
+}
+
+void LockedArena::Deallocate(void* ptr, size_t len) {
+  if (!ptr) {
+    return;
+  }
+  len = std::max<size_t>(len, 1);
+
+  if (len > kMaxBlockSize) {
+    size_t mapped_len = (len + page_size_ - 1) / page_size_ * page_size_;
+    OPENSSL_cleanse(ptr, mapped_len);
+    UnmapLockedPages(ptr, mapped_len);
+    return;
+  }
+
+  size_t size_class = SizeClass(len);
+  OPENSSL_cleanse(ptr, kMinBlockSize << size_class);
+  absl::MutexLock lock(&mutex_);
+  free_blocks_[size_class].push_back(ptr);
+}
+
+bool LockedArena::all_locked() const {
+  absl::MutexLock lock(&mutex_);
+  return all_locked_;
+}
+
 }  // namespace cloud_kms::kmsp11
@@ -17,10 +17,13 @@
 #ifndef KMSP11_UTIL_CRYPTO_UTILS_H_
 #define KMSP11_UTIL_CRYPTO_UTILS_H_
 
+#include <array>
 #include <string>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "common/kms_v1.h"
 #include "common/openssl.h"
@@ -178,6 +181,95 @@ struct ZeroDeallocator {
   }
 };
 
+// A pool of memory for secrets that is kept out of swap where the platform
+// allows it.
+//
+// mlock and VirtualLock operate on whole pages, and their locks do not nest, so
+// locking individual heap blocks would let one block's unlock expose every
+// other block on the same page. Instead, the arena maps dedicated regions that
+// are locked once and unlocked only when the arena is destroyed, and carves
+// blocks out of them. Blocks are zeroed when they are freed, and are reused for
+// later allocations of the same size class. Allocations larger than the
+// largest block are given pages of their own, which are unmapped when they are
+// freed.
+//
+// This class is thread-safe.
+class LockedArena {
+ public:
+  // Returns an arena that lives for the life of the process.
+  static LockedArena& Default();
+
+  // `region_size` is the number of bytes mapped at a time for small blocks.
+  explicit LockedArena(size_t region_size = 64 * 1024);
+  ~LockedArena();
+
+  LockedArena(const LockedArena&) = delete;
+  LockedArena& operator=(const LockedArena&) = delete;
+
+  // Returns a block of at least `len` bytes. Throws std::bad_alloc if memory
+  // cannot be mapped.
+  void* Allocate(size_t len);
+  // Zeroes and frees a block that was returned by Allocate(len).
+  void Deallocate(void* ptr, size_t len);
+
+  // Returns false if any memory mapped by this arena could not be locked.
+  bool all_locked() const;
+
+ private:
+  struct Region {
+    void* addr;
+    size_t len;
+  };
+
+  // Blocks are 16, 32, ..., 2048 bytes.
+  static constexpr size_t kMinBlockSize = 16;
+  static constexpr size_t kSizeClassCount = 8;
+  static constexpr size_t kMaxBlockSize = kMinBlockSize
+                                          << (kSizeClassCount - 1);
+
+  static size_t SizeClass(size_t len);
+  void* MapRegion(size_t len) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const size_t page_size_;
+  const size_t region_size_;
+
+  mutable absl::Mutex mutex_;
+  std::vector<Region> regions_ ABSL_GUARDED_BY(mutex_);
+  // The unused remainder of the most recently mapped region.
+  uint8_t* next_ ABSL_GUARDED_BY(mutex_) = nullptr;
+  uint8_t* end_ ABSL_GUARDED_BY(mutex_) = nullptr;
+  std::array<std::vector<void*>, kSizeClassCount> free_blocks_
+      ABSL_GUARDED_BY(mutex_);
+  bool all_locked_ ABSL_GUARDED_BY(mutex_) = true;
+};
+
+// A replacement for std::allocator that allocates from LockedArena::Default(),
+// so that its contents are kept out of swap where the platform allows it, and
+// that zeroes before deallocating.
+//
+// Suggested usage:
+//   std::vector<uint8_t, LockedZeroDeallocator<uint8_t>> t;
+template <typename T>
+struct LockedZeroDeallocator {
+  using value_type = T;
+
+  LockedZeroDeallocator() = default;
+  template <typename U>
+  LockedZeroDeallocator(const LockedZeroDeallocator<U>&) {}
+
+  T* allocate(std::size_t len) {
+    return static_cast<T*>(LockedArena::Default().Allocate(len * sizeof(T)));
+  }
+  void deallocate(T* ptr, std::size_t len) {
+    LockedArena::Default().Deallocate(ptr, len * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const LockedZeroDeallocator<U>&) const {
+    return true;
+  }
+};
+
 // A replacement for std::default_delete that zeroes before deleting.
 //
 // Suggested usage:
@@ -26,6 +26,7 @@
 namespace cloud_kms::kmsp11 {
 namespace {
 
+using ::testing::Each;
 using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::testing::IsEmpty;
@@ -860,5 +861,62 @@ TEST(SslErrorToStringTest, DefaultMessageEmittedOnNoError) {
   EXPECT_EQ(SslErrorToString("abcd"), "abcd");
 }
 
+TEST(LockedArenaTest, SmallBlocksShareARegion) {
+  LockedArena arena(4096);
+  uint8_t* a = static_cast<uint8_t*>(arena.Allocate(32));
+  uint8_t* b = static_cast<uint8_t*>(arena.Allocate(32));
+
+  EXPECT_NE(a, b);
+  EXPECT_LT(std::max(a, b) - std::min(a, b), 4096);
+  std::fill_n(a, 32, 0xAA);
+  std::fill_n(b, 32, 0xBB);
+  EXPECT_EQ(a[31], 0xAA);
+
+  arena.Deallocate(a, 32);
+  arena.Deallocate(b, 32);
+}
+
+TEST(LockedArenaTest, FreedBlockIsZeroedAndReused) {
+  LockedArena arena;
+  uint8_t* a = static_cast<uint8_t*>(arena.Allocate(20));
+  std::fill_n(a, 20, 0xAA);
+  arena.Deallocate(a, 20);
+
+  // 20 and 30 bytes share a size class.
+  uint8_t* b = static_cast<uint8_t*>(arena.Allocate(30));
+  EXPECT_EQ(b, a);
+  EXPECT_THAT(std::vector<uint8_t>(b, b + 30), Each(0));
+  arena.Deallocate(b, 30);
+}
+
+TEST(LockedArenaTest, FreeingOneBlockLeavesItsNeighbourIntact) {
+  LockedArena arena;
+  uint8_t* a = static_cast<uint8_t*>(arena.Allocate(64));
+  uint8_t* b = static_cast<uint8_t*>(arena.Allocate(64));
+  std::fill_n(b, 64, 0xBB);
+
+  arena.Deallocate(a, 64);
+  EXPECT_THAT(std::vector<uint8_t>(b, b + 64), Each(0xBB));
+  arena.Deallocate(b, 64);
+}
+
+TEST(LockedArenaTest, LargeAllocation) {
+  LockedArena arena;
+  size_t len = 3 * 4096 + 1;
+  uint8_t* a = static_cast<uint8_t*>(arena.Allocate(len));
+  std::fill_n(a, len, 0xAA);
+  EXPECT_EQ(a[len - 1], 0xAA);
+  arena.Deallocate(a, len);
+}
+
+TEST(LockedZeroDeallocatorTest, VectorIsUsable) {
+  std::vector<uint8_t, LockedZeroDeallocator<uint8_t>> v;
+  for (int i = 0; i < 10000; i++) {
+    v.push_back(static_cast<uint8_t>(i));
+  }
+  EXPECT_EQ(v.size(), 10000);
+  EXPECT_EQ(v[9999], static_cast<uint8_t>(9999));
+}
+
 }  // namespace
 }  // namespace cloud_kms::kmsp11
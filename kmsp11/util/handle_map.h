@@ -17,9 +17,14 @@
 #ifndef KMSP11_UTIL_HANDLE_MAP_H_
 #define KMSP11_UTIL_HANDLE_MAP_H_
 
+#include <array>
+#include <memory>
+
+#include "absl/base/optimization.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
 #include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
 #include "kmsp11/cryptoki.h"
 #include "kmsp11/util/crypto_utils.h"
 #include "kmsp11/util/errors.h"
@@ -29,9 +34,18 @@ namespace cloud_kms::kmsp11 {
 // A HandleMap contains a set of items with assigned CK_ULONG handles.
 // It is intended for use with the PKCS #11 Session and Object types, both
 // of which are identified by a handle.
+//
+// Items are spread across a fixed number of independently locked shards, so
+// that concurrent lookups of different handles do not contend on a single
+// mutex. Handles remain uniformly random; the shard that holds an item is
+// given by the low bits of its handle.
 template <typename T>
 class HandleMap {
  public:
+  static constexpr size_t kShardCount = 16;
+  static_assert((kShardCount & (kShardCount - 1)) == 0,
+                "kShardCount must be a power of two");
+
   // Create a new map. The provided CK_RV will be used for Get and Remove
   // operations performed against an unknown handle.
   HandleMap(CK_RV not_found_rv) : not_found_rv_(not_found_rv) {}
@@ -40,27 +54,29 @@ class HandleMap {
   // returns its handle.
   template <typename... Args>
   inline CK_ULONG Add(Args&&... args) {
-    absl::WriterMutexLock lock(&mutex_);
+    std::shared_ptr<T> item = std::make_shared<T>(std::forward<Args>(args)...);
 
     // Generate a new handle by picking a random handle and ensuring that it is
     // not already in use. Repeat this process until we have a useable handle.
-    CK_ULONG handle;
-    do {
-      handle = RandomHandle();
-    } while (items_.contains(handle));
-
-    items_.try_emplace(handle,
-                       std::make_shared<T>(std::forward<Args>(args)...));
-    return handle;
+    while (true) {
+      CK_ULONG handle = RandomHandle();
+      Shard& shard = ShardFor(handle);
+
+      absl::WriterMutexLock lock(&shard.mutex);
+      if (shard.items.try_emplace(handle, item).second) {
+        return handle;
+      }
+    }
   }
 
   // Gets the map element with the provided handle, or returns NotFound if there
   // is no element with the provided handle.
   inline absl::StatusOr<std::shared_ptr<T>> Get(CK_ULONG handle) const {
-    absl::ReaderMutexLock lock(&mutex_);
+    const Shard& shard = ShardFor(handle);
+    absl::ReaderMutexLock lock(&shard.mutex);
 
-    auto it = items_.find(handle);
-    if (it == items_.end()) {
+    auto it = shard.items.find(handle);
+    if (it == shard.items.end()) {
       return HandleNotFoundError(handle, not_found_rv_, SOURCE_LOCATION);
     }
 
@@ -70,36 +86,51 @@ class HandleMap {
   // Removes the map element with the provided handle, or returns NotFound if
   // there is no element with the provided handle.
   inline absl::Status Remove(CK_ULONG handle) {
-    absl::WriterMutexLock lock(&mutex_);
+    // Release the item after the shard is unlocked, since destroying it may
+    // be expensive.
+    std::shared_ptr<T> item;
 
-    auto it = items_.find(handle);
-    if (it == items_.end()) {
+    Shard& shard = ShardFor(handle);
+    absl::WriterMutexLock lock(&shard.mutex);
+
+    auto it = shard.items.find(handle);
+    if (it == shard.items.end()) {
       return HandleNotFoundError(handle, not_found_rv_, SOURCE_LOCATION);
     }
 
-    items_.erase(it);
+    item = std::move(it->second);
+    shard.items.erase(it);
     return absl::OkStatus();
   }
 
   // Removes all map elements that match the provided predicate.
   inline void RemoveIf(absl::FunctionRef<bool(const T&)> predicate) {
-    absl::WriterMutexLock lock(&mutex_);
-
-    auto it = items_.begin();
-    while (it != items_.end()) {
-      if (predicate(*it->second)) {
-        items_.erase(it++);
-      } else {
-        it++;
-      }
+    for (Shard& shard : shards_) {
+      absl::WriterMutexLock lock(&shard.mutex);
+      absl::erase_if(shard.items, [&](const auto& entry) {
+        return predicate(*entry.second);
+      });
     }
   }
 
  private:
+  // Each shard is aligned to a cache line so that lookups in one shard do not
+  // invalidate the lock word of its neighbours.
+  struct ABSL_CACHELINE_ALIGNED Shard {
+    mutable absl::Mutex mutex;
+    absl::flat_hash_map<CK_ULONG, std::shared_ptr<T>> items
+        ABSL_GUARDED_BY(mutex);
+  };
+
+  inline Shard& ShardFor(CK_ULONG handle) {
+    return shards_[handle & (kShardCount - 1)];
+  }
+  inline const Shard& ShardFor(CK_ULONG handle) const {
+    return shards_[handle & (kShardCount - 1)];
+  }
+
   CK_RV not_found_rv_;
-  mutable absl::Mutex mutex_;
-  absl::flat_hash_map<CK_ULONG, std::shared_ptr<T>> items_
-      ABSL_GUARDED_BY(mutex_);
+  std::array<Shard, kShardCount> shards_;
 };
 
 }  // namespace cloud_kms::kmsp11
@@ -14,6 +14,9 @@
 
 #include "kmsp11/util/handle_map.h"
 
+#include <thread>
+#include <vector>
+
 #include "common/test/test_status_macros.h"
 #include "gtest/gtest.h"
 #include "kmsp11/test/matchers.h"
@@ -96,5 +99,24 @@ TEST(HandleMapTest, RemoveIfRemovesOnPredicate) {
   EXPECT_THAT(map.Get(h4), StatusRvIs(CKR_SESSION_HANDLE_INVALID));
 }
 
+TEST(HandleMapTest, ConcurrentAddGetRemove) {
+  HandleMap<int> map(CKR_SESSION_HANDLE_INVALID);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&map, i] {
+      for (int j = 0; j < 100; j++) {
+        CK_ULONG handle = map.Add(i);
+        EXPECT_THAT(map.Get(handle), IsOkAndHolds(Pointee(i)));
+        EXPECT_OK(map.Remove(handle));
+        EXPECT_THAT(map.Get(handle), StatusRvIs(CKR_SESSION_HANDLE_INVALID));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
 }  // namespace
 }  // namespace cloud_kms::kmsp11
@@ -14,10 +14,14 @@
 
 #include "kmsp11/util/logging.h"
 
+#include <ctime>
+#include <string>
+
 #include "absl/base/log_severity.h"
 #include "absl/log/initialize.h"
 #include "absl/log/log_sink.h"
 #include "absl/log/log_sink_registry.h"
+#include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
 #include "common/platform.h"
 #include "common/status_utils.h"
@@ -29,8 +33,60 @@
 namespace cloud_kms::kmsp11 {
 namespace {
 
+// glog's default value for FLAGS_max_log_size.
+constexpr uint32_t kDefaultMaxLogSizeMb = 1800;
+
+// Wraps glog's logger for a log file, so that messages are written to the file
+// by a background thread.
+class AsyncGlogLogger : public google::base::Logger {
+ public:
+  AsyncGlogLogger(google::base::Logger* wrapped,
+                  AsyncLogWriter::Options options)
+      : wrapped_(wrapped),
+        writer_(options, [this](std::string_view lines, uint64_t dropped) {
+          WriteToWrapped(lines, dropped);
+        }) {}
+
+  void Write(bool force_flush, time_t timestamp, const char* message,
+             int message_len) override {
+    if (message_len > 0) {
+      writer_.Enqueue(std::string(message, message_len));
+    }
+    if (force_flush) {
+      Flush();
+    }
+  }
+
+  void Flush() override {
+    writer_.Flush();
+    wrapped_->Flush();
+  }
+
+  google::uint32 LogSize() override { return wrapped_->LogSize(); }
+
+  google::base::Logger* wrapped() const { return wrapped_; }
+
+ private:
+  void WriteToWrapped(std::string_view lines, uint64_t dropped) {
+    time_t now = time(nullptr);
+    if (dropped > 0) {
+      std::string notice = absl::StrFormat(
+          "dropped %d log messages because the log buffer was full\n",
+          dropped);
+      wrapped_->Write(false, now, notice.data(), notice.size());
+    }
+    if (!lines.empty()) {
+      wrapped_->Write(false, now, lines.data(), lines.size());
+    }
+  }
+
+  google::base::Logger* const wrapped_;
+  AsyncLogWriter writer_;
+};
+
 ABSL_CONST_INIT static absl::Mutex logging_lock(absl::kConstInit);
 static bool logging_initialized ABSL_GUARDED_BY(logging_lock);
+static AsyncGlogLogger* async_logger ABSL_GUARDED_BY(logging_lock) = nullptr;
 
 void GrpcLog(gpr_log_func_args* args) {
   // Map gRPC severities to glog severities.
@@ -94,7 +150,8 @@ static const bool kOneTimeInitialized = [] {
 }  // namespace
 
 absl::Status InitializeLogging(std::string_view output_directory,
-                               std::string_view output_filename_suffix) {
+                               std::string_view output_filename_suffix,
+                               const LogFileOptions& file_options) {
   absl::WriterMutexLock lock(&logging_lock);
 
   if (logging_initialized) {
@@ -128,19 +185,64 @@ absl::Status InitializeLogging(std::string_view output_directory,
       google::SetLogFilenameExtension(
           absl::StrCat(output_filename_suffix, "-").c_str());
     }
+
+    FLAGS_max_log_size = file_options.max_file_size_mb > 0
+                             ? file_options.max_file_size_mb
+                             : kDefaultMaxLogSizeMb;
   }
 
   google::InitGoogleLogging("libkmsp11");
+
+  if (!output_directory.empty() && file_options.async) {
+    // glog asks loggers to flush messages more severe than FLAGS_logbuflevel
+    // immediately. In async mode, only FATAL messages (which are about to
+    // crash the program) should wait for the writer thread.
+    FLAGS_logbuflevel = google::GLOG_ERROR;
+    async_logger =
+        new AsyncGlogLogger(google::base::GetLogger(google::GLOG_INFO),
+                            file_options.async_options);
+    google::base::SetLogger(google::GLOG_INFO, async_logger);
+  } else {
+    FLAGS_logbuflevel = google::GLOG_INFO;
+  }
+
   logging_initialized = true;
   return absl::OkStatus();
 }
 
+namespace {
+
+void ShutdownLoggingLocked(bool in_forked_child)
+    ABSL_EXCLUSIVE_LOCKS_REQUIRED(logging_lock) {
+  if (!logging_initialized) {
+    return;
+  }
+  if (async_logger) {
+    // SetLogger holds glog's lock, so no thread is inside async_logger once it
+    // returns.
+    google::base::SetLogger(google::GLOG_INFO, async_logger->wrapped());
+    // Deleting the logger writes any messages that remain. In a forked child
+    // the writer thread does not exist and can't be joined, so the logger is
+    // leaked; any messages that it holds belong to the parent.
+    if (!in_forked_child) {
+      delete async_logger;
+    }
+    async_logger = nullptr;
+  }
+  google::ShutdownGoogleLogging();
+  logging_initialized = false;
+}
+
+}  // namespace
+
 void ShutdownLogging() {
   absl::WriterMutexLock lock(&logging_lock);
-  if (logging_initialized) {
-    google::ShutdownGoogleLogging();
-    logging_initialized = false;
-  }
+  ShutdownLoggingLocked(/*in_forked_child=*/false);
+}
+
+void ShutdownLoggingInForkedChild() {
+  absl::WriterMutexLock lock(&logging_lock);
+  ShutdownLoggingLocked(/*in_forked_child=*/true);
 }
 
 CK_RV LogAndResolve(std::string_view function_name,
@@ -148,6 +250,9 @@ CK_RV LogAndResolve(std::string_view function_name,
   if (status.ok()) {
     return CKR_OK;
   }
+  if (IsExpectedError(status)) {
+    return GetCkRv(status);
+  }
 
   CK_RV rv = GetCkRv(status);
   std::string message =
@@ -17,16 +17,34 @@
 #ifndef KMSP11_UTIL_LOGGING_H_
 #define KMSP11_UTIL_LOGGING_H_
 
+#include <cstdint>
 #include <string_view>
 
 #include "absl/status/status.h"
+#include "common/async_log_writer.h"
 #include "kmsp11/cryptoki.h"
 
 namespace cloud_kms::kmsp11 {
 
-absl::Status InitializeLogging(std::string_view output_directory,
-                               std::string_view output_filename_suffix);
+// Options for the log file that is written when an output directory is
+// specified.
+struct LogFileOptions {
+  // If true, log messages are written to the log file by a background thread
+  // rather than by the thread that emits them.
+  bool async = false;
+  AsyncLogWriter::Options async_options;
+  // If non-zero, a new log file is started once the current file reaches this
+  // size.
+  uint32_t max_file_size_mb = 0;
+};
+
+absl::Status InitializeLogging(
+    std::string_view output_directory, std::string_view output_filename_suffix,
+    const LogFileOptions& file_options = LogFileOptions());
 void ShutdownLogging();
+// Like ShutdownLogging, for use in the child process after fork(), where the
+// thread that writes async log messages does not exist.
+void ShutdownLoggingInForkedChild();
 
 CK_RV LogAndResolve(std::string_view function_name, const absl::Status& status);
 
@@ -26,6 +26,7 @@
 #include "kmsp11/test/matchers.h"
 #include "kmsp11/test/resource_helpers.h"
 #include "kmsp11/util/errors.h"
+#include "kmsp11/util/status_utils.h"
 #include "kmsp11/util/string_utils.h"
 
 namespace cloud_kms::kmsp11 {
@@ -56,6 +57,15 @@ TEST(LoggingTest, LogAndResolveWithUninitializedLoggerWritesToStandardError) {
   EXPECT_THAT(GetCapturedStderr(), HasSubstr(error.ToString()));
 }
 
+TEST(LoggingTest, LogAndResolveDoesNotLogExpectedErrors) {
+  CaptureStderr();
+
+  EXPECT_EQ(LogAndResolve("foo", ExpectedError(CKR_BUFFER_TOO_SMALL)),
+            CKR_BUFFER_TOO_SMALL);
+
+  EXPECT_THAT(GetCapturedStderr(), IsEmpty());
+}
+
 TEST(LoggingTest, NoDirectoryLogsInfoToStandardError) {
   CaptureStderr();
   ASSERT_OK(InitializeLogging("", ""));
@@ -215,6 +225,28 @@ TEST_F(LogDirectoryTest, SingleFileContainsAllLogLevels) {
                          HasSubstr(info_message))));
 }
 
+TEST_F(LogDirectoryTest, AsyncLoggingWritesAllMessagesOnShutdown) {
+  LogFileOptions options;
+  options.async = true;
+  options.async_options.overflow_policy =
+      AsyncLogWriter::OverflowPolicy::kBlock;
+
+  {
+    ASSERT_OK(InitializeLogging(log_directory_, "", options));
+    absl::Cleanup c = ShutdownLogging;
+
+    for (int i = 0; i < 100; i++) {
+      LOG(INFO) << "Async message " << i;
+    }
+  }
+
+  std::vector<std::filesystem::directory_entry> files = LogDirectoryEntries();
+  ASSERT_THAT(files, SizeIs(1));
+  EXPECT_THAT(ReadFileToString(files[0].path().string()),
+              IsOkAndHolds(AllOf(HasSubstr("Async message 0\n"),
+                                 HasSubstr("Async message 99\n"))));
+}
+
 TEST_F(LogDirectoryTest, GrpcErrorsAreLoggedToGlogDestination) {
   std::string error_message = "Error message";
   std::string info_message = "Info message";
@@ -14,7 +14,9 @@
 
 #include "kmsp11/util/status_utils.h"
 
+#include <algorithm>
 #include <cstring>
+#include <iterator>
 #include <optional>
 #include <string>
 
@@ -35,6 +37,30 @@ namespace {
 constexpr std::string_view kTypeUrl =
     "type.googleapis.com/kmsp11.StatusDetails";
 
+// Statuses created by ExpectedError carry one of these raw codes. They are not
+// canonical absl::StatusCodes, so code() reports them as kUnknown and they
+// can't be produced by other libraries. A status with an empty message and no
+// payload holds its raw code inline, so creating one does not allocate.
+struct ExpectedRv {
+  CK_RV rv;
+  int raw_code;
+};
+
+constexpr ExpectedRv kExpectedRvs[] = {
+    {CKR_ATTRIBUTE_SENSITIVE, 0x4b4d0001},
+    {CKR_ATTRIBUTE_TYPE_INVALID, 0x4b4d0002},
+    {CKR_BUFFER_TOO_SMALL, 0x4b4d0003},
+};
+
+std::optional<CK_RV> ExpectedRvForStatus(const absl::Status& status) {
+  for (const ExpectedRv& expected : kExpectedRvs) {
+    if (expected.raw_code == status.raw_code()) {
+      return expected.rv;
+    }
+  }
+  return std::nullopt;
+}
+
 CK_RV ExtractRvFromCord(const absl::Cord& cord) {
   std::string payload(cord);
   StatusDetails details;
@@ -78,7 +104,7 @@ CK_RV GetCkRv(const absl::Status& status) {
 
   std::optional<absl::Cord> payload = status.GetPayload(kTypeUrl);
   if (!payload.has_value()) {
-    return kDefaultErrorCkRv;
+    return ExpectedRvForStatus(status).value_or(kDefaultErrorCkRv);
   }
 
   CK_RV rv = ExtractRvFromCord(*payload);
@@ -90,4 +116,17 @@ CK_RV GetCkRv(const absl::Status& status) {
   return rv;
 }
 
+absl::Status ExpectedError(CK_RV rv) {
+  const ExpectedRv* expected =
+      std::find_if(std::begin(kExpectedRvs), std::end(kExpectedRvs),
+                   [rv](const ExpectedRv& e) { return e.rv == rv; });
+  CHECK(expected != std::end(kExpectedRvs))
+      << "rv=" << rv << " is not an expected CK_RV";
+  return absl::Status(static_cast<absl::StatusCode>(expected->raw_code), "");
+}
+
+bool IsExpectedError(const absl::Status& status) {
+  return ExpectedRvForStatus(status).has_value();
+}
+
 }  // namespace cloud_kms::kmsp11
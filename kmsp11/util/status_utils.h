@@ -35,9 +35,22 @@ void SetErrorRv(absl::Status& status, CK_RV rv);
 
 // Get a CK_RV suitable for returning to a caller. For an `ok` status, this is
 // always CKR_OK. For a non-OK status, this is the value that was set using
-// SetCkRv, or if no value was set, `kDefaultErrorCkRv`.
+// SetCkRv or ExpectedError, or if no value was set, `kDefaultErrorCkRv`.
 CK_RV GetCkRv(const absl::Status& status);
 
+// Creates an error status for a CK_RV that callers routinely receive in the
+// normal course of operation, like CKR_ATTRIBUTE_TYPE_INVALID when probing for
+// attributes. The status has no message and no payload, so creating it does
+// not allocate, and it is not logged when returned from an entry point. It is
+// marked by a reserved, non-canonical raw code, so its code() is kUnknown.
+//
+// Only CKR_ATTRIBUTE_SENSITIVE, CKR_ATTRIBUTE_TYPE_INVALID and
+// CKR_BUFFER_TOO_SMALL may be provided; this requirement is CHECKed.
+absl::Status ExpectedError(CK_RV rv);
+
+// Returns true if the provided status was created with ExpectedError.
+bool IsExpectedError(const absl::Status& status);
+
 }  // namespace cloud_kms::kmsp11
 
 #endif  // KMSP11_UTIL_STATUS_UTILS_H_
@@ -14,9 +14,31 @@
 
 #include "kmsp11/util/status_utils.h"
 
+#include <cstdlib>
+#include <new>
+
 #include "absl/status/status.h"
 #include "gmock/gmock.h"
 
+namespace {
+
+// The number of allocations made by the current thread, so that tests can
+// check that an operation does not allocate.
+thread_local size_t allocation_count = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  allocation_count++;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
 namespace cloud_kms::kmsp11 {
 namespace {
 
@@ -68,6 +90,59 @@ TEST(GetCkRvTest, RetrieveVendorDefinedSetValue) {
   EXPECT_EQ(GetCkRv(s), custom_value);
 }
 
+TEST(ExpectedErrorTest, RetrieveExpectedValue) {
+  for (CK_RV rv : {CKR_ATTRIBUTE_SENSITIVE, CKR_ATTRIBUTE_TYPE_INVALID,
+                   CKR_BUFFER_TOO_SMALL}) {
+    absl::Status s = ExpectedError(rv);
+    EXPECT_FALSE(s.ok());
+    EXPECT_TRUE(IsExpectedError(s));
+    EXPECT_EQ(GetCkRv(s), rv);
+  }
+}
+
+TEST(ExpectedErrorTest, ExpectedErrorDoesNotAllocate) {
+  for (CK_RV rv : {CKR_ATTRIBUTE_SENSITIVE, CKR_ATTRIBUTE_TYPE_INVALID,
+                   CKR_BUFFER_TOO_SMALL}) {
+    size_t allocations_before = allocation_count;
+    absl::Status s = ExpectedError(rv);
+    bool is_expected = IsExpectedError(s);
+    CK_RV got_rv = GetCkRv(s);
+    size_t allocations = allocation_count - allocations_before;
+
+    EXPECT_EQ(allocations, 0) << "rv=" << rv;
+    EXPECT_TRUE(is_expected);
+    EXPECT_EQ(got_rv, rv);
+  }
+}
+
+TEST(ExpectedErrorTest, UnexpectedValue) {
+  EXPECT_DEATH(ExpectedError(CKR_DEVICE_ERROR),
+               "rv=48 is not an expected CK_RV");
+}
+
+TEST(ExpectedErrorTest, StatusWithMessageIsNotExpected) {
+  absl::Status s = absl::NotFoundError("foo");
+  EXPECT_FALSE(IsExpectedError(s));
+  EXPECT_EQ(GetCkRv(s), CKR_FUNCTION_FAILED);
+}
+
+TEST(ExpectedErrorTest, StatusWithoutMessageIsNotExpected) {
+  for (absl::StatusCode code :
+       {absl::StatusCode::kNotFound, absl::StatusCode::kPermissionDenied,
+        absl::StatusCode::kOutOfRange}) {
+    absl::Status s = absl::Status(code, "");
+    EXPECT_FALSE(IsExpectedError(s));
+    EXPECT_EQ(GetCkRv(s), CKR_FUNCTION_FAILED);
+  }
+}
+
+TEST(ExpectedErrorTest, StatusWithRvIsNotExpected) {
+  absl::Status s = absl::Status(absl::StatusCode::kOutOfRange, "");
+  SetErrorRv(s, CKR_DATA_LEN_RANGE);
+  EXPECT_FALSE(IsExpectedError(s));
+  EXPECT_EQ(GetCkRv(s), CKR_DATA_LEN_RANGE);
+}
+
 TEST(StatusPayloadTest, StatusToStringIsReadable) {
   ASSERT_EQ(CKR_SESSION_CLOSED, 0xb0);
 